@@ -0,0 +1,482 @@
+/*  Accuracy-vs-speed harness for alternative detection paths. Every path
+ *  runs over the same inputs as the reference path; a single table reports
+ *  per path the time per image and the speedup over the reference, the
+ *  mAP@0.5:0.95, and how far its detections drift from the reference: IoU
+ *  and score deltas of matched boxes, and the fraction of unmatched boxes.
+ *  The exit code is 2 if any path exceeds one of the tolerances.
+ *
+ *  Inputs are either
+ *    --capture file    tensors recorded with yolov5_detect --record. Only
+ *                      post-processing runs, so no GPU is needed. There are
+ *                      no labels, so the mAP is measured against the
+ *                      reference detections. Paths:
+ *                        reference     internal::postprocessOutput()
+ *                        fp16-output   the same, on outputs rounded to
+ *                                      half precision as an FP16 output
+ *                                      binding would deliver them
+ *  or
+ *    --engine file --images dir [--labels dir]
+ *                      a small labeled image set (YOLO text labels with
+ *                      the same name as the image), detected end-to-end.
+ *                      Without labels, the mAP is measured against the
+ *                      reference detections. Paths:
+ *                        reference     OpenCV-CPU pre-processing at the
+ *                                      engine input size
+ *                        cuda-preprocessing   OpenCV-CUDA pre-processing
+ *                        inference-sizes      input size with the least
+ *                                      padding (dynamic engines only)
+ *                        mosaic        images packed onto shared inputs
+ *  New fast paths are added to the list of paths of their input kind.
+ *
+ *  Usage: ./yolov5_accuracy_benchmark (--capture file |
+ *             --engine file --images dir [--labels dir])
+ *             [--score-threshold 0.001] [--repeat 3]
+ *             [--max-map-drop 0.005] [--max-iou-delta 0.02]
+ *             [--max-score-delta 0.01] [--max-unmatched 0.01]
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "yolov5_calibrator.h"
+#include "yolov5_detector.h"
+#include "yolov5_evaluation.h"
+#include "yolov5_mosaic.h"
+#include "yolov5_replay.h"
+
+namespace {
+
+typedef std::vector<std::vector<yolov5::Detection>> DetectionSet;
+
+struct Options {
+  Options()
+      : scoreThreshold(0.001),
+        repeat(3),
+        maxMapDrop(0.005),
+        maxIouDelta(0.02),
+        maxScoreDelta(0.01),
+        maxUnmatched(0.01) {}
+
+  std::string captureFile;
+  std::string engineFile;
+  std::string imagesDir;
+  std::string labelsDir;
+
+  double scoreThreshold; /**<    images only; captures use the recorded */
+  int repeat;
+
+  /*  Tolerances, relative to the reference path   */
+  double maxMapDrop;    /**<    absolute mAP@0.5:0.95 */
+  double maxIouDelta;   /**<    mean 1 - IoU of matched boxes   */
+  double maxScoreDelta; /**<    mean score difference of matched boxes  */
+  double maxUnmatched;  /**<    fraction of unmatched boxes */
+};
+
+/**
+ * A way of obtaining detections. run() fills in the detections of every
+ * input and returns the time spent, in microseconds, or a negative value if
+ * the path is not available
+ */
+struct Path {
+  std::string name;
+  std::function<double(DetectionSet*, std::string* note)> run;
+};
+
+struct PathResult {
+  std::string name;
+  std::string note;
+  bool available;
+  double time; /**<    microseconds per image  */
+  DetectionSet detections;
+};
+
+double elapsedSince(const std::chrono::steady_clock::time_point& start) {
+  return std::chrono::duration<double, std::micro>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+/*  Best of several runs, so that a single hiccup does not count as a
+    slowdown   */
+PathResult runPath(const Path& path, const int& numImages,
+                   const int& repeat) {
+  PathResult result;
+  result.name = path.name;
+  result.available = false;
+  result.time = 0.0;
+  for (int i = 0; i < std::max(1, repeat); ++i) {
+    DetectionSet detections;
+    const double time = path.run(&detections, &result.note);
+    if (time < 0.0) {
+      result.available = false;
+      return result;
+    }
+    if (!result.available || time < result.time * numImages) {
+      result.time = time / std::max(1, numImages);
+      result.detections.swap(detections);
+    }
+    result.available = true;
+  }
+  return result;
+}
+
+/*  Post-processing paths over the frames of a capture   */
+std::vector<Path> capturePaths(const yolov5::TensorCapture& capture,
+                               const std::shared_ptr<yolov5::Logger>& logger,
+                               std::vector<std::vector<float>>* fp16) {
+  const auto postprocess = [&capture, logger](
+                               const std::vector<const float*>& outputs,
+                               DetectionSet* out) {
+    double time = 0.0;
+    for (int f = 0; f < capture.numFrames(); ++f) {
+      const yolov5::TensorFrame& frame = capture.frame(f);
+      const int numGridBoxes = frame.outputDims.d[1];
+      const int rowSize = frame.outputDims.d[2];
+      for (int i = 0; i < frame.numImages; ++i) {
+        out->emplace_back();
+        const auto start = std::chrono::steady_clock::now();
+        const yolov5::Result r = yolov5::internal::postprocessOutput(
+            outputs[f] + i * numGridBoxes * rowSize, numGridBoxes, rowSize,
+            frame.scoreThreshold, frame.nmsThreshold, frame.transforms[i],
+            nullptr, logger, "accuracy", &out->back());
+        time += elapsedSince(start);
+        if (r != yolov5::RESULT_SUCCESS) {
+          return -1.0;
+        }
+      }
+    }
+    return time;
+  };
+
+  /*  Rounded once, up front, so that only post-processing is timed  */
+  std::vector<const float*> original, rounded;
+  for (int f = 0; f < capture.numFrames(); ++f) {
+    const yolov5::TensorFrame& frame = capture.frame(f);
+    const int volume =
+        frame.outputDims.d[0] * frame.outputDims.d[1] * frame.outputDims.d[2];
+    const cv::Mat output(1, volume, CV_32F, (void*)frame.output);
+    cv::Mat half, back;
+    output.convertTo(half, CV_16F);
+    half.convertTo(back, CV_32F);
+    fp16->emplace_back((const float*)back.data,
+                       (const float*)back.data + volume);
+    original.push_back(frame.output);
+  }
+  for (const std::vector<float>& output : *fp16) {
+    rounded.push_back(output.data());
+  }
+
+  std::vector<Path> paths;
+  paths.push_back({"reference", [postprocess, original](
+                                    DetectionSet* out, std::string* note) {
+                     YOLOV5_UNUSED(note);
+                     return postprocess(original, out);
+                   }});
+  paths.push_back({"fp16-output", [postprocess, rounded](
+                                      DetectionSet* out, std::string* note) {
+                     YOLOV5_UNUSED(note);
+                     return postprocess(rounded, out);
+                   }});
+  return paths;
+}
+
+/*  Set up a Detector for an image path; false if the path is not
+    available   */
+bool setupDetector(const Options& options, const int& flags,
+                   const std::shared_ptr<yolov5::Logger>& logger,
+                   yolov5::Detector* detector, std::string* note) {
+  detector->setLogger(logger);
+  if (detector->init(flags) != yolov5::RESULT_SUCCESS ||
+      detector->loadEngine(options.engineFile) != yolov5::RESULT_SUCCESS ||
+      detector->setScoreThreshold(options.scoreThreshold) !=
+          yolov5::RESULT_SUCCESS) {
+    *note = "could not set up the detector";
+    return false;
+  }
+  return true;
+}
+
+double detectImages(yolov5::Detector* detector,
+                    const std::vector<cv::Mat>& images, DetectionSet* out) {
+  out->resize(images.size());
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < images.size(); ++i) {
+    if (detector->detect(images[i], &(*out)[i], yolov5::INPUT_BGR) !=
+        yolov5::RESULT_SUCCESS) {
+      return -1.0;
+    }
+  }
+  return elapsedSince(start);
+}
+
+/*  End-to-end paths over the images. Every path has its own Detector,
+    set up (and warmed up) once, outside of the timed runs  */
+std::vector<Path> imagePaths(
+    const Options& options, const std::vector<cv::Mat>& images,
+    const std::shared_ptr<yolov5::Logger>& logger,
+    std::vector<std::unique_ptr<yolov5::Detector>>* detectors,
+    std::vector<std::unique_ptr<yolov5::MosaicDetector>>* mosaics) {
+  std::vector<Path> paths;
+  const auto addDetectorPath = [&](const std::string& name, const int& flags,
+                                   const std::function<bool(
+                                       yolov5::Detector*, std::string*)>&
+                                       configure) {
+    detectors->emplace_back(new yolov5::Detector());
+    yolov5::Detector* detector = detectors->back().get();
+    std::string note;
+    const bool available =
+        setupDetector(options, flags, logger, detector, &note) &&
+        (!configure || configure(detector, &note)) &&
+        detector->warmup() == yolov5::RESULT_SUCCESS;
+    paths.push_back({name, [detector, available, note, &images](
+                               DetectionSet* out, std::string* outNote) {
+                       *outNote = note;
+                       if (!available) {
+                         return -1.0;
+                       }
+                       return detectImages(detector, images, out);
+                     }});
+    return detector;
+  };
+
+  addDetectorPath("reference", yolov5::PREPROCESSOR_CVCPU, nullptr);
+
+  if (yolov5::internal::opencvHasCuda()) {
+    addDetectorPath("cuda-preprocessing", yolov5::PREPROCESSOR_CVCUDA,
+                    nullptr);
+  } else {
+    paths.push_back({"cuda-preprocessing",
+                     [](DetectionSet* out, std::string* note) {
+                       YOLOV5_UNUSED(out);
+                       *note = "OpenCV lacks CUDA";
+                       return -1.0;
+                     }});
+  }
+
+  /*  portrait and landscape sizes with less padding than the engine size */
+  addDetectorPath(
+      "inference-sizes", yolov5::PREPROCESSOR_CVCPU,
+      [](yolov5::Detector* detector, std::string* note) {
+        const cv::Size size = detector->inferenceSize();
+        const int reduced = std::max(32, (size.height * 3 / 5) / 32 * 32);
+        const std::vector<cv::Size> sizes = {
+            size, cv::Size(size.width, reduced),
+            cv::Size(reduced, size.height)};
+        if (detector->setInferenceSizes(sizes) != yolov5::RESULT_SUCCESS) {
+          *note = "engine has static dimensions";
+          return false;
+        }
+        return true;
+      });
+
+  yolov5::Detector* mosaicDetector =
+      addDetectorPath("mosaic-setup", yolov5::PREPROCESSOR_CVCPU, nullptr);
+  paths.pop_back();
+  mosaics->emplace_back(new yolov5::MosaicDetector());
+  yolov5::MosaicDetector* mosaic = mosaics->back().get();
+  const bool mosaicAvailable = mosaic->setup(mosaicDetector) ==
+                               yolov5::RESULT_SUCCESS;
+  paths.push_back({"mosaic", [mosaic, mosaicAvailable, &images](
+                                 DetectionSet* out, std::string* note) {
+                     if (!mosaicAvailable) {
+                       *note = "could not set up the detector";
+                       return -1.0;
+                     }
+                     const auto start = std::chrono::steady_clock::now();
+                     if (mosaic->detect(images, out) !=
+                         yolov5::RESULT_SUCCESS) {
+                       return -1.0;
+                     }
+                     return elapsedSince(start);
+                   }});
+  return paths;
+}
+
+bool loadImages(const Options& options, std::vector<cv::Mat>* images,
+                DetectionSet* labels) {
+  std::vector<std::string> files;
+  if (yolov5::CalibrationStream::listImages(options.imagesDir, &files) !=
+      yolov5::RESULT_SUCCESS) {
+    std::printf("Could not list %s\n", options.imagesDir.c_str());
+    return false;
+  }
+  for (const std::string& file : files) {
+    cv::Mat image = cv::imread(file);
+    if (image.empty()) {
+      continue;
+    }
+    images->push_back(image);
+    if (options.labelsDir.empty()) {
+      continue;
+    }
+
+    const std::filesystem::path labelFile =
+        std::filesystem::path(options.labelsDir) /
+        std::filesystem::path(file).stem().concat(".txt");
+    labels->emplace_back();
+    if (yolov5::loadYoloLabels(labelFile.string(), image.size(),
+                               &labels->back()) != yolov5::RESULT_SUCCESS) {
+      std::printf("Invalid labels for %s\n", file.c_str());
+      return false;
+    }
+  }
+  if (images->empty()) {
+    std::printf("No images in %s\n", options.imagesDir.c_str());
+    return false;
+  }
+  return true;
+}
+
+/*  Print the table; returns the number of paths beyond the tolerances  */
+int report(const std::vector<PathResult>& results, const DetectionSet& labels,
+           const Options& options) {
+  const PathResult& reference = results.front();
+  const DetectionSet& groundTruth =
+      labels.empty() ? reference.detections : labels;
+  const double referenceMap =
+      yolov5::meanAveragePrecision(reference.detections, groundTruth);
+
+  std::printf(
+      "\nmAP@0.5:0.95 against %s\n"
+      "%-20s %10s %8s %8s %8s %15s %15s %10s  %s\n",
+      labels.empty() ? "the reference detections" : "the labels", "path",
+      "us/image", "speedup", "mAP", "dmAP", "IoU d mean/max",
+      "score d mean/max", "unmatched", "status");
+
+  int failures = 0;
+  for (const PathResult& result : results) {
+    if (!result.available) {
+      std::printf("%-20s %10s %8s %8s %8s %15s %15s %10s  n/a (%s)\n",
+                  result.name.c_str(), "-", "-", "-", "-", "-", "-", "-",
+                  result.note.c_str());
+      continue;
+    }
+
+    const double map =
+        yolov5::meanAveragePrecision(result.detections, groundTruth);
+    yolov5::DetectionDrift drift;
+    for (size_t i = 0; i < result.detections.size(); ++i) {
+      drift.add(reference.detections[i], result.detections[i]);
+    }
+
+    std::string status;
+    if (referenceMap - map > options.maxMapDrop) {
+      status += " mAP";
+    }
+    if (drift.meanIouDelta() > options.maxIouDelta) {
+      status += " IoU";
+    }
+    if (drift.meanScoreDelta() > options.maxScoreDelta) {
+      status += " score";
+    }
+    if (drift.unmatchedFraction() > options.maxUnmatched) {
+      status += " unmatched";
+    }
+    failures += status.empty() ? 0 : 1;
+
+    char iou[32], score[32];
+    std::snprintf(iou, sizeof(iou), "%.4f/%.4f", drift.meanIouDelta(),
+                  drift.maxIouDelta());
+    std::snprintf(score, sizeof(score), "%.4f/%.4f", drift.meanScoreDelta(),
+                  drift.maxScoreDelta());
+    std::printf("%-20s %10.1f %7.2fx %8.4f %+8.4f %15s %15s %9.2f%%  %s\n",
+                result.name.c_str(), result.time,
+                result.time > 0.0 ? reference.time / result.time : 0.0,
+                map, map - referenceMap, iou, score,
+                100.0 * drift.unmatchedFraction(),
+                status.empty() ? "ok" : ("FAIL:" + status).c_str());
+  }
+  return failures;
+}
+
+} /*  namespace   */
+
+int main(int argc, char* argv[]) {
+  Options options;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const std::string arg = argv[i];
+    const char* value = argv[i + 1];
+    if (arg == "--capture") {
+      options.captureFile = value;
+    } else if (arg == "--engine") {
+      options.engineFile = value;
+    } else if (arg == "--images") {
+      options.imagesDir = value;
+    } else if (arg == "--labels") {
+      options.labelsDir = value;
+    } else if (arg == "--score-threshold") {
+      options.scoreThreshold = std::atof(value);
+    } else if (arg == "--repeat") {
+      options.repeat = std::atoi(value);
+    } else if (arg == "--max-map-drop") {
+      options.maxMapDrop = std::atof(value);
+    } else if (arg == "--max-iou-delta") {
+      options.maxIouDelta = std::atof(value);
+    } else if (arg == "--max-score-delta") {
+      options.maxScoreDelta = std::atof(value);
+    } else if (arg == "--max-unmatched") {
+      options.maxUnmatched = std::atof(value);
+    } else {
+      std::printf("Unknown option: %s\n", arg.c_str());
+      return 1;
+    }
+  }
+  if (options.captureFile.empty() ==
+      (options.engineFile.empty() || options.imagesDir.empty())) {
+    std::printf(
+        "Specify either --capture, or --engine and --images (see the "
+        "header of accuracy_benchmark.cc)\n");
+    return 1;
+  }
+
+  std::shared_ptr<yolov5::Logger> logger = std::make_shared<yolov5::Logger>();
+  logger->setMinLevel(yolov5::LOGGING_WARNING);
+
+  /*  Inputs and paths; the objects the paths refer to live until the end */
+  yolov5::TensorCapture capture;
+  std::vector<std::vector<float>> fp16;
+  std::vector<cv::Mat> images;
+  DetectionSet labels;
+  std::vector<std::unique_ptr<yolov5::Detector>> detectors;
+  std::vector<std::unique_ptr<yolov5::MosaicDetector>> mosaics;
+  std::vector<Path> paths;
+  int numImages = 0;
+  if (!options.captureFile.empty()) {
+    capture.setLogger(logger);
+    if (capture.open(options.captureFile) != yolov5::RESULT_SUCCESS) {
+      return 1;
+    }
+    for (int f = 0; f < capture.numFrames(); ++f) {
+      numImages += capture.frame(f).numImages;
+    }
+    paths = capturePaths(capture, logger, &fp16);
+  } else {
+    if (!loadImages(options, &images, &labels)) {
+      return 1;
+    }
+    numImages = images.size();
+    paths = imagePaths(options, images, logger, &detectors, &mosaics);
+  }
+
+  std::vector<PathResult> results;
+  for (const Path& path : paths) {
+    results.push_back(runPath(path, numImages, options.repeat));
+  }
+  if (!results.front().available) {
+    std::printf("The reference path failed: %s\n",
+                results.front().note.c_str());
+    return 1;
+  }
+
+  const int failures = report(results, labels, options);
+  if (failures > 0) {
+    std::printf("%i path(s) beyond the tolerances\n", failures);
+    return 2;
+  }
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,473 @@
+/*  CPU benchmarks of the host-side hot paths of the Detector. All inputs
+ *  are synthetic, so neither a GPU nor an engine is needed:
+ *    preprocess      CvCpuPreprocessor::process() in host-only mode, per
+ *                    input resolution and color order (640x640 network)
+ *    decode          internal::decodeOutput() of a 640x640 YoloV5 output
+ *                    (25200 rows, 80 classes), per score threshold and
+ *                    fraction of rows that become candidates
+ *    nms             cv::dnn::NMSBoxes() per number of candidates
+ *    transformBbox   PreprocessorTransform::transformBbox(), 1000 boxes
+ *    visualize       visualizeDetection() per number of detections
+ *  With --tensor, a recorded output tensor (raw float32, 85 values per row)
+ *  is decoded as well.
+ *
+ *  Every benchmark reports the median and minimum time per iteration over
+ *  a number of samples. --json writes the results as JSON; --baseline
+ *  compares the medians to those of an earlier JSON file and exits with 2
+ *  if any benchmark got slower by more than --threshold (default 0.1, i.e.
+ *  10%).
+ *
+ *  Usage: ./yolov5_host_benchmark [--filter substring] [--min-time seconds]
+ *             [--json out.json] [--baseline baseline.json]
+ *             [--threshold fraction] [--tensor output.bin]
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "yolov5_detection.h"
+#include "yolov5_detector_internal.h"
+
+namespace {
+
+const int NETWORK_SIZE = 640;
+const int NUM_GRID_BOXES = 25200; /**<    for a 640x640 input   */
+const int ROW_SIZE = 85;          /**<    80 classes   */
+
+struct Options {
+  Options() : minTime(0.5), threshold(0.1) {}
+
+  std::string filter;
+  double minTime; /**<    seconds per benchmark   */
+  std::string jsonFile;
+  std::string baselineFile;
+  double threshold;
+  std::string tensorFile;
+};
+
+struct Measurement {
+  std::string name;
+  int iterations;
+  double median; /**<    microseconds per iteration    */
+  double min;
+};
+
+/*  Run the function repeatedly for about minTime seconds, in samples of
+    several iterations each, so that short functions are not dominated
+    by the clock   */
+Measurement measure(const std::string& name, const double& minTime,
+                    const std::function<void()>& fn) {
+  typedef std::chrono::steady_clock Clock;
+  fn(); /*  warm up caches and buffers  */
+
+  const auto calibrationStart = Clock::now();
+  fn();
+  const double once = std::chrono::duration<double>(
+                          Clock::now() - calibrationStart)
+                          .count();
+  const int numSamples = 25;
+  const double sampleTime = minTime / numSamples;
+  const int perSample =
+      once > 0.0 ? std::max(1, (int)(sampleTime / once)) : 1000;
+
+  std::vector<double> samples;
+  const auto start = Clock::now();
+  while ((int)samples.size() < numSamples ||
+         std::chrono::duration<double>(Clock::now() - start).count() <
+             minTime) {
+    const auto sampleStart = Clock::now();
+    for (int i = 0; i < perSample; ++i) {
+      fn();
+    }
+    samples.push_back(std::chrono::duration<double, std::micro>(
+                          Clock::now() - sampleStart)
+                          .count() /
+                      perSample);
+    if ((int)samples.size() >= 10 * numSamples) {
+      break;
+    }
+  }
+
+  std::sort(samples.begin(), samples.end());
+  Measurement m;
+  m.name = name;
+  m.iterations = (int)samples.size() * perSample;
+  m.median = samples[samples.size() / 2];
+  m.min = samples.front();
+  return m;
+}
+
+/*  Output tensor of a single image in which about the given fraction of
+    the rows score above the threshold   */
+std::vector<float> syntheticOutput(const double& threshold,
+                                   const double& density) {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  std::uniform_real_distribution<float> center(0.0f, NETWORK_SIZE);
+  std::uniform_real_distribution<float> size(8.0f, 200.0f);
+  std::uniform_int_distribution<int> classId(0, ROW_SIZE - 6);
+
+  /*  objectness and class score of a candidate are at least sqrt(t), so
+      that their product reaches the threshold t  */
+  const float high = std::sqrt(threshold);
+  std::vector<float> output(NUM_GRID_BOXES * ROW_SIZE);
+  for (int i = 0; i < NUM_GRID_BOXES; ++i) {
+    float* row = output.data() + i * ROW_SIZE;
+    row[0] = center(rng);
+    row[1] = center(rng);
+    row[2] = size(rng);
+    row[3] = size(rng);
+    for (int c = 5; c < ROW_SIZE; ++c) {
+      row[c] = 0.05f * uniform(rng);
+    }
+    if (uniform(rng) < density) {
+      row[4] = high + (1.0f - high) * uniform(rng);
+      row[5 + classId(rng)] = high + (1.0f - high) * uniform(rng);
+    } else {
+      row[4] = 0.9f * threshold * uniform(rng);
+    }
+  }
+  return output;
+}
+
+/*  Candidates around a number of objects, as the decoder produces them:
+    several overlapping boxes per object   */
+void syntheticCandidates(const int& count, std::vector<cv::Rect>* boxes,
+                         std::vector<float>* scores) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> position(0, NETWORK_SIZE - 100);
+  std::uniform_int_distribution<int> size(16, 100);
+  std::uniform_int_distribution<int> jitter(-4, 4);
+  std::uniform_real_distribution<float> score(0.25f, 1.0f);
+
+  const int perObject = 5;
+  cv::Rect object;
+  for (int i = 0; i < count; ++i) {
+    if (i % perObject == 0) {
+      object = cv::Rect(position(rng), position(rng), size(rng), size(rng));
+    }
+    boxes->push_back(cv::Rect(object.x + jitter(rng), object.y + jitter(rng),
+                              object.width + jitter(rng),
+                              object.height + jitter(rng)));
+    scores->push_back(score(rng));
+  }
+}
+
+void runPreprocess(const Options& options,
+                   std::vector<Measurement>* results) {
+  const cv::Size resolutions[] = {cv::Size(640, 480), cv::Size(1280, 720),
+                                  cv::Size(1920, 1080), cv::Size(3840, 2160)};
+  const int flags[] = {yolov5::INPUT_BGR, yolov5::INPUT_RGB};
+
+  nvinfer1::Dims dims;
+  dims.nbDims = 4;
+  dims.d[0] = 1;
+  dims.d[1] = 3;
+  dims.d[2] = NETWORK_SIZE;
+  dims.d[3] = NETWORK_SIZE;
+
+  std::shared_ptr<yolov5::Logger> logger = std::make_shared<yolov5::Logger>();
+  for (const cv::Size& resolution : resolutions) {
+    cv::Mat image(resolution, CV_8UC3);
+    cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(255));
+
+    for (const int& flag : flags) {
+      const std::string name =
+          "preprocess/" + std::to_string(resolution.width) + "x" +
+          std::to_string(resolution.height) +
+          (flag == yolov5::INPUT_BGR ? "/bgr" : "/rgb");
+      if (name.find(options.filter) == std::string::npos) {
+        continue;
+      }
+
+      /*  host-only: no device memory, so nothing is copied  */
+      yolov5::internal::CvCpuPreprocessor preprocessor;
+      preprocessor.setLogger(logger);
+      if (!preprocessor.setup(dims, flag, 1, nullptr, nullptr)) {
+        std::printf("%s: setup failed\n", name.c_str());
+        continue;
+      }
+      results->push_back(measure(name, options.minTime, [&]() {
+        preprocessor.process(0, image, true);
+      }));
+    }
+  }
+}
+
+void runDecode(const std::string& name, const std::vector<float>& output,
+               const int& numGridBoxes, const double& threshold,
+               const Options& options, std::vector<Measurement>* results) {
+  if (name.find(options.filter) == std::string::npos) {
+    return;
+  }
+  std::vector<cv::Rect> boxes;
+  std::vector<float> scores;
+  std::vector<int> classes;
+  results->push_back(measure(name, options.minTime, [&]() {
+    boxes.clear();
+    scores.clear();
+    classes.clear();
+    yolov5::internal::decodeOutput(output.data(), numGridBoxes, ROW_SIZE,
+                                   threshold, &boxes, &scores, &classes);
+  }));
+}
+
+void runDecodes(const Options& options, std::vector<Measurement>* results) {
+  const double thresholds[] = {0.25, 0.5};
+  const double densities[] = {0.001, 0.01, 0.1};
+  for (const double& threshold : thresholds) {
+    for (const double& density : densities) {
+      char name[64];
+      std::snprintf(name, sizeof(name), "decode/t%.2f/d%.3f", threshold,
+                    density);
+      const std::vector<float> output = syntheticOutput(threshold, density);
+      runDecode(name, output, NUM_GRID_BOXES, threshold, options, results);
+    }
+  }
+
+  if (options.tensorFile.empty()) {
+    return;
+  }
+  std::ifstream file(options.tensorFile, std::ios::binary);
+  std::vector<char> bytes((std::istreambuf_iterator<char>(file)),
+                          std::istreambuf_iterator<char>());
+  const int numGridBoxes = bytes.size() / (ROW_SIZE * sizeof(float));
+  if (!file.good() && !file.eof()) {
+    std::printf("Could not read tensor %s\n", options.tensorFile.c_str());
+    return;
+  }
+  if (numGridBoxes == 0) {
+    std::printf("Tensor %s holds no rows of %i values\n",
+                options.tensorFile.c_str(), ROW_SIZE);
+    return;
+  }
+  std::vector<float> output(numGridBoxes * ROW_SIZE);
+  std::memcpy(output.data(), bytes.data(), output.size() * sizeof(float));
+  for (const double& threshold : thresholds) {
+    char name[64];
+    std::snprintf(name, sizeof(name), "decode/recorded/t%.2f", threshold);
+    runDecode(name, output, numGridBoxes, threshold, options, results);
+  }
+}
+
+void runNms(const Options& options, std::vector<Measurement>* results) {
+  const int counts[] = {100, 1000, 5000};
+  for (const int& count : counts) {
+    const std::string name = "nms/" + std::to_string(count);
+    if (name.find(options.filter) == std::string::npos) {
+      continue;
+    }
+    std::vector<cv::Rect> boxes;
+    std::vector<float> scores;
+    syntheticCandidates(count, &boxes, &scores);
+    std::vector<int> indices;
+    results->push_back(measure(name, options.minTime, [&]() {
+      cv::dnn::NMSBoxes(boxes, scores, 0.25f, 0.45f, indices);
+    }));
+  }
+}
+
+void runTransformBbox(const Options& options,
+                      std::vector<Measurement>* results) {
+  const std::string name = "transformBbox/1000";
+  if (name.find(options.filter) == std::string::npos) {
+    return;
+  }
+  std::vector<cv::Rect> boxes;
+  std::vector<float> scores;
+  syntheticCandidates(1000, &boxes, &scores);
+
+  /*  1920x1080 letterboxed into 640x640   */
+  const yolov5::internal::PreprocessorTransform transform(
+      cv::Size(1920, 1080), 1.0 / 3.0, 0, 140);
+  std::vector<cv::Rect> out(boxes.size());
+  results->push_back(measure(name, options.minTime, [&]() {
+    for (size_t i = 0; i < boxes.size(); ++i) {
+      out[i] = transform.transformBbox(boxes[i]);
+    }
+  }));
+}
+
+void runVisualize(const Options& options,
+                  std::vector<Measurement>* results) {
+  const int counts[] = {10, 100};
+  const char* names[] = {"person", "car", "bicycle", "dog"};
+  for (const int& count : counts) {
+    const std::string name = "visualize/" + std::to_string(count);
+    if (name.find(options.filter) == std::string::npos) {
+      continue;
+    }
+    std::vector<cv::Rect> boxes;
+    std::vector<float> scores;
+    syntheticCandidates(count, &boxes, &scores);
+    std::vector<yolov5::Detection> detections;
+    for (int i = 0; i < count; ++i) {
+      const cv::Rect& box = boxes[i];
+      detections.emplace_back(
+          i % 4, cv::Rect(2 * box.x, 2 * box.y, 2 * box.width, 2 * box.height),
+          scores[i]);
+      detections.back().setClassName(names[i % 4]);
+    }
+
+    /*  drawing does not depend on the content of the image, so the same
+        image is drawn onto repeatedly. The console output of
+        visualizeDetection() is discarded  */
+    cv::Mat image(720, 1280, CV_8UC3, cv::Scalar(40, 40, 40));
+    std::ostringstream discard;
+    std::streambuf* console = std::cout.rdbuf(discard.rdbuf());
+    results->push_back(measure(name, options.minTime, [&]() {
+      discard.str("");
+      yolov5::visualizeDetection(detections, &image, 30);
+    }));
+    std::cout.rdbuf(console);
+  }
+}
+
+bool writeJson(const std::string& filepath,
+               const std::vector<Measurement>& results) {
+  std::FILE* file = std::fopen(filepath.c_str(), "w");
+  if (file == nullptr) {
+    return false;
+  }
+  /*  one benchmark per line, which is what readBaseline() expects  */
+  std::fprintf(file, "{\n  \"unit\": \"us\",\n  \"benchmarks\": [\n");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Measurement& m = results[i];
+    std::fprintf(file,
+                 "    {\"name\": \"%s\", \"iterations\": %i, "
+                 "\"median\": %.4f, \"min\": %.4f}%s\n",
+                 m.name.c_str(), m.iterations, m.median, m.min,
+                 i + 1 < results.size() ? "," : "");
+  }
+  std::fprintf(file, "  ]\n}\n");
+  return std::fclose(file) == 0;
+}
+
+bool readBaseline(const std::string& filepath,
+                  std::map<std::string, double>* medians) {
+  std::ifstream file(filepath);
+  if (!file.good()) {
+    return false;
+  }
+  std::string line;
+  while (std::getline(file, line)) {
+    const char* name = std::strstr(line.c_str(), "\"name\": \"");
+    const char* median = std::strstr(line.c_str(), "\"median\": ");
+    if (name == nullptr || median == nullptr) {
+      continue;
+    }
+    name += std::strlen("\"name\": \"");
+    const char* nameEnd = std::strchr(name, '"');
+    if (nameEnd == nullptr) {
+      continue;
+    }
+    (*medians)[std::string(name, nameEnd)] =
+        std::atof(median + std::strlen("\"median\": "));
+  }
+  return true;
+}
+
+/*  Returns the number of regressions   */
+int compareBaseline(const std::vector<Measurement>& results,
+                    const std::map<std::string, double>& baseline,
+                    const double& threshold) {
+  int regressions = 0;
+  std::printf("\n%-28s %12s %12s %9s\n", "benchmark", "baseline us",
+              "current us", "change");
+  for (const Measurement& m : results) {
+    const auto it = baseline.find(m.name);
+    if (it == baseline.end() || it->second <= 0.0) {
+      std::printf("%-28s %12s %12.2f %9s\n", m.name.c_str(), "-", m.median,
+                  "new");
+      continue;
+    }
+    const double change = m.median / it->second - 1.0;
+    const bool regressed = change > threshold;
+    regressions += regressed ? 1 : 0;
+    std::printf("%-28s %12.2f %12.2f %+8.1f%%%s\n", m.name.c_str(),
+                it->second, m.median, 100.0 * change,
+                regressed ? "  REGRESSION" : "");
+  }
+  return regressions;
+}
+
+} /*  namespace   */
+
+int main(int argc, char* argv[]) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      std::printf("Missing value for %s\n", arg.c_str());
+      return 1;
+    }
+    const char* value = argv[++i];
+    if (arg == "--filter") {
+      options.filter = value;
+    } else if (arg == "--min-time") {
+      options.minTime = std::atof(value);
+    } else if (arg == "--json") {
+      options.jsonFile = value;
+    } else if (arg == "--baseline") {
+      options.baselineFile = value;
+    } else if (arg == "--threshold") {
+      options.threshold = std::atof(value);
+    } else if (arg == "--tensor") {
+      options.tensorFile = value;
+    } else {
+      std::printf("Unknown option: %s\n", arg.c_str());
+      return 1;
+    }
+  }
+  if (options.minTime <= 0.0 || options.threshold < 0.0) {
+    std::printf("Invalid --min-time or --threshold\n");
+    return 1;
+  }
+
+  std::map<std::string, double> baseline;
+  if (!options.baselineFile.empty() &&
+      !readBaseline(options.baselineFile, &baseline)) {
+    std::printf("Could not read baseline %s\n",
+                options.baselineFile.c_str());
+    return 1;
+  }
+
+  std::vector<Measurement> results;
+  runPreprocess(options, &results);
+  runDecodes(options, &results);
+  runNms(options, &results);
+  runTransformBbox(options, &results);
+  runVisualize(options, &results);
+
+  for (const Measurement& m : results) {
+    std::printf("%-28s %10.2f us median %10.2f us min %9i iterations\n",
+                m.name.c_str(), m.median, m.min, m.iterations);
+  }
+
+  if (!options.jsonFile.empty() && !writeJson(options.jsonFile, results)) {
+    std::printf("Could not write %s\n", options.jsonFile.c_str());
+    return 1;
+  }
+
+  if (!options.baselineFile.empty()) {
+    const int regressions =
+        compareBaseline(results, baseline, options.threshold);
+    if (regressions > 0) {
+      std::printf("%i benchmark(s) regressed by more than %.0f%%\n",
+                  regressions, 100.0 * options.threshold);
+      return 2;
+    }
+  }
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,133 @@
+/*  Benchmark of the cost of logging on the calling thread.
+ *
+ *  Producer threads log formatted messages as fast as they can, and the
+ *  time per call is measured on those threads, for:
+ *    - a message below the minimum level (filtered before formatting)
+ *    - the synchronous Logger, writing to /dev/null
+ *    - the AsyncLogger, writing to /dev/null on its background thread
+ *    - the AsyncLogger with one repeated message (rate limited)
+ *
+ *  The background thread of the AsyncLogger needs a core of its own;
+ *  otherwise its time is charged to the producers.
+ *
+ *  Usage: ./yolov5_logging_benchmark [numThreads ...]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "yolov5_logging.h"
+
+namespace {
+
+/*  Prints like the default Logger, but to a file   */
+class FileLogger : public yolov5::Logger {
+ public:
+  explicit FileLogger(std::FILE* file) noexcept : _file(file) {}
+
+  virtual void print(const yolov5::LogLevel& level, const char* msg) override {
+    std::fprintf(_file, "|yolov5|%s|%s\n", yolov5::loglevel_to_string(level),
+                 msg);
+  }
+
+ private:
+  std::FILE* _file;
+};
+
+/*  Nanoseconds per call, averaged over all threads   */
+double measure(const int& numThreads, const int& numCalls,
+               const std::function<void(int, int)>& call) {
+  std::vector<double> times(numThreads, 0.0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < numThreads; ++t) {
+    threads.emplace_back([t, numCalls, &call, &times]() {
+      const auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < numCalls; ++i) {
+        call(t, i);
+      }
+      times[t] = std::chrono::duration<double, std::nano>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+    });
+  }
+  double total = 0.0;
+  for (int t = 0; t < numThreads; ++t) {
+    threads[t].join();
+    total += times[t];
+  }
+  return total / ((double)numThreads * numCalls);
+}
+
+void runBenchmark(const int& numThreads, std::FILE* devNull) {
+  const int numCalls = 100000;
+
+  auto fileLogger = std::make_shared<FileLogger>(devNull);
+  fileLogger->setMinLevel(yolov5::LOGGING_INFO);
+  const double filtered =
+      measure(numThreads, numCalls, [&fileLogger](int t, int i) {
+        fileLogger->logf(yolov5::LOGGING_DEBUG,
+                         "[Benchmark] thread %i: message %i", t, i);
+      });
+  const double sync =
+      measure(numThreads, numCalls, [&fileLogger](int t, int i) {
+        fileLogger->logf(yolov5::LOGGING_ERROR,
+                         "[Benchmark] thread %i: message %i", t, i);
+      });
+
+  yolov5::AsyncLoggerOptions options;
+  options.capacity = 4096;
+  yolov5::AsyncLogger asyncLogger;
+  asyncLogger.setup(options, fileLogger);
+  const double async =
+      measure(numThreads, numCalls, [&asyncLogger](int t, int i) {
+        asyncLogger.logf(yolov5::LOGGING_ERROR,
+                         "[Benchmark] thread %i: message %i", t, i);
+      });
+  asyncLogger.flush();
+  const yolov5::AsyncLoggerStats unique = asyncLogger.stats();
+
+  const double limited =
+      measure(numThreads, numCalls, [&asyncLogger](int, int) {
+        asyncLogger.logf(yolov5::LOGGING_ERROR,
+                         "[Benchmark] detect() failure: %s", "no engine");
+      });
+  asyncLogger.stop();
+  const yolov5::AsyncLoggerStats total = asyncLogger.stats();
+
+  std::printf(
+      "%3i threads: filtered %6.1f ns, sync %7.1f ns, async %6.1f ns "
+      "(%lu dropped), rate limited %6.1f ns (%lu suppressed) per call\n",
+      numThreads, filtered, sync, async, (unsigned long)unique.dropped,
+      limited, (unsigned long)(total.suppressed - unique.suppressed));
+}
+
+} /*  namespace   */
+
+int main(int argc, char* argv[]) {
+  std::vector<int> counts;
+  for (int i = 1; i < argc; ++i) {
+    const int count = std::atoi(argv[i]);
+    if (count <= 0) {
+      std::printf("Invalid number of threads: %s\n", argv[i]);
+      return 1;
+    }
+    counts.push_back(count);
+  }
+  if (counts.empty()) {
+    counts = {1, 4};
+  }
+
+  std::FILE* devNull = std::fopen("/dev/null", "w");
+  if (devNull == nullptr) {
+    std::printf("Could not open /dev/null\n");
+    return 1;
+  }
+  for (const int& count : counts) {
+    runBenchmark(count, devNull);
+  }
+  std::fclose(devNull);
+  return 0;
+}
\ No newline at end of file
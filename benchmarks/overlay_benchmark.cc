@@ -0,0 +1,96 @@
+/*  CPU benchmark of the OverlayRenderer against visualizeDetection().
+ *
+ *  Random detections of a few classes are drawn onto a 1920x1080 frame,
+ *  and the time per frame is measured for both. The console output of
+ *  visualizeDetection() is discarded, so that only drawing is measured.
+ *
+ *  Usage: ./yolov5_overlay_benchmark [numDetections ...]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+#include "yolov5_overlay.h"
+
+namespace {
+
+void runBenchmark(const int& numDetections, const int& numFrames) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> x(0, 1800);
+  std::uniform_int_distribution<int> y(20, 1000);
+  std::uniform_int_distribution<int> size(20, 200);
+  std::uniform_real_distribution<double> score(0.3, 1.0);
+  const char* names[] = {"person", "car", "bicycle", "dog"};
+
+  std::vector<yolov5::Detection> detections;
+  for (int i = 0; i < numDetections; ++i) {
+    const int classId = i % 4;
+    detections.emplace_back(classId,
+                            cv::Rect(x(rng), y(rng), size(rng), size(rng)),
+                            score(rng));
+    detections.back().setClassName(names[classId]);
+  }
+
+  const cv::Mat background(1080, 1920, CV_8UC3, cv::Scalar(40, 40, 40));
+  cv::Mat image;
+
+  yolov5::OverlayRenderer overlay;
+  overlay.setup();
+  double overlayTime = 0.0;
+  for (int frame = 0; frame < numFrames; ++frame) {
+    background.copyTo(image);
+    const auto start = std::chrono::steady_clock::now();
+    overlay.render(detections, &image);
+    overlay.renderText("FPS: " + std::to_string(frame % 60),
+                       cv::Point(10, 30), cv::Scalar(0, 255, 0), &image);
+    overlayTime += std::chrono::duration<double, std::micro>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  }
+
+  std::ostringstream discard;
+  std::streambuf* console = std::cout.rdbuf(discard.rdbuf());
+  double visualizeTime = 0.0;
+  for (int frame = 0; frame < numFrames; ++frame) {
+    background.copyTo(image);
+    discard.str("");
+    const auto start = std::chrono::steady_clock::now();
+    yolov5::visualizeDetection(detections, &image, frame % 60);
+    visualizeTime += std::chrono::duration<double, std::micro>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+  }
+  std::cout.rdbuf(console);
+
+  std::printf(
+      "%6i detections: OverlayRenderer %8.1f us/frame, "
+      "visualizeDetection %8.1f us/frame (%.1fx), %i cached labels\n",
+      numDetections, overlayTime / numFrames, visualizeTime / numFrames,
+      overlayTime > 0.0 ? visualizeTime / overlayTime : 0.0,
+      (int)overlay.cacheSize());
+}
+
+} /*  namespace   */
+
+int main(int argc, char* argv[]) {
+  std::vector<int> counts;
+  for (int i = 1; i < argc; ++i) {
+    const int count = std::atoi(argv[i]);
+    if (count <= 0) {
+      std::printf("Invalid number of detections: %s\n", argv[i]);
+      return 1;
+    }
+    counts.push_back(count);
+  }
+  if (counts.empty()) {
+    counts = {10, 100, 1000};
+  }
+
+  for (const int& count : counts) {
+    runBenchmark(count, 200);
+  }
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,158 @@
+/*  Replays a capture file recorded by a TensorRecorder (yolov5_detect
+ *  --record) through the host-side post-processing of the Detector:
+ *  decoding, non-max suppression and transforming the boxes to image space.
+ *  Neither the model nor a GPU is needed.
+ *
+ *  The first pass checks that every frame yields exactly the detections
+ *  that were recorded; further passes only measure. The exit code is 1 if
+ *  any frame differs. Overriding a threshold disables the check, which is
+ *  useful to see how the time per frame depends on it.
+ *
+ *  Usage: ./yolov5_replay_benchmark capture.bin [--repeat N]
+ *             [--score-threshold value] [--nms-threshold value]
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "yolov5_replay.h"
+
+namespace {
+
+bool sameDetections(const std::vector<yolov5::Detection>& a,
+                    const std::vector<yolov5::Detection>& b,
+                    std::string* difference) {
+  if (a.size() != b.size()) {
+    *difference = std::to_string(a.size()) + " detections instead of " +
+                  std::to_string(b.size());
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (a[i].classId() != b[i].classId() ||
+        a[i].boundingBox() != b[i].boundingBox() ||
+        std::fabs(a[i].score() - b[i].score()) > 1e-6) {
+      char buffer[256];
+      const cv::Rect& r = a[i].boundingBox();
+      const cv::Rect& e = b[i].boundingBox();
+      std::snprintf(buffer, sizeof(buffer),
+                    "detection %i: class %i (%i,%i %ix%i) score %.6f, "
+                    "recorded class %i (%i,%i %ix%i) score %.6f",
+                    (int)i, a[i].classId(), r.x, r.y, r.width, r.height,
+                    a[i].score(), b[i].classId(), e.x, e.y, e.width,
+                    e.height, b[i].score());
+      *difference = buffer;
+      return false;
+    }
+  }
+  return true;
+}
+
+} /*  namespace   */
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    std::printf(
+        "Usage: %s capture.bin [--repeat N] [--score-threshold value] "
+        "[--nms-threshold value]\n",
+        argv[0]);
+    return 1;
+  }
+  int repeat = 10;
+  double scoreThreshold = -1.0, nmsThreshold = -1.0;
+  for (int i = 2; i + 1 < argc; i += 2) {
+    const std::string arg = argv[i];
+    if (arg == "--repeat") {
+      repeat = std::atoi(argv[i + 1]);
+    } else if (arg == "--score-threshold") {
+      scoreThreshold = std::atof(argv[i + 1]);
+    } else if (arg == "--nms-threshold") {
+      nmsThreshold = std::atof(argv[i + 1]);
+    } else {
+      std::printf("Unknown option: %s\n", arg.c_str());
+      return 1;
+    }
+  }
+  const bool check = scoreThreshold < 0.0 && nmsThreshold < 0.0;
+
+  std::shared_ptr<yolov5::Logger> logger = std::make_shared<yolov5::Logger>();
+  yolov5::TensorCapture capture;
+  capture.setLogger(logger);
+  if (capture.open(argv[1]) != yolov5::RESULT_SUCCESS) {
+    return 1;
+  }
+  if (capture.numFrames() == 0) {
+    std::printf("%s holds no frames\n", argv[1]);
+    return 1;
+  }
+
+  int numImages = 0, numMismatches = 0;
+  std::vector<double> frameTimes;
+  std::vector<yolov5::Detection> detections;
+  for (int pass = 0; pass < std::max(1, repeat); ++pass) {
+    for (int f = 0; f < capture.numFrames(); ++f) {
+      const yolov5::TensorFrame& frame = capture.frame(f);
+      const int numGridBoxes = frame.outputDims.d[1];
+      const int rowSize = frame.outputDims.d[2];
+      const double score =
+          scoreThreshold >= 0.0 ? scoreThreshold : frame.scoreThreshold;
+      const double nms =
+          nmsThreshold >= 0.0 ? nmsThreshold : frame.nmsThreshold;
+
+      const auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < frame.numImages; ++i) {
+        detections.clear();
+        const yolov5::Result r = yolov5::internal::postprocessOutput(
+            frame.output + i * numGridBoxes * rowSize, numGridBoxes, rowSize,
+            score, nms, frame.transforms[i], nullptr, logger, "replay",
+            &detections);
+        if (r != yolov5::RESULT_SUCCESS) {
+          return 1;
+        }
+
+        std::string difference;
+        if (pass == 0 && check &&
+            !sameDetections(detections, frame.detections[i], &difference)) {
+          numMismatches += 1;
+          std::printf("Frame %lu, image %i differs: %s\n",
+                      (unsigned long)frame.sequence, i, difference.c_str());
+        }
+      }
+      frameTimes.push_back(std::chrono::duration<double, std::micro>(
+                               std::chrono::steady_clock::now() - start)
+                               .count());
+      numImages += frame.numImages;
+    }
+  }
+
+  double total = 0.0;
+  for (const double& t : frameTimes) {
+    total += t;
+  }
+  std::sort(frameTimes.begin(), frameTimes.end());
+  const auto percentile = [&frameTimes](const double& p) {
+    return frameTimes[std::min(frameTimes.size() - 1,
+                               (size_t)(p * frameTimes.size()))];
+  };
+  std::printf(
+      "%i frames (%i images) x %i passes: %.1f us/frame mean, p50 %.1f us, "
+      "p99 %.1f us, max %.1f us, %.0f images/s\n",
+      capture.numFrames(), numImages / std::max(1, repeat),
+      std::max(1, repeat), total / frameTimes.size(), percentile(0.5),
+      percentile(0.99), frameTimes.back(),
+      total > 0.0 ? numImages / (total / 1e6) : 0.0);
+
+  if (!check) {
+    std::printf("Thresholds overridden: detections not checked\n");
+    return 0;
+  }
+  if (numMismatches > 0) {
+    std::printf("%i image(s) differ from the recording\n", numMismatches);
+    return 1;
+  }
+  std::printf("All detections match the recording\n");
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,563 @@
+/*  Soak test: drives detection for hours, with engine reloads, threshold
+ *  changes and varying input sizes, and watches for slow regressions that
+ *  short benchmarks miss: memory that grows with every reload or frame,
+ *  and latency that drifts upwards.
+ *
+ *  Every --interval seconds, a sample is printed (and written to --csv):
+ *  p50/p99/p99.9 latency of the interval, the resident set size, the heap
+ *  in use according to malloc, and the engine memory. At the end, a line
+ *  is fitted through every series, ignoring the first --warmup fraction
+ *  of the samples, and growth beyond the tolerances is flagged; the exit
+ *  code is then 2. Only steady trends are flagged (R^2 of the fit at
+ *  least --min-r2), so that a single spike does not fail the run.
+ *
+ *  Backends:
+ *    --engine file     a Detector. Reloads go through loadEngineAsync(),
+ *                      so detection continues while the engine is
+ *                      swapped. Engine memory is that of
+ *                      Detector::memoryUsage(); the device memory in use
+ *                      is sampled as well.
+ *    (none)            a mock backend that needs no GPU: the host-only
+ *                      CvCpuPreprocessor, a synthetic output and the
+ *                      Detector's post-processing, with the bindings in a
+ *                      DeviceMemory like an engine instance. Every reload
+ *                      sets up a new instance (alternating between network
+ *                      sizes) and releases the old one; the engine memory
+ *                      is what the arena allocators have not freed.
+ *
+ *  Usage: ./yolov5_soak_benchmark [--engine file] [--duration 3600]
+ *             [--interval 10] [--reload-interval 60]
+ *             [--threshold-interval 5] [--mock-inference-ms 2]
+ *             [--csv samples.csv] [--warmup 0.1] [--min-r2 0.5]
+ *             [--max-rss-growth 16] [--max-heap-growth 16]
+ *             [--max-engine-growth 1] [--max-device-growth 16]
+ *             [--max-p99-growth 0.1]
+ *  Growth limits are in MiB per hour, the p99 limit is a fraction of the
+ *  mean p99 per hour. Ctrl+C ends the run early, with the report.
+ */
+#include <cuda_runtime_api.h>
+#include <malloc.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "yolov5_detector.h"
+#include "yolov5_detector_internal.h"
+#include "yolov5_stats.h"
+
+namespace {
+
+struct Options {
+  Options()
+      : duration(3600.0),
+        interval(10.0),
+        reloadInterval(60.0),
+        thresholdInterval(5.0),
+        mockInferenceMs(2.0),
+        warmup(0.1),
+        minRSquared(0.5),
+        maxRssGrowth(16.0),
+        maxHeapGrowth(16.0),
+        maxEngineGrowth(1.0),
+        maxDeviceGrowth(16.0),
+        maxP99Growth(0.1) {}
+
+  std::string engineFile;
+  double duration; /**<    seconds   */
+  double interval;
+  double reloadInterval;
+  double thresholdInterval;
+  double mockInferenceMs;
+  std::string csvFile;
+
+  double warmup;      /**<    fraction of the samples not fitted  */
+  double minRSquared; /**<    only steady trends are flagged  */
+
+  /*  MiB per hour  */
+  double maxRssGrowth;
+  double maxHeapGrowth;
+  double maxEngineGrowth;
+  double maxDeviceGrowth;
+
+  double maxP99Growth; /**<    fraction of the mean p99 per hour  */
+};
+
+/*  A value of -1 means not available   */
+struct Sample {
+  double time; /**<    seconds since the start */
+  uint64_t frames;
+  uint64_t reloads;
+  double p50; /**<    milliseconds, over the interval   */
+  double p99;
+  double p999;
+  double rss; /**<    bytes   */
+  double heap;
+  double engine;
+  double device;
+};
+
+volatile std::sig_atomic_t interrupted = 0;
+
+void onInterrupt(int) { interrupted = 1; }
+
+double residentBytes() {
+  std::ifstream file("/proc/self/statm");
+  long size = 0, resident = 0;
+  if (!(file >> size >> resident)) {
+    return -1.0;
+  }
+  return (double)resident * (double)sysconf(_SC_PAGESIZE);
+}
+
+/*  Bytes allocated through malloc and not yet freed   */
+double heapBytes() {
+#if defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  const struct mallinfo2 info = mallinfo2();
+  return (double)info.uordblks + (double)info.hblkhd;
+#else
+  return -1.0;
+#endif
+}
+
+/**
+ * What the soak test drives. All calls are made from the main thread
+ */
+class Backend {
+ public:
+  virtual ~Backend() {}
+
+  virtual bool detect(const cv::Mat& image,
+                      std::vector<yolov5::Detection>* out) = 0;
+
+  /*  Start loading the engine again; may complete asynchronously   */
+  virtual bool reload() = 0;
+
+  virtual bool setThresholds(const double& score, const double& nms) = 0;
+
+  /*  Fill in the engine and device memory of the sample   */
+  virtual void sampleMemory(Sample* sample) = 0;
+};
+
+class DetectorBackend : public Backend {
+ public:
+  bool setup(const std::string& engineFile,
+             const std::shared_ptr<yolov5::Logger>& logger) {
+    _engineFile = engineFile;
+    _detector.setLogger(logger);
+    return _detector.init() == yolov5::RESULT_SUCCESS &&
+           _detector.loadEngine(engineFile) == yolov5::RESULT_SUCCESS;
+  }
+
+  ~DetectorBackend() {
+    if (_pending.valid()) {
+      _pending.wait();
+    }
+  }
+
+  virtual bool detect(const cv::Mat& image,
+                      std::vector<yolov5::Detection>* out) override {
+    return _detector.detect(image, out, yolov5::INPUT_BGR) ==
+           yolov5::RESULT_SUCCESS;
+  }
+
+  virtual bool reload() override {
+    if (_pending.valid()) {
+      if (_pending.wait_for(std::chrono::seconds(0)) !=
+          std::future_status::ready) {
+        return true; /*  still loading the previous one  */
+      }
+      if (_pending.get() != yolov5::RESULT_SUCCESS) {
+        return false;
+      }
+    }
+    _pending = _detector.loadEngineAsync(_engineFile);
+    return true;
+  }
+
+  virtual bool setThresholds(const double& score,
+                             const double& nms) override {
+    return _detector.setScoreThreshold(score) == yolov5::RESULT_SUCCESS &&
+           _detector.setNmsThreshold(nms) == yolov5::RESULT_SUCCESS;
+  }
+
+  virtual void sampleMemory(Sample* sample) override {
+    const yolov5::MemoryUsage usage = _detector.memoryUsage();
+    sample->engine = (double)(usage.deviceBytes + usage.hostBytes);
+
+    size_t free = 0, total = 0;
+    sample->device = -1.0;
+    if (cudaMemGetInfo(&free, &total) == 0) {
+      sample->device = (double)(total - free);
+    }
+  }
+
+ private:
+  yolov5::Detector _detector;
+  std::string _engineFile;
+  std::future<yolov5::Result> _pending;
+};
+
+class MockBackend : public Backend {
+ public:
+  MockBackend(const double& inferenceMs,
+              const std::shared_ptr<yolov5::Logger>& logger)
+      : _logger(logger),
+        _inferenceMs(inferenceMs),
+        _scoreThreshold(0.4),
+        _nmsThreshold(0.45),
+        _generation(0),
+        _deviceAllocator(std::make_shared<yolov5::internal::CountingAllocator>(
+            std::make_shared<yolov5::internal::HostAllocator>())),
+        _hostAllocator(std::make_shared<yolov5::internal::CountingAllocator>(
+            std::make_shared<yolov5::internal::HostAllocator>())) {}
+
+  virtual bool detect(const cv::Mat& image,
+                      std::vector<yolov5::Detection>* out) override {
+    std::shared_ptr<Instance> instance = _instance;
+    if (!instance || !instance->preprocessor.process(0, image, true)) {
+      return false;
+    }
+    if (_inferenceMs > 0.0) {
+      std::this_thread::sleep_for(
+          std::chrono::duration<double, std::milli>(_inferenceMs));
+    }
+    out->clear();
+    return yolov5::internal::postprocessOutput(
+               (const float*)instance->memory.hostAt(1),
+               instance->numGridBoxes, ROW_SIZE, _scoreThreshold,
+               _nmsThreshold, instance->preprocessor.transform(0), nullptr,
+               _logger, "detect", out) == yolov5::RESULT_SUCCESS;
+  }
+
+  /*  Set up a new instance, then release the old one, as the Detector
+      does   */
+  virtual bool reload() override {
+    static const cv::Size sizes[] = {cv::Size(640, 640), cv::Size(640, 384),
+                                     cv::Size(384, 640)};
+    const cv::Size size = sizes[_generation % 3];
+
+    std::shared_ptr<Instance> instance = std::make_shared<Instance>();
+    instance->preprocessor.setLogger(_logger);
+    instance->numGridBoxes = 0;
+    for (const int& stride : {8, 16, 32}) {
+      instance->numGridBoxes +=
+          3 * (size.width / stride) * (size.height / stride);
+    }
+
+    nvinfer1::Dims inputDims;
+    inputDims.nbDims = 4;
+    inputDims.d[0] = 1;
+    inputDims.d[1] = 3;
+    inputDims.d[2] = size.height;
+    inputDims.d[3] = size.width;
+    const std::vector<size_t> bindingSizes = {
+        (size_t)3 * size.area() * sizeof(float),
+        (size_t)instance->numGridBoxes * ROW_SIZE * sizeof(float)};
+    if (yolov5::internal::DeviceMemory::setup(
+            _logger, bindingSizes, {0, 1}, 1, _deviceAllocator,
+            _hostAllocator, &instance->memory) != yolov5::RESULT_SUCCESS ||
+        !instance->preprocessor.setup(
+            inputDims, yolov5::INPUT_BGR, 1, nullptr,
+            (float*)instance->memory.hostAt(0))) {
+      return false;
+    }
+    _synthesizeOutput(instance->numGridBoxes, size,
+                      (float*)instance->memory.hostAt(1));
+
+    _instance = instance;
+    _generation += 1;
+    return true;
+  }
+
+  virtual bool setThresholds(const double& score,
+                             const double& nms) override {
+    _scoreThreshold = score;
+    _nmsThreshold = nms;
+    return true;
+  }
+
+  virtual void sampleMemory(Sample* sample) override {
+    sample->engine = (double)(_deviceAllocator->stats().liveBytes +
+                              _hostAllocator->stats().liveBytes);
+    sample->device = -1.0;
+  }
+
+ private:
+  static const int ROW_SIZE = 85; /**<    80 classes   */
+
+  struct Instance {
+    yolov5::internal::DeviceMemory memory;
+    yolov5::internal::CvCpuPreprocessor preprocessor;
+    int numGridBoxes;
+  };
+
+  /*  Mostly background, with a few hundred confident rows, clustered so
+      that non-max suppression has work to do   */
+  void _synthesizeOutput(const int& numGridBoxes, const cv::Size& size,
+                         float* output) {
+    std::mt19937 rng(1234 + _generation);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    for (int i = 0; i < numGridBoxes; ++i) {
+      float* row = output + i * ROW_SIZE;
+      row[0] = uniform(rng) * size.width;
+      row[1] = uniform(rng) * size.height;
+      row[2] = 8.0f + uniform(rng) * size.width / 4;
+      row[3] = 8.0f + uniform(rng) * size.height / 4;
+      const bool object = (i % 97) == 0;
+      row[4] = object ? 0.3f + 0.7f * uniform(rng) : 0.01f * uniform(rng);
+      for (int c = 5; c < ROW_SIZE; ++c) {
+        row[c] = 0.05f * uniform(rng);
+      }
+      row[5 + i % (ROW_SIZE - 5)] = object ? 0.9f : 0.1f;
+    }
+  }
+
+  std::shared_ptr<yolov5::Logger> _logger;
+  double _inferenceMs;
+  double _scoreThreshold;
+  double _nmsThreshold;
+  uint64_t _generation;
+
+  std::shared_ptr<yolov5::internal::CountingAllocator> _deviceAllocator;
+  std::shared_ptr<yolov5::internal::CountingAllocator> _hostAllocator;
+  std::shared_ptr<Instance> _instance;
+};
+
+void printSample(const Sample& s, std::FILE* file, const char* format) {
+  std::fprintf(file, format, s.time, (unsigned long)s.frames,
+               (unsigned long)s.reloads, s.p50, s.p99, s.p999,
+               s.rss / (1 << 20), s.heap / (1 << 20), s.engine / (1 << 20),
+               s.device / (1 << 20));
+}
+
+/*  Fit a line through a series; returns false if it grows faster than
+    the limit per hour   */
+bool checkTrend(const char* name, const std::vector<Sample>& samples,
+                const size_t& first, double Sample::*field,
+                const double& scale, const double& limit,
+                const bool& relative, const Options& options) {
+  yolov5::LinearTrend trend;
+  for (size_t i = first; i < samples.size(); ++i) {
+    if (samples[i].*field >= 0.0) {
+      trend.add(samples[i].time / 3600.0, samples[i].*field / scale);
+    }
+  }
+  if (trend.count() < 3) {
+    std::printf("%-8s %14s\n", name, "n/a");
+    return true;
+  }
+
+  const double max = relative ? limit * trend.meanY() : limit;
+  const bool growing =
+      trend.slope() > max && trend.rSquared() >= options.minRSquared;
+  std::printf("%-8s %+14.3f %10.3f %12.3f  %s\n", name, trend.slope(),
+              trend.rSquared(), max, growing ? "GROWING" : "ok");
+  return !growing;
+}
+
+int report(const std::vector<Sample>& samples,
+           const yolov5::LatencyHistogram& total, const Options& options) {
+  std::string latency;
+  total.toString(&latency);
+  std::printf("\nlatency: %s\n", latency.c_str());
+
+  const size_t first = (size_t)(options.warmup * samples.size());
+  std::printf(
+      "trends over %zu samples (after warm-up), per hour:\n"
+      "%-8s %14s %10s %12s\n",
+      samples.size() - first, "series", "slope", "R^2", "limit");
+  const double MiB = 1 << 20;
+  bool ok = true;
+  ok &= checkTrend("p99 ms", samples, first, &Sample::p99, 1.0,
+                   options.maxP99Growth, true, options);
+  ok &= checkTrend("rss MiB", samples, first, &Sample::rss, MiB,
+                   options.maxRssGrowth, false, options);
+  ok &= checkTrend("heap MiB", samples, first, &Sample::heap, MiB,
+                   options.maxHeapGrowth, false, options);
+  ok &= checkTrend("eng. MiB", samples, first, &Sample::engine, MiB,
+                   options.maxEngineGrowth, false, options);
+  ok &= checkTrend("dev. MiB", samples, first, &Sample::device, MiB,
+                   options.maxDeviceGrowth, false, options);
+  return ok ? 0 : 2;
+}
+
+} /*  namespace   */
+
+int main(int argc, char* argv[]) {
+  Options options;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const std::string arg = argv[i];
+    const char* value = argv[i + 1];
+    if (arg == "--engine") {
+      options.engineFile = value;
+    } else if (arg == "--duration") {
+      options.duration = std::atof(value);
+    } else if (arg == "--interval") {
+      options.interval = std::atof(value);
+    } else if (arg == "--reload-interval") {
+      options.reloadInterval = std::atof(value);
+    } else if (arg == "--threshold-interval") {
+      options.thresholdInterval = std::atof(value);
+    } else if (arg == "--mock-inference-ms") {
+      options.mockInferenceMs = std::atof(value);
+    } else if (arg == "--csv") {
+      options.csvFile = value;
+    } else if (arg == "--warmup") {
+      options.warmup = std::atof(value);
+    } else if (arg == "--min-r2") {
+      options.minRSquared = std::atof(value);
+    } else if (arg == "--max-rss-growth") {
+      options.maxRssGrowth = std::atof(value);
+    } else if (arg == "--max-heap-growth") {
+      options.maxHeapGrowth = std::atof(value);
+    } else if (arg == "--max-engine-growth") {
+      options.maxEngineGrowth = std::atof(value);
+    } else if (arg == "--max-device-growth") {
+      options.maxDeviceGrowth = std::atof(value);
+    } else if (arg == "--max-p99-growth") {
+      options.maxP99Growth = std::atof(value);
+    } else {
+      std::printf("Unknown option: %s\n", arg.c_str());
+      return 1;
+    }
+  }
+
+  std::shared_ptr<yolov5::Logger> logger = std::make_shared<yolov5::Logger>();
+  logger->setMinLevel(yolov5::LOGGING_WARNING);
+
+  std::unique_ptr<Backend> backend;
+  if (!options.engineFile.empty()) {
+    DetectorBackend* detector = new DetectorBackend();
+    backend.reset(detector);
+    if (!detector->setup(options.engineFile, logger)) {
+      std::printf("Could not load %s\n", options.engineFile.c_str());
+      return 1;
+    }
+  } else {
+    backend.reset(new MockBackend(options.mockInferenceMs, logger));
+    if (!backend->reload()) {
+      std::printf("Could not set up the mock backend\n");
+      return 1;
+    }
+    std::printf("No --engine: using the mock backend\n");
+  }
+
+  std::FILE* csv = nullptr;
+  if (!options.csvFile.empty()) {
+    csv = std::fopen(options.csvFile.c_str(), "w");
+    if (csv == nullptr) {
+      std::printf("Could not open %s\n", options.csvFile.c_str());
+      return 1;
+    }
+    std::fprintf(csv,
+                 "time,frames,reloads,p50_ms,p99_ms,p999_ms,rss_mib,"
+                 "heap_mib,engine_mib,device_mib\n");
+  }
+
+  /*  Landscape, portrait and odd sizes, so that the pre-processing
+      buffers are resized all the time   */
+  std::vector<cv::Mat> images;
+  for (const cv::Size& size :
+       {cv::Size(640, 480), cv::Size(1280, 720), cv::Size(1920, 1080),
+        cv::Size(480, 640), cv::Size(1001, 997), cv::Size(3840, 2160)}) {
+    images.emplace_back(size, CV_8UC3);
+    cv::randu(images.back(), cv::Scalar::all(0), cv::Scalar::all(255));
+  }
+
+  std::printf("%8s %10s %7s %8s %8s %8s %9s %9s %9s %9s\n", "time s",
+              "frames", "reloads", "p50 ms", "p99 ms", "p99.9 ms", "rss MiB",
+              "heap MiB", "eng. MiB", "dev. MiB");
+  const char* format =
+      "%8.0f %10lu %7lu %8.2f %8.2f %8.2f %9.1f %9.1f %9.1f %9.1f\n";
+
+  typedef std::chrono::steady_clock Clock;
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  std::vector<yolov5::Detection> detections;
+  yolov5::LatencyHistogram window, total;
+  std::vector<Sample> samples;
+  uint64_t frames = 0, reloads = 0, failures = 0;
+
+  const auto start = Clock::now();
+  double nextSample = options.interval;
+  double nextReload = options.reloadInterval;
+  double nextThresholds = 0.0;
+
+  std::signal(SIGINT, onInterrupt);
+  double now = 0.0;
+  while (now < options.duration && !interrupted) {
+    if (now >= nextThresholds) {
+      backend->setThresholds(0.2 + 0.4 * uniform(rng),
+                             0.3 + 0.3 * uniform(rng));
+      nextThresholds += options.thresholdInterval;
+    }
+    if (now >= nextReload) {
+      if (!backend->reload()) {
+        std::printf("Reload failed\n");
+        failures += 1;
+      }
+      reloads += 1;
+      nextReload += options.reloadInterval;
+    }
+
+    const cv::Mat& image = images[rng() % images.size()];
+    const auto detectStart = Clock::now();
+    if (!backend->detect(image, &detections)) {
+      failures += 1;
+    }
+    const auto detectEnd = Clock::now();
+    const uint64_t latency =
+        std::chrono::duration_cast<std::chrono::microseconds>(detectEnd -
+                                                              detectStart)
+            .count();
+    window.record(latency);
+    total.record(latency);
+    frames += 1;
+
+    now = std::chrono::duration<double>(detectEnd - start).count();
+    if (now >= nextSample) {
+      Sample sample;
+      sample.time = now;
+      sample.frames = frames;
+      sample.reloads = reloads;
+      sample.p50 = window.percentile(0.5) / 1000.0;
+      sample.p99 = window.percentile(0.99) / 1000.0;
+      sample.p999 = window.percentile(0.999) / 1000.0;
+      sample.rss = residentBytes();
+      sample.heap = heapBytes();
+      backend->sampleMemory(&sample);
+      samples.push_back(sample);
+      window.reset();
+
+      printSample(sample, stdout, format);
+      if (csv != nullptr) {
+        printSample(sample, csv,
+                    "%.3f,%lu,%lu,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n");
+        std::fflush(csv);
+      }
+      nextSample += options.interval;
+    }
+  }
+  std::signal(SIGINT, SIG_DFL);
+  if (csv != nullptr) {
+    std::fclose(csv);
+  }
+
+  if (failures > 0) {
+    std::printf("%lu failed detections or reloads\n",
+                (unsigned long)failures);
+  }
+  const int r = report(samples, total, options);
+  return failures > 0 ? 1 : r;
+}
\ No newline at end of file
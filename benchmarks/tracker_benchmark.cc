@@ -0,0 +1,121 @@
+/*  CPU benchmark of the Tracker with synthetic detections.
+ *
+ *  Objects move with constant velocity on a large canvas; their detections
+ *  are jittered and sometimes missed. For every number of objects, the
+ *  time per frame is measured for update() (a frame with detections) and
+ *  predict() (an extrapolated frame).
+ *
+ *  Usage: ./yolov5_tracker_benchmark [numObjects ...]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "yolov5_tracker.h"
+
+namespace {
+
+struct Object {
+  double x, y, vx, vy, width, height;
+  int classId;
+};
+
+void runBenchmark(const int& numObjects, const int& numFrames) {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> position(0.0, 40000.0);
+  std::uniform_real_distribution<double> velocity(-3.0, 3.0);
+  std::uniform_real_distribution<double> size(20.0, 80.0);
+  std::uniform_real_distribution<double> score(0.4, 0.95);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  std::normal_distribution<double> jitter(0.0, 1.0);
+
+  std::vector<Object> objects(numObjects);
+  for (Object& object : objects) {
+    object.x = position(rng);
+    object.y = position(rng);
+    object.vx = velocity(rng);
+    object.vy = velocity(rng);
+    object.width = size(rng);
+    object.height = size(rng);
+    object.classId = (int)(uniform(rng) * 4);
+  }
+
+  yolov5::TrackerOptions options;
+  options.detectionInterval = 3;
+  yolov5::Tracker tracker;
+  tracker.setup(options);
+
+  std::vector<yolov5::Detection> detections;
+  std::vector<yolov5::Track> tracks;
+  double updateTime = 0.0, predictTime = 0.0;
+  int numUpdates = 0, numPredicts = 0;
+  for (int frame = 0; frame < numFrames; ++frame) {
+    for (Object& object : objects) {
+      object.x += object.vx;
+      object.y += object.vy;
+    }
+
+    const bool detect = tracker.needsDetection();
+    if (detect) {
+      detections.clear();
+      for (const Object& object : objects) {
+        if (uniform(rng) < 0.05) {
+          continue; /*  missed  */
+        }
+        const cv::Rect box((int)(object.x + jitter(rng)),
+                           (int)(object.y + jitter(rng)),
+                           (int)(object.width + jitter(rng)),
+                           (int)(object.height + jitter(rng)));
+        detections.emplace_back(object.classId, box, score(rng));
+      }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    if (detect) {
+      tracker.update(detections, &tracks);
+    } else {
+      tracker.predict(&tracks);
+    }
+    const double elapsed = std::chrono::duration<double, std::micro>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+    if (detect) {
+      updateTime += elapsed;
+      numUpdates += 1;
+    } else {
+      predictTime += elapsed;
+      numPredicts += 1;
+    }
+  }
+
+  const yolov5::TrackerStats stats = tracker.stats();
+  std::printf(
+      "%7i objects: update %9.1f us/frame, predict %8.1f us/frame, "
+      "%7i confirmed tracks, %4.1f%% of frames skipped\n",
+      numObjects, numUpdates > 0 ? updateTime / numUpdates : 0.0,
+      numPredicts > 0 ? predictTime / numPredicts : 0.0, (int)tracks.size(),
+      100.0 * stats.skippedFraction());
+}
+
+} /*  namespace   */
+
+int main(int argc, char* argv[]) {
+  std::vector<int> counts;
+  for (int i = 1; i < argc; ++i) {
+    const int count = std::atoi(argv[i]);
+    if (count <= 0) {
+      std::printf("Invalid number of objects: %s\n", argv[i]);
+      return 1;
+    }
+    counts.push_back(count);
+  }
+  if (counts.empty()) {
+    counts = {100, 1000, 5000};
+  }
+
+  for (const int& count : counts) {
+    runBenchmark(count, 300);
+  }
+  return 0;
+}
\ No newline at end of file
@@ -4,11 +4,83 @@
 
 #include <cstring>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "yolov5_logging.h"
 
 namespace yolov5 {
+
+/**
+ * Shape of the network input, used to describe the optimization profile of
+ * an engine. A value of 0 means that the dimension of the ONNX model is used.
+ */
+struct InputShape {
+  InputShape() noexcept;
+
+  InputShape(const int& batchSize, const int& rows, const int& cols) noexcept;
+
+  int batchSize;
+  int rows;
+  int cols;
+};
+
+/**
+ * Options for INT8 calibration
+ */
+struct CalibrationOptions {
+  CalibrationOptions() noexcept;
+
+  /**<    Calibration images: either a directory, or a text file that lists
+          one image path per line   */
+  std::string images;
+
+  /**<    Optional path to the calibration table. If the file exists, it is
+          used as-is and calibration is skipped; otherwise it is written
+          once calibration finishes */
+  std::string cacheFile;
+
+  /**<    Number of threads used to decode and pre-process images. A value
+          of 0 uses the number of hardware threads */
+  int numThreads;
+
+  /**<    Maximum number of batches that are prepared in advance  */
+  int prefetchBatches;
+
+  /**<    Maximum number of batches used for calibration. A value of 0 uses
+          the entire dataset */
+  int maxBatches;
+};
+
+/**
+ * Additional options that control how an engine is built
+ */
+struct BuilderOptions {
+  BuilderOptions() noexcept;
+
+  /**<    Maximum amount of scratch memory (in bytes) that TensorRT may use
+          during tactic selection. Too small a value rules out the faster
+          tactics   */
+  size_t workspaceSize;
+
+  /**<    Optimization profile of the input. These are only used when the
+          ONNX model has dynamic dimensions (e.g. exported with
+          --dynamic). The engine is tuned for optShape, and accepts any
+          shape between minShape and maxShape. Use the same batch size for
+          all three for a fixed batch size. */
+  InputShape minShape;
+  InputShape optShape;
+  InputShape maxShape;
+
+  /**<    Optional path to a timing cache file. If the file exists, it is
+          used to speed up the build; afterwards it is (re-)written with
+          the updated cache  */
+  std::string timingCacheFile;
+
+  /**<    Calibration options, used when building at PRECISION_INT8   */
+  CalibrationOptions calibration;
+};
+
 class Builder {
  public:
   Builder() noexcept;
@@ -21,6 +93,10 @@ class Builder {
                      const std::string& outputFilePath,
                      Precision precision = PRECISION_FP32) const noexcept;
 
+  Result buildEngine(const std::string& inputFilePath,
+                     const std::string& outputFilePath, Precision precision,
+                     const BuilderOptions& options) const noexcept;
+
   Result setLogger(std::shared_ptr<Logger> logger) noexcept;
 
   std::shared_ptr<Logger> logger() const noexcept;
@@ -28,7 +104,23 @@ class Builder {
  private:
   Result _buildEngine(const std::string& inputFilePath,
                       std::shared_ptr<nvinfer1::IHostMemory>* output,
-                      Precision precision) const noexcept;
+                      Precision precision,
+                      const BuilderOptions& options) const noexcept;
+
+  Result _setupProfile(nvinfer1::IBuilder* builder,
+                       nvinfer1::INetworkDefinition* network,
+                       nvinfer1::IBuilderConfig* config,
+                       const BuilderOptions& options,
+                       nvinfer1::IOptimizationProfile** profile,
+                       nvinfer1::Dims* optDims) const noexcept;
+
+  Result _loadTimingCache(const std::string& filepath,
+                          nvinfer1::IBuilderConfig* config,
+                          std::unique_ptr<nvinfer1::ITimingCache>* output)
+      const noexcept;
+
+  Result _saveTimingCache(const std::string& filepath,
+                          nvinfer1::IBuilderConfig* config) const noexcept;
 
  private:
   bool _initialized;
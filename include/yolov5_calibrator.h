@@ -0,0 +1,179 @@
+#ifndef _YOLOV5_CALIBRATOR_HPP_
+#define _YOLOV5_CALIBRATOR_HPP_
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "yolov5_builder.h"
+#include "yolov5_detector_internal.h"
+
+namespace yolov5 {
+
+/**
+ * Streams a calibration dataset through the same letterbox pre-processing
+ * as the CvCpuPreprocessor. Images are decoded and pre-processed by a pool
+ * of worker threads, and handed out as complete NCHW batches through a
+ * bounded prefetch queue.
+ *
+ * This class only uses the CPU; it does not require a CUDA device.
+ */
+class CalibrationStream {
+ public:
+  CalibrationStream() noexcept;
+
+  ~CalibrationStream() noexcept;
+
+ private:
+  CalibrationStream(const CalibrationStream&);
+
+ public:
+  void setLogger(std::shared_ptr<Logger> logger) noexcept;
+
+  /**
+   * @brief               List the images of a calibration dataset
+   *
+   * @param path          Directory, or text file listing one image per line
+   * @param out           Output, sorted list of image paths
+   */
+  static Result listImages(const std::string& path,
+                           std::vector<std::string>* out) noexcept;
+
+  /**
+   * @brief               Start streaming the specified images
+   *
+   * @param files         Image files. Images that do not fill up a complete
+   *                      batch are not used
+   * @param inputDims     Network input dimensions (NCHW)
+   * @param numThreads    Number of worker threads (0: hardware threads)
+   * @param prefetch      Maximum number of batches prepared in advance
+   *
+   * @return              Result code
+   */
+  Result start(const std::vector<std::string>& files,
+               const nvinfer1::Dims& inputDims, const int& numThreads,
+               const int& prefetch) noexcept;
+
+  /**
+   * @brief               Stop the worker threads. Called automatically on
+   *                      destruction
+   */
+  void stop() noexcept;
+
+  /**
+   * @brief               Obtain the next batch
+   *
+   * The batches are handed out in the order in which they finish, which
+   * is not necessarily the order of the files. The buffer that was passed
+   * in is recycled for subsequent batches.
+   *
+   * @param batch         Output, NCHW batch of pre-processed images
+   *
+   * @return              True if a batch was obtained, False at the end of
+   *                      the dataset
+   */
+  bool next(std::vector<float>* batch) noexcept;
+
+  int numBatches() const noexcept;
+
+  /**
+   * @brief               Number of images that could not be decoded; these
+   *                      are replaced by black images
+   */
+  int numFailedImages() const noexcept;
+
+ private:
+  void _work() noexcept;
+
+  bool _processBatch(internal::CvCpuPreprocessor* preprocessor,
+                     const int& index, std::vector<float>* batch) noexcept;
+
+ private:
+  std::shared_ptr<Logger> _logger;
+
+  std::vector<std::string> _files;
+  nvinfer1::Dims _inputDims;
+  size_t _batchVolume;
+  int _numBatches;
+  int _prefetch;
+
+  std::vector<std::thread> _threads;
+
+  int _nextBatch;
+  std::atomic<int> _numFailedImages;
+
+  /*  note: the members below are protected by _mutex */
+  std::mutex _mutex;
+  std::condition_variable _queueNotFull;
+  std::condition_variable _queueNotEmpty;
+  std::deque<std::vector<float>> _queue;
+  std::vector<std::vector<float>> _freeBuffers;
+  int _numPending; /*  batches queued or being processed   */
+  int _numActiveWorkers;
+  bool _stopped;
+};
+
+/**
+ * INT8 entropy calibrator for TensorRT, fed by a CalibrationStream. The
+ * calibration table is persisted, so that subsequent builds can skip
+ * calibration entirely.
+ */
+class Int8Calibrator : public nvinfer1::IInt8EntropyCalibrator2 {
+ public:
+  Int8Calibrator() noexcept;
+
+  virtual ~Int8Calibrator() noexcept;
+
+ private:
+  Int8Calibrator(const Int8Calibrator&);
+
+ public:
+  /**
+   * @brief               Set up the calibrator
+   *
+   * @param logger        Logger to be used
+   * @param options       Calibration options
+   * @param inputName     Name of the network input
+   * @param inputDims     Shape of the calibration batches (NCHW)
+   *
+   * @return              Result code
+   */
+  Result setup(std::shared_ptr<Logger> logger,
+               const CalibrationOptions& options,
+               const std::string& inputName,
+               const nvinfer1::Dims& inputDims) noexcept;
+
+  virtual int32_t getBatchSize() const noexcept override;
+
+  virtual bool getBatch(void* bindings[], const char* names[],
+                        int32_t nbBindings) noexcept override;
+
+  virtual const void* readCalibrationCache(
+      std::size_t& length) noexcept override;
+
+  virtual void writeCalibrationCache(const void* ptr,
+                                     std::size_t length) noexcept override;
+
+ private:
+  std::shared_ptr<Logger> _logger;
+
+  CalibrationOptions _options;
+  std::string _inputName;
+  nvinfer1::Dims _inputDims;
+
+  bool _started;
+  int _numBatches;
+  CalibrationStream _stream;
+
+  std::vector<float> _hostBatch;
+  void* _deviceBatch;
+
+  std::vector<char> _cache;
+};
+
+} /*  namespace yolov5    */
+
+#endif /*  include guard   */
\ No newline at end of file
@@ -1,7 +1,9 @@
 #ifndef _YOLOV5_COMMON_HPP_
 #define _YOLOV5_COMMON_HPP_
 #pragma once
+#include <cstddef>
 #include <string>
+#include <vector>
 
 #define YOLOV5_UNUSED(x) (void)x;
 
@@ -57,11 +59,69 @@ enum Precision {
   PRECISION_FP32 = 0, /**<    32-bit floating point mode  */
 
   PRECISION_FP16 = 1, /**<    16-bit floating point mode  */
+
+  PRECISION_INT8 = 2, /**<    8-bit integer mode, requires calibration  */
 };
 
 const char* precision_to_string(Precision p) noexcept;
 
 bool precision_to_string(Precision p, std::string* out) noexcept;
+
+/**
+ * Memory used for the engine bindings
+ */
+struct MemoryUsage {
+  MemoryUsage() noexcept;
+
+  size_t deviceBytes;     /**<    size of the device arena    */
+  size_t hostBytes;       /**<    size of the host staging arena  */
+  size_t bindingBytes;    /**<    device memory used by bindings, i.e.
+                                  excluding alignment padding  */
+  bool hostPinned;        /**<    whether the host arena is page-locked */
+  int numBindings;        /**<    number of engine bindings   */
+  int numSlots;           /**<    number of in-flight slots   */
+};
+
+/**
+ * Options for warming up the Detector. The first detection on a freshly
+ * loaded engine pays for lazy initialization: allocation of the
+ * pre-processing buffers, initialization of OpenCV (CUDA) kernels and the
+ * first-enqueue setup of TensorRT for every input shape. Warming up runs
+ * synthetic detections for every configuration the application is going
+ * to use, so that this cost is paid before the first real frame.
+ */
+struct WarmupOptions {
+  WarmupOptions() noexcept;
+
+  /** number of synthetic detections per configuration. Default: 3 */
+  int iterations;
+
+  /** input flags to set up, e.g. INPUT_BGR. Empty: the default flags (0) */
+  std::vector<int> flags;
+
+  /** batch sizes to set up. Empty: 1 and the maximum batch size */
+  std::vector<int> batchSizes;
+
+  /** also set up cv::cuda::GpuMat inputs (requires OpenCV-CUDA) */
+  bool gpuInputs;
+};
+
+/**
+ * Latencies measured while warming up, in milliseconds. A configuration is
+ * a combination of input flags, input type, batch size and inference size.
+ */
+struct WarmupReport {
+  WarmupReport() noexcept;
+
+  int numConfigurations; /**<    number of configurations set up   */
+  int numDetections;     /**<    number of synthetic detections    */
+
+  double coldLatency;    /**<    first detection (the first-frame spike)  */
+  double maxColdLatency; /**<    slowest first detection of a configuration */
+  double warmLatency;    /**<    mean of the last detection per configuration */
+  double maxWarmLatency; /**<    slowest last detection of a configuration */
+};
+
 /**
  * Additional flags that can be passed to the Detector
  */
@@ -75,8 +135,12 @@ enum DetectorFlag {
   PREPROCESSOR_CVCUDA = 4,
   /**<    OpenCV-CUDA pre-processing should be used */
 
-  PREPROCESSOR_CVCPU = 8
+  PREPROCESSOR_CVCPU = 8,
   /**<    OpenCV-CPU pre-processing should be used */
+
+  INFERENCE_SIZE_SMALLEST = 16
+  /**<    run at the smallest of the inference sizes (see
+          Detector::setInferenceSizes()), trading accuracy for compute */
 };
 
 } /*  namespace yolov5    */
@@ -26,6 +26,8 @@ class Detection {
 
   const cv::Rect& boundingBox() const noexcept;
 
+  void setBoundingBox(const cv::Rect& boundingBox) noexcept;
+
   const double& score() const noexcept;
 
   const std::string& className() const noexcept;
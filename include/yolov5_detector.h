@@ -2,9 +2,37 @@
 #define _YOLOV5_DETECTOR_HPP_
 #pragma once
 
+#include <atomic>
+#include <future>
+#include <mutex>
+
 #include "yolov5_detector_internal.h"
+#include "yolov5_replay.h"
 
 namespace yolov5 {
+
+/**
+ * Statistics about the inference sizes selected by the Detector. The
+ * compute of the network scales with the number of input pixels, so the
+ * ratio between the pixels that were actually processed and the pixels at
+ * the reference size (the size the engine was optimized for) indicates
+ * the compute that was saved. The statistics cover all detections of the
+ * Detector, so streams that share a Detector are counted together.
+ */
+struct InferenceSizeStats {
+  InferenceSizeStats() noexcept;
+
+  uint64_t frames;          /**<    number of images processed    */
+  uint64_t inferencePixels; /**<    network pixels actually processed   */
+  uint64_t referencePixels; /**<    network pixels at the reference size */
+
+  /**
+   * @brief               Fraction of compute saved relative to always
+   *                      inferring at the reference size
+   */
+  double savedFraction() const noexcept;
+};
+
 class Detector {
  public:
   Detector() noexcept;
@@ -18,12 +46,61 @@ class Detector {
 
   bool isInitialized() const noexcept;
 
+  /**
+   * @brief               Load an engine. If an engine is already loaded,
+   *                      it keeps serving detections until the new engine
+   *                      has been loaded and warmed up; it is then replaced
+   *                      atomically. Detections that are in flight at that
+   *                      moment finish on the old engine; this method
+   *                      waits for them and releases the old engine, so
+   *                      that detection threads never pay for its teardown.
+   *
+   * This method may be called from another thread than the one(s) calling
+   * detect().
+   */
   Result loadEngine(const std::string& filepath) noexcept;
 
   Result loadEngine(const std::vector<char>& data) noexcept;
 
+  /**
+   * @brief               Load an engine on a background thread, see
+   *                      loadEngine(). Detections continue on the current
+   *                      engine in the meantime.
+   */
+  std::future<Result> loadEngineAsync(const std::string& filepath) noexcept;
+
   bool isEngineLoaded() const noexcept;
 
+  /**
+   * @brief               Sequence number of the loaded engine; incremented
+   *                      every time an engine is loaded. 0 if no engine is
+   *                      loaded.
+   */
+  uint64_t engineGeneration() const noexcept;
+
+  /**
+   * @brief               Run synthetic detections on the loaded engine, see
+   *                      WarmupOptions. Detections from other threads wait
+   *                      until the warm-up has finished.
+   * @param options       Configurations to warm up
+   * @param report        [out] Optional. Cold vs warm latencies
+   */
+  Result warmup(const WarmupOptions& options = WarmupOptions(),
+                WarmupReport* report = nullptr) noexcept;
+
+  /**
+   * @brief               Warm up every engine that is loaded from now on,
+   *                      before it starts serving detections. If disabled
+   *                      (the default), a single detection is run.
+   */
+  Result setWarmupOnLoad(const bool& enable,
+                         const WarmupOptions& options = WarmupOptions()) noexcept;
+
+  /**
+   * @brief               Report of the warm-up of the loaded engine
+   */
+  WarmupReport loadWarmupReport() const noexcept;
+
   int numClasses() const noexcept;
 
   Result setClasses(const Classes& classes) noexcept;
@@ -54,59 +131,130 @@ class Detector {
 
   cv::Size inferenceSize() const noexcept;
 
+  /**
+   * @brief               Specify the network input sizes the Detector may
+   *                      choose from. For every call, the size with the
+   *                      least letterbox padding is selected, e.g. 640x384
+   *                      for 16:9 video and 384x640 for portrait video.
+   *
+   * This requires an engine with dynamic rows and columns whose
+   * optimization profile covers all sizes. Sizes must be multiples of 32.
+   * An empty list restores the default, i.e. inferenceSize().
+   */
+  Result setInferenceSizes(const std::vector<cv::Size>& sizes) noexcept;
+
+  std::vector<cv::Size> inferenceSizes() const noexcept;
+
+  InferenceSizeStats inferenceSizeStats() const noexcept;
+
+  void resetInferenceSizeStats() noexcept;
+
+  /**
+   * @brief               Memory used for the bindings of the loaded engine
+   */
+  MemoryUsage memoryUsage() const noexcept;
+
   Result setLogger(std::shared_ptr<Logger> logger) noexcept;
 
   std::shared_ptr<Logger> logger() const noexcept;
 
+  /**
+   * @brief               Record the input and output tensors, transforms
+   *                      and detections of every call from now on, e.g. to
+   *                      replay them later with a TensorCapture. The
+   *                      recorder must be open and outlive its use by the
+   *                      Detector; nullptr stops recording.
+   *
+   * Recording copies the input back from the device, which slows down
+   * detection. Failures to record are logged, but do not fail detection.
+   */
+  Result setRecorder(TensorRecorder* recorder) noexcept;
+
  private:
   Detector& operator=(const Detector& rhs);
 
+  std::shared_ptr<internal::EngineInstance> _currentInstance() const noexcept;
+
   Result _loadEngine(const std::vector<char>& data) noexcept;
 
+  /*  Wait until the in-flight detections on a replaced instance have
+      finished, and destroy it on the calling thread   */
+  void _releaseInstance(
+      std::shared_ptr<internal::EngineInstance>* instance) noexcept;
+
+  Result _warmupInstance(internal::EngineInstance& instance,
+                         const WarmupOptions& options,
+                         WarmupReport* report) noexcept;
+
+  template <typename Image>
+  Result _warmupDetection(internal::EngineInstance& instance,
+                          const std::vector<Image>& images,
+                          const int& flags) noexcept;
+
   void _printBindings(
       const std::unique_ptr<nvinfer1::ICudaEngine>& engine) const noexcept;
 
-  int _batchSize() const noexcept;
+  int _batchSize(const internal::EngineInstance& instance) const noexcept;
+
+  int _numClasses(const internal::EngineInstance& instance) const noexcept;
 
-  int _numClasses() const noexcept;
+  Result _selectShape(internal::EngineInstance& instance, const char* logid,
+                      const cv::Size* inputSizes, const int& numInputs,
+                      const int& flags,
+                      const bool& accountStats = true) noexcept;
 
-  Result _detect(std::vector<Detection>* out);
+  Result _validateInferenceSizes(const char* logid,
+                                 const internal::EngineBinding& input,
+                                 const std::vector<cv::Size>& sizes) const
+      noexcept;
 
-  Result _detectBatch(const int& nrImages,
+  Result _detect(internal::EngineInstance& instance,
+                 std::vector<Detection>* out);
+
+  Result _detectBatch(internal::EngineInstance& instance, const int& nrImages,
                       std::vector<std::vector<Detection>>* out);
 
-  Result _inference(const char* logid);
+  Result _inference(internal::EngineInstance& instance, const char* logid);
+
+  Result _decodeOutput(internal::EngineInstance& instance, const char* logid,
+                       const int& index, std::vector<Detection>* out);
 
-  Result _decodeOutput(const char* logid, const int& index,
-                       std::vector<Detection>* out);
+  void _record(internal::EngineInstance& instance, TensorRecorder* recorder,
+               const int& nrImages,
+               const std::vector<Detection>* detections) noexcept;
 
  private:
   bool _initialized;
+  bool _useCudaPreprocessor;
 
   std::shared_ptr<Logger> _logger;
 
-  Classes _classes;
-  double _scoreThreshold;
-  double _nmsThreshold;
+  /*  Always accessed through std::atomic_load / std::atomic_store, so
+      that the classes can be set while detecting. nullptr if not set  */
+  std::shared_ptr<const Classes> _classes;
+  std::atomic<double> _scoreThreshold;
+  std::atomic<double> _nmsThreshold;
 
   /*  TensorRT    */
   std::unique_ptr<TensorRT_Logger> _trtLogger;
   std::unique_ptr<nvinfer1::IRuntime> _trtRuntime;
 
-  /*  note: execution context depends on the engine, and should be destroyed
-          _before_ the engine is destroyed */
-  std::unique_ptr<nvinfer1::ICudaEngine> _trtEngine;
-  std::unique_ptr<nvinfer1::IExecutionContext> _trtExecutionContext;
+  /*  The engine instance that new detections run on. Always accessed
+      through std::atomic_load / std::atomic_store  */
+  std::shared_ptr<internal::EngineInstance> _instance;
 
-  /*  I/O  */
-  internal::EngineBinding _inputBinding;
-  internal::EngineBinding _outputBinding;
+  /*  Serializes engine loads */
+  std::mutex _loadMutex;
+  uint64_t _lastGeneration;
 
-  std::unique_ptr<internal::Preprocessor> _preprocessor;
+  bool _warmupOnLoad;
+  WarmupOptions _warmupOptions;
 
-  internal::DeviceMemory _deviceMemory;
+  std::atomic<uint64_t> _statsFrames;
+  std::atomic<uint64_t> _statsInferencePixels;
+  std::atomic<uint64_t> _statsReferencePixels;
 
-  std::vector<float> _outputHostMemory;
+  std::atomic<TensorRecorder*> _recorder;
 };
 
 } /*  namespace yolov5    */
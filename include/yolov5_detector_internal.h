@@ -2,7 +2,9 @@
 #include <NvInfer.h>
 #include <NvInferRuntime.h>
 
+#include <mutex>
 #include <opencv2/opencv.hpp>
+#include <unordered_map>
 #include <vector>
 
 #include "yolov5_detection.h"
@@ -31,6 +33,17 @@ class EngineBinding {
 
   const nvinfer1::Dims& dims() const noexcept;
 
+  /**
+   * @brief           Dimensions of the optimization profile of the binding.
+   *                  For bindings without dynamic dimensions (and for
+   *                  output bindings), these are equal to dims()
+   */
+  const nvinfer1::Dims& minDims() const noexcept;
+
+  const nvinfer1::Dims& optDims() const noexcept;
+
+  const nvinfer1::Dims& maxDims() const noexcept;
+
   const int& volume() const noexcept;
 
   bool isDynamic() const noexcept;
@@ -53,12 +66,219 @@ class EngineBinding {
   nvinfer1::Dims _dims;
   int _volume; /*  note: calculated based on dims  */
 
+  nvinfer1::Dims _minDims;
+  nvinfer1::Dims _optDims;
+  nvinfer1::Dims _maxDims;
+
   bool _isInput;
 };
 
 /**
- * Used to manage memory on the CUDA device, corresponding to the engine
- * bindings.
+ * @brief               Size in bytes of a single element of the specified
+ *                      TensorRT data type, or 0 if it is unknown
+ */
+size_t dataTypeSize(const nvinfer1::DataType& type) noexcept;
+
+/**
+ * Allocator used for the memory arenas. Besides the CUDA allocators, a
+ * plain host allocator is provided, which can stand in for the CUDA ones
+ * when no device is available.
+ */
+class MemoryAllocator {
+ public:
+  MemoryAllocator() noexcept;
+
+  virtual ~MemoryAllocator() noexcept;
+
+ public:
+  /**
+   * @brief           Allocate memory. Returns nullptr on failure
+   */
+  virtual void* allocate(const size_t& size) noexcept = 0;
+
+  virtual void free(void* ptr) noexcept = 0;
+
+  virtual const char* name() const noexcept = 0;
+};
+
+/**
+ * Allocates memory on the CUDA device
+ */
+class CudaDeviceAllocator : public MemoryAllocator {
+ public:
+  virtual void* allocate(const size_t& size) noexcept override;
+
+  virtual void free(void* ptr) noexcept override;
+
+  virtual const char* name() const noexcept override;
+};
+
+/**
+ * Allocates page-locked (pinned) host memory, so that transfers to and
+ * from the device can be performed asynchronously
+ */
+class CudaPinnedAllocator : public MemoryAllocator {
+ public:
+  virtual void* allocate(const size_t& size) noexcept override;
+
+  virtual void free(void* ptr) noexcept override;
+
+  virtual const char* name() const noexcept override;
+};
+
+/**
+ * Allocates ordinary (pageable) host memory
+ */
+class HostAllocator : public MemoryAllocator {
+ public:
+  virtual void* allocate(const size_t& size) noexcept override;
+
+  virtual void free(void* ptr) noexcept override;
+
+  virtual const char* name() const noexcept override;
+};
+
+/**
+ * Statistics of a CountingAllocator
+ */
+struct AllocatorStats {
+  AllocatorStats() noexcept;
+
+  uint64_t allocations; /**<    successful allocations  */
+  uint64_t frees;       /**<    frees of allocated memory   */
+  uint64_t failures;    /**<    failed allocations  */
+  size_t liveBytes;     /**<    allocated and not yet freed */
+  size_t peakBytes;     /**<    highest value of liveBytes  */
+};
+
+/**
+ * Forwards to another allocator and keeps count of the allocations, e.g.
+ * to check that no memory is left behind when engines are reloaded.
+ * Thread-safe.
+ */
+class CountingAllocator : public MemoryAllocator {
+ public:
+  explicit CountingAllocator(std::shared_ptr<MemoryAllocator> allocator)
+      noexcept;
+
+  virtual void* allocate(const size_t& size) noexcept override;
+
+  virtual void free(void* ptr) noexcept override;
+
+  virtual const char* name() const noexcept override;
+
+  AllocatorStats stats() const noexcept;
+
+ private:
+  std::shared_ptr<MemoryAllocator> _allocator;
+
+  mutable std::mutex _mutex;
+  std::unordered_map<void*, size_t> _sizes;
+  AllocatorStats _stats;
+};
+
+/**
+ * Layout of the engine bindings of one or more in-flight slots within a
+ * single allocation. Every binding of every slot starts at a multiple of
+ * the alignment. Bindings with size 0 are not part of the arena.
+ */
+class ArenaLayout {
+ public:
+  ArenaLayout() noexcept;
+
+  ~ArenaLayout() noexcept;
+
+ public:
+  /**
+   * @brief           Compute the layout
+   *
+   * @param sizes     Size in bytes of every binding
+   * @param numSlots  Number of in-flight slots
+   * @param alignment Alignment in bytes; must be a power of two
+   *
+   * @return          True on success, False otherwise
+   */
+  bool setup(const std::vector<size_t>& sizes, const int& numSlots,
+             const size_t& alignment) noexcept;
+
+  void swap(ArenaLayout& other) noexcept;
+
+  int numBindings() const noexcept;
+
+  int numSlots() const noexcept;
+
+  /**
+   * @brief           Offset of a binding within the arena, in bytes
+   */
+  size_t offset(const int& binding, const int& slot) const noexcept;
+
+  /**
+   * @brief           Size of a binding in bytes (excluding padding)
+   */
+  size_t size(const int& binding) const noexcept;
+
+  /**
+   * @brief           Total size of the arena, in bytes
+   */
+  size_t totalSize() const noexcept;
+
+  /**
+   * @brief           Sum of the sizes of all bindings of all slots, i.e.
+   *                  the total size excluding alignment padding
+   */
+  size_t usedSize() const noexcept;
+
+ private:
+  std::vector<size_t> _sizes;
+  std::vector<size_t> _offsets; /*  within a slot   */
+  size_t _slotSize;
+  int _numSlots;
+};
+
+/**
+ * A single allocation, laid out according to an ArenaLayout
+ */
+class Arena {
+ public:
+  Arena() noexcept;
+
+  ~Arena() noexcept;
+
+ private:
+  Arena(const Arena&);
+
+ public:
+  void swap(Arena& other) noexcept;
+
+  /**
+   * @brief           Allocate the arena. Any previous allocation is freed
+   */
+  bool setup(const ArenaLayout& layout,
+             std::shared_ptr<MemoryAllocator> allocator) noexcept;
+
+  void release() noexcept;
+
+  /**
+   * @brief           Obtain a pointer to a binding, or nullptr if the
+   *                  binding is not part of the arena
+   */
+  void* at(const int& binding, const int& slot) const noexcept;
+
+  const ArenaLayout& layout() const noexcept;
+
+  const std::shared_ptr<MemoryAllocator>& allocator() const noexcept;
+
+ private:
+  ArenaLayout _layout;
+  std::shared_ptr<MemoryAllocator> _allocator;
+  char* _memory;
+};
+
+/**
+ * Used to manage the memory corresponding to the engine bindings: a single
+ * device arena holding all bindings of all in-flight slots, and a matching
+ * (pinned) host arena holding the host mirrors of selected bindings, such
+ * as the network input and output.
  */
 class DeviceMemory {
  public:
@@ -73,39 +293,128 @@ class DeviceMemory {
   void swap(DeviceMemory& other) noexcept;
 
   /**
-   * @brief           Get the beginning of the data. This can be passed onto
-   *                  the TensorRT engine
+   * @brief           Get the beginning of the binding pointers of a slot.
+   *                  This can be passed onto the TensorRT engine
    */
-  void** begin() const noexcept;
+  void** begin(const int& slot = 0) const noexcept;
 
   /**
    * @brief           Obtain a pointer to the device memory corresponding to
    *                  the specified binding
    *
    * @param index     Index of the engine binding
+   * @param slot      In-flight slot
    */
-  void* at(const int& index) const noexcept;
+  void* at(const int& index, const int& slot = 0) const noexcept;
+
+  /**
+   * @brief           Obtain a pointer to the host mirror of the specified
+   *                  binding, or nullptr if it is not mirrored
+   */
+  void* hostAt(const int& index, const int& slot = 0) const noexcept;
+
+  /**
+   * @brief           Size of the specified binding in bytes
+   */
+  size_t size(const int& index) const noexcept;
+
+  int numSlots() const noexcept;
+
+  MemoryUsage usage() const noexcept;
 
   /**
    * @brief           Try setting up the Device Memory based on the TensorRT
-   *                  engine
+   *                  engine. The dimensions of the bindings are taken from
+   *                  the execution context, so that for engines with
+   *                  dynamic dimensions, the input shapes can be set to the
+   *                  largest ones that will be used. Bindings are sized
+   *                  according to their data type.
    *
    *
    * @param logger    Logger to be used
    *
    * @param engine    TensorRT engine
+   * @param context   Execution context, with all input dimensions specified
+   * @param hostBindings  Indices of the bindings that get a host mirror
+   * @param numSlots  Number of in-flight slots
    * @param output    Output
    *
    * @return Result   Result code
    */
   static Result setup(const std::shared_ptr<Logger>& logger,
                       std::unique_ptr<nvinfer1::ICudaEngine>& engine,
+                      std::unique_ptr<nvinfer1::IExecutionContext>& context,
+                      const std::vector<int>& hostBindings,
+                      const int& numSlots, DeviceMemory* output) noexcept;
+
+  /**
+   * @brief           Set up the Device Memory from binding sizes. This does
+   *                  not depend on TensorRT; with a HostAllocator for both
+   *                  arenas, it does not depend on CUDA either.
+   *
+   * @param logger    Logger to be used
+   * @param sizes     Size in bytes of every binding
+   * @param hostBindings  Indices of the bindings that get a host mirror
+   * @param numSlots  Number of in-flight slots
+   * @param deviceAllocator   Allocator for the device arena
+   * @param hostAllocator     Allocator for the host arena
+   * @param output    Output
+   *
+   * @return Result   Result code
+   */
+  static Result setup(const std::shared_ptr<Logger>& logger,
+                      const std::vector<size_t>& sizes,
+                      const std::vector<int>& hostBindings,
+                      const int& numSlots,
+                      std::shared_ptr<MemoryAllocator> deviceAllocator,
+                      std::shared_ptr<MemoryAllocator> hostAllocator,
                       DeviceMemory* output) noexcept;
 
+  /**<    Alignment of every binding, in bytes */
+  static const size_t ALIGNMENT = 256;
+
  private:
-  std::vector<void*> _memory;
+  Arena _device;
+  Arena _host;
+
+  /*  binding pointers, per slot  */
+  std::vector<void*> _bindings;
 };
 
+/**
+ * @brief               Fraction of the network input that is covered by
+ *                      the image when it is letterboxed, in [0, 1]
+ */
+double letterboxFill(const cv::Size& input, const cv::Size& network) noexcept;
+
+/**
+ * @brief               Select the inference size that wastes the least
+ *                      compute on letterbox padding for the given inputs.
+ *                      Ties are broken in favour of the larger size, so
+ *                      that resolution is not given up.
+ *
+ * @param candidates    Candidate network input sizes
+ * @param inputs        Sizes of the input images (i.e. the batch)
+ * @param numInputs     Number of input images
+ *
+ * @return              Index of the selected candidate, or -1 if there are
+ *                      no candidates
+ */
+int selectInferenceSize(const std::vector<cv::Size>& candidates,
+                        const cv::Size* inputs, const int& numInputs) noexcept;
+
+/**
+ * @brief               Select the smallest inference size (by area). Among
+ *                      sizes of the same area, the one that wastes the
+ *                      least compute on letterbox padding is selected.
+ *
+ * @return              Index of the selected candidate, or -1 if there are
+ *                      no candidates
+ */
+int selectSmallestInferenceSize(const std::vector<cv::Size>& candidates,
+                                const cv::Size* inputs,
+                                const int& numInputs) noexcept;
+
 /**
  * @brief               Check whether OpenCV-CUDA is supported
  */
@@ -133,6 +442,14 @@ class PreprocessorTransform {
    */
   cv::Rect transformBbox(const cv::Rect& input) const noexcept;
 
+  const cv::Size& inputSize() const noexcept;
+
+  const double& scale() const noexcept; /**<    network / input   */
+
+  const int& leftWidth() const noexcept;
+
+  const int& topHeight() const noexcept;
+
  private:
   cv::Size _inputSize;
 
@@ -141,6 +458,74 @@ class PreprocessorTransform {
   int _topHeight;
 };
 
+/**
+ * @brief               Letterbox an image to the network input size: resize
+ *                      it while keeping the aspect ratio, and pad the
+ *                      remainder with black. If the image already has the
+ *                      network size, it is copied into 'output'; the
+ *                      output never refers to the memory of the input.
+ *
+ * @param input         Input image
+ * @param networkSize   Network input size
+ * @param buffer        Intermediate buffer for the resized image
+ * @param output        [out] Letterboxed image
+ * @param transform     [out] Transform from network space to input space
+ *
+ * Note: OpenCV exceptions are propagated to the caller.
+ */
+void letterbox(const cv::Mat& input, const cv::Size& networkSize,
+               cv::Mat* buffer, cv::Mat* output,
+               PreprocessorTransform* transform);
+
+/**
+ * @brief               Decode the YoloV5 output of a single image: every
+ *                      grid box whose score (objectness times the highest
+ *                      class score) reaches the threshold is appended to
+ *                      the candidates, in network space. Non-max
+ *                      suppression is left to the caller.
+ *
+ * @param output        Output of the image, numGridBoxes rows of
+ *                      (x, y, w, h, objectness, class scores...)
+ * @param numGridBoxes  Number of rows
+ * @param rowSize       Number of values per row, i.e. 5 + number of classes
+ * @param scoreThreshold  Minimum score of a candidate
+ * @param boxes         [out] Bounding boxes of the candidates
+ * @param scores        [out] Scores of the candidates
+ * @param classes       [out] Class with the highest score, per candidate
+ *
+ * Note: allocation exceptions are propagated to the caller.
+ */
+void decodeOutput(const float* output, const int& numGridBoxes,
+                  const int& rowSize, const double& scoreThreshold,
+                  std::vector<cv::Rect>* boxes, std::vector<float>* scores,
+                  std::vector<int>* classes);
+
+/**
+ * @brief               Post-process the YoloV5 output of a single image as
+ *                      the Detector does: decode, apply non-max
+ *                      suppression and transform the bounding boxes to
+ *                      input space
+ *
+ * @param output        Output of the image, see decodeOutput()
+ * @param numGridBoxes  Number of rows
+ * @param rowSize       Number of values per row
+ * @param scoreThreshold  Minimum score of a detection
+ * @param nmsThreshold  IoU threshold of non-max suppression
+ * @param transform     Transform from network space to input space
+ * @param classes       Optional. If loaded, used to name the detections
+ * @param logger        Logger for failures
+ * @param logid         Name of the calling method, for log messages
+ * @param out           [out] Detections are appended
+ */
+Result postprocessOutput(const float* output, const int& numGridBoxes,
+                         const int& rowSize, const double& scoreThreshold,
+                         const double& nmsThreshold,
+                         const PreprocessorTransform& transform,
+                         const Classes* classes,
+                         const std::shared_ptr<Logger>& logger,
+                         const char* logid,
+                         std::vector<Detection>* out) noexcept;
+
 /**
  * Used to perform pre-processing task, and to store intermediate buffers to
  * speed up repeated computations.
@@ -168,11 +553,15 @@ class Preprocessor {
    * @param batchSize     Number of images that will be processed (i.e. in
    *                      batch mode)
    * @param inputMemory   Start of input on the CUDA device
+   * @param hostInputMemory   Optional host staging memory for the input
+   *                      (ideally pinned). If nullptr, the preprocessor
+   *                      allocates its own memory if it needs any.
    *
    * @return              True on success, False otherwise
    */
   virtual bool setup(const nvinfer1::Dims& inputDims, const int& flags,
-                     const int& batchSize, float* inputMemory) noexcept = 0;
+                     const int& batchSize, float* inputMemory,
+                     float* hostInputMemory) noexcept = 0;
 
   virtual void reset() noexcept = 0;
 
@@ -205,6 +594,11 @@ class Preprocessor {
    */
   cv::Rect transformBbox(const int& index, const cv::Rect& bbox) const noexcept;
 
+  /**
+   * @brief               Transform of a particular image in the batch
+   */
+  const PreprocessorTransform& transform(const int& index) const noexcept;
+
  protected:
   std::shared_ptr<Logger> _logger;
 
@@ -213,6 +607,10 @@ class Preprocessor {
 
 /**
  * Preprocessing based on letterboxing with OpenCV CPU operations
+ *
+ * If no CUDA input memory is passed to setup(), the preprocessor works in
+ * host-only mode: the letterboxed input is only written to host memory
+ * (see hostInputMemory()), and no CUDA calls are made at all.
  */
 class CvCpuPreprocessor : public Preprocessor {
  public:
@@ -222,8 +620,13 @@ class CvCpuPreprocessor : public Preprocessor {
 
  public:
   virtual bool setup(const nvinfer1::Dims& inputDims, const int& flags,
-                     const int& batchSize,
-                     float* inputMemory) noexcept override;
+                     const int& batchSize, float* inputMemory,
+                     float* hostInputMemory) noexcept override;
+
+  /**
+   * @brief               Obtain the pre-processed input (NCHW) on the host
+   */
+  const float* hostInputMemory() const noexcept;
 
   virtual void reset() noexcept override;
 
@@ -252,7 +655,8 @@ class CvCpuPreprocessor : public Preprocessor {
 
   std::vector<std::vector<cv::Mat>> _inputChannels;
 
-  std::vector<float> _hostInputMemory;
+  std::vector<float> _hostInputBuffer; /*  if no staging memory is given */
+  float* _hostInputMemory;
   float* _deviceInputMemory;
 };
 
@@ -269,8 +673,8 @@ class CvCudaPreprocessor : public Preprocessor {
 
  public:
   virtual bool setup(const nvinfer1::Dims& inputDims, const int& flags,
-                     const int& batchSize,
-                     float* inputMemory) noexcept override;
+                     const int& batchSize, float* inputMemory,
+                     float* hostInputMemory) noexcept override;
 
   virtual void reset() noexcept override;
 
@@ -293,6 +697,8 @@ class CvCudaPreprocessor : public Preprocessor {
   int _networkCols;
   int _networkRows;
 
+  float* _inputMemory;
+
   cv::cuda::GpuMat _buffer0;
   cv::cuda::GpuMat _buffer1;
   cv::cuda::GpuMat _buffer2;
@@ -301,6 +707,56 @@ class CvCudaPreprocessor : public Preprocessor {
   std::vector<std::vector<cv::cuda::GpuMat>> _inputChannels;
 };
 
+/**
+ * Everything that depends on a particular engine: the engine itself, its
+ * execution context, bindings, memory and pre-processor.
+ *
+ * The Detector publishes instances atomically and every detection holds a
+ * reference to the instance it started on. A new engine can therefore be
+ * loaded and warmed up while detections continue on the current one; the
+ * old instance is destroyed once the last in-flight detection releases it.
+ */
+class EngineInstance {
+ public:
+  EngineInstance() noexcept;
+
+  ~EngineInstance() noexcept;
+
+ private:
+  EngineInstance(const EngineInstance&);
+
+ public:
+  /*  note: members are destroyed in reverse order: the execution context
+      is destroyed before the engine, and the pre-processor before the
+      memory it refers to */
+  std::unique_ptr<nvinfer1::ICudaEngine> engine;
+  std::unique_ptr<nvinfer1::IExecutionContext> context;
+
+  EngineBinding inputBinding;
+  EngineBinding outputBinding;
+
+  /*  Shapes currently set on the execution context. These only differ
+      from the binding dimensions for engines with dynamic dimensions  */
+  nvinfer1::Dims inputDims;
+  nvinfer1::Dims outputDims;
+
+  DeviceMemory memory;
+  float* outputHostMemory; /*  note: part of memory    */
+
+  std::unique_ptr<Preprocessor> preprocessor;
+
+  std::vector<cv::Size> inferenceSizes;
+  std::vector<cv::Size> batchInputSizes; /*  scratch buffer  */
+
+  /*  Sequence number of the instance, incremented for every load  */
+  uint64_t generation;
+
+  WarmupReport warmupReport;
+
+  /*  Serializes the detections that run on this instance   */
+  std::mutex mutex;
+};
+
 } /*  namespace internal  */
 
 } /*  namespace yolov5    */
\ No newline at end of file
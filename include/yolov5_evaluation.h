@@ -0,0 +1,100 @@
+#ifndef _YOLOV5_EVALUATION_HPP_
+#define _YOLOV5_EVALUATION_HPP_
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "yolov5_detection.h"
+
+namespace yolov5 {
+
+/**
+ * @brief               Intersection over union of two boxes, in [0, 1]
+ */
+double intersectionOverUnion(const cv::Rect& a, const cv::Rect& b) noexcept;
+
+/**
+ * @brief               Mean average precision at a single IoU threshold,
+ *                      computed as COCO does: per class, detections of all
+ *                      images are matched to the ground truth in order of
+ *                      decreasing score, and the precision is interpolated
+ *                      at 101 recall points. Classes without ground truth
+ *                      are ignored.
+ * @param detections    Detections per image
+ * @param groundTruth   Labeled objects per image (scores are ignored)
+ * @return              mAP in [0, 1], or -1 if there is no ground truth
+ */
+double averagePrecision(
+    const std::vector<std::vector<Detection>>& detections,
+    const std::vector<std::vector<Detection>>& groundTruth,
+    const double& iouThreshold) noexcept;
+
+/**
+ * @brief               mAP@0.5:0.95, i.e. averagePrecision() averaged over
+ *                      the IoU thresholds 0.5, 0.55, ..., 0.95
+ */
+double meanAveragePrecision(
+    const std::vector<std::vector<Detection>>& detections,
+    const std::vector<std::vector<Detection>>& groundTruth) noexcept;
+
+/**
+ * @brief               Load the labels of an image in the YOLO text
+ *                      format: one "class cx cy w h" line per object,
+ *                      relative to the image size. A missing file means
+ *                      that the image has no objects.
+ */
+Result loadYoloLabels(const std::string& filepath, const cv::Size& imageSize,
+                      std::vector<Detection>* out) noexcept;
+
+/**
+ * Measures how far the detections of a candidate implementation drift from
+ * those of a reference. Per image, every reference detection is matched to
+ * the candidate detection of the same class with the highest IoU (at least
+ * 0.5); for matched pairs, the IoU and score deltas are accumulated.
+ */
+class DetectionDrift {
+ public:
+  DetectionDrift() noexcept;
+
+  void add(const std::vector<Detection>& reference,
+           const std::vector<Detection>& candidate) noexcept;
+
+  void reset() noexcept;
+
+  int numReference() const noexcept;
+
+  int numMatched() const noexcept;
+
+  int numMissing() const noexcept; /**<    reference only   */
+
+  int numExtra() const noexcept; /**<    candidate only   */
+
+  /**
+   * @brief               Unmatched detections of both sides, relative to
+   *                      the number of reference detections
+   */
+  double unmatchedFraction() const noexcept;
+
+  /*  1 - IoU of the matched pairs   */
+  double meanIouDelta() const noexcept;
+  double maxIouDelta() const noexcept;
+
+  /*  absolute score difference of the matched pairs    */
+  double meanScoreDelta() const noexcept;
+  double maxScoreDelta() const noexcept;
+
+ private:
+  int _numReference;
+  int _numMatched;
+  int _numExtra;
+
+  double _sumIouDelta;
+  double _maxIouDelta;
+  double _sumScoreDelta;
+  double _maxScoreDelta;
+};
+
+} /*  namespace yolov5    */
+
+#endif /*  include guard   */
\ No newline at end of file
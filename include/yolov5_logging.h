@@ -3,9 +3,13 @@
 #pragma once
 #include <NvInfer.h>
 
+#include <atomic>
+#include <chrono>
 #include <memory>
+#include <thread>
 
 #include "yolov5_common.h"
+#include "yolov5_queue.h"
 
 namespace yolov5 {
 
@@ -34,10 +38,145 @@ class Logger {
 
   void log(const LogLevel& level, const char* msg) noexcept;
 
+  /**
+   * @brief               Format and print a message. Messages below the
+   *                      minimum level are discarded before formatting;
+   *                      short messages are formatted on the stack
+   */
   void logf(const LogLevel& level, const char* fmt, ...) noexcept
       __attribute__((format(printf, 3, 4)));
 
+  /**
+   * @brief               Discard messages below the given level.
+   *                      Default: LOGGING_DEBUG, i.e. print everything
+   */
+  void setMinLevel(const LogLevel& level) noexcept;
+
+  LogLevel minLevel() const noexcept;
+
+  /**
+   * @brief               Whether messages of the level are printed. Cheap
+   *                      enough to guard expensive log statements
+   */
+  bool isEnabled(const LogLevel& level) const noexcept {
+    return (int)level >= _minLevel.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<int> _minLevel;
+};
+
+struct AsyncLoggerOptions {
+  AsyncLoggerOptions() noexcept;
+
+  /** number of preallocated records; messages are dropped while all of
+      them are waiting to be printed. Default: 1024 */
+  int capacity;
+
+  /** identical messages are printed at most this many times per
+      interval; the rest is counted and reported. 0 disables rate
+      limiting. Default: 10 */
+  int maxRepeats;
+
+  /** length of the rate limiting interval, in seconds. Default: 1 */
+  double repeatInterval;
+};
+
+struct AsyncLoggerStats {
+  AsyncLoggerStats() noexcept;
+
+  uint64_t printed;    /**<    messages handed to the backend   */
+  uint64_t dropped;    /**<    messages dropped because the queue was full */
+  uint64_t suppressed; /**<    repeated messages dropped by the limiter  */
+};
+
+/**
+ * Logger that never blocks the calling thread: print() copies the message
+ * into a preallocated record of a lock-free queue, and a background thread
+ * hands the records to the backend (by default, the console). Messages
+ * longer than a record are truncated. When the queue is full, or a message
+ * has been repeated too often recently, the message is dropped and
+ * counted; the background thread reports the counts.
+ *
+ * Before setup() and after stop(), messages are printed synchronously.
+ */
+class AsyncLogger : public Logger {
+ public:
+  AsyncLogger() noexcept;
+
+  virtual ~AsyncLogger();
+
+ private:
+  AsyncLogger(const AsyncLogger&);
+  AsyncLogger& operator=(const AsyncLogger&);
+
+ public:
+  /**
+   * @brief               Start the background thread
+   * @param backend       Logger that prints the messages, on the
+   *                      background thread. nullptr: the console
+   */
+  Result setup(const AsyncLoggerOptions& options = AsyncLoggerOptions(),
+               std::shared_ptr<Logger> backend = nullptr) noexcept;
+
+  virtual void print(const LogLevel& level, const char* msg) override;
+
+  /**
+   * @brief               Wait until the messages logged so far have been
+   *                      printed
+   */
+  void flush() noexcept;
+
+  /**
+   * @brief               Print the remaining messages and stop the
+   *                      background thread
+   */
+  void stop() noexcept;
+
+  AsyncLoggerStats stats() const noexcept;
+
+ private:
+  /*  Fixed size, so that records can be preallocated   */
+  struct Record {
+    int level;
+    char text[248];
+  };
+
+  /*  Entry of the rate limiter, indexed by the hash of the message.
+      Updates are not atomic as a whole, which makes the limiter
+      approximate, but never blocks   */
+  struct RepeatEntry {
+    RepeatEntry() noexcept : hash(0), windowStart(0), count(0) {}
+
+    std::atomic<uint64_t> hash;
+    std::atomic<int64_t> windowStart; /**<    nanoseconds   */
+    std::atomic<uint32_t> count;
+  };
+
+  bool _allow(const char* msg) noexcept;
+
+  void _drain() noexcept;
+
+  void _write(const LogLevel& level, const char* msg) noexcept;
+
  private:
+  AsyncLoggerOptions _options;
+  std::shared_ptr<Logger> _backend;
+
+  MpscQueue<Record> _queue;
+  std::thread _thread;
+  std::atomic<bool> _running;
+  std::atomic<bool> _stopping;
+
+  /*  print() calls that may still push a record, waited for by stop()  */
+  std::atomic<int> _producers;
+
+  RepeatEntry _repeats[64];
+
+  std::atomic<uint64_t> _queued;
+  std::atomic<uint64_t> _printed;
+  std::atomic<uint64_t> _dropped;
+  std::atomic<uint64_t> _suppressed;
 };
 
 class TensorRT_Logger : public nvinfer1::ILogger {
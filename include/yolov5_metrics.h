@@ -0,0 +1,267 @@
+#ifndef _YOLOV5_METRICS_HPP_
+#define _YOLOV5_METRICS_HPP_
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "yolov5_common.h"
+#include "yolov5_logging.h"
+#include "yolov5_stats.h"
+
+namespace yolov5 {
+
+/**
+ * Monotonic counter that may be incremented from any thread. Every thread
+ * increments the shard it was assigned to, so that threads do not contend
+ * on a single cache line; reading sums all shards.
+ */
+class Counter {
+ public:
+  Counter() noexcept;
+
+ private:
+  Counter(const Counter&);
+  Counter& operator=(const Counter&);
+
+ public:
+  void add(const uint64_t& n = 1) noexcept;
+
+  uint64_t value() const noexcept;
+
+ public:
+  static const int NUM_SHARDS = 8;
+
+ private:
+  struct alignas(64) Shard {
+    std::atomic<uint64_t> value;
+  };
+
+  Shard _shards[NUM_SHARDS];
+};
+
+/**
+ * Value that may go up and down, e.g. a queue depth
+ */
+class Gauge {
+ public:
+  Gauge() noexcept;
+
+ private:
+  Gauge(const Gauge&);
+  Gauge& operator=(const Gauge&);
+
+ public:
+  void set(const double& value) noexcept;
+
+  void add(const double& delta) noexcept;
+
+  double value() const noexcept;
+
+ private:
+  std::atomic<double> _value;
+};
+
+/**
+ * Histogram of latencies in microseconds that may be recorded from any
+ * thread, with the bucket layout of LatencyHistogram. Like Counter, every
+ * thread records into its own shard with relaxed atomic increments;
+ * snapshot() merges the shards.
+ */
+class Histogram {
+ public:
+  Histogram() noexcept;
+
+ private:
+  Histogram(const Histogram&);
+  Histogram& operator=(const Histogram&);
+
+ public:
+  void record(const uint64_t& value) noexcept;
+
+  /**
+   * @brief               Values recorded so far. Concurrent records may or
+   *                      may not be included
+   */
+  LatencyHistogram snapshot() const noexcept;
+
+  /**
+   * @brief               Number of values in every bucket of the layout
+   *                      of LatencyHistogram
+   */
+  bool bucketCounts(std::vector<uint64_t>* out) const noexcept;
+
+  /**
+   * @brief               Exact sum of the recorded values
+   */
+  uint64_t sum() const noexcept;
+
+ private:
+  struct alignas(64) Shard {
+    std::atomic<uint64_t> buckets[LatencyHistogram::NUM_BUCKETS];
+    std::atomic<uint64_t> sum;
+  };
+
+  std::unique_ptr<Shard[]> _shards;
+};
+
+/**
+ * Named metrics, exported in the Prometheus text format. Metrics are
+ * registered once (e.g. during setup) and the returned pointers remain
+ * valid for the lifetime of the registry; recording does not touch the
+ * registry.
+ *
+ * Metrics of the same name form a family and are distinguished by their
+ * labels, given in Prometheus syntax, e.g. 'stage="inference"'.
+ */
+class MetricsRegistry {
+ public:
+  /**
+   * Computes the value of a gauge when the metrics are exported
+   */
+  typedef std::function<double()> GaugeFunction;
+
+ public:
+  MetricsRegistry() noexcept;
+
+  ~MetricsRegistry() noexcept;
+
+ private:
+  MetricsRegistry(const MetricsRegistry&);
+  MetricsRegistry& operator=(const MetricsRegistry&);
+
+ public:
+  /**
+   * @brief               Register a counter, or return the existing one
+   *                      with the same name and labels
+   * @return              nullptr on failure
+   */
+  Counter* counter(const std::string& name, const std::string& help,
+                   const std::string& labels = "") noexcept;
+
+  Gauge* gauge(const std::string& name, const std::string& help,
+               const std::string& labels = "") noexcept;
+
+  /**
+   * @brief               Register a gauge whose value is computed on
+   *                      export. The function is called with the registry
+   *                      locked and must not register metrics
+   */
+  Result gauge(const std::string& name, const std::string& help,
+               const std::string& labels,
+               const GaugeFunction& function) noexcept;
+
+  /**
+   * @brief               Register a histogram of latencies in
+   *                      microseconds. It is exported in seconds
+   */
+  Histogram* histogram(const std::string& name, const std::string& help,
+                       const std::string& labels = "") noexcept;
+
+  /**
+   * @brief               Count a failure in yolov5_errors_total, labeled
+   *                      by the Result code. RESULT_SUCCESS is ignored
+   */
+  void countResult(const Result& r) noexcept;
+
+  /**
+   * @brief               All metrics in the Prometheus text format
+   */
+  bool toPrometheus(std::string* out) const noexcept;
+
+ private:
+  enum MetricType {
+    METRIC_COUNTER = 0,
+    METRIC_GAUGE = 1,
+    METRIC_GAUGE_FUNCTION = 2,
+    METRIC_HISTOGRAM = 3
+  };
+
+  struct Metric {
+    MetricType type;
+    std::string name;
+    std::string help;
+    std::string labels;
+
+    std::unique_ptr<Counter> counter;
+    std::unique_ptr<Gauge> gauge;
+    GaugeFunction function;
+    std::unique_ptr<Histogram> histogram;
+  };
+
+  /*  Existing metric of the name and labels, or a new one. Requires the
+      lock   */
+  Metric* _find(const MetricType& type, const std::string& name,
+                const std::string& help, const std::string& labels);
+
+ private:
+  mutable std::mutex _mutex;
+  std::vector<std::unique_ptr<Metric>> _metrics;
+
+  /*  Number of failure codes in Result; checked by the implementation */
+  static const int NUM_ERROR_CODES = 11;
+
+  /*  Counters of yolov5_errors_total, indexed like the Result codes in
+      the implementation, created on the first failure of each code  */
+  std::atomic<Counter*> _errors[NUM_ERROR_CODES];
+};
+
+/**
+ * Minimal HTTP server that exposes a MetricsRegistry for scraping: GET
+ * /metrics returns the metrics in the Prometheus text format. Connections
+ * are handled one at a time on a background thread. By default, the
+ * server only listens on the loopback interface.
+ */
+class MetricsServer {
+ public:
+  MetricsServer() noexcept;
+
+  ~MetricsServer() noexcept;
+
+ private:
+  MetricsServer(const MetricsServer&);
+  MetricsServer& operator=(const MetricsServer&);
+
+ public:
+  /**
+   * @brief               Start listening
+   * @param registry      Metrics to expose. Must outlive the server
+   * @param port          TCP port; 0 picks a free one, see port()
+   * @param address       IPv4 address to listen on
+   */
+  Result start(MetricsRegistry* registry, const int& port = 9464,
+               const std::string& address = "127.0.0.1") noexcept;
+
+  void stop() noexcept;
+
+  /**
+   * @brief               Port the server listens on, or 0 if not running
+   */
+  int port() const noexcept;
+
+  void setLogger(std::shared_ptr<Logger> logger) noexcept;
+
+ private:
+  void _serve() noexcept;
+
+  void _handle(const int& fd) noexcept;
+
+ private:
+  std::shared_ptr<Logger> _logger;
+  MetricsRegistry* _registry;
+
+  int _fd;
+  int _port;
+  std::thread _thread;
+  std::atomic<bool> _stopped;
+};
+
+} /*  namespace yolov5    */
+
+#endif /*  include guard   */
\ No newline at end of file
@@ -0,0 +1,151 @@
+#ifndef _YOLOV5_MOSAIC_HPP_
+#define _YOLOV5_MOSAIC_HPP_
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "yolov5_detector.h"
+
+namespace yolov5 {
+
+/**
+ * Transform of a region of a canvas: an image scaled by f and placed at
+ * the top-left corner of the region. This is a letterbox transform with
+ * the region's position as padding.
+ */
+class RegionTransform : public internal::PreprocessorTransform {
+ public:
+  RegionTransform() noexcept;
+
+  /**
+   * @param imageSize     Size of the source image
+   * @param f             Scale factor from source image to canvas
+   * @param region        Area of the canvas occupied by the image
+   */
+  RegionTransform(const cv::Size& imageSize, const double& f,
+                  const cv::Rect& region) noexcept;
+
+  ~RegionTransform() noexcept;
+
+ public:
+  const cv::Rect& region() const noexcept;
+
+  /**
+   * @brief               Whether a box in canvas space belongs to this
+   *                      region, i.e. whether its center lies inside
+   */
+  bool contains(const cv::Rect& box) const noexcept;
+
+ private:
+  cv::Rect _region;
+};
+
+struct MosaicOptions {
+  MosaicOptions() noexcept;
+
+  /** empty pixels between the images on a canvas, so that objects in
+      neighboring images are not detected as one. Default: 8 */
+  int margin;
+};
+
+struct MosaicStats {
+  MosaicStats() noexcept;
+
+  uint64_t images;   /**<    images detected */
+  uint64_t canvases; /**<    network inputs used, i.e. batch slots   */
+
+  double imagePixels;  /**<    canvas pixels occupied by images  */
+  double canvasPixels; /**<    total canvas pixels   */
+
+  /**
+   * @brief               Fraction of the network input that was occupied
+   *                      by images
+   */
+  double efficiency() const noexcept;
+};
+
+/**
+ * Detects objects in many small images by packing them onto canvases of
+ * the network input size, rather than letterboxing every image into its
+ * own batch slot. Images are placed on shelves (first-fit decreasing
+ * height) at their native resolution, or downscaled if they do not fit.
+ * The canvases are detected with Detector::detectBatch(), and every
+ * detection is assigned back to the image in whose region its center
+ * lies.
+ */
+class MosaicDetector {
+ public:
+  MosaicDetector() noexcept;
+
+  ~MosaicDetector() noexcept;
+
+ private:
+  MosaicDetector(const MosaicDetector&);
+  MosaicDetector& operator=(const MosaicDetector&);
+
+ public:
+  /**
+   * @brief               Set up the detector
+   * @param detector      Detector with a loaded engine. Must outlive the
+   *                      MosaicDetector
+   * @param options       Options
+   * @param flags         Flags passed to the Detector
+   */
+  Result setup(Detector* detector,
+               const MosaicOptions& options = MosaicOptions(),
+               const int& flags = INPUT_BGR) noexcept;
+
+  /**
+   * @brief               Detect objects in a set of images
+   * @param images        8-bit, 3-channel images
+   * @param out           [out] Detections per image, in image coordinates
+   */
+  Result detect(const std::vector<cv::Mat>& images,
+                std::vector<std::vector<Detection>>* out) noexcept;
+
+  MosaicStats stats() const noexcept;
+
+  void resetStats() noexcept;
+
+ private:
+  struct Placement {
+    int canvas;
+    RegionTransform transform;
+  };
+
+  struct Shelf {
+    int canvas;
+    int y;
+    int height;
+    int width; /**<    used width    */
+  };
+
+  /*  Place the images on canvases; returns the number of canvases  */
+  int _pack(const std::vector<cv::Mat>& images, const cv::Size& canvasSize);
+
+  /*  Detect a range of canvases  */
+  Result _detectCanvases(const std::vector<cv::Mat>& images,
+                         const int& first, const int& count,
+                         std::vector<std::vector<Detection>>* out);
+
+ private:
+  Detector* _detector;
+  std::shared_ptr<Logger> _logger;
+  MosaicOptions _options;
+  int _flags;
+
+  std::vector<Placement> _placements;
+  std::vector<int> _order;
+  std::vector<Shelf> _shelves;
+  std::vector<int> _canvasHeights; /**<    used height per canvas  */
+
+  std::vector<cv::Mat> _canvases;
+  std::vector<std::vector<Detection>> _results;
+
+  MosaicStats _stats;
+};
+
+} /*  namespace yolov5    */
+
+#endif /*  include guard   */
\ No newline at end of file
@@ -0,0 +1,105 @@
+#ifndef _YOLOV5_MOTION_HPP_
+#define _YOLOV5_MOTION_HPP_
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "yolov5_logging.h"
+
+namespace yolov5 {
+
+struct MotionGateOptions {
+  MotionGateOptions() noexcept;
+
+  /** size of the grayscale thumbnail that frames are compared on.
+      Default: 64x36 */
+  cv::Size thumbnailSize;
+
+  /** minimum difference (0-255) for a thumbnail pixel to count as
+      changed. Default: 16 */
+  int pixelThreshold;
+
+  /** fraction of changed thumbnail pixels above which the frame is
+      considered changed. Default: 0.01 */
+  double changeThreshold;
+
+  /** run the detector at least once every this many frames, even if
+      nothing changed. Default: 30 */
+  int refreshInterval;
+};
+
+struct MotionGateStats {
+  MotionGateStats() noexcept;
+
+  uint64_t frames;  /**<    frames checked    */
+  uint64_t skipped; /**<    frames for which detection was skipped    */
+
+  double skipRatio() const noexcept;
+};
+
+/**
+ * Decides whether a frame has to be detected, or whether the detections
+ * of the previous frame can be reused because nothing has changed.
+ *
+ * Frames are reduced to a small grayscale thumbnail by sampling the
+ * image (without touching most of its pixels) and compared to the
+ * thumbnail of the frame that was last detected. Comparing against the
+ * last detected frame, rather than the previous frame, also catches slow
+ * changes.
+ */
+class MotionGate {
+ public:
+  MotionGate() noexcept;
+
+  ~MotionGate() noexcept;
+
+ public:
+  Result setup(const MotionGateOptions& options = MotionGateOptions()) noexcept;
+
+  /**
+   * @brief               Check a frame
+   * @param image         BGR or grayscale image, 8 bits per channel
+   * @param detect        [out] Whether the frame should be detected. If
+   *                      so, the frame becomes the new reference
+   */
+  Result check(const cv::Mat& image, bool* detect) noexcept;
+
+  /**
+   * @brief               Fraction of changed thumbnail pixels of the last
+   *                      checked frame
+   */
+  double lastScore() const noexcept;
+
+  MotionGateStats stats() const noexcept;
+
+  /**
+   * @brief               Forget the reference frame, so that the next
+   *                      frame is detected
+   */
+  void reset() noexcept;
+
+  void setLogger(std::shared_ptr<Logger> logger) noexcept;
+
+ private:
+  void _thumbnail(const cv::Mat& image, uint8_t* out) const noexcept;
+
+ private:
+  std::shared_ptr<Logger> _logger;
+  MotionGateOptions _options;
+
+  std::vector<uint8_t> _current;
+  std::vector<uint8_t> _reference;
+  bool _hasReference;
+  int _framesSinceDetection;
+  double _lastScore;
+
+  uint64_t _statsFrames;
+  uint64_t _statsSkipped;
+};
+
+} /*  namespace yolov5    */
+
+#endif /*  include guard   */
\ No newline at end of file
@@ -0,0 +1,303 @@
+#ifndef _YOLOV5_MULTISTREAM_HPP_
+#define _YOLOV5_MULTISTREAM_HPP_
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "yolov5_detector.h"
+#include "yolov5_metrics.h"
+#include "yolov5_queue.h"
+#include "yolov5_stats.h"
+
+namespace yolov5 {
+
+/**
+ * Determines the order in which frames of different streams are batched
+ */
+enum StreamFairness {
+  /**<    take one frame per stream in turn    */
+  FAIRNESS_ROUND_ROBIN = 0,
+
+  /**<    take the frames of the streams with the highest priority first,
+          and among those, the frames with the earliest deadline (capture
+          time plus the latency budget of the stream)    */
+  FAIRNESS_DEADLINE = 1
+};
+
+/**
+ * Determines what happens to the frames of a stream when the runner is
+ * overloaded. A frame is considered infeasible if, according to the
+ * measured inference times, its result cannot be delivered before its
+ * deadline anymore. Frames are shed before any preprocessing or inference
+ * is spent on them.
+ */
+enum SheddingPolicy {
+  /**<    never shed frames; late results are delivered late    */
+  SHED_NONE = 0,
+
+  /**<    shed infeasible frames, and all queued frames except the newest
+          one, so that the stream always works on its freshest frame    */
+  SHED_DROP_OLDEST = 1,
+
+  /**<    shed infeasible frames; while overloaded, only every
+          StreamOptions::decimation-th frame is processed   */
+  SHED_DECIMATE = 2,
+
+  /**<    shed infeasible frames; while overloaded, frames are detected
+          at the smallest of the Detector's inference sizes. This only
+          applies to batches made entirely of such frames, and requires
+          Detector::setInferenceSizes() with more than one size   */
+  SHED_LOWER_RESOLUTION = 3
+};
+
+const char* shedding_policy_to_string(const SheddingPolicy& policy) noexcept;
+
+/**
+ * A frame of one of the streams of a MultiStreamRunner
+ */
+struct StreamFrame {
+  StreamFrame() noexcept;
+
+  int streamId;
+  uint64_t id; /**<    sequence number within the stream   */
+
+  cv::Mat image;
+  std::chrono::steady_clock::time_point captureTime;
+  std::chrono::steady_clock::time_point deadline;
+
+  std::vector<Detection> detections;
+};
+
+struct StreamOptions {
+  StreamOptions() noexcept;
+
+  /** live source: frames are dropped when the stream's queue is full, so
+      that the source keeps being drained. Otherwise (files), the decode
+      thread waits. Default: true */
+  bool live;
+
+  /** number of decoded frames that may wait for inference. Default: 2 */
+  int queueCapacity;
+
+  /** milliseconds from capture until the result is due. Default: 100 */
+  double latencyBudget;
+
+  /** streams with a higher priority are batched first with
+      FAIRNESS_DEADLINE. Default: 0 */
+  int priority;
+
+  /** what to do with the frames of this stream when overloaded.
+      Default: SHED_NONE */
+  SheddingPolicy shedding;
+
+  /** SHED_DECIMATE: process one in this many frames while overloaded.
+      Default: 2 */
+  int decimation;
+};
+
+struct StreamStats {
+  StreamStats() noexcept;
+
+  int streamId;
+
+  uint64_t captured;   /**<    frames read from the source   */
+  uint64_t processed;  /**<    frames delivered to the sink  */
+  uint64_t dropped;    /**<    frames dropped because the queue was full */
+  uint64_t shed;       /**<    frames shed by the scheduler  */
+  uint64_t downscaled; /**<    frames detected at the smallest size  */
+  uint64_t missed;     /**<    frames delivered after their deadline */
+
+  double fps; /**<    processed frames per second   */
+
+  LatencyHistogram latency; /**<    capture-to-result, in microseconds  */
+};
+
+/**
+ * Runs detection on many streams with a single Detector. Every stream is
+ * decoded on its own thread; frames of all streams are combined into
+ * batches for Detector::detectBatch(), and the results are routed back to
+ * the sink of their stream.
+ */
+class MultiStreamRunner {
+ public:
+  /**
+   * Reads the next image of a stream into the provided (recycled) buffer.
+   * Return false at the end of the stream. Called on the stream's thread.
+   */
+  typedef std::function<bool(cv::Mat*)> Source;
+
+  /**
+   * Receives a frame with its detections. Called on the thread that
+   * calls run(), so it should return quickly. Return false to stop the
+   * runner.
+   */
+  typedef std::function<bool(StreamFrame*)> Sink;
+
+ public:
+  MultiStreamRunner() noexcept;
+
+  ~MultiStreamRunner() noexcept;
+
+ private:
+  MultiStreamRunner(const MultiStreamRunner&);
+  MultiStreamRunner& operator=(const MultiStreamRunner&);
+
+ public:
+  /**
+   * @brief               Set up the runner
+   * @param detector      Detector with a loaded engine. Must outlive the
+   *                      runner
+   * @param fairness      Order in which frames are batched
+   * @param maxBatchDelay Milliseconds to wait for a batch to fill up once
+   *                      the first frame is available
+   * @param flags         Flags passed to Detector::detectBatch()
+   */
+  Result setup(Detector* detector,
+               const StreamFairness& fairness = FAIRNESS_ROUND_ROBIN,
+               const double& maxBatchDelay = 2.0,
+               const int& flags = INPUT_BGR) noexcept;
+
+  /**
+   * @brief               Add a stream. Not possible while running
+   * @return              Identifier of the stream, or -1 on failure
+   */
+  int addStream(const Source& source, const Sink& sink,
+                const StreamOptions& options = StreamOptions()) noexcept;
+
+  int numStreams() const noexcept;
+
+  /**
+   * @brief               Record metrics into the registry while running:
+   *                      per stream, the processed, dropped, shed and late
+   *                      frames and the capture-to-result latency; the
+   *                      duration of every batch and failures by Result
+   *                      code. The registry must outlive the runner;
+   *                      nullptr disables metrics. Not possible while
+   *                      running
+   */
+  Result setMetrics(MetricsRegistry* registry) noexcept;
+
+  /**
+   * @brief               Run until all sources are exhausted, a sink returns
+   *                      false, stop() is called or detection fails.
+   *                      Inference runs on the calling thread.
+   */
+  Result run() noexcept;
+
+  /**
+   * @brief               Stop the runner; may be called from any thread
+   */
+  void stop() noexcept;
+
+  /**
+   * @brief               Statistics of the last run, per stream
+   */
+  std::vector<StreamStats> stats() const noexcept;
+
+  bool statsToString(std::string* out) const noexcept;
+
+ private:
+  struct Stream {
+    Stream() noexcept;
+
+    int id;
+    Source source;
+    Sink sink;
+    StreamOptions options;
+
+    std::vector<std::unique_ptr<StreamFrame>> frames;
+    SpscQueue<StreamFrame*> queue; /**<    decode thread -> inference  */
+    SpscQueue<StreamFrame*> free;  /**<    inference -> decode thread  */
+
+    std::thread thread;
+    std::atomic<bool> done;
+    std::atomic<uint64_t> captured;
+    std::atomic<uint64_t> dropped;
+
+    /*  only accessed by the inference thread  */
+    uint64_t processed;
+    uint64_t shed;
+    uint64_t downscaled;
+    uint64_t missed;
+    bool overloaded;
+    LatencyHistogram latency;
+
+    /*  nullptr if metrics are disabled   */
+    Counter* processedMetric;
+    Counter* droppedMetric;
+    Counter* shedMetric;
+    Counter* missedMetric;
+    Histogram* latencyMetric;
+  };
+
+  /*  Register the metrics of every stream   */
+  Result _registerMetrics() noexcept;
+
+  void _decode(Stream* stream) noexcept;
+
+  /*  Add frames to the batch, according to the fairness policy   */
+  void _gather(std::vector<StreamFrame*>* batch, const int& batchSize) noexcept;
+
+  /*  Shed the queued frames that should not be processed, according to
+      the shedding policy of their stream, assuming the next batch holds
+      the given number of frames    */
+  void _shed(const int& batchSize) noexcept;
+
+  bool _shouldShed(const Stream& stream, const StreamFrame& frame,
+                   const std::chrono::steady_clock::time_point& now,
+                   const double& serviceTime) const noexcept;
+
+  /*  Whether a batch of the given size can still be delivered before
+      the deadline   */
+  bool _fits(const int& batchSize,
+             const std::chrono::steady_clock::time_point& deadline) const
+      noexcept;
+
+  /*  Expected duration of _process() for a batch, in milliseconds   */
+  double _serviceTime(const int& batchSize) const noexcept;
+
+  bool _allDone() const noexcept;
+
+  Result _process(std::vector<StreamFrame*>* batch) noexcept;
+
+ private:
+  Detector* _detector;
+  std::shared_ptr<Logger> _logger;
+  StreamFairness _fairness;
+  double _maxBatchDelay;
+  int _flags;
+
+  std::vector<std::unique_ptr<Stream>> _streams;
+
+  MetricsRegistry* _metrics;
+  Histogram* _batchTime;
+  int _nextStream; /**<    stream after the one that started the last
+                       batch, for FAIRNESS_ROUND_ROBIN   */
+
+  std::atomic<bool> _running;
+  std::atomic<bool> _stopped;
+  double _runTime;
+
+  /*  moving average of the duration of _process(), in milliseconds,
+      per batch size. 0 if not measured yet  */
+  std::vector<double> _serviceTimes;
+
+  /*  earliest deadline of the frames in the batch being gathered whose
+      stream sheds frames   */
+  std::chrono::steady_clock::time_point _batchDeadline;
+
+  /*  scratch buffers for the inference thread    */
+  std::vector<cv::Mat> _images;
+  std::vector<std::vector<Detection>> _results;
+};
+
+} /*  namespace yolov5    */
+
+#endif /*  include guard   */
\ No newline at end of file
@@ -0,0 +1,97 @@
+#ifndef _YOLOV5_OVERLAY_HPP_
+#define _YOLOV5_OVERLAY_HPP_
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "yolov5_detection.h"
+
+namespace yolov5 {
+
+struct OverlayOptions {
+  OverlayOptions() noexcept;
+
+  cv::Scalar boxColor;  /**<    Default: (255, 51, 153)  */
+  cv::Scalar textColor; /**<    Default: white */
+  int boxThickness;     /**<    Default: 4  */
+
+  double fontScale;  /**<    of cv::FONT_HERSHEY_PLAIN. Default: 1.0   */
+  int textThickness; /**<    Default: 2  */
+
+  /** opacity of the labels, in [0, 1]. Default: 1 (opaque) */
+  double labelOpacity;
+};
+
+/**
+ * Draws detections onto images, as visualizeDetection() does, but
+ * without its per-frame cost: labels are rasterized once and cached (the
+ * class name per class, the score per value with 2 decimals), and blitted
+ * onto the image afterwards. Boxes are drawn as filled bars rather than
+ * rasterized lines. Nothing is written to the console.
+ *
+ * A renderer keeps state and is not thread-safe; use one per render
+ * thread.
+ */
+class OverlayRenderer {
+ public:
+  OverlayRenderer() noexcept;
+
+  ~OverlayRenderer() noexcept;
+
+ public:
+  Result setup(const OverlayOptions& options = OverlayOptions()) noexcept;
+
+  /**
+   * @brief               Draw the detections onto the image
+   */
+  Result render(const std::vector<Detection>& detections,
+                cv::Mat* image) noexcept;
+
+  /**
+   * @brief               Draw a line of text, e.g. a frame rate, with its
+   *                      baseline at the given position. Texts are cached
+   *                      as well, so they should come from a small set
+   */
+  Result renderText(const std::string& text, const cv::Point& origin,
+                    const cv::Scalar& color, cv::Mat* image) noexcept;
+
+  /**
+   * @brief               Number of cached label images
+   */
+  size_t cacheSize() const noexcept;
+
+  void clearCache() noexcept;
+
+ private:
+  /*  Label of a class: the class name on the box color   */
+  const cv::Mat& _classLabel(const int& classId, const std::string& name);
+
+  /*  Label of a score, with 2 decimals, on the box color   */
+  const cv::Mat& _scoreLabel(const double& score);
+
+  /*  BGR image of a label, laid out as by visualizeDetection()  */
+  cv::Mat _rasterizeLabel(const std::string& text) const;
+
+  void _drawBox(const cv::Rect& box, cv::Mat* image) const;
+
+  /*  Copy (or blend, with labelOpacity) a label onto the image   */
+  void _blit(const cv::Mat& label, const cv::Point& tl, cv::Mat* image) const;
+
+ private:
+  OverlayOptions _options;
+
+  std::vector<cv::Mat> _classLabels; /**<    indexed by class id   */
+  std::vector<std::string> _classNames;
+  std::unordered_map<std::string, cv::Mat> _namedLabels; /**< other ids */
+  std::vector<cv::Mat> _scoreLabels; /**<    "0.00" to "1.00"   */
+
+  /*  Texts drawn without background: 8-bit coverage masks, blended onto
+      the image in the requested color   */
+  std::unordered_map<std::string, cv::Mat> _texts;
+};
+
+} /*  namespace yolov5    */
+
+#endif /*  include guard   */
\ No newline at end of file
@@ -0,0 +1,155 @@
+#ifndef _YOLOV5_PERF_HPP_
+#define _YOLOV5_PERF_HPP_
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "yolov5_common.h"
+
+namespace yolov5 {
+
+/**
+ * Hardware counters accumulated over all executions of a stage
+ */
+struct PerfStageStats {
+  PerfStageStats() noexcept;
+
+  std::string name;
+
+  uint64_t calls; /**<    number of times the stage ran, e.g. frames  */
+
+  /*  Counter totals. A counter the CPU (or kernel) does not provide is
+      reported as -1   */
+  int64_t cycles;
+  int64_t instructions;
+  int64_t cacheMisses;  /**<    last-level cache misses    */
+  int64_t branchMisses; /**<    mispredicted branches   */
+
+  /**
+   * @brief               Instructions per cycle, or 0 if not available.
+   *                      A low IPC combined with many cache misses
+   *                      indicates a memory-bound stage
+   */
+  double ipc() const noexcept;
+
+  /**
+   * @brief               Average of a counter per call, or -1 if the
+   *                      counter is not available
+   */
+  double perCall(const int64_t& total) const noexcept;
+};
+
+/**
+ * Process-wide sampling of hardware performance counters (cycles,
+ * instructions, last-level cache misses, branch misses) around host-side
+ * stages such as pre-processing and decoding, using perf_event_open(2).
+ * Every thread opens its own counters when it first enters a stage; the
+ * counts of a stage are accumulated over all threads.
+ *
+ * Sampling is disabled by default, and a disabled scope costs a single
+ * relaxed atomic load. Counters may be unavailable, e.g. outside of Linux,
+ * in containers or virtual machines, or if kernel.perf_event_paranoid
+ * forbids them; stages then simply record nothing. Defining
+ * YOLOV5_NO_TRACING removes the scopes at compile time.
+ */
+class PerfCounters {
+ public:
+  /**
+   * @brief               Start or stop sampling. Fails with
+   *                      RESULT_FAILURE_OTHER, and stays disabled, if the
+   *                      counters cannot be opened on the calling thread
+   */
+  static Result setEnabled(const bool& enabled) noexcept;
+
+  static bool isEnabled() noexcept {
+    return _enabled.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief               Whether the calling thread can read the counters
+   */
+  static bool isAvailable() noexcept;
+
+  /**
+   * @brief               Begin a stage on the calling thread. Returns an
+   *                      opaque handle for end(), or -1 if nothing is
+   *                      sampled
+   */
+  static int begin() noexcept;
+
+  /**
+   * @brief               End the stage begun with the given handle and add
+   *                      the counts to the totals of the stage. The name
+   *                      must outlive the counters, e.g. a string literal
+   */
+  static void end(const char* name, const int& handle) noexcept;
+
+  /**
+   * @brief               Totals of all stages, in order of first use
+   */
+  static std::vector<PerfStageStats> stats() noexcept;
+
+  /**
+   * @brief               Human-readable table of IPC and misses per call
+   */
+  static bool statsToString(std::string* out) noexcept;
+
+  /**
+   * @brief               Reset the totals of all stages
+   */
+  static void clear() noexcept;
+
+ private:
+  static std::atomic<bool> _enabled;
+};
+
+/**
+ * Samples the counters from its construction until end() is called or the
+ * scope is left. With YOLOV5_NO_TRACING, it does nothing
+ */
+class PerfScope {
+ public:
+#ifndef YOLOV5_NO_TRACING
+  explicit PerfScope(const char* name) noexcept
+      : _name(name),
+        _handle(PerfCounters::isEnabled() ? PerfCounters::begin() : -1) {}
+
+  ~PerfScope() noexcept { end(); }
+
+  void end() noexcept {
+    if (_handle >= 0) {
+      PerfCounters::end(_name, _handle);
+      _handle = -1;
+    }
+  }
+#else
+  explicit PerfScope(const char*) noexcept : _name(nullptr), _handle(-1) {}
+
+  void end() noexcept {}
+#endif
+
+ private:
+  PerfScope(const PerfScope&);
+  PerfScope& operator=(const PerfScope&);
+
+ private:
+  const char* _name;
+  int _handle;
+};
+
+} /*  namespace yolov5    */
+
+#ifndef YOLOV5_NO_TRACING
+/*  Sample the counters until the end of the enclosing scope   */
+#define YOLOV5_PERF_CONCAT_(a, b) a##b
+#define YOLOV5_PERF_CONCAT(a, b) YOLOV5_PERF_CONCAT_(a, b)
+#define YOLOV5_PERF_SCOPE(name) \
+  yolov5::PerfScope YOLOV5_PERF_CONCAT(_yolov5PerfScope, __LINE__)(name)
+#else
+#define YOLOV5_PERF_SCOPE(name)
+#endif
+
+#endif /*  include guard   */
\ No newline at end of file
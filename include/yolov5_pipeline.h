@@ -0,0 +1,271 @@
+#ifndef _YOLOV5_PIPELINE_HPP_
+#define _YOLOV5_PIPELINE_HPP_
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "yolov5_detector.h"
+#include "yolov5_metrics.h"
+#include "yolov5_motion.h"
+#include "yolov5_queue.h"
+#include "yolov5_stats.h"
+
+namespace yolov5 {
+
+/**
+ * A frame travelling through the Pipeline. Frames are allocated once and
+ * recycled, so that the image buffers are reused for every frame.
+ */
+struct PipelineFrame {
+  PipelineFrame() noexcept;
+
+  uint64_t id; /**<    sequence number, starting at 0   */
+
+  /*  time at which the source returned the image   */
+  std::chrono::steady_clock::time_point captureTime;
+
+  cv::Mat image;  /**<    captured image    */
+  cv::Mat input;  /**<    image letterboxed to the network input size;
+                              never shares memory with the image */
+  cv::Mat buffer; /**<    intermediate buffer for letterboxing   */
+
+  /*  transform from network input space to image space  */
+  internal::PreprocessorTransform transform;
+
+  std::vector<Detection> detections; /**<    in image coordinates  */
+
+  /*  false if the motion gate skipped detection; the detections are then
+      those of the previous frame   */
+  bool detected;
+};
+
+/**
+ * Statistics of a single Pipeline stage
+ */
+struct StageStats {
+  StageStats() noexcept;
+
+  std::string name;
+
+  uint64_t frames; /**<    number of frames processed    */
+
+  double busyTime; /**<    seconds spent processing frames   */
+  double idleTime; /**<    seconds spent waiting for input or output  */
+
+  /*  Depth of the output queue of the stage, sampled on every push  */
+  double meanQueueDepth;
+  int maxQueueDepth;
+
+  /**
+   * @brief               Frames per second the stage could sustain on its
+   *                      own, i.e. frames per second of busy time
+   */
+  double throughput() const noexcept;
+
+  /**
+   * @brief               Fraction of time spent processing frames
+   */
+  double utilization() const noexcept;
+};
+
+/**
+ * Runs capture, pre-processing, inference & decoding, optionally rendering,
+ * and the sink (e.g. display) as separate stages connected by bounded
+ * lock-free queues. Each stage runs on its own thread, except for the sink,
+ * which runs on the thread calling run() (GUI toolkits typically require
+ * this). The throughput of the Pipeline is that of its slowest stage.
+ *
+ * The pre-processing stage letterboxes the captured image to the network
+ * input size, so the Detector only has to convert it.
+ */
+class Pipeline {
+ public:
+  /**
+   * Called by the capture stage to read the next image into the provided
+   * (recycled) buffer. Return false at the end of the stream.
+   */
+  typedef std::function<bool(cv::Mat*)> Source;
+
+  /**
+   * Called by the sink stage for every frame, in order. The frame is
+   * recycled after the call returns. Return false to stop the Pipeline.
+   */
+  typedef std::function<bool(PipelineFrame*)> Sink;
+
+  /**
+   * Called by the render stage for every frame, in order, e.g. to draw the
+   * detections onto the image. Return false to stop the Pipeline.
+   */
+  typedef std::function<bool(PipelineFrame*)> Render;
+
+ public:
+  Pipeline() noexcept;
+
+  ~Pipeline() noexcept;
+
+ private:
+  Pipeline(const Pipeline&);
+  Pipeline& operator=(const Pipeline&);
+
+ public:
+  /**
+   * @brief               Set up the Pipeline
+   * @param detector      Detector with a loaded engine. Must outlive the
+   *                      Pipeline
+   * @param queueCapacity Capacity of the queues between the stages
+   * @param flags         Flags passed to Detector::detect()
+   */
+  Result setup(Detector* detector, const int& queueCapacity = 4,
+               const int& flags = INPUT_BGR) noexcept;
+
+  /**
+   * @brief               Skip pre-processing and detection of frames in
+   *                      which nothing changed, according to the gate.
+   *                      Such frames reuse the detections of the previous
+   *                      frame. The gate is used by the pre-processing
+   *                      stage and must outlive the Pipeline; nullptr
+   *                      disables gating. Call before run()
+   */
+  Result setMotionGate(MotionGate* gate) noexcept;
+
+  /**
+   * @brief               Run the given function on a separate render stage
+   *                      between inference and the sink, so that drawing
+   *                      does not slow down the sink thread. An empty
+   *                      function removes the stage. Call before run()
+   */
+  Result setRender(const Render& render) noexcept;
+
+  /**
+   * @brief               Record metrics into the registry while running:
+   *                      frames, detections and frames skipped by the
+   *                      motion gate, failures by Result code, the time
+   *                      per frame of every stage, the capture-to-result
+   *                      latency and the depth of every queue. The
+   *                      registry must outlive the Pipeline; nullptr
+   *                      disables metrics. Call before run()
+   */
+  Result setMetrics(MetricsRegistry* registry) noexcept;
+
+  /**
+   * @brief               Run until the source is exhausted, the sink
+   *                      returns false, stop() is called or a stage fails
+   * @return              The first failure of a stage, or RESULT_SUCCESS
+   */
+  Result run(const Source& source, const Sink& sink) noexcept;
+
+  /**
+   * @brief               Stop the Pipeline; may be called from any thread
+   */
+  void stop() noexcept;
+
+  /**
+   * @brief               Statistics of the last run, for every stage
+   */
+  std::vector<StageStats> stats() const noexcept;
+
+  /**
+   * @brief               Latency from capture until the detections reached
+   *                      the sink, for every frame of the last run
+   */
+  const LatencyHistogram& latency() const noexcept;
+
+  /**
+   * @brief               Human-readable summary of the statistics
+   */
+  bool statsToString(std::string* out) const noexcept;
+
+ private:
+  typedef SpscQueue<PipelineFrame*> FrameQueue;
+
+  void _captureStage(const Source& source) noexcept;
+
+  void _preprocessStage() noexcept;
+
+  void _inferenceStage() noexcept;
+
+  void _renderStage() noexcept;
+
+  void _sinkStage(const Sink& sink) noexcept;
+
+  bool _pop(FrameQueue* queue, const std::atomic<bool>* upstreamDone,
+            PipelineFrame** frame, StageStats* stats) noexcept;
+
+  bool _push(FrameQueue* queue, PipelineFrame* frame,
+             StageStats* stats) noexcept;
+
+  void _fail(const Result& r) noexcept;
+
+  /*  Time since start, into the histogram if metrics are enabled   */
+  void _observe(Histogram* histogram,
+                const std::chrono::steady_clock::time_point& start) const
+      noexcept;
+
+ private:
+  Detector* _detector;
+  std::shared_ptr<Logger> _logger;
+  int _queueCapacity;
+  int _flags;
+
+  std::vector<cv::Size> _inferenceSizes;
+  cv::Size _networkSize;
+
+  MotionGate* _motionGate;
+  std::vector<Detection> _lastDetections; /**<    inference stage only  */
+
+  Render _render;
+
+  std::vector<std::unique_ptr<PipelineFrame>> _frames;
+
+  /*  Frames flow from _free to the capture stage, through the queues, and
+      from the sink stage back to _free   */
+  FrameQueue _free;
+  FrameQueue _captured;
+  FrameQueue _preprocessed;
+  FrameQueue _detected;
+  FrameQueue _rendered;
+
+  std::atomic<bool> _stopped;
+  std::atomic<bool> _captureDone;
+  std::atomic<bool> _preprocessDone;
+  std::atomic<bool> _inferenceDone;
+  std::atomic<bool> _renderDone;
+
+  std::mutex _resultMutex;
+  Result _result;
+
+  /*  Each stage only writes its own statistics   */
+  StageStats _captureStats;
+  StageStats _preprocessStats;
+  StageStats _inferenceStats;
+  StageStats _renderStats;
+  StageStats _sinkStats;
+  LatencyHistogram _latency;
+  double _runTime;
+
+  /*  Metrics, nullptr if disabled    */
+  MetricsRegistry* _metrics;
+  Counter* _framesCounter;
+  Counter* _detectionsCounter;
+  Counter* _skippedCounter;
+  Histogram* _captureTime;
+  Histogram* _preprocessTime;
+  Histogram* _inferenceTime;
+  Histogram* _renderTime;
+  Histogram* _sinkTime;
+  Histogram* _latencyMetric;
+  Gauge* _capturedDepth;
+  Gauge* _preprocessedDepth;
+  Gauge* _detectedDepth;
+  Gauge* _renderedDepth;
+};
+
+} /*  namespace yolov5    */
+
+#endif /*  include guard   */
\ No newline at end of file
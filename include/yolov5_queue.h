@@ -0,0 +1,374 @@
+#ifndef _YOLOV5_QUEUE_HPP_
+#define _YOLOV5_QUEUE_HPP_
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace yolov5 {
+
+/**
+ * Bounded lock-free queue for exactly one producer thread and one consumer
+ * thread. Neither side ever blocks: tryPush() fails if the queue is full
+ * and tryPop() fails if it is empty, and it is up to the caller to decide
+ * how to wait.
+ *
+ * The producer and consumer indices live on separate cache lines, and
+ * each side keeps a cached copy of the other side's index, so that the
+ * shared indices are only read when the queue looks full or empty.
+ */
+template <typename T>
+class SpscQueue {
+ public:
+  SpscQueue() noexcept
+      : _capacity(0), _mask(0), _head(0), _cachedTail(0), _tail(0),
+        _cachedHead(0) {}
+
+  ~SpscQueue() noexcept {}
+
+ private:
+  SpscQueue(const SpscQueue&);
+  SpscQueue& operator=(const SpscQueue&);
+
+ public:
+  /**
+   * @brief               Set up the queue. Not thread-safe: must be called
+   *                      before the producer and consumer start.
+   * @param capacity      Maximum number of items in the queue
+   */
+  bool setup(const int& capacity) noexcept {
+    if (capacity < 1) {
+      return false;
+    }
+    size_t size = 1;
+    while (size < (size_t)capacity) {
+      size <<= 1;
+    }
+    try {
+      _items.assign(size, T());
+    } catch (const std::exception& e) {
+      return false;
+    }
+    _capacity = capacity;
+    _mask = size - 1;
+    _head.store(0, std::memory_order_relaxed);
+    _tail.store(0, std::memory_order_relaxed);
+    _cachedHead = 0;
+    _cachedTail = 0;
+    return true;
+  }
+
+  /**
+   * @brief               Add an item (producer side)
+   * @return              False if the queue is full
+   */
+  bool tryPush(const T& item) noexcept {
+    const size_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail - _cachedHead >= _capacity) {
+      _cachedHead = _head.load(std::memory_order_acquire);
+      if (tail - _cachedHead >= _capacity) {
+        return false;
+      }
+    }
+    _items[tail & _mask] = item;
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief               Take the oldest item (consumer side)
+   * @return              False if the queue is empty
+   */
+  bool tryPop(T* item) noexcept {
+    const size_t head = _head.load(std::memory_order_relaxed);
+    if (head == _cachedTail) {
+      _cachedTail = _tail.load(std::memory_order_acquire);
+      if (head == _cachedTail) {
+        return false;
+      }
+    }
+    *item = _items[head & _mask];
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief               Look at the oldest item without removing it
+   *                      (consumer side)
+   * @return              False if the queue is empty
+   */
+  bool tryPeek(T* item) noexcept {
+    const size_t head = _head.load(std::memory_order_relaxed);
+    if (head == _cachedTail) {
+      _cachedTail = _tail.load(std::memory_order_acquire);
+      if (head == _cachedTail) {
+        return false;
+      }
+    }
+    *item = _items[head & _mask];
+    return true;
+  }
+
+  /**
+   * @brief               Number of items in the queue. Exact only when
+   *                      called from the producer or consumer thread while
+   *                      the other side is idle
+   */
+  int size() const noexcept {
+    const size_t head = _head.load(std::memory_order_acquire);
+    const size_t tail = _tail.load(std::memory_order_acquire);
+    return (int)(tail - head);
+  }
+
+  int capacity() const noexcept { return (int)_capacity; }
+
+ private:
+  std::vector<T> _items;
+  size_t _capacity;
+  size_t _mask;
+
+  /*  consumer side   */
+  alignas(64) std::atomic<size_t> _head;
+  size_t _cachedTail;
+
+  /*  producer side   */
+  alignas(64) std::atomic<size_t> _tail;
+  size_t _cachedHead;
+};
+
+/**
+ * Bounded lock-free queue for any number of producer threads and one
+ * consumer thread. Every slot carries a sequence number that tells whether
+ * it is free for the producer of a given position or holds an item for the
+ * consumer, so producers only contend on the shared tail index (a single
+ * compare-and-swap) and never wait for each other. Like SpscQueue, neither
+ * side ever blocks.
+ *
+ * Items are copied into preallocated slots; T should be cheap to copy.
+ */
+template <typename T>
+class MpscQueue {
+ public:
+  MpscQueue() noexcept : _mask(0), _head(0), _tail(0) {}
+
+  ~MpscQueue() noexcept {}
+
+ private:
+  MpscQueue(const MpscQueue&);
+  MpscQueue& operator=(const MpscQueue&);
+
+ public:
+  /**
+   * @brief               Set up the queue. Not thread-safe: must be called
+   *                      before the producers and consumer start.
+   * @param capacity      Maximum number of items in the queue; rounded up
+   *                      to a power of two
+   */
+  bool setup(const int& capacity) noexcept {
+    if (capacity < 1) {
+      return false;
+    }
+    size_t size = 1;
+    while (size < (size_t)capacity) {
+      size <<= 1;
+    }
+    try {
+      std::vector<Slot> slots(size);
+      _slots.swap(slots);
+    } catch (const std::exception& e) {
+      return false;
+    }
+    for (size_t i = 0; i < size; ++i) {
+      _slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    _mask = size - 1;
+    _head.store(0, std::memory_order_relaxed);
+    _tail.store(0, std::memory_order_relaxed);
+    return true;
+  }
+
+  /**
+   * @brief               Add an item (producer side, any thread)
+   * @return              False if the queue is full
+   */
+  bool tryPush(const T& item) noexcept {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    Slot* slot = nullptr;
+    while (true) {
+      slot = &_slots[tail & _mask];
+      const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      const intptr_t difference = (intptr_t)sequence - (intptr_t)tail;
+      if (difference == 0) {
+        if (_tail.compare_exchange_weak(tail, tail + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        return false; /*  the slot still holds an item: full  */
+      } else {
+        tail = _tail.load(std::memory_order_relaxed);
+      }
+    }
+    slot->item = item;
+    slot->sequence.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief               Take the oldest item (consumer side)
+   * @return              False if the queue is empty, or if the producer
+   *                      of the oldest item has not finished writing it
+   */
+  bool tryPop(T* item) noexcept {
+    const size_t head = _head.load(std::memory_order_relaxed);
+    Slot& slot = _slots[head & _mask];
+    if (slot.sequence.load(std::memory_order_acquire) != head + 1) {
+      return false;
+    }
+    *item = slot.item;
+    slot.sequence.store(head + _mask + 1, std::memory_order_release);
+    _head.store(head + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  int capacity() const noexcept { return (int)(_mask + 1); }
+
+ private:
+  struct Slot {
+    Slot() noexcept : sequence(0) {}
+
+    std::atomic<size_t> sequence;
+    T item;
+  };
+
+  std::vector<Slot> _slots;
+  size_t _mask;
+
+  /*  consumer side   */
+  alignas(64) std::atomic<size_t> _head;
+
+  /*  producer side   */
+  alignas(64) std::atomic<size_t> _tail;
+};
+
+/**
+ * Waiting strategy for threads polling lock-free queues, which cannot
+ * block: yield for a while, then sleep, so that idle threads do not
+ * occupy a core
+ */
+class Backoff {
+ public:
+  Backoff() noexcept : _count(0) {}
+
+  void wait() noexcept {
+    if (_count < 64) {
+      _count += 1;
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  }
+
+  void reset() noexcept { _count = 0; }
+
+ private:
+  int _count;
+};
+
+/**
+ * Single-slot mailbox for one producer and one consumer where only the
+ * newest value matters (latest-value-wins): posting replaces a value that
+ * has not been taken yet. Values are exchanged by swapping, so buffers
+ * (e.g. cv::Mat) are recycled between producer and consumer.
+ */
+template <typename T>
+class Mailbox {
+ public:
+  Mailbox() noexcept : _full(false), _closed(false), _numDropped(0) {}
+
+  ~Mailbox() noexcept {}
+
+ private:
+  Mailbox(const Mailbox&);
+  Mailbox& operator=(const Mailbox&);
+
+ public:
+  /**
+   * @brief               Post a value, replacing the previous one if it has
+   *                      not been taken yet. 'value' receives the recycled
+   *                      content of the slot.
+   * @return              False if the mailbox has been closed
+   */
+  bool post(T* value) noexcept {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (_closed) {
+        return false;
+      }
+      if (_full) {
+        _numDropped += 1;
+      }
+      std::swap(_value, *value);
+      _full = true;
+    }
+    _cv.notify_one();
+    return true;
+  }
+
+  /**
+   * @brief               Take the newest value, waiting until one has been
+   *                      posted. The previous content of 'value' is
+   *                      recycled.
+   * @return              False if the mailbox was closed and is empty
+   */
+  bool take(T* value) noexcept {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cv.wait(lock, [this]() { return _full || _closed; });
+    if (!_full) {
+      return false;
+    }
+    std::swap(_value, *value);
+    _full = false;
+    return true;
+  }
+
+  /**
+   * @brief               Close the mailbox; wakes up a waiting consumer
+   */
+  void close() noexcept {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _closed = true;
+    }
+    _cv.notify_all();
+  }
+
+  /**
+   * @brief               Number of values that were replaced before they
+   *                      were taken
+   */
+  uint64_t numDropped() const noexcept {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _numDropped;
+  }
+
+ private:
+  T _value;
+  bool _full;
+  bool _closed;
+  uint64_t _numDropped;
+
+  mutable std::mutex _mutex;
+  std::condition_variable _cv;
+};
+
+} /*  namespace yolov5    */
+
+#endif /*  include guard   */
\ No newline at end of file
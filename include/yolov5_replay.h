@@ -0,0 +1,162 @@
+#ifndef _YOLOV5_REPLAY_HPP_
+#define _YOLOV5_REPLAY_HPP_
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "yolov5_detector_internal.h"
+
+namespace yolov5 {
+
+/**
+ * The tensors of a single call to Detector::detect() or detectBatch(): the
+ * network input, the raw network output, the letterbox transform of every
+ * image and the resulting detections
+ */
+struct TensorFrame {
+  TensorFrame() noexcept;
+
+  uint64_t sequence; /**<    number of the recorded call   */
+
+  int numImages;
+
+  double scoreThreshold;
+  double nmsThreshold;
+
+  nvinfer1::Dims inputDims; /**<    NCHW, N = numImages   */
+  const float* input;       /**<    nullptr if not recorded   */
+
+  nvinfer1::Dims outputDims; /**<    N x rows x (5 + classes)  */
+  const float* output;
+
+  std::vector<internal::PreprocessorTransform> transforms; /**< per image */
+  std::vector<std::vector<Detection>> detections;          /**< per image */
+};
+
+struct TensorRecorderOptions {
+  TensorRecorderOptions() noexcept;
+
+  /** record the network input as well; it is usually larger than the
+      output. Default: true */
+  bool recordInput;
+
+  /** record one in this many calls. Default: 1 */
+  int interval;
+
+  /** stop recording once the file reaches this size; 0 for no limit.
+      Default: 1 GiB */
+  uint64_t maxBytes;
+};
+
+/**
+ * Writes TensorFrames to a capture file, see Detector::setRecorder(). The
+ * file is a header followed by one record per frame; all tensors are
+ * stored as raw floats, so that a TensorCapture can map them directly.
+ * Records are appended under a lock, so a recorder may be shared between
+ * threads.
+ */
+class TensorRecorder {
+ public:
+  TensorRecorder() noexcept;
+
+  ~TensorRecorder() noexcept;
+
+ private:
+  TensorRecorder(const TensorRecorder&);
+  TensorRecorder& operator=(const TensorRecorder&);
+
+ public:
+  /**
+   * @brief               Create (or truncate) the capture file
+   */
+  Result open(const std::string& filepath,
+              const TensorRecorderOptions& options =
+                  TensorRecorderOptions()) noexcept;
+
+  bool isOpen() const noexcept;
+
+  /**
+   * @brief               Count a call of the Detector, and decide whether
+   *                      it should be recorded, according to the options
+   */
+  bool shouldRecord() noexcept;
+
+  const TensorRecorderOptions& options() const noexcept;
+
+  /**
+   * @brief               Append a frame to the capture file
+   */
+  Result record(const TensorFrame& frame) noexcept;
+
+  /**
+   * @brief               Flush and close the capture file
+   */
+  Result close() noexcept;
+
+  uint64_t numRecorded() const noexcept;
+
+  uint64_t bytesWritten() const noexcept;
+
+  void setLogger(std::shared_ptr<Logger> logger) noexcept;
+
+ private:
+  std::shared_ptr<Logger> _logger;
+  TensorRecorderOptions _options;
+
+  mutable std::mutex _mutex;
+  std::FILE* _file;
+  uint64_t _numCalls;
+  uint64_t _numRecorded;
+  uint64_t _bytesWritten;
+  bool _full;
+};
+
+/**
+ * Read-only view of a capture file written by a TensorRecorder. The file is
+ * memory-mapped; the tensors of the frames point into the mapping, so
+ * frames can be replayed without copying.
+ */
+class TensorCapture {
+ public:
+  TensorCapture() noexcept;
+
+  ~TensorCapture() noexcept;
+
+ private:
+  TensorCapture(const TensorCapture&);
+  TensorCapture& operator=(const TensorCapture&);
+
+ public:
+  /**
+   * @brief               Map and validate a capture file
+   */
+  Result open(const std::string& filepath) noexcept;
+
+  void close() noexcept;
+
+  int numFrames() const noexcept;
+
+  /**
+   * @brief               Frame of the capture. Valid until close()
+   */
+  const TensorFrame& frame(const int& index) const noexcept;
+
+  void setLogger(std::shared_ptr<Logger> logger) noexcept;
+
+ private:
+  std::shared_ptr<Logger> _logger;
+
+  void* _mapping;
+  size_t _size;
+
+  std::vector<TensorFrame> _frames;
+};
+
+} /*  namespace yolov5    */
+
+#endif /*  include guard   */
\ No newline at end of file
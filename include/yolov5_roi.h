@@ -0,0 +1,122 @@
+#ifndef _YOLOV5_ROI_HPP_
+#define _YOLOV5_ROI_HPP_
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "yolov5_detector.h"
+
+namespace yolov5 {
+
+struct RoiOptions {
+  RoiOptions() noexcept;
+
+  /** run a full-frame detection at least once every this many frames,
+      to find new objects. Default: 10 */
+  int fullFrameInterval;
+
+  /** padding around a detection, relative to its size, on every side.
+      Default: 0.5 */
+  double padding;
+
+  /** minimum size of a region relative to the network input size;
+      smaller objects are detected at a higher resolution than in a
+      full-frame pass. Default: 0.5 */
+  double minRegionScale;
+
+  /** do a full-frame detection instead if the regions cover more than
+      this fraction of the image. Default: 0.5 */
+  double maxCoverage;
+};
+
+struct RoiStats {
+  RoiStats() noexcept;
+
+  uint64_t frames;     /**<    frames detected   */
+  uint64_t fullFrames; /**<    frames detected with a full-frame pass   */
+  uint64_t regions;    /**<    regions detected in the other frames    */
+
+  /**
+   * @brief               Mean number of regions per region-based frame
+   */
+  double meanRegions() const noexcept;
+};
+
+/**
+ * Detects objects in regions around the objects of the previous frame,
+ * rather than in the full frame. The regions are padded, merged where
+ * they overlap, and detected together with Detector::detectBatch(); the
+ * results are mapped back to the frame. Full-frame passes run
+ * periodically, and whenever the regions would not save work.
+ *
+ * When only a few, small objects are present, the regions are smaller
+ * than the frame, so objects are seen at a higher resolution.
+ */
+class RoiDetector {
+ public:
+  RoiDetector() noexcept;
+
+  ~RoiDetector() noexcept;
+
+ private:
+  RoiDetector(const RoiDetector&);
+  RoiDetector& operator=(const RoiDetector&);
+
+ public:
+  /**
+   * @brief               Set up the detector
+   * @param detector      Detector with a loaded engine. Must outlive the
+   *                      RoiDetector. Engines with a larger batch size
+   *                      allow more regions per frame
+   * @param options       Options
+   * @param flags         Flags passed to the Detector
+   */
+  Result setup(Detector* detector, const RoiOptions& options = RoiOptions(),
+               const int& flags = INPUT_BGR) noexcept;
+
+  /**
+   * @brief               Detect objects in the next frame of a sequence
+   */
+  Result detect(const cv::Mat& image, std::vector<Detection>* out) noexcept;
+
+  /**
+   * @brief               Forget the previous frame; the next frame gets a
+   *                      full-frame pass
+   */
+  void reset() noexcept;
+
+  /**
+   * @brief               Regions used for the last frame. Empty if it was
+   *                      a full-frame pass
+   */
+  const std::vector<cv::Rect>& regions() const noexcept;
+
+  RoiStats stats() const noexcept;
+
+ private:
+  /*  Compute the regions around the previous detections. Returns false
+      if a full-frame pass should be done instead  */
+  bool _computeRegions(const cv::Size& imageSize);
+
+ private:
+  Detector* _detector;
+  std::shared_ptr<Logger> _logger;
+  RoiOptions _options;
+  int _flags;
+
+  std::vector<Detection> _previous;
+  int _framesSinceFullFrame;
+
+  std::vector<cv::Rect> _regions;
+  std::vector<cv::Mat> _crops;
+  std::vector<std::vector<Detection>> _results;
+
+  uint64_t _statsFrames;
+  uint64_t _statsFullFrames;
+  uint64_t _statsRegions;
+};
+
+} /*  namespace yolov5    */
+
+#endif /*  include guard   */
\ No newline at end of file
@@ -0,0 +1,138 @@
+#ifndef _YOLOV5_STARTUP_HPP_
+#define _YOLOV5_STARTUP_HPP_
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+#include "yolov5_common.h"
+
+namespace yolov5 {
+
+/**
+ * Records the phases of application startup (e.g. loading the engine,
+ * opening the capture device) with their start and end times relative to
+ * the construction of the timeline. Phases may overlap and may be recorded
+ * from different threads.
+ */
+class StartupTimeline {
+ public:
+  struct Phase {
+    std::string name;
+    double start; /**<    milliseconds since the start of the timeline  */
+    double end;   /**<    negative if the phase has not ended yet   */
+  };
+
+ public:
+  StartupTimeline() noexcept;
+
+  ~StartupTimeline() noexcept;
+
+ public:
+  /**
+   * @brief               Start a new phase
+   * @return              Identifier of the phase, or -1 on failure
+   */
+  int begin(const std::string& name) noexcept;
+
+  /**
+   * @brief               End the phase with the specified identifier
+   */
+  void end(const int& id) noexcept;
+
+  /**
+   * @brief               Record an event, i.e. a phase without duration
+   */
+  void mark(const std::string& name) noexcept;
+
+  /**
+   * @brief               Milliseconds since the start of the timeline
+   */
+  double elapsed() const noexcept;
+
+  std::vector<Phase> phases() const noexcept;
+
+  /**
+   * @brief               Human-readable table of all phases, in order of
+   *                      their start time
+   */
+  bool toString(std::string* out) const noexcept;
+
+ private:
+  std::chrono::steady_clock::time_point _startTime;
+
+  mutable std::mutex _mutex;
+  std::vector<Phase> _phases;
+};
+
+/**
+ * Bounded ring of frames, filled by a single capture thread and drained by
+ * a single consumer. Frames are exchanged with the caller by swapping, so
+ * the buffers are recycled instead of reallocated for every frame.
+ */
+class FrameRing {
+ public:
+  FrameRing() noexcept;
+
+  ~FrameRing() noexcept;
+
+ public:
+  /**
+   * @brief               Set up the ring
+   * @param capacity      Number of frames that can be buffered
+   * @param dropOldest    If true, push() replaces the oldest frame when the
+   *                      ring is full (live sources). Otherwise, push()
+   *                      waits until there is space (files)
+   */
+  bool setup(const int& capacity, const bool& dropOldest) noexcept;
+
+  /**
+   * @brief               Add a frame. The frame is swapped with a recycled
+   *                      buffer, which can be used to capture the next frame
+   * @return              False if the ring has been closed
+   */
+  bool push(cv::Mat* frame) noexcept;
+
+  /**
+   * @brief               Take the oldest frame, waiting if the ring is empty.
+   *                      The previous content of 'frame' is recycled
+   * @return              False if the ring is closed and empty
+   */
+  bool pop(cv::Mat* frame) noexcept;
+
+  /**
+   * @brief               Close the ring; wakes up all waiting threads
+   */
+  void close() noexcept;
+
+  bool isClosed() const noexcept;
+
+  int size() const noexcept;
+
+  int capacity() const noexcept;
+
+  /**
+   * @brief               Number of frames replaced because the ring was full
+   */
+  uint64_t numDropped() const noexcept;
+
+ private:
+  std::vector<cv::Mat> _frames;
+  bool _dropOldest;
+
+  int _head; /**<    index of the oldest frame   */
+  int _size;
+  bool _closed;
+  uint64_t _numDropped;
+
+  mutable std::mutex _mutex;
+  std::condition_variable _cv;
+};
+
+} /*  namespace yolov5    */
+
+#endif /*  include guard   */
\ No newline at end of file
@@ -0,0 +1,144 @@
+#ifndef _YOLOV5_STATS_HPP_
+#define _YOLOV5_STATS_HPP_
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace yolov5 {
+
+/**
+ * Histogram of latencies in microseconds with bounded relative error, in
+ * the style of HdrHistogram: values are grouped by their power of two, and
+ * every power of two is split into 16 linear sub-buckets. Percentiles are
+ * accurate to within ~6%, for latencies from 1 us up to days, using a
+ * fixed amount of memory.
+ *
+ * Recording is O(1) and does not allocate. The histogram is not
+ * thread-safe; use one per thread and merge() them.
+ */
+class LatencyHistogram {
+ public:
+  LatencyHistogram() noexcept;
+
+  ~LatencyHistogram() noexcept;
+
+ public:
+  /**
+   * @brief               Record a latency in microseconds
+   */
+  void record(const uint64_t& value) noexcept;
+
+  /**
+   * @brief               Record a latency the specified number of times
+   */
+  void record(const uint64_t& value, const uint64_t& times) noexcept;
+
+  /**
+   * @brief               Add all values recorded in another histogram
+   */
+  void merge(const LatencyHistogram& other) noexcept;
+
+  void reset() noexcept;
+
+  uint64_t count() const noexcept;
+
+  uint64_t min() const noexcept;
+
+  uint64_t max() const noexcept;
+
+  double mean() const noexcept;
+
+  /**
+   * @brief               Latency below which the specified fraction of the
+   *                      recorded values lie
+   * @param p             Fraction in [0, 1], e.g. 0.99
+   */
+  uint64_t percentile(const double& p) const noexcept;
+
+  /**
+   * @brief               Summary (count, mean, percentiles and max) in
+   *                      milliseconds
+   */
+  bool toString(std::string* out) const noexcept;
+
+ public:
+  /*  Bucket layout, shared with histograms that record concurrently  */
+  static const int SUB_BUCKET_BITS = 4;
+  static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  static const int NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+  static int bucketIndex(const uint64_t& value) noexcept;
+
+  /**
+   * @brief               Representative value of a bucket (its middle)
+   */
+  static uint64_t bucketValue(const int& index) noexcept;
+
+  /**
+   * @brief               Largest value that falls into a bucket
+   */
+  static uint64_t bucketMax(const int& index) noexcept;
+
+ private:
+
+  uint64_t _buckets[NUM_BUCKETS];
+  uint64_t _count;
+  uint64_t _min;
+  uint64_t _max;
+  double _sum;
+};
+
+/**
+ * Least-squares line through a series of (x, y) samples, e.g. memory use
+ * over time, to tell a steady growth apart from noise. Uses a constant
+ * amount of memory; x values are taken relative to the first sample, so
+ * that large timestamps do not cost precision.
+ */
+class LinearTrend {
+ public:
+  LinearTrend() noexcept;
+
+  ~LinearTrend() noexcept;
+
+ public:
+  void add(const double& x, const double& y) noexcept;
+
+  void reset() noexcept;
+
+  uint64_t count() const noexcept;
+
+  /**
+   * @brief               Change of y per unit of x. 0 with fewer than two
+   *                      distinct x values
+   */
+  double slope() const noexcept;
+
+  /**
+   * @brief               Value of the line at the first x
+   */
+  double intercept() const noexcept;
+
+  /**
+   * @brief               Fraction of the variance of y explained by the
+   *                      line, in [0, 1]. Close to 1 for a steady trend,
+   *                      close to 0 for noise. 0 if y is constant
+   */
+  double rSquared() const noexcept;
+
+  double meanY() const noexcept;
+
+ private:
+  uint64_t _count;
+  double _x0;
+  double _sumX;
+  double _sumY;
+  double _sumXX;
+  double _sumXY;
+  double _sumYY;
+};
+
+} /*  namespace yolov5    */
+
+#endif /*  include guard   */
\ No newline at end of file
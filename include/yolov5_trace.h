@@ -0,0 +1,144 @@
+#ifndef _YOLOV5_TRACE_HPP_
+#define _YOLOV5_TRACE_HPP_
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "yolov5_common.h"
+
+namespace yolov5 {
+
+/**
+ * Process-wide recorder of trace spans, e.g. the stages of
+ * Detector::detect(). Every thread records into its own ring buffer with
+ * nanosecond timestamps and the identifier of the frame it is working on;
+ * when a ring is full, its oldest spans are overwritten. The spans of all
+ * threads can be exported as a Chrome trace (chrome://tracing, Perfetto).
+ * The ring of a thread that has exited is released once its spans have
+ * been exported or cleared.
+ *
+ * Tracing is disabled by default. While disabled, a span costs a single
+ * relaxed atomic load. Defining YOLOV5_NO_TRACING (CMake option
+ * YOLOV5_TRACING=OFF) removes the spans at compile time.
+ *
+ * Spans of asynchronous CUDA work (enqueue, copies) measure the time spent
+ * by the host thread; the GPU time shows up in the synchronization span.
+ */
+class Tracer {
+ public:
+  /**
+   * @brief               Start or stop recording spans
+   */
+  static void setEnabled(const bool& enabled) noexcept;
+
+  static bool isEnabled() noexcept {
+    return _enabled.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief               Set the frame that subsequent spans of the calling
+   *                      thread belong to
+   */
+  static void setFrame(const uint64_t& frame) noexcept;
+
+  /**
+   * @brief               Name the calling thread in exported traces
+   */
+  static void setThreadName(const std::string& name) noexcept;
+
+  /**
+   * @brief               Number of spans kept per thread. Applies to
+   *                      threads that record their first span afterwards.
+   *                      Default: 16384
+   */
+  static void setRingCapacity(const int& capacity) noexcept;
+
+  /**
+   * @brief               Nanoseconds on the clock used by the spans
+   */
+  static int64_t now() noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  /**
+   * @brief               Record a span of the calling thread. The name must
+   *                      outlive the tracer, e.g. a string literal
+   */
+  static void record(const char* name, const int64_t& begin,
+                     const int64_t& end) noexcept;
+
+  /**
+   * @brief               Write the recorded spans of all threads as Chrome
+   *                      trace JSON. Spans recorded during the export may
+   *                      be missing. Spans of threads that have exited are
+   *                      only exported once
+   */
+  static Result exportChromeTrace(const std::string& filepath) noexcept;
+
+  /**
+   * @brief               Discard the recorded spans of all threads
+   */
+  static void clear() noexcept;
+
+ private:
+  static std::atomic<bool> _enabled;
+};
+
+/**
+ * Records a span from its construction until end() is called or the span
+ * goes out of scope. With YOLOV5_NO_TRACING, it does nothing
+ */
+class TraceSpan {
+ public:
+#ifndef YOLOV5_NO_TRACING
+  explicit TraceSpan(const char* name) noexcept
+      : _name(Tracer::isEnabled() ? name : nullptr), _begin(0) {
+    if (_name != nullptr) {
+      _begin = Tracer::now();
+    }
+  }
+
+  ~TraceSpan() noexcept { end(); }
+
+  void end() noexcept {
+    if (_name != nullptr) {
+      Tracer::record(_name, _begin, Tracer::now());
+      _name = nullptr;
+    }
+  }
+#else
+  explicit TraceSpan(const char*) noexcept : _name(nullptr), _begin(0) {}
+
+  void end() noexcept {}
+#endif
+
+ private:
+  TraceSpan(const TraceSpan&);
+  TraceSpan& operator=(const TraceSpan&);
+
+ private:
+  const char* _name;
+  int64_t _begin;
+};
+
+} /*  namespace yolov5    */
+
+#define YOLOV5_TRACE_CONCAT_(a, b) a##b
+#define YOLOV5_TRACE_CONCAT(a, b) YOLOV5_TRACE_CONCAT_(a, b)
+
+#ifndef YOLOV5_NO_TRACING
+/*  Record a span until the end of the enclosing scope   */
+#define YOLOV5_TRACE_SPAN(name) \
+  yolov5::TraceSpan YOLOV5_TRACE_CONCAT(_yolov5TraceSpan, __LINE__)(name)
+#define YOLOV5_TRACE_FRAME(frame) yolov5::Tracer::setFrame(frame)
+#else
+#define YOLOV5_TRACE_SPAN(name)
+#define YOLOV5_TRACE_FRAME(frame)
+#endif
+
+#endif /*  include guard   */
\ No newline at end of file
@@ -0,0 +1,209 @@
+#ifndef _YOLOV5_TRACKER_HPP_
+#define _YOLOV5_TRACKER_HPP_
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "yolov5_detection.h"
+
+namespace yolov5 {
+
+struct TrackerOptions {
+  TrackerOptions() noexcept;
+
+  /** run the detector at least once every this many frames; the tracks
+      are extrapolated in between. Default: 3 */
+  int detectionInterval;
+
+  /** run the detector early if a confirmed track's confidence decays
+      below this value. Default: 0.3 */
+  double minConfidence;
+
+  /** factor applied to the confidence of a track for every frame that
+      is not detected. Default: 0.9 */
+  double confidenceDecay;
+
+  /** minimum IoU between a track and a detection to associate them.
+      Default: 0.3 */
+  double iouThreshold;
+
+  /** detections with at least this score are associated first and may
+      start new tracks. Default: 0.5 */
+  double highScore;
+
+  /** detections with a score between this value and highScore are only
+      used to keep existing tracks alive (ByteTrack). Default: 0.1 */
+  double lowScore;
+
+  /** number of consecutive detected frames a track needs to be matched
+      to be confirmed. Default: 2 */
+  int minHits;
+
+  /** number of consecutive detected frames a track may go unmatched
+      before it is removed. Default: 3 */
+  int maxMisses;
+};
+
+/**
+ * An object followed over multiple frames by the Tracker
+ */
+struct Track {
+  Track() noexcept;
+
+  uint64_t id; /**<    unique within the Tracker   */
+  int classId;
+  std::string className;
+
+  double score;      /**<    score of the last matched detection    */
+  double confidence; /**<    score, decayed for extrapolated frames */
+
+  cv::Rect boundingBox;
+  cv::Point2d velocity; /**<    pixels per frame, of the center    */
+
+  int hits;              /**<    number of matched detections   */
+  int framesSinceUpdate; /**<    frames since the last match    */
+
+  Detection toDetection() const noexcept;
+};
+
+struct TrackerStats {
+  TrackerStats() noexcept;
+
+  uint64_t frames;         /**<    frames passed to the tracker  */
+  uint64_t detectedFrames; /**<    frames with detections   */
+
+  /**
+   * @brief               Fraction of the frames for which the detector
+   *                      did not have to run
+   */
+  double skippedFraction() const noexcept;
+};
+
+/**
+ * Multi-object tracker for the output of the Detector (SORT/ByteTrack).
+ *
+ * Every track has a constant-velocity Kalman filter on its center and
+ * size. For a frame with detections, the tracks are predicted and then
+ * associated with the detections on IoU, by solving the assignment
+ * problem per group of overlapping boxes. This keeps association cheap
+ * with thousands of tracks.
+ *
+ * Between detections, the tracks are extrapolated, so that the detector
+ * only has to run every few frames (see needsDetection()):
+ *
+ *   if (tracker.needsDetection()) {
+ *     detector.detect(image, &detections);
+ *     tracker.update(detections, &tracks);
+ *   } else {
+ *     tracker.predict(&tracks);
+ *   }
+ */
+class Tracker {
+ public:
+  Tracker() noexcept;
+
+  ~Tracker() noexcept;
+
+ public:
+  Result setup(const TrackerOptions& options = TrackerOptions()) noexcept;
+
+  /**
+   * @brief               Whether the detector should run for the next
+   *                      frame: the detection interval has elapsed, or the
+   *                      confidence of a confirmed track decayed too much
+   */
+  bool needsDetection() const noexcept;
+
+  /**
+   * @brief               Advance one frame that has detections
+   * @param detections    Detections of the frame
+   * @param out           [out] Optional. The confirmed tracks
+   */
+  Result update(const std::vector<Detection>& detections,
+                std::vector<Track>* out = nullptr) noexcept;
+
+  /**
+   * @brief               Advance one frame without detections; the tracks
+   *                      are extrapolated
+   * @param out           [out] Optional. The confirmed tracks
+   */
+  Result predict(std::vector<Track>* out = nullptr) noexcept;
+
+  /**
+   * @brief               Remove all tracks
+   */
+  void reset() noexcept;
+
+  int numTracks() const noexcept;
+
+  TrackerStats stats() const noexcept;
+
+  void setLogger(std::shared_ptr<Logger> logger) noexcept;
+
+ private:
+  /*  One coordinate of the Kalman filter. The process and measurement
+      noise are diagonal, so the filter separates into independent
+      position/velocity filters per coordinate   */
+  struct KalmanAxis {
+    double position, velocity;
+    double p00, p01, p11; /**<    covariance    */
+
+    void init(const double& z, const double& sigmaP,
+              const double& sigmaV) noexcept;
+    void predict(const double& qP, const double& qV) noexcept;
+    void update(const double& z, const double& r) noexcept;
+  };
+
+  struct TrackState {
+    Track track;
+    KalmanAxis axes[4]; /**<    center x, center y, width, height   */
+    bool confirmed;
+    int misses;
+  };
+
+  void _predictTracks() noexcept;
+
+  /*  Match the tracks to the detections, both given as indices. Matched
+      indices are removed from the lists  */
+  void _associate(const std::vector<Detection>& detections,
+                  std::vector<int>* tracks, std::vector<int>* candidates);
+
+  /*  Hungarian algorithm on the rows x cols matrix in _cost, with
+      rows <= cols. The result is stored in _assignment   */
+  void _solve(const int& rows, const int& cols);
+
+  void _updateTrack(TrackState* state, const Detection& detection) noexcept;
+
+  void _output(std::vector<Track>* out) const;
+
+ private:
+  std::shared_ptr<Logger> _logger;
+  TrackerOptions _options;
+
+  std::vector<TrackState> _tracks;
+  uint64_t _nextId;
+  int _framesSinceDetection;
+
+  uint64_t _statsFrames;
+  uint64_t _statsDetectedFrames;
+
+  /*  scratch buffers, reused between frames */
+  std::vector<cv::Rect2d> _boxes;
+  std::vector<int> _order;
+  std::vector<int> _parent;
+  std::vector<std::pair<int, int>> _edges;
+  std::vector<double> _iou;
+  std::vector<int> _trackMatch;
+  std::vector<int> _rowIndex, _colIndex;
+  std::vector<int> _rows, _cols;
+  std::vector<int> _high, _low, _unmatched, _confirmed;
+  std::vector<double> _cost;
+  std::vector<double> _u, _v, _minv;
+  std::vector<int> _p, _way, _assignment;
+  std::vector<char> _used;
+};
+
+} /*  namespace yolov5    */
+
+#endif /*  include guard   */
\ No newline at end of file
@@ -0,0 +1,118 @@
+#ifndef _YOLOV5_WRITER_HPP_
+#define _YOLOV5_WRITER_HPP_
+#pragma once
+
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "yolov5_detection.h"
+
+namespace yolov5 {
+
+enum DetectionFormat {
+  /**<    one JSON object per frame and line:
+          {"frame":0,"source":"a.jpg","detections":[{"class":0,
+          "name":"person","score":0.91,"box":[x,y,w,h]}]}  */
+  DETECTION_FORMAT_JSONL = 0,
+
+  /**<    compact binary: the header "YV5D" followed by the uint32 version
+          (1), then per frame: uint64 frame, uint32 number of detections,
+          and per detection: int32 class, float32 score, int32 x, y, w, h.
+          All values are little-endian   */
+  DETECTION_FORMAT_BINARY = 1
+};
+
+/**
+ * Writes detections to a file on a background thread. Frames are handed
+ * over in batches and formatted by the writer thread into a large write
+ * buffer, so that the caller does not pay for formatting or file I/O.
+ */
+class DetectionWriter {
+ public:
+  DetectionWriter() noexcept;
+
+  ~DetectionWriter() noexcept;
+
+ private:
+  DetectionWriter(const DetectionWriter&);
+  DetectionWriter& operator=(const DetectionWriter&);
+
+ public:
+  /**
+   * @brief               Open the output file and start the writer thread
+   * @param filepath      Output file
+   * @param format        Output format
+   * @param maxPending    Number of frames that may be pending before
+   *                      write() waits for the writer thread
+   */
+  Result open(const std::string& filepath, const DetectionFormat& format,
+              const int& maxPending = 1024) noexcept;
+
+  /**
+   * @brief               Queue the detections of a frame for writing. The
+   *                      content of 'detections' is taken over (swapped
+   *                      with a recycled list).
+   * @param frame         Frame number
+   * @param source        Optional name of the frame (e.g. image path),
+   *                      only written in JSON-lines format
+   */
+  Result write(const uint64_t& frame, const std::string& source,
+               std::vector<Detection>* detections) noexcept;
+
+  /**
+   * @brief               Write all pending frames, stop the writer thread
+   *                      and close the file
+   * @return              The first error that occurred while writing, or
+   *                      RESULT_SUCCESS
+   */
+  Result close() noexcept;
+
+  bool isOpen() const noexcept;
+
+  uint64_t numFrames() const noexcept;
+
+  uint64_t numBytes() const noexcept;
+
+  void setLogger(std::shared_ptr<Logger> logger) noexcept;
+
+ private:
+  struct Record {
+    uint64_t frame;
+    std::string source;
+    std::vector<Detection> detections;
+  };
+
+  void _run() noexcept;
+
+  void _formatRecord(const Record& record, std::string* out) const;
+
+ private:
+  std::shared_ptr<Logger> _logger;
+
+  FILE* _file;
+  DetectionFormat _format;
+  int _maxPending;
+
+  std::thread _thread;
+  mutable std::mutex _mutex;
+  std::condition_variable _cv;
+
+  /*  Frames are appended to _pending; the writer thread swaps it with
+      its own list and hands back the previous list for reuse   */
+  std::vector<Record> _pending;
+  int _numPending;
+  bool _closing;
+  Result _result;
+
+  uint64_t _numFrames;
+  uint64_t _numBytes;
+};
+
+} /*  namespace yolov5    */
+
+#endif /*  include guard   */
\ No newline at end of file
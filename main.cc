@@ -1,11 +1,36 @@
+#include <atomic>
 #include <chrono>
+#include <climits>
+#include <csignal>
+#include <cstdio>
 #include <filesystem>
+#include <fstream>
+#include <future>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
+#include <thread>
 #include <opencv2/highgui.hpp>
+#include <opencv2/imgcodecs.hpp>
 #include <opencv2/videoio.hpp>
 
 #include "yolov5_builder.h"
+#include "yolov5_calibrator.h"
 #include "yolov5_detector.h"
+#include "yolov5_mosaic.h"
+#include "yolov5_metrics.h"
+#include "yolov5_motion.h"
+#include "yolov5_multistream.h"
+#include "yolov5_overlay.h"
+#include "yolov5_perf.h"
+#include "yolov5_pipeline.h"
+#include "yolov5_queue.h"
+#include "yolov5_roi.h"
+#include "yolov5_stats.h"
+#include "yolov5_trace.h"
+#include "yolov5_tracker.h"
+#include "yolov5_writer.h"
+#include "yolov5_startup.h"
 
 char* getCmdOption(char** begin, char** end, const std::string& option) {
   char** itr = std::find(begin, end, option);
@@ -35,17 +60,177 @@ void printHelp() {
                "--model :         [mandatory] specify the ONNX model file\n"
                "--video :         [optional] specify the video file path\n"
                "--camera :        [optional] camera index\n"
+               "--precision :     [optional] fp32, fp16 (default) or int8\n"
+               "--calibration :   [optional] directory or list of images "
+               "used for int8 calibration. The table is cached next to the "
+               "model, per model and image list\n"
+               "--sizes :         [optional] inference sizes to choose from, "
+               "e.g. 640x384,384x640 (requires a model with dynamic "
+               "resolution)\n"
+               "--warmup :        [optional] number of synthetic detections "
+               "to run before the first frame (default 3, 0 to disable)\n"
+               "--low-latency :   [optional] always detect on the newest "
+               "frame and drop the others, for live cameras\n"
+               "--track :         [optional] with --low-latency, track objects "
+               "and run the detector only every N frames\n"
+               "--roi :           [optional] with --low-latency, detect only "
+               "regions around the objects, with a full-frame pass every N "
+               "frames\n"
+               "--motion :        [optional] skip detection of frames in "
+               "which nothing changed, reusing the previous detections\n"
+               "--headless :      [optional] process the input as fast as "
+               "possible without a window, writing detections to --output\n"
+               "--images :        [optional] directory or list of images to "
+               "process (requires --headless)\n"
+               "--mosaic :        [optional] with --images, pack small images "
+               "together into each network input\n"
+               "--output :        [optional] output file for --headless\n"
+               "--format :        [optional] output format for --headless: "
+               "jsonl (default) or binary\n"
+               "--streams :       [optional] comma-separated camera indices "
+               "and/or video files, processed with shared batched inference\n"
+               "--fairness :      [optional] batching order for --streams: rr "
+               "(round-robin, default) or deadline (priority, then earliest "
+               "deadline first)\n"
+               "--priorities :    [optional] comma-separated priority per "
+               "stream for --fairness deadline (higher goes first)\n"
+               "--budget :        [optional] latency budget per frame in ms "
+               "for --streams (default 100)\n"
+               "--shedding :      [optional] what to do with frames that "
+               "would miss their budget: none (default), drop-oldest, "
+               "decimate or lower-res (runs at the smallest of --sizes)\n"
+               "--batch :         [optional] maximum batch size when building "
+               "the engine (requires a model with dynamic batch size)\n"
+               "--log-level :     [optional] minimum level of log messages: "
+               "debug, info (default), warning or error\n"
+               "--trace :         [optional] record trace spans of every "
+               "stage and write them to this Chrome trace (JSON) file\n"
+               "--metrics-port :  [optional] serve Prometheus metrics on "
+               "http://127.0.0.1:<port>/metrics (0: any free port)\n"
+               "--perf-counters : [optional] sample hardware counters "
+               "(cycles, instructions, cache and branch misses) of the "
+               "host-side stages and print them per frame at the end\n"
+               "--record :        [optional] record the input and output "
+               "tensors of every detection to this capture file, for "
+               "yolov5_replay_benchmark\n"
                "Example usage:\n"
                "./yolov5_detect --onnx ../yolov5s.onnx --video ../video.mp4\n"
                "or\n"
-               "./yolov5_detect --onnx ../yolov5s.onnx --camera 0"
+               "./yolov5_detect --onnx ../yolov5s.onnx --camera 0\n"
+               "or\n"
+               "./yolov5_detect --onnx ../yolov5s.onnx --headless --images "
+               "../images --output detections.jsonl"
             << std::endl;
 }
 
-bool buildEngineFile(const std::string& modelFile) {
-  const std::string outputFile =
-      modelFile.substr(0, modelFile.find_last_of(".")) + ".engine";
-  const yolov5::Precision precision = yolov5::PRECISION_FP16;
+/*  Write the recorded trace spans, if tracing was requested  */
+void exportTrace(const std::string& traceFile) {
+  if (traceFile.empty()) {
+    return;
+  }
+  const yolov5::Result r = yolov5::Tracer::exportChromeTrace(traceFile);
+  if (r != yolov5::RESULT_SUCCESS) {
+    std::cout << "Failure: could not write trace " << traceFile << ": "
+              << yolov5::result_to_string(r) << std::endl;
+  } else {
+    std::cout << "Trace written to " << traceFile << std::endl;
+  }
+}
+
+/*  Print the hardware counters of every stage, if they were sampled   */
+void printPerfCounters() {
+  if (!yolov5::PerfCounters::isEnabled()) {
+    return;
+  }
+  std::string str;
+  if (yolov5::PerfCounters::statsToString(&str)) {
+    std::cout << str;
+  }
+}
+
+bool parseSizes(const std::string& str, std::vector<cv::Size>* out) {
+  std::stringstream ss(str);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    int width = 0, height = 0;
+    if (std::sscanf(item.c_str(), "%dx%d", &width, &height) != 2 ||
+        width <= 0 || height <= 0) {
+      return false;
+    }
+    out->push_back(cv::Size(width, height));
+  }
+  return !out->empty();
+}
+
+/*  Calibration table of the model and dataset. The file name contains a
+    hash of the model and of the image list (paths and file sizes), so that
+    a changed model or dataset gets a new table instead of a stale one  */
+std::string calibrationCacheFile(const std::string& modelFile,
+                                 const std::string& calibrationImages) {
+  uint64_t hash = 14695981039346656037ULL; /*  FNV-1a  */
+  const auto update = [&hash](const char* data, const size_t& size) {
+    for (size_t i = 0; i < size; ++i) {
+      hash = (hash ^ (unsigned char)data[i]) * 1099511628211ULL;
+    }
+  };
+
+  std::ifstream model(modelFile, std::ios::binary);
+  std::vector<char> chunk(1 << 16);
+  while (model.read(chunk.data(), chunk.size()) || model.gcount() > 0) {
+    update(chunk.data(), model.gcount());
+  }
+
+  std::vector<std::string> images;
+  if (yolov5::CalibrationStream::listImages(calibrationImages, &images) ==
+      yolov5::RESULT_SUCCESS) {
+    for (const std::string& image : images) {
+      std::error_code error;
+      const uintmax_t size = std::filesystem::file_size(image, error);
+      update(image.c_str(), image.size() + 1);
+      update((const char*)&size, sizeof(size));
+    }
+  }
+
+  char key[32];
+  std::snprintf(key, sizeof(key), "%016llx", (unsigned long long)hash);
+  return modelFile.substr(0, modelFile.find_last_of(".")) + "." + key +
+         ".calib";
+}
+
+bool buildEngineFile(const std::string& modelFile,
+                     const yolov5::Precision& precision,
+                     const std::string& calibrationImages,
+                     const std::vector<cv::Size>& inferenceSizes,
+                     const int& batchSize) {
+  const std::string basename = modelFile.substr(0, modelFile.find_last_of("."));
+  const std::string outputFile = basename + ".engine";
+
+  yolov5::BuilderOptions options;
+  options.timingCacheFile = basename + ".timing.cache";
+  options.calibration.images = calibrationImages;
+  if (precision == yolov5::PRECISION_INT8) {
+    options.calibration.cacheFile =
+        calibrationCacheFile(modelFile, calibrationImages);
+  }
+
+  if (!inferenceSizes.empty()) {
+    /*  note: only used if the model has a dynamic resolution  */
+    options.minShape.rows = options.minShape.cols = INT32_MAX;
+    for (const cv::Size& size : inferenceSizes) {
+      options.minShape.rows = std::min(options.minShape.rows, size.height);
+      options.minShape.cols = std::min(options.minShape.cols, size.width);
+      options.maxShape.rows = std::max(options.maxShape.rows, size.height);
+      options.maxShape.cols = std::max(options.maxShape.cols, size.width);
+    }
+    options.optShape.rows = inferenceSizes.front().height;
+    options.optShape.cols = inferenceSizes.front().width;
+  }
+
+  if (batchSize > 1) {
+    /*  note: only used if the model has a dynamic batch size  */
+    options.optShape.batchSize = batchSize;
+    options.maxShape.batchSize = batchSize;
+  }
 
   yolov5::Builder builder;
   yolov5::Result r = builder.init();
@@ -54,7 +239,7 @@ bool buildEngineFile(const std::string& modelFile) {
     return false;
   }
 
-  r = builder.buildEngine(modelFile, outputFile, precision);
+  r = builder.buildEngine(modelFile, outputFile, precision, options);
   if (r != yolov5::RESULT_SUCCESS) {
     std::cout << "buildEngine() failed: " << yolov5::result_to_string(r)
               << std::endl;
@@ -63,6 +248,627 @@ bool buildEngineFile(const std::string& modelFile) {
   return true;
 }
 
+/*  Builds the engine if it does not exist yet, then loads and warms it up.
+    Runs on a background thread while the capture device is opened   */
+bool prepareDetector(yolov5::Detector* detector, const std::string& onnxFile,
+                     const yolov5::Precision& precision,
+                     const std::string& calibrationImages,
+                     const std::vector<cv::Size>& inferenceSizes,
+                     const int& batchSize, const int& warmupIterations,
+                     yolov5::StartupTimeline* timeline) {
+  const std::string engineFile =
+      onnxFile.substr(0, onnxFile.find_last_of(".")) + ".engine";
+
+  if (!std::filesystem::exists(engineFile)) {
+    const int phase = timeline->begin("build engine");
+    if (!buildEngineFile(onnxFile, precision, calibrationImages,
+                         inferenceSizes, batchSize)) {
+      return false;
+    }
+    timeline->end(phase);
+    std::cout << "Successfully built engine file!" << std::endl;
+  }
+
+  int phase = timeline->begin("init detector");
+  yolov5::Result r = detector->init();
+  if (r != yolov5::RESULT_SUCCESS) {
+    std::cout << "init() failed: " << yolov5::result_to_string(r) << std::endl;
+    return false;
+  }
+  timeline->end(phase);
+
+  phase = timeline->begin("load engine");
+  r = detector->loadEngine(engineFile);
+  if (r != yolov5::RESULT_SUCCESS) {
+    std::cout << "loadEngine() failed: " << yolov5::result_to_string(r)
+              << std::endl;
+    return false;
+  }
+  timeline->end(phase);
+
+  const yolov5::MemoryUsage memoryUsage = detector->memoryUsage();
+  std::cout << "Binding memory: " << memoryUsage.deviceBytes
+            << " bytes on device, " << memoryUsage.hostBytes << " bytes "
+            << (memoryUsage.hostPinned ? "pinned" : "pageable")
+            << " on host" << std::endl;
+
+  if (!inferenceSizes.empty()) {
+    r = detector->setInferenceSizes(inferenceSizes);
+    if (r != yolov5::RESULT_SUCCESS) {
+      std::cout << "setInferenceSizes() failed: "
+                << yolov5::result_to_string(r) << std::endl;
+      return false;
+    }
+  }
+
+  if (warmupIterations > 0) {
+    yolov5::WarmupOptions warmupOptions;
+    warmupOptions.iterations = warmupIterations;
+    warmupOptions.flags = {yolov5::INPUT_BGR};
+    warmupOptions.batchSizes = {1};
+
+    phase = timeline->begin("warm up");
+    yolov5::WarmupReport warmupReport;
+    r = detector->warmup(warmupOptions, &warmupReport);
+    if (r != yolov5::RESULT_SUCCESS) {
+      std::cout << "warmup() failed: " << yolov5::result_to_string(r)
+                << std::endl;
+      return false;
+    }
+    timeline->end(phase);
+    std::cout << "Warm-up: " << warmupReport.numDetections
+              << " detections, cold " << std::fixed << std::setprecision(2)
+              << warmupReport.coldLatency << " ms, warm "
+              << warmupReport.warmLatency << " ms" << std::endl;
+  }
+  return true;
+}
+
+void printTimeline(const yolov5::StartupTimeline& timeline) {
+  std::string str;
+  if (timeline.toString(&str)) {
+    std::cout << str;
+  }
+}
+
+/*  Throughput-optimized mode: capture, pre-processing, inference and
+    rendering run as separate pipeline stages. Prefetched frames are
+    processed first */
+int runPipeline(yolov5::Detector* detector, cv::VideoCapture* capture,
+                yolov5::FrameRing* ring, const bool& motionGating,
+                yolov5::MetricsRegistry* metrics,
+                yolov5::StartupTimeline* timeline) {
+  yolov5::Pipeline pipeline;
+  yolov5::Result r = pipeline.setup(detector);
+  if (r != yolov5::RESULT_SUCCESS) {
+    std::cout << "Pipeline setup() failed: " << yolov5::result_to_string(r)
+              << std::endl;
+    return 1;
+  }
+
+  yolov5::MotionGate gate;
+  gate.setLogger(detector->logger());
+  if (motionGating) {
+    gate.setup();
+    pipeline.setMotionGate(&gate);
+  }
+  pipeline.setMetrics(metrics);
+
+  auto source = [capture, ring](cv::Mat* image) {
+    if (ring->pop(image)) {
+      return true;
+    }
+    if (!capture->read(*image)) {
+      std::cout << "Failure: could not read new frames" << std::endl;
+      return false;
+    }
+    return true;
+  };
+
+  /*  Drawing runs on its own stage, so the sink only has to display  */
+  yolov5::OverlayRenderer overlay;
+  overlay.setup();
+  auto lastTime = std::chrono::high_resolution_clock::now();
+  auto render = [&overlay, &lastTime](yolov5::PipelineFrame* frame) {
+    /*  note: frames may take less than a millisecond   */
+    auto endTime = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+                        endTime - lastTime)
+                        .count();
+    lastTime = endTime;
+    const int fps = duration > 0 ? (int)(1000000 / duration) : 0;
+
+    overlay.render(frame->detections, &frame->image);
+    overlay.renderText("FPS: " + std::to_string(fps), cv::Point(10, 30),
+                       cv::Scalar(0, 255, 0), &frame->image);
+    return true;
+  };
+  pipeline.setRender(render);
+
+  auto sink = [timeline](yolov5::PipelineFrame* frame) {
+    if (frame->id == 0) {
+      timeline->mark("first detection");
+      printTimeline(*timeline);
+    }
+    cv::imshow("yolov5_tensorrt", frame->image);
+    return cv::waitKey(1) < 0;  // Exit on key press
+  };
+
+  r = pipeline.run(source, sink);
+  if (r != yolov5::RESULT_SUCCESS) {
+    std::cout << "Pipeline run() failed: " << yolov5::result_to_string(r)
+              << std::endl;
+  }
+
+  std::string str;
+  if (pipeline.statsToString(&str)) {
+    std::cout << str;
+  }
+  return r == yolov5::RESULT_SUCCESS ? 0 : 1;
+}
+
+struct CapturedFrame {
+  cv::Mat image;
+  std::chrono::steady_clock::time_point captureTime;
+};
+
+/*  Latency-optimized mode: a capture thread keeps draining the device into
+    a single-slot mailbox, and detection always runs on the newest frame.
+    Frames that arrive while a detection is running are dropped, so the
+    age of the results stays bounded under overload   */
+int runLowLatency(yolov5::Detector* detector, cv::VideoCapture* capture,
+                  yolov5::FrameRing* ring, const int& trackInterval,
+                  const bool& motionGating, const int& roiInterval,
+                  yolov5::MetricsRegistry* metrics,
+                  yolov5::StartupTimeline* timeline) {
+  /*  Prefetched frames are stale by now  */
+  cv::Mat stale;
+  while (ring->pop(&stale)) {
+  }
+
+  /*  With tracking, the detector only runs every few frames and the
+      tracks are extrapolated in between  */
+  yolov5::Tracker tracker;
+  tracker.setLogger(detector->logger());
+  if (trackInterval > 0) {
+    yolov5::TrackerOptions trackerOptions;
+    trackerOptions.detectionInterval = trackInterval;
+    tracker.setup(trackerOptions);
+  }
+  std::vector<yolov5::Track> tracks;
+
+  /*  With motion gating, frames in which nothing changed keep the
+      detections of the previous frame  */
+  yolov5::MotionGate gate;
+  gate.setLogger(detector->logger());
+  if (motionGating) {
+    gate.setup();
+  }
+
+  /*  With region re-detection, only the surroundings of the objects are
+      detected, with a full-frame pass every few frames  */
+  yolov5::RoiDetector roiDetector;
+  if (roiInterval > 0) {
+    yolov5::RoiOptions roiOptions;
+    roiOptions.fullFrameInterval = roiInterval;
+    const yolov5::Result r = roiDetector.setup(detector, roiOptions);
+    if (r != yolov5::RESULT_SUCCESS) {
+      std::cout << "RoiDetector setup() failed: "
+                << yolov5::result_to_string(r) << std::endl;
+      return 1;
+    }
+  }
+
+  yolov5::Mailbox<CapturedFrame> mailbox;
+  std::atomic<bool> capturing(true);
+  uint64_t numCaptured = 0;
+  std::thread captureThread([capture, &mailbox, &capturing, &numCaptured]() {
+    CapturedFrame frame;
+    while (capturing && capture->read(frame.image)) {
+      frame.captureTime = std::chrono::steady_clock::now();
+      numCaptured += 1;
+      if (!mailbox.post(&frame)) {
+        break;
+      }
+    }
+    if (capturing) {
+      std::cout << "Failure: could not read new frames" << std::endl;
+    }
+    mailbox.close();
+  });
+
+  yolov5::OverlayRenderer overlay;
+  overlay.setup();
+
+  yolov5::Counter* framesCounter = nullptr;
+  yolov5::Counter* droppedCounter = nullptr;
+  yolov5::Histogram* latencyMetric = nullptr;
+  if (metrics != nullptr) {
+    framesCounter =
+        metrics->counter("yolov5_frames_total", "Frames processed");
+    droppedCounter = metrics->counter(
+        "yolov5_dropped_frames_total",
+        "Frames replaced by a newer one before they were processed");
+    latencyMetric = metrics->histogram("yolov5_latency_seconds",
+                                       "Latency from capture to result");
+  }
+  uint64_t numDropped = 0;
+
+  yolov5::LatencyHistogram latency;
+  uint64_t numProcessed = 0;
+  CapturedFrame frame;
+  std::vector<yolov5::Detection> detections;
+  yolov5::Result r = yolov5::RESULT_SUCCESS;
+  auto lastTime = std::chrono::high_resolution_clock::now();
+  while (mailbox.take(&frame)) {
+    YOLOV5_TRACE_FRAME(numProcessed);
+    bool changed = true;
+    if (motionGating) {
+      r = gate.check(frame.image, &changed);
+      if (r != yolov5::RESULT_SUCCESS) {
+        std::cout << "MotionGate check() failed: "
+                  << yolov5::result_to_string(r) << std::endl;
+        break;
+      }
+    }
+
+    if (!changed) {
+      /*  keep the previous detections   */
+    } else if (trackInterval <= 0 || tracker.needsDetection()) {
+      r = roiInterval > 0
+              ? roiDetector.detect(frame.image, &detections)
+              : detector->detect(frame.image, &detections, yolov5::INPUT_BGR);
+      if (r != yolov5::RESULT_SUCCESS) {
+        std::cout << "detect() failed: " << yolov5::result_to_string(r)
+                  << std::endl;
+        if (metrics != nullptr) {
+          metrics->countResult(r);
+        }
+        break;
+      }
+      if (trackInterval > 0) {
+        tracker.update(detections, &tracks);
+      }
+    } else {
+      tracker.predict(&tracks);
+    }
+    if (changed && trackInterval > 0) {
+      detections.clear();
+      for (const yolov5::Track& track : tracks) {
+        detections.push_back(track.toDetection());
+      }
+    }
+    const uint64_t frameLatency =
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - frame.captureTime)
+            .count();
+    latency.record(frameLatency);
+    if (framesCounter != nullptr && droppedCounter != nullptr &&
+        latencyMetric != nullptr) {
+      latencyMetric->record(frameLatency);
+      framesCounter->add();
+      const uint64_t dropped = mailbox.numDropped();
+      droppedCounter->add(dropped - numDropped);
+      numDropped = dropped;
+    }
+
+    if (numProcessed == 0) {
+      timeline->mark("first detection");
+      printTimeline(*timeline);
+    }
+    numProcessed += 1;
+
+    /*  note: frames may take less than a millisecond   */
+    auto endTime = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+                        endTime - lastTime)
+                        .count();
+    lastTime = endTime;
+    const int fps = duration > 0 ? (int)(1000000 / duration) : 0;
+
+    overlay.render(detections, &frame.image);
+    overlay.renderText("FPS: " + std::to_string(fps), cv::Point(10, 30),
+                       cv::Scalar(0, 255, 0), &frame.image);
+    cv::imshow("yolov5_tensorrt", frame.image);
+    if (cv::waitKey(1) >= 0) break;  // Exit on key press
+  }
+  capturing = false;
+  mailbox.close();
+  captureThread.join();
+
+  std::string str;
+  latency.toString(&str);
+  std::cout << "Low-latency mode: captured " << numCaptured
+            << " frames, processed " << numProcessed << ", dropped "
+            << mailbox.numDropped() << "\n"
+            << "Capture-to-result latency: " << str << std::endl;
+  if (motionGating) {
+    std::cout << "Motion gate: skipped "
+              << 100.0 * gate.stats().skipRatio() << "% of the frames"
+              << std::endl;
+  }
+  if (roiInterval > 0) {
+    const yolov5::RoiStats roiStats = roiDetector.stats();
+    std::cout << "Regions: " << roiStats.fullFrames << " of "
+              << roiStats.frames << " frames detected in full, "
+              << roiStats.meanRegions() << " regions per other frame"
+              << std::endl;
+  }
+  if (trackInterval > 0) {
+    std::cout << "Tracking: detector skipped on "
+              << 100.0 * tracker.stats().skippedFraction()
+              << "% of the frames" << std::endl;
+  }
+  return r == yolov5::RESULT_SUCCESS ? 0 : 1;
+}
+
+/*  Headless mode: process a video file or a list of images as fast as
+    possible. Detections are written by a background writer, and nothing is
+    drawn or printed per frame   */
+int runHeadless(yolov5::Detector* detector, cv::VideoCapture* capture,
+                yolov5::FrameRing* ring, const std::vector<std::string>& images,
+                const std::string& outputFile,
+                const yolov5::DetectionFormat& outputFormat,
+                yolov5::MetricsRegistry* metrics,
+                yolov5::StartupTimeline* timeline) {
+  yolov5::DetectionWriter writer;
+  writer.setLogger(detector->logger());
+  yolov5::Result r = writer.open(outputFile, outputFormat);
+  if (r != yolov5::RESULT_SUCCESS) {
+    std::cout << "DetectionWriter open() failed: "
+              << yolov5::result_to_string(r) << std::endl;
+    return 1;
+  }
+
+  yolov5::Pipeline pipeline;
+  r = pipeline.setup(detector, 8);
+  if (r != yolov5::RESULT_SUCCESS) {
+    std::cout << "Pipeline setup() failed: " << yolov5::result_to_string(r)
+              << std::endl;
+    return 1;
+  }
+  pipeline.setMetrics(metrics);
+
+  /*  Unreadable images are skipped, so the source records which image
+      every frame came from. note: the entries are published to the sink
+      through the pipeline queues */
+  std::vector<size_t> frameImages(images.size());
+  size_t numFrames = 0;
+  size_t nextImage = 0;
+  auto source = [capture, ring, &images, &frameImages, &numFrames,
+                 &nextImage](cv::Mat* image) {
+    if (images.empty()) {
+      return ring->pop(image) || capture->read(*image);
+    }
+    while (nextImage < images.size()) {
+      const size_t index = nextImage++;
+      *image = cv::imread(images[index], cv::IMREAD_COLOR);
+      if (!image->empty()) {
+        frameImages[numFrames++] = index;
+        return true;
+      }
+      std::cout << "Warning: could not read image " << images[index]
+                << std::endl;
+    }
+    return false;
+  };
+
+  auto sink = [timeline, &writer, &images,
+               &frameImages](yolov5::PipelineFrame* frame) {
+    if (frame->id == 0) {
+      timeline->mark("first detection");
+    }
+    const std::string& name =
+        images.empty() ? std::string() : images[frameImages[frame->id]];
+    return writer.write(frame->id, name, &frame->detections) ==
+           yolov5::RESULT_SUCCESS;
+  };
+
+  r = pipeline.run(source, sink);
+  if (r != yolov5::RESULT_SUCCESS) {
+    std::cout << "Pipeline run() failed: " << yolov5::result_to_string(r)
+              << std::endl;
+  }
+  const yolov5::Result writerResult = writer.close();
+  if (writerResult != yolov5::RESULT_SUCCESS) {
+    std::cout << "DetectionWriter close() failed: "
+              << yolov5::result_to_string(writerResult) << std::endl;
+  }
+
+  printTimeline(*timeline);
+  std::string str;
+  if (pipeline.statsToString(&str)) {
+    std::cout << str;
+  }
+  std::cout << "Wrote " << writer.numFrames() << " frames ("
+            << writer.numBytes() << " bytes) to " << outputFile << std::endl;
+  return r == yolov5::RESULT_SUCCESS && writerResult == yolov5::RESULT_SUCCESS
+             ? 0
+             : 1;
+}
+
+/*  Mosaic mode: small images are packed onto shared network inputs,
+    in chunks, and their detections are written to a file  */
+int runMosaic(yolov5::Detector* detector,
+              const std::vector<std::string>& images,
+              const std::string& outputFile,
+              const yolov5::DetectionFormat& outputFormat,
+              yolov5::StartupTimeline* timeline) {
+  yolov5::DetectionWriter writer;
+  writer.setLogger(detector->logger());
+  yolov5::Result r = writer.open(outputFile, outputFormat);
+  if (r != yolov5::RESULT_SUCCESS) {
+    std::cout << "DetectionWriter open() failed: "
+              << yolov5::result_to_string(r) << std::endl;
+    return 1;
+  }
+
+  yolov5::MosaicDetector mosaic;
+  r = mosaic.setup(detector);
+  if (r != yolov5::RESULT_SUCCESS) {
+    std::cout << "MosaicDetector setup() failed: "
+              << yolov5::result_to_string(r) << std::endl;
+    return 1;
+  }
+
+  const size_t chunkSize = 256;
+  std::vector<cv::Mat> chunk;
+  std::vector<size_t> chunkImages;
+  std::vector<std::vector<yolov5::Detection>> detections;
+  uint64_t numFrames = 0;
+  const auto startTime = std::chrono::steady_clock::now();
+  size_t nextImage = 0;
+  while (r == yolov5::RESULT_SUCCESS && nextImage < images.size()) {
+    chunk.clear();
+    chunkImages.clear();
+    while (chunk.size() < chunkSize && nextImage < images.size()) {
+      const size_t index = nextImage++;
+      cv::Mat image = cv::imread(images[index], cv::IMREAD_COLOR);
+      if (image.empty()) {
+        std::cout << "Warning: could not read image " << images[index]
+                  << std::endl;
+        continue;
+      }
+      chunk.push_back(image);
+      chunkImages.push_back(index);
+    }
+
+    r = mosaic.detect(chunk, &detections);
+    if (r != yolov5::RESULT_SUCCESS) {
+      std::cout << "MosaicDetector detect() failed: "
+                << yolov5::result_to_string(r) << std::endl;
+      break;
+    }
+    if (numFrames == 0) {
+      timeline->mark("first detection");
+    }
+    for (size_t i = 0; i < chunk.size() && r == yolov5::RESULT_SUCCESS;
+         ++i) {
+      r = writer.write(numFrames++, images[chunkImages[i]], &detections[i]);
+    }
+  }
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - startTime)
+                             .count();
+  const yolov5::Result writerResult = writer.close();
+
+  printTimeline(*timeline);
+  const yolov5::MosaicStats stats = mosaic.stats();
+  std::cout << "Mosaic: " << stats.images << " images on " << stats.canvases
+            << " network inputs in " << seconds << " s, packing efficiency "
+            << 100.0 * stats.efficiency() << "%" << std::endl;
+  std::cout << "Wrote " << writer.numFrames() << " frames ("
+            << writer.numBytes() << " bytes) to " << outputFile << std::endl;
+  return r == yolov5::RESULT_SUCCESS && writerResult == yolov5::RESULT_SUCCESS
+             ? 0
+             : 1;
+}
+
+volatile std::sig_atomic_t interrupted = 0;
+
+void onInterrupt(int) { interrupted = 1; }
+
+/*  Multi-stream mode: every source is decoded on its own thread, and the
+    frames of all sources share batched inference. Runs until all sources
+    are exhausted or until interrupted (Ctrl+C)  */
+int runMultiStream(yolov5::Detector* detector, std::future<bool>* detectorReady,
+                   const std::vector<std::string>& sources,
+                   std::vector<yolov5::StreamOptions> streamOptions,
+                   const yolov5::StreamFairness& fairness,
+                   const std::string& outputFile,
+                   const yolov5::DetectionFormat& outputFormat,
+                   yolov5::MetricsRegistry* metrics,
+                   yolov5::StartupTimeline* timeline) {
+  /*  Sources are opened while the engine is loading   */
+  int phase = timeline->begin("open streams");
+  std::vector<cv::VideoCapture> captures(sources.size());
+  std::vector<bool> live(sources.size());
+  for (size_t i = 0; i < sources.size(); ++i) {
+    const std::string& source = sources[i];
+    live[i] = source.find_first_not_of("0123456789") == std::string::npos;
+    const bool opened = live[i]
+                            ? captures[i].open(std::atoi(source.c_str()),
+                                               cv::CAP_ANY)
+                            : captures[i].open(source);
+    if (!opened) {
+      std::cout << "Failure: could not open stream " << source << std::endl;
+      detectorReady->wait();
+      return 1;
+    }
+  }
+  timeline->end(phase);
+
+  phase = timeline->begin("wait for engine");
+  const bool ready = detectorReady->get();
+  timeline->end(phase);
+  if (!ready) {
+    return 1;
+  }
+
+  yolov5::DetectionWriter writer;
+  writer.setLogger(detector->logger());
+  if (!outputFile.empty()) {
+    const yolov5::Result r = writer.open(outputFile, outputFormat);
+    if (r != yolov5::RESULT_SUCCESS) {
+      std::cout << "DetectionWriter open() failed: "
+                << yolov5::result_to_string(r) << std::endl;
+      return 1;
+    }
+  }
+
+  yolov5::MultiStreamRunner runner;
+  yolov5::Result r = runner.setup(detector, fairness);
+  if (r != yolov5::RESULT_SUCCESS) {
+    std::cout << "MultiStreamRunner setup() failed: "
+              << yolov5::result_to_string(r) << std::endl;
+    return 1;
+  }
+  runner.setMetrics(metrics);
+
+  bool first = true;
+  for (size_t i = 0; i < sources.size(); ++i) {
+    cv::VideoCapture* capture = &captures[i];
+    auto source = [capture](cv::Mat* image) { return capture->read(*image); };
+    auto sink = [&writer, &sources, &first,
+                 timeline](yolov5::StreamFrame* frame) {
+      if (first) {
+        timeline->mark("first detection");
+        first = false;
+      }
+      if (writer.isOpen() &&
+          writer.write(frame->id, sources[frame->streamId],
+                       &frame->detections) != yolov5::RESULT_SUCCESS) {
+        return false;
+      }
+      return interrupted == 0;
+    };
+
+    streamOptions[i].live = live[i];
+    if (runner.addStream(source, sink, streamOptions[i]) < 0) {
+      std::cout << "MultiStreamRunner addStream() failed" << std::endl;
+      return 1;
+    }
+  }
+
+  std::signal(SIGINT, onInterrupt);
+  r = runner.run();
+  std::signal(SIGINT, SIG_DFL);
+  if (r != yolov5::RESULT_SUCCESS) {
+    std::cout << "MultiStreamRunner run() failed: "
+              << yolov5::result_to_string(r) << std::endl;
+  }
+  const yolov5::Result writerResult = writer.close();
+
+  printTimeline(*timeline);
+  std::string str;
+  if (runner.statsToString(&str)) {
+    std::cout << str;
+  }
+  return r == yolov5::RESULT_SUCCESS && writerResult == yolov5::RESULT_SUCCESS
+             ? 0
+             : 1;
+}
+
 int main(int argc, char* argv[]) {
   if (cmdOptionExists(argv, argv + argc, "--help") ||
       cmdOptionExists(argv, argv + argc, "-h")) {
@@ -87,40 +893,282 @@ int main(int argc, char* argv[]) {
           : "";
   int cameraIndex =
       cameraIndexOption.empty() ? -1 : std::atoi(cameraIndexOption.c_str());
+  const std::string precisionOption =
+      cmdOptionExists(argv, argv + argc, "--precision", true)
+          ? getCmdOption(argv, argv + argc, "--precision")
+          : "fp16";
+  const std::string calibrationImages =
+      cmdOptionExists(argv, argv + argc, "--calibration", true)
+          ? getCmdOption(argv, argv + argc, "--calibration")
+          : "";
 
-  const std::string engineFile =
-      onnxFile.substr(0, onnxFile.find_last_of(".")) + ".engine";
+  std::vector<cv::Size> inferenceSizes;
+  if (cmdOptionExists(argv, argv + argc, "--sizes", true) &&
+      !parseSizes(getCmdOption(argv, argv + argc, "--sizes"),
+                  &inferenceSizes)) {
+    std::cout << "Invalid value for --sizes" << std::endl;
+    return 1;
+  }
 
-  if (!std::filesystem::exists(engineFile)) {
-    if (!buildEngineFile(onnxFile)) {
+  const bool lowLatency = cmdOptionExists(argv, argv + argc, "--low-latency");
+  const int trackInterval =
+      cmdOptionExists(argv, argv + argc, "--track", true)
+          ? std::atoi(getCmdOption(argv, argv + argc, "--track"))
+          : 0;
+  const bool motionGating = cmdOptionExists(argv, argv + argc, "--motion");
+  const int roiInterval =
+      cmdOptionExists(argv, argv + argc, "--roi", true)
+          ? std::atoi(getCmdOption(argv, argv + argc, "--roi"))
+          : 0;
+  if ((trackInterval > 0 || roiInterval > 0) && !lowLatency) {
+    std::cout << "--track and --roi require --low-latency" << std::endl;
+    return 1;
+  }
+
+  const bool headless = cmdOptionExists(argv, argv + argc, "--headless");
+  const std::string imageList =
+      cmdOptionExists(argv, argv + argc, "--images", true)
+          ? getCmdOption(argv, argv + argc, "--images")
+          : "";
+  const std::string outputFile =
+      cmdOptionExists(argv, argv + argc, "--output", true)
+          ? getCmdOption(argv, argv + argc, "--output")
+          : "";
+  const std::string formatOption =
+      cmdOptionExists(argv, argv + argc, "--format", true)
+          ? getCmdOption(argv, argv + argc, "--format")
+          : "jsonl";
+  std::vector<std::string> streamSources;
+  if (cmdOptionExists(argv, argv + argc, "--streams", true)) {
+    std::stringstream ss(getCmdOption(argv, argv + argc, "--streams"));
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+      if (!item.empty()) {
+        streamSources.push_back(item);
+      }
+    }
+  }
+  const std::string fairnessOption =
+      cmdOptionExists(argv, argv + argc, "--fairness", true)
+          ? getCmdOption(argv, argv + argc, "--fairness")
+          : "rr";
+  yolov5::StreamFairness fairness = yolov5::FAIRNESS_ROUND_ROBIN;
+  if (fairnessOption == "deadline") {
+    fairness = yolov5::FAIRNESS_DEADLINE;
+  } else if (fairnessOption != "rr") {
+    std::cout << "Invalid value for --fairness: " << fairnessOption
+              << std::endl;
+    return 1;
+  }
+
+  /*  Scheduling options of the streams  */
+  std::vector<yolov5::StreamOptions> streamOptions(streamSources.size());
+  if (cmdOptionExists(argv, argv + argc, "--priorities", true)) {
+    std::stringstream ss(getCmdOption(argv, argv + argc, "--priorities"));
+    std::string item;
+    for (size_t i = 0; i < streamOptions.size() && std::getline(ss, item, ',');
+         ++i) {
+      streamOptions[i].priority = std::atoi(item.c_str());
+    }
+  }
+  if (cmdOptionExists(argv, argv + argc, "--budget", true)) {
+    const double budget =
+        std::atof(getCmdOption(argv, argv + argc, "--budget"));
+    for (yolov5::StreamOptions& options : streamOptions) {
+      options.latencyBudget = budget;
+    }
+  }
+  if (cmdOptionExists(argv, argv + argc, "--shedding", true)) {
+    const std::string value = getCmdOption(argv, argv + argc, "--shedding");
+    yolov5::SheddingPolicy policy = yolov5::SHED_NONE;
+    if (value == "drop-oldest") {
+      policy = yolov5::SHED_DROP_OLDEST;
+    } else if (value == "decimate") {
+      policy = yolov5::SHED_DECIMATE;
+    } else if (value == "lower-res") {
+      policy = yolov5::SHED_LOWER_RESOLUTION;
+    } else if (value != "none") {
+      std::cout << "Invalid value for --shedding: " << value << std::endl;
       return 1;
     }
-    std::cout << "Successfully built engine file!" << std::endl;
+    for (yolov5::StreamOptions& options : streamOptions) {
+      options.shedding = policy;
+    }
   }
 
-  yolov5::Detector detector;
-  yolov5::Result r = detector.init();
-  if (r != yolov5::RESULT_SUCCESS) {
-    std::cout << "init() failed: " << yolov5::result_to_string(r) << std::endl;
+  const int batchSize =
+      cmdOptionExists(argv, argv + argc, "--batch", true)
+          ? std::atoi(getCmdOption(argv, argv + argc, "--batch"))
+          : 1;
+  if (batchSize < 1) {
+    std::cout << "Invalid value for --batch" << std::endl;
     return 1;
   }
 
-  r = detector.loadEngine(engineFile);
-  if (r != yolov5::RESULT_SUCCESS) {
-    std::cout << "loadEngine() failed: " << yolov5::result_to_string(r)
+  if (headless && outputFile.empty()) {
+    std::cout << "Missing argument for --headless: --output" << std::endl;
+    return 1;
+  }
+  if (!imageList.empty() && !headless) {
+    std::cout << "--images requires --headless" << std::endl;
+    return 1;
+  }
+  const bool mosaic = cmdOptionExists(argv, argv + argc, "--mosaic");
+  if (mosaic && imageList.empty()) {
+    std::cout << "--mosaic requires --images" << std::endl;
+    return 1;
+  }
+  yolov5::DetectionFormat outputFormat = yolov5::DETECTION_FORMAT_JSONL;
+  if (formatOption == "binary") {
+    outputFormat = yolov5::DETECTION_FORMAT_BINARY;
+  } else if (formatOption != "jsonl") {
+    std::cout << "Invalid value for --format: " << formatOption << std::endl;
+    return 1;
+  }
+
+  const int warmupIterations =
+      cmdOptionExists(argv, argv + argc, "--warmup", true)
+          ? std::atoi(getCmdOption(argv, argv + argc, "--warmup"))
+          : 3;
+
+  yolov5::Precision precision = yolov5::PRECISION_FP16;
+  if (precisionOption == "fp32") {
+    precision = yolov5::PRECISION_FP32;
+  } else if (precisionOption == "int8") {
+    precision = yolov5::PRECISION_INT8;
+  } else if (precisionOption != "fp16") {
+    std::cout << "Invalid value for --precision: " << precisionOption
               << std::endl;
     return 1;
   }
 
-  yolov5::Classes classes;
-  classes.setLogger(detector.logger());
-  detector.setClasses(classes);
+  const std::string logLevelOption =
+      cmdOptionExists(argv, argv + argc, "--log-level", true)
+          ? getCmdOption(argv, argv + argc, "--log-level")
+          : "info";
+  yolov5::LogLevel logLevel = yolov5::LOGGING_INFO;
+  if (logLevelOption == "debug") {
+    logLevel = yolov5::LOGGING_DEBUG;
+  } else if (logLevelOption == "warning") {
+    logLevel = yolov5::LOGGING_WARNING;
+  } else if (logLevelOption == "error") {
+    logLevel = yolov5::LOGGING_ERROR;
+  } else if (logLevelOption != "info") {
+    std::cout << "Invalid value for --log-level: " << logLevelOption
+              << std::endl;
+    return 1;
+  }
+
+  const std::string traceFile =
+      cmdOptionExists(argv, argv + argc, "--trace", true)
+          ? getCmdOption(argv, argv + argc, "--trace")
+          : "";
+  if (!traceFile.empty()) {
+    yolov5::Tracer::setEnabled(true);
+  }
+
+  if (cmdOptionExists(argv, argv + argc, "--perf-counters") &&
+      yolov5::PerfCounters::setEnabled(true) != yolov5::RESULT_SUCCESS) {
+    std::cout << "Hardware counters are not available (see "
+              << "kernel.perf_event_paranoid); continuing without them"
+              << std::endl;
+  }
 
-  cv::namedWindow("yolov5_tensorrt", cv::WINDOW_NORMAL);
-  cv::resizeWindow("yolov5_tensorrt", 1280, 1080);
+  const int metricsPort =
+      cmdOptionExists(argv, argv + argc, "--metrics-port", true)
+          ? std::atoi(getCmdOption(argv, argv + argc, "--metrics-port"))
+          : -1;
+
+  /*  Messages are printed on a background thread, so that logging never
+      blocks the detection threads  */
+  auto logger = std::make_shared<yolov5::AsyncLogger>();
+  logger->setMinLevel(logLevel);
+  logger->setup();
+
+  yolov5::StartupTimeline timeline;
+
+  /*  Outlives the Detector that records into it   */
+  yolov5::TensorRecorder recorder;
+  recorder.setLogger(logger);
+
+  /*  The engine is built/loaded on a background thread, while the window
+      is created, the capture device is opened and frames are prefetched */
+  yolov5::Detector detector;
+  detector.setLogger(logger);
+
+  if (cmdOptionExists(argv, argv + argc, "--record", true)) {
+    const char* recordFile = getCmdOption(argv, argv + argc, "--record");
+    if (recorder.open(recordFile) != yolov5::RESULT_SUCCESS ||
+        detector.setRecorder(&recorder) != yolov5::RESULT_SUCCESS) {
+      return 1;
+    }
+  }
 
+  /*  Metrics are served while the selected mode runs   */
+  yolov5::MetricsRegistry metrics;
+  yolov5::MetricsServer metricsServer;
+  yolov5::MetricsRegistry* metricsPtr = nullptr;
+  if (metricsPort >= 0) {
+    metrics.gauge("yolov5_memory_bytes", "Memory of the engine bindings",
+                  "memory=\"device\"", [&detector]() {
+                    return (double)detector.memoryUsage().deviceBytes;
+                  });
+    metrics.gauge("yolov5_memory_bytes", "Memory of the engine bindings",
+                  "memory=\"host\"", [&detector]() {
+                    return (double)detector.memoryUsage().hostBytes;
+                  });
+    metricsServer.setLogger(logger);
+    const yolov5::Result r = metricsServer.start(&metrics, metricsPort);
+    if (r != yolov5::RESULT_SUCCESS) {
+      std::cout << "MetricsServer start() failed: "
+                << yolov5::result_to_string(r) << std::endl;
+      return 1;
+    }
+    std::cout << "Serving metrics on http://127.0.0.1:"
+              << metricsServer.port() << "/metrics" << std::endl;
+    metricsPtr = &metrics;
+  }
+  std::future<bool> detectorReady;
+  try {
+    detectorReady = std::async(
+        std::launch::async, prepareDetector, &detector, onnxFile, precision,
+        calibrationImages, inferenceSizes, batchSize, warmupIterations,
+        &timeline);
+  } catch (const std::exception& e) {
+    std::cout << "Failure: could not start engine thread: " << e.what()
+              << std::endl;
+    return 1;
+  }
+
+  if (!streamSources.empty()) {
+    const int ret =
+        runMultiStream(&detector, &detectorReady, streamSources,
+                       streamOptions, fairness, outputFile, outputFormat,
+                       metricsPtr, &timeline);
+    exportTrace(traceFile);
+    printPerfCounters();
+    return ret;
+  }
+
+  int phase = -1;
+  if (!headless) {
+    phase = timeline.begin("create window");
+    cv::namedWindow("yolov5_tensorrt", cv::WINDOW_NORMAL);
+    cv::resizeWindow("yolov5_tensorrt", 1280, 1080);
+    timeline.end(phase);
+  }
+
+  phase = timeline.begin("open capture");
   cv::VideoCapture capture;
-  if (!videoFile.empty()) {
+  std::vector<std::string> images;
+  if (!imageList.empty()) {
+    if (yolov5::CalibrationStream::listImages(imageList, &images) !=
+            yolov5::RESULT_SUCCESS ||
+        images.empty()) {
+      std::cout << "Failure: could not list images" << std::endl;
+      return 1;
+    }
+  } else if (!videoFile.empty()) {
     // Open video file
     if (!capture.open(videoFile)) {
       std::cout << "Failure: could not open video file" << std::endl;
@@ -133,37 +1181,74 @@ int main(int argc, char* argv[]) {
       return 1;
     }
   } else {
-    std::cout << "Must specify either --video or --camera" << std::endl;
+    std::cout << "Must specify either --video, --camera or --images"
+              << std::endl;
     return 1;
   }
+  timeline.end(phase);
 
-  cv::Mat image;
-  std::vector<yolov5::Detection> detections;
-  while (true) {
-    auto startTime = std::chrono::high_resolution_clock::now();
-    if (!capture.read(image)) {
-      std::cout << "Failure: could not read new frames" << std::endl;
-      break;
+  /*  Frames are prefetched while the engine is loading. Live sources keep
+      only the most recent frames; video files are read until the ring is
+      full, without dropping frames  */
+  const bool isLive = videoFile.empty() && images.empty();
+  yolov5::FrameRing ring;
+  ring.setup(4, isLive);
+  std::atomic<bool> prefetching(true);
+  std::thread prefetchThread([&capture, &ring, &timeline, &prefetching,
+                              isLive]() {
+    cv::Mat frame;
+    const int captureMark = timeline.begin("prefetch first frame");
+    bool first = true;
+    while (prefetching && (isLive || ring.size() < ring.capacity()) &&
+           capture.read(frame)) {
+      if (first) {
+        timeline.end(captureMark);
+        first = false;
+      }
+      ring.push(&frame);
     }
+  });
 
-    r = detector.detect(image, &detections, yolov5::INPUT_BGR);
-    if (r != yolov5::RESULT_SUCCESS) {
-      std::cout << "detect() failed: " << yolov5::result_to_string(r)
-                << std::endl;
-      return 1;
-    }
+  phase = timeline.begin("wait for engine");
+  const bool ready = detectorReady.get();
+  timeline.end(phase);
 
-    auto endTime = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
-                        endTime - startTime)
-                        .count();
-    int fps = 1000 / duration;
+  /*  From here on, the selected mode captures the frames  */
+  prefetching = false;
+  prefetchThread.join();
+  ring.close();
+  if (!ready) {
+    return 1;
+  }
 
-    yolov5::visualizeDetection(detections, &image, fps);
-    cv::imshow("yolov5_tensorrt", image);
-    if (cv::waitKey(1) >= 0) break;  // Exit on key press
+  yolov5::Classes classes;
+  classes.setLogger(detector.logger());
+  detector.setClasses(classes);
+
+  int ret = 0;
+  if (mosaic) {
+    ret = runMosaic(&detector, images, outputFile, outputFormat, &timeline);
+  } else if (headless) {
+    ret = runHeadless(&detector, &capture, &ring, images, outputFile,
+                      outputFormat, metricsPtr, &timeline);
+  } else if (lowLatency) {
+    ret = runLowLatency(&detector, &capture, &ring, trackInterval,
+                        motionGating, roiInterval, metricsPtr, &timeline);
+  } else {
+    ret = runPipeline(&detector, &capture, &ring, motionGating, metricsPtr,
+                      &timeline);
   }
   capture.release();
-  cv::destroyAllWindows();
-  return 0;
+  if (!headless) {
+    cv::destroyAllWindows();
+  }
+
+  const yolov5::InferenceSizeStats stats = detector.inferenceSizeStats();
+  std::cout << "Processed " << stats.frames << " frames; compute saved by "
+            << "inference size selection: " << std::fixed
+            << std::setprecision(1) << 100.0 * stats.savedFraction() << "%"
+            << std::endl;
+  exportTrace(traceFile);
+  printPerfCounters();
+  return ret;
 }
\ No newline at end of file
@@ -4,8 +4,22 @@
 
 #include <fstream>
 
+#include "yolov5_calibrator.h"
+
 namespace yolov5 {
 
+InputShape::InputShape() noexcept : batchSize(0), rows(0), cols(0) {}
+
+InputShape::InputShape(const int& batchSize_, const int& rows_,
+                       const int& cols_) noexcept
+    : batchSize(batchSize_), rows(rows_), cols(cols_) {}
+
+BuilderOptions::BuilderOptions() noexcept
+    : workspaceSize(1ULL << 30),
+      minShape(1, 0, 0),
+      optShape(1, 0, 0),
+      maxShape(1, 0, 0) {}
+
 Builder::Builder() noexcept : _initialized(false) {}
 
 Builder::~Builder() {}
@@ -41,6 +55,14 @@ Result Builder::init() noexcept {
 Result Builder::buildEngine(const std::string& inputFilePath,
                             const std::string& outputFilePath,
                             Precision precision) const noexcept {
+  return buildEngine(inputFilePath, outputFilePath, precision,
+                     BuilderOptions());
+}
+
+Result Builder::buildEngine(const std::string& inputFilePath,
+                            const std::string& outputFilePath,
+                            Precision precision,
+                            const BuilderOptions& options) const noexcept {
   if (!_initialized) {
     if (_logger) {
       _logger->log(
@@ -51,7 +73,7 @@ Result Builder::buildEngine(const std::string& inputFilePath,
   }
 
   std::shared_ptr<nvinfer1::IHostMemory> engineOutput;
-  Result r = _buildEngine(inputFilePath, &engineOutput, precision);
+  Result r = _buildEngine(inputFilePath, &engineOutput, precision, options);
   if (r != RESULT_SUCCESS) {
     return r;
   }
@@ -93,7 +115,8 @@ std::shared_ptr<Logger> Builder::logger() const noexcept { return _logger; }
 
 Result Builder::_buildEngine(const std::string& inputFilePath,
                              std::shared_ptr<nvinfer1::IHostMemory>* output,
-                             Precision precision) const noexcept {
+                             Precision precision,
+                             const BuilderOptions& options) const noexcept {
   const char* precisionStr = precision_to_string(precision);
   if (std::strlen(precisionStr) == 0) {
     _logger->log(
@@ -112,8 +135,6 @@ Result Builder::_buildEngine(const std::string& inputFilePath,
     std::unique_ptr<nvinfer1::INetworkDefinition> network(
         builder->createNetworkV2(explicitBatch));
 
-    builder->setMaxBatchSize(1);
-
     std::unique_ptr<nvonnxparser::IParser> parser(
         nvonnxparser::createParser(*network, *_trtLogger));
     if (!parser->parseFromFile(inputFilePath.c_str(),
@@ -126,7 +147,26 @@ Result Builder::_buildEngine(const std::string& inputFilePath,
 
     std::unique_ptr<nvinfer1::IBuilderConfig> config(
         builder->createBuilderConfig());
-    config->setMaxWorkspaceSize(1 << 20);
+    config->setMaxWorkspaceSize(options.workspaceSize);
+
+    nvinfer1::IOptimizationProfile* profile = nullptr;
+    nvinfer1::Dims optDims;
+    Result r = _setupProfile(builder.get(), network.get(), config.get(),
+                             options, &profile, &optDims);
+    if (r != RESULT_SUCCESS) {
+      return r;
+    }
+
+    /*  note: the timing cache and calibrator must outlive the build   */
+    std::unique_ptr<nvinfer1::ITimingCache> timingCache;
+    std::unique_ptr<Int8Calibrator> calibrator;
+    if (!options.timingCacheFile.empty()) {
+      r = _loadTimingCache(options.timingCacheFile, config.get(),
+                           &timingCache);
+      if (r != RESULT_SUCCESS) {
+        return r;
+      }
+    }
 
     if (precision == PRECISION_FP32) {
       /*  this is the default */
@@ -138,6 +178,39 @@ Result Builder::_buildEngine(const std::string& inputFilePath,
         return RESULT_FAILURE_INVALID_INPUT;
       }
       config->setFlag(nvinfer1::BuilderFlag::kFP16);
+    } else if (precision == PRECISION_INT8) {
+      if (!builder->platformHasFastInt8()) {
+        _logger->log(LOGGING_ERROR,
+                     "[Builder] buildEngine() failure: int8 precision "
+                     "specified, but not supported by current platform");
+        return RESULT_FAILURE_INVALID_INPUT;
+      }
+      config->setFlag(nvinfer1::BuilderFlag::kINT8);
+
+      /*  layers without an int8 implementation fall back to fp16 rather
+          than fp32, if possible  */
+      if (builder->platformHasFastFp16()) {
+        config->setFlag(nvinfer1::BuilderFlag::kFP16);
+      }
+
+      try {
+        calibrator = std::make_unique<Int8Calibrator>();
+      } catch (const std::exception& e) {
+        _logger->logf(LOGGING_ERROR,
+                      "[Builder] buildEngine() failure: could not create "
+                      "calibrator: %s",
+                      e.what());
+        return RESULT_FAILURE_ALLOC;
+      }
+      r = calibrator->setup(_logger, options.calibration,
+                            network->getInput(0)->getName(), optDims);
+      if (r != RESULT_SUCCESS) {
+        return r;
+      }
+      config->setInt8Calibrator(calibrator.get());
+      if (profile != nullptr) {
+        config->setCalibrationProfile(profile);
+      }
     }
 
     _logger->logf(LOGGING_INFO,
@@ -154,6 +227,11 @@ Result Builder::_buildEngine(const std::string& inputFilePath,
       return RESULT_FAILURE_TENSORRT_ERROR;
     }
     *output = serialized;
+
+    if (!options.timingCacheFile.empty()) {
+      /*  failing to store the cache only slows down the next build  */
+      _saveTimingCache(options.timingCacheFile, config.get());
+    }
   } catch (const std::exception& e) {
     _logger->logf(LOGGING_ERROR,
                   "[Builder] buildEngine() failure: got exception: %s",
@@ -163,4 +241,200 @@ Result Builder::_buildEngine(const std::string& inputFilePath,
   return RESULT_SUCCESS;
 }
 
+Result Builder::_setupProfile(nvinfer1::IBuilder* builder,
+                              nvinfer1::INetworkDefinition* network,
+                              nvinfer1::IBuilderConfig* config,
+                              const BuilderOptions& options,
+                              nvinfer1::IOptimizationProfile** profile,
+                              nvinfer1::Dims* optDimsOut) const noexcept {
+  *profile = nullptr;
+
+  if (network->getNbInputs() != 1) {
+    _logger->logf(LOGGING_ERROR,
+                  "[Builder] buildEngine() failure: expected 1 network "
+                  "input, got %i",
+                  network->getNbInputs());
+    return RESULT_FAILURE_MODEL_ERROR;
+  }
+  nvinfer1::ITensor* input = network->getInput(0);
+  const nvinfer1::Dims dims = input->getDimensions();
+  if (dims.nbDims != 4) {
+    _logger->log(LOGGING_ERROR,
+                 "[Builder] buildEngine() failure: network input is "
+                 "expected to have 4 dimensions");
+    return RESULT_FAILURE_MODEL_ERROR;
+  }
+
+  bool isDynamic = false;
+  for (int i = 0; i < dims.nbDims; ++i) {
+    if (dims.d[i] == -1) {
+      isDynamic = true;
+    }
+  }
+
+  *optDimsOut = dims;
+  if (!isDynamic) {
+    /*  Static model: the shape is determined by the ONNX file   */
+    const InputShape* shapes[] = {&options.minShape, &options.optShape,
+                                  &options.maxShape};
+    for (const InputShape* s : shapes) {
+      if ((s->batchSize > 0 && s->batchSize != dims.d[0]) ||
+          (s->rows > 0 && s->rows != dims.d[2]) ||
+          (s->cols > 0 && s->cols != dims.d[3])) {
+        _logger->logf(LOGGING_WARNING,
+                      "[Builder] buildEngine() warning: ONNX model has "
+                      "static input shape (%i,%i,%i,%i); ignoring the "
+                      "specified optimization profile",
+                      dims.d[0], dims.d[1], dims.d[2], dims.d[3]);
+        break;
+      }
+    }
+    return RESULT_SUCCESS;
+  }
+
+  /*  Dynamic model: every dynamic dimension should be covered by the
+      options  */
+  nvinfer1::Dims minDims = dims;
+  nvinfer1::Dims& optDims = *optDimsOut;
+  nvinfer1::Dims maxDims = dims;
+
+  const int indices[] = {0, 2, 3};
+  for (const int& i : indices) {
+    if (dims.d[i] != -1) {
+      continue;
+    }
+    int* minValue = &minDims.d[i];
+    int* optValue = &optDims.d[i];
+    int* maxValue = &maxDims.d[i];
+    if (i == 0) {
+      *minValue = options.minShape.batchSize;
+      *optValue = options.optShape.batchSize;
+      *maxValue = options.maxShape.batchSize;
+    } else if (i == 2) {
+      *minValue = options.minShape.rows;
+      *optValue = options.optShape.rows;
+      *maxValue = options.maxShape.rows;
+    } else {
+      *minValue = options.minShape.cols;
+      *optValue = options.optShape.cols;
+      *maxValue = options.maxShape.cols;
+    }
+
+    if (*minValue <= 0 || *minValue > *optValue || *optValue > *maxValue) {
+      _logger->logf(LOGGING_ERROR,
+                    "[Builder] buildEngine() failure: network input "
+                    "dimension %i is dynamic, but no valid min/opt/max "
+                    "range was specified (got %i/%i/%i)",
+                    i, *minValue, *optValue, *maxValue);
+      return RESULT_FAILURE_INVALID_INPUT;
+    }
+  }
+
+  *profile = builder->createOptimizationProfile();
+  if (*profile == nullptr) {
+    _logger->log(LOGGING_ERROR,
+                 "[Builder] buildEngine() failure: could not create "
+                 "optimization profile");
+    return RESULT_FAILURE_TENSORRT_ERROR;
+  }
+
+  const char* name = input->getName();
+  if (!(*profile)->setDimensions(name, nvinfer1::OptProfileSelector::kMIN,
+                                 minDims) ||
+      !(*profile)->setDimensions(name, nvinfer1::OptProfileSelector::kOPT,
+                                 optDims) ||
+      !(*profile)->setDimensions(name, nvinfer1::OptProfileSelector::kMAX,
+                                 maxDims) ||
+      config->addOptimizationProfile(*profile) < 0) {
+    _logger->log(LOGGING_ERROR,
+                 "[Builder] buildEngine() failure: could not set up "
+                 "optimization profile");
+    return RESULT_FAILURE_TENSORRT_ERROR;
+  }
+
+  _logger->logf(LOGGING_INFO,
+                "[Builder] buildEngine(): optimization profile: "
+                "min (%i,%i,%i,%i), opt (%i,%i,%i,%i), max (%i,%i,%i,%i)",
+                minDims.d[0], minDims.d[1], minDims.d[2], minDims.d[3],
+                optDims.d[0], optDims.d[1], optDims.d[2], optDims.d[3],
+                maxDims.d[0], maxDims.d[1], maxDims.d[2], maxDims.d[3]);
+  return RESULT_SUCCESS;
+}
+
+Result Builder::_loadTimingCache(
+    const std::string& filepath, nvinfer1::IBuilderConfig* config,
+    std::unique_ptr<nvinfer1::ITimingCache>* output) const noexcept {
+  std::vector<char> data;
+  std::ifstream file(filepath, std::ios::binary);
+  if (file.good()) {
+    try {
+      file.seekg(0, file.end);
+      const auto size = file.tellg();
+      file.seekg(0, file.beg);
+
+      data.resize(size);
+      file.read(data.data(), size);
+    } catch (const std::exception& e) {
+      _logger->logf(LOGGING_ERROR,
+                    "[Builder] buildEngine() failure: could not load "
+                    "timing cache into memory: %s",
+                    e.what());
+      return RESULT_FAILURE_ALLOC;
+    }
+    _logger->logf(LOGGING_INFO,
+                  "[Builder] buildEngine(): using timing cache '%s'",
+                  filepath.c_str());
+  } else {
+    _logger->logf(LOGGING_INFO,
+                  "[Builder] buildEngine(): timing cache '%s' does not "
+                  "exist yet; it will be created",
+                  filepath.c_str());
+  }
+
+  /*  an empty cache is created if there is no data   */
+  std::unique_ptr<nvinfer1::ITimingCache> cache(
+      config->createTimingCache(data.data(), data.size()));
+  if (!cache) {
+    _logger->log(LOGGING_ERROR,
+                 "[Builder] buildEngine() failure: could not create "
+                 "timing cache");
+    return RESULT_FAILURE_TENSORRT_ERROR;
+  }
+  if (!config->setTimingCache(*cache, false)) {
+    _logger->log(LOGGING_ERROR,
+                 "[Builder] buildEngine() failure: could not set "
+                 "timing cache");
+    return RESULT_FAILURE_TENSORRT_ERROR;
+  }
+  cache.swap(*output);
+  return RESULT_SUCCESS;
+}
+
+Result Builder::_saveTimingCache(
+    const std::string& filepath,
+    nvinfer1::IBuilderConfig* config) const noexcept {
+  const nvinfer1::ITimingCache* cache = config->getTimingCache();
+  if (cache == nullptr) {
+    return RESULT_FAILURE_TENSORRT_ERROR;
+  }
+  std::unique_ptr<nvinfer1::IHostMemory> serialized(cache->serialize());
+  if (!serialized) {
+    _logger->log(LOGGING_WARNING,
+                 "[Builder] buildEngine() warning: could not serialize "
+                 "timing cache");
+    return RESULT_FAILURE_TENSORRT_ERROR;
+  }
+
+  std::ofstream file(filepath, std::ios::out | std::ios::binary);
+  file.write((const char*)serialized->data(), serialized->size());
+  if (!file.good()) {
+    _logger->logf(LOGGING_WARNING,
+                  "[Builder] buildEngine() warning: could not write "
+                  "timing cache to '%s'",
+                  filepath.c_str());
+    return RESULT_FAILURE_FILESYSTEM_ERROR;
+  }
+  return RESULT_SUCCESS;
+}
+
 } /*  namespace yolov5    */
\ No newline at end of file
@@ -0,0 +1,463 @@
+#include "yolov5_calibrator.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+/*  CUDA    */
+#include <cuda_runtime_api.h>
+
+namespace yolov5 {
+
+CalibrationOptions::CalibrationOptions() noexcept
+    : numThreads(0), prefetchBatches(4), maxBatches(0) {}
+
+CalibrationStream::CalibrationStream() noexcept
+    : _batchVolume(0),
+      _numBatches(0),
+      _prefetch(1),
+      _nextBatch(0),
+      _numFailedImages(0),
+      _numPending(0),
+      _numActiveWorkers(0),
+      _stopped(false) {}
+
+CalibrationStream::~CalibrationStream() noexcept { stop(); }
+
+void CalibrationStream::setLogger(std::shared_ptr<Logger> logger) noexcept {
+  _logger = logger;
+}
+
+static bool isImageFile(const std::filesystem::path& path) {
+  std::string ext = path.extension().string();
+  std::transform(ext.begin(), ext.end(), ext.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  return (ext == ".jpg" || ext == ".jpeg" || ext == ".png" || ext == ".bmp");
+}
+
+Result CalibrationStream::listImages(const std::string& path,
+                                     std::vector<std::string>* out) noexcept {
+  std::vector<std::string> files;
+  try {
+    if (std::filesystem::is_directory(path)) {
+      for (const auto& entry : std::filesystem::directory_iterator(path)) {
+        if (entry.is_regular_file() && isImageFile(entry.path())) {
+          files.push_back(entry.path().string());
+        }
+      }
+    } else {
+      std::ifstream file(path);
+      if (!file.good()) {
+        return RESULT_FAILURE_FILESYSTEM_ERROR;
+      }
+      std::string line;
+      while (std::getline(file, line)) {
+        if (!line.empty()) {
+          files.push_back(line);
+        }
+      }
+    }
+    std::sort(files.begin(), files.end());
+  } catch (const std::exception& e) {
+    return RESULT_FAILURE_FILESYSTEM_ERROR;
+  }
+
+  std::swap(files, *out);
+  return RESULT_SUCCESS;
+}
+
+Result CalibrationStream::start(const std::vector<std::string>& files,
+                                const nvinfer1::Dims& inputDims,
+                                const int& numThreads,
+                                const int& prefetch) noexcept {
+  stop();
+
+  if (inputDims.nbDims != 4 || inputDims.d[1] != 3 ||
+      internal::dimsVolume(inputDims) <= 0) {
+    if (_logger) {
+      _logger->log(LOGGING_ERROR,
+                   "[CalibrationStream] start() failure: invalid "
+                   "input dimensions");
+    }
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+
+  try {
+    _files = files;
+  } catch (const std::exception& e) {
+    return RESULT_FAILURE_ALLOC;
+  }
+  _inputDims = inputDims;
+  _batchVolume = internal::dimsVolume(inputDims);
+  _numBatches = files.size() / inputDims.d[0];
+  _prefetch = MAX(1, prefetch);
+  _nextBatch = 0;
+  _numFailedImages = 0;
+  _numPending = 0;
+  _stopped = false;
+  _queue.clear();
+
+  if (_numBatches == 0) {
+    if (_logger) {
+      _logger->logf(LOGGING_ERROR,
+                    "[CalibrationStream] start() failure: %i images is "
+                    "not enough for a single batch of %i",
+                    (int)files.size(), inputDims.d[0]);
+    }
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+
+  int nrThreads = numThreads;
+  if (nrThreads <= 0) {
+    nrThreads = MAX(1, (int)std::thread::hardware_concurrency());
+  }
+
+  try {
+    _numActiveWorkers = nrThreads;
+    for (int i = 0; i < nrThreads; ++i) {
+      _threads.emplace_back(&CalibrationStream::_work, this);
+    }
+  } catch (const std::exception& e) {
+    if (_logger) {
+      _logger->logf(LOGGING_ERROR,
+                    "[CalibrationStream] start() failure: could not "
+                    "start worker threads: %s",
+                    e.what());
+    }
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _numActiveWorkers -= nrThreads - (int)_threads.size();
+    }
+    stop();
+    return RESULT_FAILURE_OTHER;
+  }
+
+  if (_logger) {
+    _logger->logf(LOGGING_INFO,
+                  "[CalibrationStream] Streaming %i batches of %i images "
+                  "using %i threads",
+                  _numBatches, inputDims.d[0], nrThreads);
+  }
+  return RESULT_SUCCESS;
+}
+
+void CalibrationStream::stop() noexcept {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopped = true;
+  }
+  _queueNotFull.notify_all();
+  _queueNotEmpty.notify_all();
+
+  for (auto& thread : _threads) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+  _threads.clear();
+}
+
+bool CalibrationStream::next(std::vector<float>* batch) noexcept {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _queueNotEmpty.wait(lock, [this]() {
+    return !_queue.empty() || _numActiveWorkers == 0 || _stopped;
+  });
+  if (_queue.empty() || _stopped) {
+    return false;
+  }
+
+  try {
+    if (!batch->empty()) {
+      _freeBuffers.push_back(std::move(*batch));
+    }
+  } catch (const std::exception& e) {
+    /*  buffer is simply not recycled   */
+  }
+  *batch = std::move(_queue.front());
+  _queue.pop_front();
+  _numPending -= 1;
+
+  lock.unlock();
+  _queueNotFull.notify_one();
+  return true;
+}
+
+int CalibrationStream::numBatches() const noexcept { return _numBatches; }
+
+int CalibrationStream::numFailedImages() const noexcept {
+  return _numFailedImages;
+}
+
+void CalibrationStream::_work() noexcept {
+  /*  Each worker has its own pre-processor, in host-only mode  */
+  internal::CvCpuPreprocessor preprocessor;
+  preprocessor.setLogger(_logger);
+
+  nvinfer1::Dims imageDims = _inputDims;
+  imageDims.d[0] = 1;
+  bool ok = preprocessor.setup(imageDims, INPUT_BGR, 1, nullptr, nullptr);
+
+  while (ok) {
+    std::vector<float> batch;
+    int index = 0;
+    {
+      /*  Wait for a free slot in the prefetch queue  */
+      std::unique_lock<std::mutex> lock(_mutex);
+      _queueNotFull.wait(
+          lock, [this]() { return _numPending < _prefetch || _stopped; });
+      if (_stopped) {
+        break;
+      }
+      index = _nextBatch++;
+      if (index >= _numBatches) {
+        break;
+      }
+      _numPending += 1;
+
+      if (!_freeBuffers.empty()) {
+        batch = std::move(_freeBuffers.back());
+        _freeBuffers.pop_back();
+      }
+    }
+
+    ok = _processBatch(&preprocessor, index, &batch);
+
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (ok) {
+        try {
+          _queue.push_back(std::move(batch));
+        } catch (const std::exception& e) {
+          ok = false;
+        }
+      }
+      if (!ok) {
+        _numPending -= 1;
+      }
+    }
+    _queueNotEmpty.notify_one();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _numActiveWorkers -= 1;
+  }
+  _queueNotEmpty.notify_all();
+  _queueNotFull.notify_all();
+}
+
+bool CalibrationStream::_processBatch(
+    internal::CvCpuPreprocessor* preprocessor, const int& index,
+    std::vector<float>* batch) noexcept {
+  const int batchSize = _inputDims.d[0];
+  const size_t imageVolume = _batchVolume / batchSize;
+
+  try {
+    batch->resize(_batchVolume);
+  } catch (const std::exception& e) {
+    if (_logger) {
+      _logger->logf(LOGGING_ERROR,
+                    "[CalibrationStream] failure: could not allocate "
+                    "batch: %s",
+                    e.what());
+    }
+    return false;
+  }
+
+  for (int i = 0; i < batchSize; ++i) {
+    const std::string& file = _files[index * batchSize + i];
+    float* dst = batch->data() + i * imageVolume;
+
+    cv::Mat image;
+    try {
+      image = cv::imread(file, cv::IMREAD_COLOR);
+    } catch (const std::exception& e) {
+      image = cv::Mat();
+    }
+
+    if (image.empty() || !preprocessor->process(0, image, true)) {
+      if (_logger) {
+        _logger->logf(LOGGING_WARNING,
+                      "[CalibrationStream] could not load '%s'; using a "
+                      "black image instead",
+                      file.c_str());
+      }
+      _numFailedImages += 1;
+      std::memset(dst, 0, imageVolume * sizeof(float));
+      continue;
+    }
+    std::memcpy(dst, preprocessor->hostInputMemory(),
+                imageVolume * sizeof(float));
+  }
+  return true;
+}
+
+Int8Calibrator::Int8Calibrator() noexcept
+    : _started(false), _numBatches(0), _deviceBatch(nullptr) {}
+
+Int8Calibrator::~Int8Calibrator() noexcept {
+  _stream.stop();
+  if (_deviceBatch) {
+    cudaFree(_deviceBatch);
+  }
+}
+
+Result Int8Calibrator::setup(std::shared_ptr<Logger> logger,
+                             const CalibrationOptions& options,
+                             const std::string& inputName,
+                             const nvinfer1::Dims& inputDims) noexcept {
+  _logger = logger;
+  _stream.setLogger(logger);
+
+  if (options.images.empty() && options.cacheFile.empty()) {
+    _logger->log(LOGGING_ERROR,
+                 "[Int8Calibrator] setup() failure: neither calibration "
+                 "images nor a calibration table were specified");
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+
+  try {
+    _options = options;
+    _inputName = inputName;
+  } catch (const std::exception& e) {
+    return RESULT_FAILURE_ALLOC;
+  }
+  _inputDims = inputDims;
+
+  const int volume = internal::dimsVolume(inputDims);
+  if (volume <= 0) {
+    _logger->log(LOGGING_ERROR,
+                 "[Int8Calibrator] setup() failure: invalid input "
+                 "dimensions");
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+
+  auto r = cudaMalloc(&_deviceBatch, volume * sizeof(float));
+  if (r != 0 || _deviceBatch == nullptr) {
+    _logger->logf(LOGGING_ERROR,
+                  "[Int8Calibrator] setup() failure: could not allocate "
+                  "device memory: %s",
+                  cudaGetErrorString(r));
+    return RESULT_FAILURE_CUDA_ERROR;
+  }
+  return RESULT_SUCCESS;
+}
+
+int32_t Int8Calibrator::getBatchSize() const noexcept {
+  /*  The network has an explicit batch dimension: the batch size is part of
+      the input shape   */
+  return 1;
+}
+
+bool Int8Calibrator::getBatch(void* bindings[], const char* names[],
+                              int32_t nbBindings) noexcept {
+  if (!_started) {
+    /*  The dataset is only read when TensorRT actually needs it, i.e.
+        when there is no calibration table   */
+    _started = true;
+
+    std::vector<std::string> files;
+    if (_options.images.empty() ||
+        CalibrationStream::listImages(_options.images, &files) !=
+            RESULT_SUCCESS) {
+      _logger->logf(LOGGING_ERROR,
+                    "[Int8Calibrator] failure: could not list "
+                    "calibration images from '%s'",
+                    _options.images.c_str());
+      return false;
+    }
+    if (_stream.start(files, _inputDims, _options.numThreads,
+                      _options.prefetchBatches) != RESULT_SUCCESS) {
+      return false;
+    }
+  }
+
+  if (_options.maxBatches > 0 && _numBatches >= _options.maxBatches) {
+    return false;
+  }
+  if (!_stream.next(&_hostBatch)) {
+    return false;
+  }
+  _numBatches += 1;
+
+  auto r = cudaMemcpy(_deviceBatch, _hostBatch.data(),
+                      _hostBatch.size() * sizeof(float),
+                      cudaMemcpyHostToDevice);
+  if (r != 0) {
+    _logger->logf(LOGGING_ERROR,
+                  "[Int8Calibrator] failure: could not copy batch to "
+                  "device: %s",
+                  cudaGetErrorString(r));
+    return false;
+  }
+
+  for (int i = 0; i < nbBindings; ++i) {
+    if (nbBindings == 1 || _inputName == names[i]) {
+      bindings[i] = _deviceBatch;
+    }
+  }
+
+  _logger->logf(LOGGING_INFO, "[Int8Calibrator] Calibration batch %i / %i",
+                _numBatches,
+                _options.maxBatches > 0
+                    ? MIN(_options.maxBatches, _stream.numBatches())
+                    : _stream.numBatches());
+  return true;
+}
+
+const void* Int8Calibrator::readCalibrationCache(
+    std::size_t& length) noexcept {
+  length = 0;
+  if (_options.cacheFile.empty()) {
+    return nullptr;
+  }
+
+  std::ifstream file(_options.cacheFile, std::ios::binary);
+  if (!file.good()) {
+    return nullptr;
+  }
+
+  try {
+    file.seekg(0, file.end);
+    const auto size = file.tellg();
+    file.seekg(0, file.beg);
+
+    _cache.resize(size);
+    file.read(_cache.data(), size);
+  } catch (const std::exception& e) {
+    _logger->logf(LOGGING_WARNING,
+                  "[Int8Calibrator] could not read calibration table: %s",
+                  e.what());
+    return nullptr;
+  }
+
+  _logger->logf(LOGGING_INFO,
+                "[Int8Calibrator] Using calibration table '%s'; "
+                "skipping calibration",
+                _options.cacheFile.c_str());
+  length = _cache.size();
+  return _cache.data();
+}
+
+void Int8Calibrator::writeCalibrationCache(const void* ptr,
+                                           std::size_t length) noexcept {
+  if (_options.cacheFile.empty()) {
+    return;
+  }
+
+  std::ofstream file(_options.cacheFile, std::ios::out | std::ios::binary);
+  file.write((const char*)ptr, length);
+  if (!file.good()) {
+    _logger->logf(LOGGING_WARNING,
+                  "[Int8Calibrator] could not write calibration table "
+                  "to '%s'",
+                  _options.cacheFile.c_str());
+    return;
+  }
+  _logger->logf(LOGGING_INFO,
+                "[Int8Calibrator] Wrote calibration table to '%s'",
+                _options.cacheFile.c_str());
+}
+
+} /*  namespace yolov5    */
\ No newline at end of file
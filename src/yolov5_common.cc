@@ -54,6 +54,8 @@ const char* precision_to_string(Precision p) noexcept {
     return "fp32";
   } else if (p == PRECISION_FP16) {
     return "fp16";
+  } else if (p == PRECISION_INT8) {
+    return "int8";
   } else {
     return "";
   }
@@ -74,4 +76,22 @@ bool precision_to_string(Precision p, std::string* out) noexcept {
   return true;
 }
 
+MemoryUsage::MemoryUsage() noexcept
+    : deviceBytes(0),
+      hostBytes(0),
+      bindingBytes(0),
+      hostPinned(false),
+      numBindings(0),
+      numSlots(0) {}
+
+WarmupOptions::WarmupOptions() noexcept : iterations(3), gpuInputs(false) {}
+
+WarmupReport::WarmupReport() noexcept
+    : numConfigurations(0),
+      numDetections(0),
+      coldLatency(0.0),
+      maxColdLatency(0.0),
+      warmLatency(0.0),
+      maxWarmLatency(0.0) {}
+
 } /*  namespace yolov5    */
\ No newline at end of file
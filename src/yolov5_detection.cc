@@ -44,6 +44,10 @@ const int32_t& Detection::classId() const noexcept { return _classId; }
 
 const cv::Rect& Detection::boundingBox() const noexcept { return _boundingBox; }
 
+void Detection::setBoundingBox(const cv::Rect& boundingBox) noexcept {
+  _boundingBox = boundingBox;
+}
+
 const double& Detection::score() const noexcept { return _score; }
 
 const std::string& Detection::className() const noexcept { return _className; }
@@ -2,17 +2,41 @@
 
 #include <cstddef>
 #include <cstdio>
+#include <chrono>
+#include <cstring>
 #include <fstream>
 #include <iterator>
 #include <memory>
+#include <thread>
 
 /*  CUDA    */
 #include <cuda_runtime_api.h>
 
+#include "yolov5_trace.h"
+
 namespace yolov5 {
 
+InferenceSizeStats::InferenceSizeStats() noexcept
+    : frames(0), inferencePixels(0), referencePixels(0) {}
+
+double InferenceSizeStats::savedFraction() const noexcept {
+  if (referencePixels == 0) {
+    return 0.0;
+  }
+  return 1.0 - (double)inferencePixels / (double)referencePixels;
+}
+
 Detector::Detector() noexcept
-    : _initialized(false), _scoreThreshold(0.4), _nmsThreshold(0.4) {}
+    : _initialized(false),
+      _useCudaPreprocessor(false),
+      _scoreThreshold(0.4),
+      _nmsThreshold(0.4),
+      _lastGeneration(0),
+      _warmupOnLoad(false),
+      _statsFrames(0),
+      _statsInferencePixels(0),
+      _statsReferencePixels(0),
+      _recorder(nullptr) {}
 
 Detector::~Detector() noexcept {}
 
@@ -40,53 +64,42 @@ Result Detector::init(int flags) noexcept {
     }
   }
 
-  /*  Set up Preprocessor */
-  if (!_preprocessor) {
-    try {
-      const bool cvCudaAvailable = internal::opencvHasCuda();
-
-      if ((flags & PREPROCESSOR_CVCUDA) && (flags & PREPROCESSOR_CVCPU)) {
-        _logger->log(LOGGING_ERROR,
-                     "[Detector] init() failure: "
-                     "both PREPROCESSOR_CVCUDA and PREPROCESSOR_CVCPU "
-                     "flags specified");
-        return RESULT_FAILURE_INVALID_INPUT;
-      }
+  /*  Select Preprocessor. Every engine instance gets its own  */
+  if (!_initialized) {
+    const bool cvCudaAvailable = internal::opencvHasCuda();
 
-      /*  If the CVCUDA flag was specified, OpenCV-CUDA has to be
-          available or fail   */
-      if (flags & PREPROCESSOR_CVCUDA && !cvCudaAvailable) {
-        _logger->log(LOGGING_ERROR,
-                     "[Detector] init() failure: "
-                     "PREPROCESSOR_CVCUDA flag specified, but "
-                     "OpenCV-CUDA  pre-processor is not available.");
-        return RESULT_FAILURE_OPENCV_NO_CUDA;
-      }
+    if ((flags & PREPROCESSOR_CVCUDA) && (flags & PREPROCESSOR_CVCPU)) {
+      _logger->log(LOGGING_ERROR,
+                   "[Detector] init() failure: "
+                   "both PREPROCESSOR_CVCUDA and PREPROCESSOR_CVCPU "
+                   "flags specified");
+      return RESULT_FAILURE_INVALID_INPUT;
+    }
 
-      bool useCudaPreprocessor = cvCudaAvailable;
-      if (flags & PREPROCESSOR_CVCPU) {
-        useCudaPreprocessor = false;
-      }
+    /*  If the CVCUDA flag was specified, OpenCV-CUDA has to be
+        available or fail   */
+    if (flags & PREPROCESSOR_CVCUDA && !cvCudaAvailable) {
+      _logger->log(LOGGING_ERROR,
+                   "[Detector] init() failure: "
+                   "PREPROCESSOR_CVCUDA flag specified, but "
+                   "OpenCV-CUDA  pre-processor is not available.");
+      return RESULT_FAILURE_OPENCV_NO_CUDA;
+    }
 
-      if (useCudaPreprocessor) {
-        _logger->log(LOGGING_INFO,
-                     "[Detector] Using OpenCV-CUDA "
-                     "pre-processor");
-        _preprocessor = std::make_unique<internal::CvCudaPreprocessor>();
-      } else {
-        _logger->log(LOGGING_INFO,
-                     "[Detector] Using OpenCV-CPU "
-                     "pre-processor");
-        _preprocessor = std::make_unique<internal::CvCpuPreprocessor>();
-      }
-    } catch (const std::exception& e) {
-      _logger->logf(LOGGING_ERROR,
-                    "[Detector] init() failure: "
-                    "could not set up preprocessor: %s",
-                    e.what());
-      return RESULT_FAILURE_ALLOC;
+    _useCudaPreprocessor = cvCudaAvailable;
+    if (flags & PREPROCESSOR_CVCPU) {
+      _useCudaPreprocessor = false;
+    }
+
+    if (_useCudaPreprocessor) {
+      _logger->log(LOGGING_INFO,
+                   "[Detector] Using OpenCV-CUDA "
+                   "pre-processor");
+    } else {
+      _logger->log(LOGGING_INFO,
+                   "[Detector] Using OpenCV-CPU "
+                   "pre-processor");
     }
-    _preprocessor->setLogger(_logger);
   }
 
   /*  Initialize TensorRT runtime */
@@ -162,10 +175,87 @@ Result Detector::loadEngine(const std::vector<char>& data) noexcept {
   return _loadEngine(data);
 }
 
-bool Detector::isEngineLoaded() const noexcept { return (bool)_trtEngine; }
+std::future<Result> Detector::loadEngineAsync(
+    const std::string& filepath) noexcept {
+  try {
+    return std::async(std::launch::async,
+                      [this, filepath]() { return loadEngine(filepath); });
+  } catch (const std::exception& e) {
+    if (_logger) {
+      _logger->logf(LOGGING_ERROR,
+                    "[Detector] loadEngineAsync() failure: could not "
+                    "start background thread: %s",
+                    e.what());
+    }
+  }
+
+  std::promise<Result> promise;
+  promise.set_value(RESULT_FAILURE_OTHER);
+  return promise.get_future();
+}
+
+bool Detector::isEngineLoaded() const noexcept {
+  return (bool)_currentInstance();
+}
+
+uint64_t Detector::engineGeneration() const noexcept {
+  const auto instance = _currentInstance();
+  return instance ? instance->generation : 0;
+}
+
+Result Detector::warmup(const WarmupOptions& options,
+                        WarmupReport* report) noexcept {
+  const auto instance = _currentInstance();
+  if (!instance) {
+    if (_logger) {
+      _logger->log(LOGGING_ERROR,
+                   "[Detector] warmup() failure: no "
+                   "engine loaded");
+    }
+    return RESULT_FAILURE_NOT_LOADED;
+  }
+  std::lock_guard<std::mutex> lock(instance->mutex);
+  return _warmupInstance(*instance, options, report);
+}
+
+Result Detector::setWarmupOnLoad(const bool& enable,
+                                 const WarmupOptions& options) noexcept {
+  if (options.iterations < 1) {
+    if (_logger) {
+      _logger->log(LOGGING_ERROR,
+                   "[Detector] setWarmupOnLoad() failure: number of "
+                   "iterations should be at least 1");
+    }
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+
+  try {
+    std::lock_guard<std::mutex> lock(_loadMutex);
+    _warmupOptions = options;
+    _warmupOnLoad = enable;
+  } catch (const std::exception& e) {
+    if (_logger) {
+      _logger->logf(LOGGING_ERROR,
+                    "[Detector] setWarmupOnLoad() failure: "
+                    "got exception: %s",
+                    e.what());
+    }
+    return RESULT_FAILURE_ALLOC;
+  }
+  return RESULT_SUCCESS;
+}
+
+WarmupReport Detector::loadWarmupReport() const noexcept {
+  const auto instance = _currentInstance();
+  if (!instance) {
+    return WarmupReport();
+  }
+  return instance->warmupReport;
+}
 
 int Detector::numClasses() const noexcept {
-  if (!isEngineLoaded()) {
+  const auto instance = _currentInstance();
+  if (!instance) {
     if (_logger) {
       _logger->log(LOGGING_ERROR,
                    "[Detector] numClasses() failure: no "
@@ -173,7 +263,7 @@ int Detector::numClasses() const noexcept {
     }
     return 0;
   }
-  return _numClasses();
+  return _numClasses(*instance);
 }
 
 Result Detector::setClasses(const Classes& classes) noexcept {
@@ -186,8 +276,9 @@ Result Detector::setClasses(const Classes& classes) noexcept {
     return RESULT_FAILURE_INVALID_INPUT;
   }
 
+  std::shared_ptr<const Classes> copy;
   try {
-    _classes = classes;
+    copy = std::make_shared<Classes>(classes);
   } catch (const std::exception& e) {
     if (_logger) {
       _logger->logf(LOGGING_ERROR,
@@ -197,12 +288,14 @@ Result Detector::setClasses(const Classes& classes) noexcept {
     }
     return RESULT_FAILURE_ALLOC;
   }
+  std::atomic_store(&_classes, copy);
   return RESULT_SUCCESS;
 }
 
 Result Detector::detect(const cv::Mat& img, std::vector<Detection>* out,
                         int flags) noexcept {
-  if (!isEngineLoaded()) {
+  const auto instance = _currentInstance();
+  if (!instance) {
     if (_logger) {
       _logger->log(LOGGING_ERROR,
                    "[Detector] detect() failure: no "
@@ -210,28 +303,43 @@ Result Detector::detect(const cv::Mat& img, std::vector<Detection>* out,
     }
     return RESULT_FAILURE_NOT_LOADED;
   }
+  std::lock_guard<std::mutex> lock(instance->mutex);
+  internal::Preprocessor* preprocessor = instance->preprocessor.get();
+  YOLOV5_TRACE_SPAN("detect");
+  TraceSpan setupSpan("setup");
+
+  const cv::Size inputSize = img.size();
+  Result r = _selectShape(*instance, "detect()", &inputSize, 1, flags);
+  if (r != RESULT_SUCCESS) {
+    return r;
+  }
 
   /**     Pre-processing      **/
-  if (!_preprocessor->setup(_inputBinding.dims(), flags, _batchSize(),
-                            (float*)_deviceMemory.at(_inputBinding.index()))) {
+  const int inputIndex = instance->inputBinding.index();
+  if (!preprocessor->setup(instance->inputDims, flags,
+                           instance->inputDims.d[0],
+                           (float*)instance->memory.at(inputIndex),
+                           (float*)instance->memory.hostAt(inputIndex))) {
     _logger->log(LOGGING_ERROR,
                  "[Detector] detect() failure: could not "
                  "set up pre-processor");
     return RESULT_FAILURE_OTHER;
   }
-  if (!_preprocessor->process(0, img, true)) {
+  setupSpan.end();
+  if (!preprocessor->process(0, img, true)) {
     _logger->log(LOGGING_ERROR,
                  "[Detector] detect() failure: could not "
                  "pre-process input");
     return RESULT_FAILURE_OTHER;
   }
 
-  return _detect(out);
+  return _detect(*instance, out);
 }
 
 Result Detector::detect(const cv::cuda::GpuMat& img,
                         std::vector<Detection>* out, int flags) noexcept {
-  if (!isEngineLoaded()) {
+  const auto instance = _currentInstance();
+  if (!instance) {
     if (_logger) {
       _logger->log(LOGGING_ERROR,
                    "[Detector] detect() failure: no "
@@ -247,29 +355,44 @@ Result Detector::detect(const cv::cuda::GpuMat& img,
                  "available. Use detect(const cv::Mat&, ...) instead");
     return RESULT_FAILURE_OPENCV_NO_CUDA;
   }
+  std::lock_guard<std::mutex> lock(instance->mutex);
+  internal::Preprocessor* preprocessor = instance->preprocessor.get();
+  YOLOV5_TRACE_SPAN("detect");
+  TraceSpan setupSpan("setup");
+
+  const cv::Size inputSize = img.size();
+  Result r = _selectShape(*instance, "detect()", &inputSize, 1, flags);
+  if (r != RESULT_SUCCESS) {
+    return r;
+  }
 
   /**     Pre-processing      **/
-  if (!_preprocessor->setup(_inputBinding.dims(), flags, _batchSize(),
-                            (float*)_deviceMemory.at(_inputBinding.index()))) {
+  const int inputIndex = instance->inputBinding.index();
+  if (!preprocessor->setup(instance->inputDims, flags,
+                           instance->inputDims.d[0],
+                           (float*)instance->memory.at(inputIndex),
+                           (float*)instance->memory.hostAt(inputIndex))) {
     _logger->log(LOGGING_ERROR,
                  "[Detector] detect() failure: could not "
                  "set up pre-processor");
     return RESULT_FAILURE_OTHER;
   }
-  if (!_preprocessor->process(0, img, true)) {
+  setupSpan.end();
+  if (!preprocessor->process(0, img, true)) {
     _logger->log(LOGGING_ERROR,
                  "[Detector] detect() failure: could not "
                  "pre-process input");
     return RESULT_FAILURE_OTHER;
   }
 
-  return _detect(out);
+  return _detect(*instance, out);
 }
 
 Result Detector::detectBatch(const std::vector<cv::Mat>& images,
                              std::vector<std::vector<Detection>>* out,
                              int flags) noexcept {
-  if (!isEngineLoaded()) {
+  const auto instance = _currentInstance();
+  if (!instance) {
     if (_logger) {
       _logger->log(LOGGING_ERROR,
                    "[Detector] detectBatch() failure: no "
@@ -283,26 +406,54 @@ Result Detector::detectBatch(const std::vector<cv::Mat>& images,
                  "of inputs is empty");
     return RESULT_FAILURE_INVALID_INPUT;
   }
-  if ((int)images.size() > _batchSize()) {
+  if ((int)images.size() > _batchSize(*instance)) {
     _logger->logf(LOGGING_ERROR,
                   "[Detector] detectBatch() failure: "
                   "specified %d images, but batch size is %i",
-                  (unsigned int)images.size(), _batchSize());
+                  (unsigned int)images.size(), _batchSize(*instance));
     return RESULT_FAILURE_INVALID_INPUT;
   }
-  const int numProcessed = MIN((int)images.size(), _batchSize());
+  const int numProcessed = MIN((int)images.size(), _batchSize(*instance));
+
+  std::lock_guard<std::mutex> lock(instance->mutex);
+  internal::Preprocessor* preprocessor = instance->preprocessor.get();
+  YOLOV5_TRACE_SPAN("detectBatch");
+  TraceSpan setupSpan("setup");
+
+  try {
+    instance->batchInputSizes.resize(numProcessed);
+  } catch (const std::exception& e) {
+    _logger->logf(LOGGING_ERROR,
+                  "[Detector] detectBatch() failure: could not "
+                  "allocate memory: %s",
+                  e.what());
+    return RESULT_FAILURE_ALLOC;
+  }
+  for (int i = 0; i < numProcessed; ++i) {
+    instance->batchInputSizes[i] = images[i].size();
+  }
+  Result r = _selectShape(*instance, "detectBatch()",
+                          instance->batchInputSizes.data(), numProcessed,
+                          flags);
+  if (r != RESULT_SUCCESS) {
+    return r;
+  }
 
   /**     Pre-processing      **/
-  if (!_preprocessor->setup(_inputBinding.dims(), flags, _batchSize(),
-                            (float*)_deviceMemory.at(_inputBinding.index()))) {
+  const int inputIndex = instance->inputBinding.index();
+  if (!preprocessor->setup(instance->inputDims, flags,
+                           instance->inputDims.d[0],
+                           (float*)instance->memory.at(inputIndex),
+                           (float*)instance->memory.hostAt(inputIndex))) {
     _logger->log(LOGGING_ERROR,
                  "[Detector] detectBatch() failure: could "
                  "not set up pre-processor");
     return RESULT_FAILURE_OTHER;
   }
 
+  setupSpan.end();
   for (int i = 0; i < numProcessed; ++i) {
-    if (!_preprocessor->process(i, images[i], i == numProcessed - 1)) {
+    if (!preprocessor->process(i, images[i], i == numProcessed - 1)) {
       _logger->logf(LOGGING_ERROR,
                     "[Detector] detectBatch() "
                     "failure: preprocessing for image %i failed",
@@ -311,13 +462,14 @@ Result Detector::detectBatch(const std::vector<cv::Mat>& images,
     }
   }
 
-  return _detectBatch(numProcessed, out);
+  return _detectBatch(*instance, numProcessed, out);
 }
 
 Result Detector::detectBatch(const std::vector<cv::cuda::GpuMat>& images,
                              std::vector<std::vector<Detection>>* out,
                              int flags) noexcept {
-  if (!isEngineLoaded()) {
+  const auto instance = _currentInstance();
+  if (!instance) {
     if (_logger) {
       _logger->log(LOGGING_ERROR,
                    "[Detector] detectBatch() failure: no "
@@ -340,26 +492,54 @@ Result Detector::detectBatch(const std::vector<cv::cuda::GpuMat>& images,
                  "of inputs is empty");
     return RESULT_FAILURE_INVALID_INPUT;
   }
-  if ((int)images.size() > _batchSize()) {
+  if ((int)images.size() > _batchSize(*instance)) {
     _logger->logf(LOGGING_ERROR,
                   "[Detector] detectBatch() failure: "
                   "specified %d images, but batch size is %i",
-                  (unsigned int)images.size(), _batchSize());
+                  (unsigned int)images.size(), _batchSize(*instance));
     return RESULT_FAILURE_INVALID_INPUT;
   }
-  const int numProcessed = MIN((int)images.size(), _batchSize());
+  const int numProcessed = MIN((int)images.size(), _batchSize(*instance));
+
+  std::lock_guard<std::mutex> lock(instance->mutex);
+  internal::Preprocessor* preprocessor = instance->preprocessor.get();
+  YOLOV5_TRACE_SPAN("detectBatch");
+  TraceSpan setupSpan("setup");
+
+  try {
+    instance->batchInputSizes.resize(numProcessed);
+  } catch (const std::exception& e) {
+    _logger->logf(LOGGING_ERROR,
+                  "[Detector] detectBatch() failure: could not "
+                  "allocate memory: %s",
+                  e.what());
+    return RESULT_FAILURE_ALLOC;
+  }
+  for (int i = 0; i < numProcessed; ++i) {
+    instance->batchInputSizes[i] = images[i].size();
+  }
+  Result r = _selectShape(*instance, "detectBatch()",
+                          instance->batchInputSizes.data(), numProcessed,
+                          flags);
+  if (r != RESULT_SUCCESS) {
+    return r;
+  }
 
   /**     Pre-processing      **/
-  if (!_preprocessor->setup(_inputBinding.dims(), flags, _batchSize(),
-                            (float*)_deviceMemory.at(_inputBinding.index()))) {
+  const int inputIndex = instance->inputBinding.index();
+  if (!preprocessor->setup(instance->inputDims, flags,
+                           instance->inputDims.d[0],
+                           (float*)instance->memory.at(inputIndex),
+                           (float*)instance->memory.hostAt(inputIndex))) {
     _logger->log(LOGGING_ERROR,
                  "[Detector] detectBatch() failure: could "
                  "not set up pre-processor");
     return RESULT_FAILURE_OTHER;
   }
 
+  setupSpan.end();
   for (int i = 0; i < numProcessed; ++i) {
-    if (!_preprocessor->process(i, images[i], i == numProcessed - 1)) {
+    if (!preprocessor->process(i, images[i], i == numProcessed - 1)) {
       _logger->logf(LOGGING_ERROR,
                     "[Detector] detectBatch() "
                     "failure: preprocessing for image %i failed",
@@ -368,7 +548,7 @@ Result Detector::detectBatch(const std::vector<cv::cuda::GpuMat>& images,
     }
   }
 
-  return _detectBatch(numProcessed, out);
+  return _detectBatch(*instance, numProcessed, out);
 }
 
 double Detector::scoreThreshold() const noexcept { return _scoreThreshold; }
@@ -402,7 +582,8 @@ Result Detector::setNmsThreshold(const double& v) noexcept {
 }
 
 int Detector::batchSize() const noexcept {
-  if (!isEngineLoaded()) {
+  const auto instance = _currentInstance();
+  if (!instance) {
     if (_logger) {
       _logger->log(LOGGING_ERROR,
                    "[Detector] batchSize() failure: no "
@@ -410,11 +591,12 @@ int Detector::batchSize() const noexcept {
     }
     return 0;
   }
-  return _batchSize();
+  return _batchSize(*instance);
 }
 
 cv::Size Detector::inferenceSize() const noexcept {
-  if (!isEngineLoaded()) {
+  const auto instance = _currentInstance();
+  if (!instance) {
     if (_logger) {
       _logger->log(LOGGING_ERROR,
                    "[Detector] inferenceSize() failure: "
@@ -422,12 +604,81 @@ cv::Size Detector::inferenceSize() const noexcept {
     }
     return cv::Size(0, 0);
   }
-  const auto& inputDims = _inputBinding.dims();
+  const auto& inputDims = instance->inputBinding.optDims();
   const int rows = inputDims.d[2];
   const int cols = inputDims.d[3];
   return cv::Size(cols, rows);
 }
 
+Result Detector::setInferenceSizes(const std::vector<cv::Size>& sizes) noexcept {
+  const auto instance = _currentInstance();
+  if (!instance) {
+    if (_logger) {
+      _logger->log(LOGGING_ERROR,
+                   "[Detector] setInferenceSizes() failure: "
+                   "no engine loaded");
+    }
+    return RESULT_FAILURE_NOT_LOADED;
+  }
+
+  Result r = _validateInferenceSizes("setInferenceSizes()",
+                                     instance->inputBinding, sizes);
+  if (r != RESULT_SUCCESS) {
+    return r;
+  }
+
+  std::lock_guard<std::mutex> lock(instance->mutex);
+  try {
+    instance->inferenceSizes = sizes;
+  } catch (const std::exception& e) {
+    _logger->logf(LOGGING_ERROR,
+                  "[Detector] setInferenceSizes() failure: "
+                  "could not set up sizes: %s",
+                  e.what());
+    return RESULT_FAILURE_ALLOC;
+  }
+  return RESULT_SUCCESS;
+}
+
+std::vector<cv::Size> Detector::inferenceSizes() const noexcept {
+  const auto instance = _currentInstance();
+  if (!instance) {
+    return std::vector<cv::Size>();
+  }
+  std::lock_guard<std::mutex> lock(instance->mutex);
+  try {
+    return instance->inferenceSizes;
+  } catch (const std::exception& e) {
+    _logger->logf(LOGGING_ERROR,
+                  "[Detector] inferenceSizes() failure: "
+                  "got exception: %s",
+                  e.what());
+  }
+  return std::vector<cv::Size>();
+}
+
+InferenceSizeStats Detector::inferenceSizeStats() const noexcept {
+  InferenceSizeStats stats;
+  stats.frames = _statsFrames;
+  stats.inferencePixels = _statsInferencePixels;
+  stats.referencePixels = _statsReferencePixels;
+  return stats;
+}
+
+void Detector::resetInferenceSizeStats() noexcept {
+  _statsFrames = 0;
+  _statsInferencePixels = 0;
+  _statsReferencePixels = 0;
+}
+
+MemoryUsage Detector::memoryUsage() const noexcept {
+  const auto instance = _currentInstance();
+  if (!instance) {
+    return MemoryUsage();
+  }
+  return instance->memory.usage();
+}
+
 Result Detector::setLogger(std::shared_ptr<Logger> logger) noexcept {
   if (!logger) {
     if (_logger) {
@@ -439,42 +690,76 @@ Result Detector::setLogger(std::shared_ptr<Logger> logger) noexcept {
   }
   _logger = logger; /*  note: operator= of shared_ptr is marked noexcept */
 
-  if (_preprocessor) {
-    _preprocessor->setLogger(_logger);
+  const auto instance = _currentInstance();
+  if (instance) {
+    std::lock_guard<std::mutex> lock(instance->mutex);
+    instance->preprocessor->setLogger(_logger);
   }
   return RESULT_SUCCESS;
 }
 
 std::shared_ptr<Logger> Detector::logger() const noexcept { return _logger; }
 
+Result Detector::setRecorder(TensorRecorder* recorder) noexcept {
+  if (recorder != nullptr && !recorder->isOpen()) {
+    if (_logger) {
+      _logger->log(LOGGING_ERROR,
+                   "[Detector] setRecorder() failure: recorder is not open");
+    }
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+  _recorder.store(recorder);
+  return RESULT_SUCCESS;
+}
+
+std::shared_ptr<internal::EngineInstance> Detector::_currentInstance()
+    const noexcept {
+  return std::atomic_load(&_instance);
+}
+
 Result Detector::_loadEngine(const std::vector<char>& data) noexcept {
+  /*  Loads are serialized; detections keep running on the current engine */
+  std::unique_lock<std::mutex> loadLock(_loadMutex, std::defer_lock);
+  std::shared_ptr<internal::EngineInstance> instance;
+  try {
+    loadLock.lock();
+    instance = std::make_shared<internal::EngineInstance>();
+  } catch (const std::exception& e) {
+    _logger->logf(LOGGING_ERROR,
+                  "[Detector] loadEngine() failure: "
+                  "got exception: %s",
+                  e.what());
+    return RESULT_FAILURE_ALLOC;
+  }
+
   /*  Try to deserialize engine */
   _logger->log(LOGGING_INFO,
                "[Detector] Deserializing inference engine. "
                "This may take a while...");
-  std::unique_ptr<nvinfer1::ICudaEngine> engine(
+  instance->engine.reset(
       _trtRuntime->deserializeCudaEngine(data.data(), data.size()));
-  if (!engine) {
+  if (!instance->engine) {
     _logger->log(LOGGING_ERROR,
                  "[Detector] loadEngine() failure: could "
                  "not deserialize engine");
     return RESULT_FAILURE_TENSORRT_ERROR;
   }
+  auto& engine = instance->engine;
 
   /*  Create execution context    */
-  std::unique_ptr<nvinfer1::IExecutionContext> executionContext(
-      engine->createExecutionContext());
-  if (!executionContext) {
+  instance->context.reset(engine->createExecutionContext());
+  if (!instance->context) {
     _logger->log(LOGGING_ERROR,
                  "[Detector] loadEngine() failure: could "
                  "not create execution context");
     return RESULT_FAILURE_TENSORRT_ERROR;
   }
+  auto& executionContext = instance->context;
 
   _printBindings(engine);
 
   /*  Determine input bindings & verify that it matches what is expected  */
-  internal::EngineBinding input;
+  internal::EngineBinding& input = instance->inputBinding;
   if (!internal::EngineBinding::setup(engine, "images", &input)) {
     _logger->log(LOGGING_ERROR,
                  "[Detector] loadEngine() failure: could "
@@ -491,15 +776,41 @@ Result Detector::_loadEngine(const std::vector<char>& data) noexcept {
     return RESULT_FAILURE_MODEL_ERROR;
   }
   if (input.isDynamic()) {
-    _logger->log(LOGGING_ERROR,
-                 "[Detector] loadEngine() failure: "
-                 "input binding has dynamic dimensions. This is not "
-                 "supported at this time!");
-    return RESULT_FAILURE_MODEL_ERROR;
+    if (engine->getNbOptimizationProfiles() < 1) {
+      _logger->log(LOGGING_ERROR,
+                   "[Detector] loadEngine() failure: "
+                   "input binding has dynamic dimensions, but the engine "
+                   "has no optimization profile");
+      return RESULT_FAILURE_MODEL_ERROR;
+    }
+    if (input.maxDims().d[1] != 3) {
+      _logger->log(LOGGING_ERROR,
+                   "[Detector] loadEngine() failure: "
+                   "input binding is expected to have 3 channels");
+      return RESULT_FAILURE_MODEL_ERROR;
+    }
+
+    /*  Device memory is sized for the largest shape of the profile  */
+    if (!executionContext->setBindingDimensions(input.index(),
+                                                input.maxDims())) {
+      _logger->log(LOGGING_ERROR,
+                   "[Detector] loadEngine() failure: "
+                   "could not set input dimensions");
+      return RESULT_FAILURE_TENSORRT_ERROR;
+    }
+
+    std::string minStr, maxStr;
+    internal::dimsToString(input.minDims(), &minStr);
+    internal::dimsToString(input.maxDims(), &maxStr);
+    _logger->logf(LOGGING_INFO,
+                  "[Detector] loadEngine() info: input binding has "
+                  "dynamic dimensions %s - %s",
+                  minStr.c_str(), maxStr.c_str());
   }
+  instance->inputDims = executionContext->getBindingDimensions(input.index());
 
   /*  Determine output binding & verify that it matches what is expected   */
-  internal::EngineBinding output;
+  internal::EngineBinding& output = instance->outputBinding;
   if (!internal::EngineBinding::setup(engine, "output", &output)) {
     _logger->log(LOGGING_ERROR,
                  "[Detector] loadEngine() failure: could "
@@ -515,63 +826,336 @@ Result Detector::_loadEngine(const std::vector<char>& data) noexcept {
                   str.c_str());
     return RESULT_FAILURE_MODEL_ERROR;
   }
-  if (output.isDynamic()) {
+  instance->outputDims =
+      executionContext->getBindingDimensions(output.index());
+  if (output.isDynamic() && internal::dimsVolume(instance->outputDims) <= 0) {
+    _logger->log(LOGGING_ERROR,
+                 "[Detector] loadEngine() failure: "
+                 "could not determine output dimensions");
+    return RESULT_FAILURE_MODEL_ERROR;
+  }
+
+  /*  Pre- and post-processing operate on floats   */
+  if (engine->getBindingDataType(input.index()) !=
+          nvinfer1::DataType::kFLOAT ||
+      engine->getBindingDataType(output.index()) !=
+          nvinfer1::DataType::kFLOAT) {
     _logger->log(LOGGING_ERROR,
                  "[Detector] loadEngine() failure: "
-                 "output binding has dynamic dimensions. This is not "
-                 "supported at this time!");
+                 "input and output bindings are expected to be fp32");
     return RESULT_FAILURE_MODEL_ERROR;
   }
 
-  /*  Set up Device memory for input & output */
-  internal::DeviceMemory memory;
-  const Result r = internal::DeviceMemory::setup(_logger, engine, &memory);
+  /*  Set up Device memory for all bindings, with host (staging) memory
+      for the output, and for the input if it is pre-processed on the CPU;
+      the CUDA pre-processor writes the input on the device directly   */
+  std::vector<int> hostBindings;
+  try {
+    hostBindings = {output.index()};
+    if (!_useCudaPreprocessor) {
+      hostBindings.push_back(input.index());
+    }
+  } catch (const std::exception& e) {
+    _logger->logf(LOGGING_ERROR,
+                  "[Detector] loadEngine() failure: "
+                  "got exception: %s",
+                  e.what());
+    return RESULT_FAILURE_ALLOC;
+  }
+  Result r = internal::DeviceMemory::setup(_logger, engine, executionContext,
+                                           hostBindings, 1, &instance->memory);
   if (r != RESULT_SUCCESS) {
     _logger->log(LOGGING_ERROR,
                  "[Detector] loadEngine() failure: "
                  "could not set up device memory");
     return r;
   }
+  instance->outputHostMemory =
+      (float*)instance->memory.hostAt(output.index());
+
+  /*  Set up the pre-processor of this engine   */
+  try {
+    if (_useCudaPreprocessor) {
+      instance->preprocessor.reset(new internal::CvCudaPreprocessor());
+    } else {
+      instance->preprocessor.reset(new internal::CvCpuPreprocessor());
+    }
+  } catch (const std::exception& e) {
+    _logger->logf(LOGGING_ERROR,
+                  "[Detector] loadEngine() failure: could not set up "
+                  "pre-processor: %s",
+                  e.what());
+    return RESULT_FAILURE_ALLOC;
+  }
+  instance->preprocessor->setLogger(_logger);
+
+  /*  The inference sizes are kept if the new engine supports them   */
+  std::shared_ptr<internal::EngineInstance> current = _currentInstance();
+  if (current) {
+    const std::vector<cv::Size> sizes = inferenceSizes();
+    if (_validateInferenceSizes("loadEngine()", input, sizes) ==
+        RESULT_SUCCESS) {
+      try {
+        instance->inferenceSizes = sizes;
+      } catch (const std::exception& e) {
+        _logger->logf(LOGGING_ERROR,
+                      "[Detector] loadEngine() failure: "
+                      "got exception: %s",
+                      e.what());
+        return RESULT_FAILURE_ALLOC;
+      }
+    } else {
+      _logger->log(LOGGING_WARNING,
+                   "[Detector] loadEngine() warning: the new engine does "
+                   "not support the configured inference sizes; using the "
+                   "default size instead");
+    }
+  }
 
-  /*  Set up memory on host for post-processing */
-  std::vector<float> outputHostMemory;
+  /*  Run the new engine before it is published, so that the first
+      detection after the swap does not pay for lazy initialization   */
+  WarmupOptions warmupOptions;
   try {
-    outputHostMemory.resize(output.volume());
+    if (_warmupOnLoad) {
+      warmupOptions = _warmupOptions;
+    } else {
+      warmupOptions.iterations = 1;
+      warmupOptions.batchSizes = {1};
+    }
   } catch (const std::exception& e) {
     _logger->logf(LOGGING_ERROR,
                   "[Detector] loadEngine() failure: "
-                  "could not set up output host memory: %s",
+                  "got exception: %s",
                   e.what());
     return RESULT_FAILURE_ALLOC;
   }
+  r = _warmupInstance(*instance, warmupOptions, &instance->warmupReport);
+  if (r != RESULT_SUCCESS) {
+    _logger->log(LOGGING_ERROR,
+                 "[Detector] loadEngine() failure: "
+                 "could not warm up engine");
+    return r;
+  }
+  _logger->logf(LOGGING_INFO,
+                "[Detector] loadEngine() info: warm-up ran %i detections; "
+                "first detection took %.2f ms, warm detections %.2f ms",
+                instance->warmupReport.numDetections,
+                instance->warmupReport.coldLatency,
+                instance->warmupReport.warmLatency);
 
   /*  commit to the new engine; at this point, there is nothing that
       will fail anymore  */
-  if (isEngineLoaded()) {
-    _logger->log(LOGGING_INFO,
-                 "[Detector] loadEngine() info: an engine "
-                 "is already loaded; Replacing it");
+  if (current) {
+    _logger->logf(LOGGING_INFO,
+                  "[Detector] loadEngine() info: replacing engine %lu; "
+                  "it is released once in-flight detections finish",
+                  (unsigned long)current->generation);
   }
+  instance->generation = ++_lastGeneration;
+  std::atomic_store(&_instance, instance);
+  loadLock.unlock();
 
-  engine.swap(_trtEngine);
-  executionContext.swap(_trtExecutionContext);
+  _logger->logf(LOGGING_INFO,
+                "[Detector] Successfully loaded inference "
+                "engine %lu",
+                (unsigned long)instance->generation);
 
-  memory.swap(_deviceMemory);
-  outputHostMemory.swap(_outputHostMemory);
+  _releaseInstance(&current);
+  return RESULT_SUCCESS;
+}
 
-  input.swap(_inputBinding);
-  output.swap(_outputBinding);
+void Detector::_releaseInstance(
+    std::shared_ptr<internal::EngineInstance>* instance) noexcept {
+  if (!*instance) {
+    return;
+  }
+  /*  The instance is not published anymore, so no new references to it
+      can appear; wait for the in-flight detections to drop theirs, so
+      that the engine and its memory are torn down here rather than on a
+      detection thread   */
+  while (instance->use_count() > 1) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  const unsigned long generation = (*instance)->generation;
+  instance->reset();
+  _logger->logf(LOGGING_INFO,
+                "[Detector] Released inference engine %lu", generation);
+}
 
-  /*  Note: this is the PreProcessor::reset() method, not the reset()
-      method of unique_ptr (!)    */
-  _preprocessor->reset();
+Result Detector::_warmupInstance(internal::EngineInstance& instance,
+                                 const WarmupOptions& options,
+                                 WarmupReport* report) noexcept {
+  if (options.iterations < 1) {
+    _logger->log(LOGGING_ERROR,
+                 "[Detector] warmup() failure: number of iterations "
+                 "should be at least 1");
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+  if (options.gpuInputs && !internal::opencvHasCuda()) {
+    _logger->log(LOGGING_ERROR,
+                 "[Detector] warmup() failure: GpuMat inputs require "
+                 "OpenCV-CUDA support, which is not available");
+    return RESULT_FAILURE_OPENCV_NO_CUDA;
+  }
 
-  _logger->log(LOGGING_INFO,
-               "[Detector] Successfully loaded inference "
-               "engine");
+  /*  Configurations to set up; every inference size selects a different
+      shape on the execution context, which TensorRT sets up lazily   */
+  const int maxBatchSize = _batchSize(instance);
+  std::vector<int> flagsList;
+  std::vector<int> batchSizes;
+  std::vector<cv::Size> sizes;
+  try {
+    flagsList = options.flags;
+    if (flagsList.empty()) {
+      flagsList.push_back(0);
+    }
+    batchSizes = options.batchSizes;
+    if (batchSizes.empty()) {
+      batchSizes.push_back(1);
+      if (maxBatchSize > 1) {
+        batchSizes.push_back(maxBatchSize);
+      }
+    }
+    sizes = instance.inferenceSizes;
+    if (sizes.empty()) {
+      const nvinfer1::Dims& optDims = instance.inputBinding.optDims();
+      sizes.push_back(cv::Size(optDims.d[3], optDims.d[2]));
+    }
+  } catch (const std::exception& e) {
+    _logger->logf(LOGGING_ERROR,
+                  "[Detector] warmup() failure: got exception: %s",
+                  e.what());
+    return RESULT_FAILURE_ALLOC;
+  }
+  for (const int& batchSize : batchSizes) {
+    if (batchSize < 1 || batchSize > maxBatchSize) {
+      _logger->logf(LOGGING_ERROR,
+                    "[Detector] warmup() failure: batch size %i is outside "
+                    "of the range 1 - %i of the engine",
+                    batchSize, maxBatchSize);
+      return RESULT_FAILURE_INVALID_INPUT;
+    }
+  }
+
+  WarmupReport result;
+  double warmSum = 0.0;
+
+  /*  Runs all iterations of a single configuration    */
+  auto runConfiguration = [&](const auto& images, const int& flags) {
+    for (int i = 0; i < options.iterations; ++i) {
+      const auto startTime = std::chrono::steady_clock::now();
+      const Result r = _warmupDetection(instance, images, flags);
+      if (r != RESULT_SUCCESS) {
+        return r;
+      }
+      const double latency = std::chrono::duration<double, std::milli>(
+                                 std::chrono::steady_clock::now() - startTime)
+                                 .count();
+
+      if (i == 0) {
+        if (result.numDetections == 0) {
+          result.coldLatency = latency;
+        }
+        result.maxColdLatency = MAX(result.maxColdLatency, latency);
+      }
+      if (i == options.iterations - 1) {
+        warmSum += latency;
+        result.maxWarmLatency = MAX(result.maxWarmLatency, latency);
+      }
+      result.numDetections += 1;
+    }
+    result.numConfigurations += 1;
+    return RESULT_SUCCESS;
+  };
+
+  for (const cv::Size& size : sizes) {
+    for (const int& batchSize : batchSizes) {
+      std::vector<cv::Mat> images;
+      std::vector<cv::cuda::GpuMat> gpuImages;
+      try {
+        const cv::Mat img = cv::Mat::zeros(size, CV_8UC3);
+        images.assign(batchSize, img);
+        if (options.gpuInputs) {
+          cv::cuda::GpuMat gpuImg;
+          gpuImg.upload(img);
+          gpuImages.assign(batchSize, gpuImg);
+        }
+      } catch (const std::exception& e) {
+        _logger->logf(LOGGING_ERROR,
+                      "[Detector] warmup() failure: could not set up "
+                      "synthetic input: %s",
+                      e.what());
+        return RESULT_FAILURE_ALLOC;
+      }
+
+      for (const int& flags : flagsList) {
+        Result r = runConfiguration(images, flags);
+        if (r == RESULT_SUCCESS && options.gpuInputs) {
+          r = runConfiguration(gpuImages, flags);
+        }
+        if (r != RESULT_SUCCESS) {
+          return r;
+        }
+      }
+    }
+  }
+
+  result.warmLatency = warmSum / MAX(1, result.numConfigurations);
+  if (report != nullptr) {
+    *report = result;
+  }
   return RESULT_SUCCESS;
 }
 
+template <typename Image>
+Result Detector::_warmupDetection(internal::EngineInstance& instance,
+                                  const std::vector<Image>& images,
+                                  const int& flags) noexcept {
+  const int numImages = (int)images.size();
+  try {
+    instance.batchInputSizes.resize(numImages);
+  } catch (const std::exception& e) {
+    _logger->logf(LOGGING_ERROR,
+                  "[Detector] warmup() failure: could not "
+                  "allocate memory: %s",
+                  e.what());
+    return RESULT_FAILURE_ALLOC;
+  }
+  for (int i = 0; i < numImages; ++i) {
+    instance.batchInputSizes[i] = images[i].size();
+  }
+
+  /*  Synthetic detections are not accounted in the inference size stats */
+  Result r = _selectShape(instance, "warmup()",
+                          instance.batchInputSizes.data(), numImages, 0,
+                          false);
+  if (r != RESULT_SUCCESS) {
+    return r;
+  }
+
+  const int inputIndex = instance.inputBinding.index();
+  if (!instance.preprocessor->setup(
+          instance.inputDims, flags, instance.inputDims.d[0],
+          (float*)instance.memory.at(inputIndex),
+          (float*)instance.memory.hostAt(inputIndex))) {
+    _logger->log(LOGGING_ERROR,
+                 "[Detector] warmup() failure: could not "
+                 "set up pre-processor");
+    return RESULT_FAILURE_OTHER;
+  }
+  for (int i = 0; i < numImages; ++i) {
+    if (!instance.preprocessor->process(i, images[i], i == numImages - 1)) {
+      _logger->log(LOGGING_ERROR,
+                   "[Detector] warmup() failure: could not "
+                   "pre-process synthetic input");
+      return RESULT_FAILURE_OTHER;
+    }
+  }
+
+  /*  Decoding & NMS are run as well, their output is discarded  */
+  return _detectBatch(instance, numImages, nullptr);
+}
+
 void Detector::_printBindings(
     const std::unique_ptr<nvinfer1::ICudaEngine>& engine) const noexcept {
   const int32_t nbBindings = engine->getNbBindings();
@@ -590,36 +1174,137 @@ void Detector::_printBindings(
   }
 }
 
-int Detector::_batchSize() const noexcept { return _inputBinding.dims().d[0]; }
+int Detector::_batchSize(const internal::EngineInstance& instance) const
+    noexcept {
+  return instance.inputBinding.maxDims().d[0];
+}
+
+Result Detector::_selectShape(internal::EngineInstance& instance,
+                              const char* logid, const cv::Size* inputSizes,
+                              const int& numInputs, const int& flags,
+                              const bool& accountStats) noexcept {
+  const internal::EngineBinding& input = instance.inputBinding;
+  if (input.isDynamic()) {
+    /*  Use the smallest batch that fits all images, at the resolution
+        with the least padding (or the one the engine was optimized for) */
+    nvinfer1::Dims dims = input.optDims();
+    dims.d[0] = MAX(numInputs, input.minDims().d[0]);
+
+    const int index =
+        (flags & INFERENCE_SIZE_SMALLEST)
+            ? internal::selectSmallestInferenceSize(
+                  instance.inferenceSizes, inputSizes, numInputs)
+            : internal::selectInferenceSize(instance.inferenceSizes,
+                                            inputSizes, numInputs);
+    if (index >= 0) {
+      dims.d[2] = instance.inferenceSizes[index].height;
+      dims.d[3] = instance.inferenceSizes[index].width;
+    }
+
+    if (std::memcmp(&dims, &instance.inputDims, sizeof(nvinfer1::Dims)) !=
+        0) {
+      if (!instance.context->setBindingDimensions(input.index(), dims)) {
+        std::string str;
+        internal::dimsToString(dims, &str);
+        _logger->logf(LOGGING_ERROR,
+                      "[Detector] %s failure: could not set input "
+                      "dimensions %s",
+                      logid, str.c_str());
+        return RESULT_FAILURE_TENSORRT_ERROR;
+      }
+      instance.inputDims = dims;
+      instance.outputDims = instance.context->getBindingDimensions(
+          instance.outputBinding.index());
+    }
+  }
 
-int Detector::_numClasses() const noexcept {
-  return _outputBinding.dims().d[2] - 5;
+  /*  Compute is accounted per image, relative to the size the engine was
+      optimized for; only once the shape has been set successfully  */
+  if (accountStats) {
+    const nvinfer1::Dims& optDims = input.optDims();
+    _statsFrames += numInputs;
+    _statsReferencePixels += (uint64_t)numInputs * optDims.d[2] * optDims.d[3];
+    _statsInferencePixels +=
+        (uint64_t)numInputs * instance.inputDims.d[2] * instance.inputDims.d[3];
+  }
+  return RESULT_SUCCESS;
 }
 
-Result Detector::_detect(std::vector<Detection>* out) {
+Result Detector::_validateInferenceSizes(
+    const char* logid, const internal::EngineBinding& input,
+    const std::vector<cv::Size>& sizes) const noexcept {
+  if (sizes.empty()) {
+    return RESULT_SUCCESS;
+  }
+
+  const nvinfer1::Dims& minDims = input.minDims();
+  const nvinfer1::Dims& maxDims = input.maxDims();
+  if (minDims.d[2] == maxDims.d[2] && minDims.d[3] == maxDims.d[3]) {
+    _logger->logf(LOGGING_ERROR,
+                  "[Detector] %s failure: engine has a fixed input "
+                  "size; build it with a dynamic resolution to select "
+                  "between inference sizes",
+                  logid);
+    return RESULT_FAILURE_MODEL_ERROR;
+  }
+
+  for (const cv::Size& size : sizes) {
+    if (size.width % 32 != 0 || size.height % 32 != 0) {
+      _logger->logf(LOGGING_ERROR,
+                    "[Detector] %s failure: inference size %ix%i is not "
+                    "a multiple of 32",
+                    logid, size.width, size.height);
+      return RESULT_FAILURE_INVALID_INPUT;
+    }
+    if (size.height < minDims.d[2] || size.height > maxDims.d[2] ||
+        size.width < minDims.d[3] || size.width > maxDims.d[3]) {
+      _logger->logf(LOGGING_ERROR,
+                    "[Detector] %s failure: inference size %ix%i is "
+                    "outside of the range %ix%i - %ix%i of the engine",
+                    logid, size.width, size.height, minDims.d[3],
+                    minDims.d[2], maxDims.d[3], maxDims.d[2]);
+      return RESULT_FAILURE_INVALID_INPUT;
+    }
+  }
+  return RESULT_SUCCESS;
+}
+
+int Detector::_numClasses(const internal::EngineInstance& instance) const
+    noexcept {
+  return instance.outputBinding.dims().d[2] - 5;
+}
+
+Result Detector::_detect(internal::EngineInstance& instance,
+                         std::vector<Detection>* out) {
   /**     Inference     **/
-  Result r = _inference("detect()");
+  Result r = _inference(instance, "detect()");
   if (r != RESULT_SUCCESS) {
     return r;
   }
 
   /**     Post-processing     **/
   std::vector<Detection> lst;
-  r = _decodeOutput("detect()", 0, &lst);
+  r = _decodeOutput(instance, "detect()", 0, &lst);
   if (r != RESULT_SUCCESS) {
     return r;
   }
 
+  TensorRecorder* recorder = _recorder.load();
+  if (recorder != nullptr && recorder->shouldRecord()) {
+    _record(instance, recorder, 1, &lst);
+  }
+
   if (out != nullptr) {
     std::swap(lst, *out);
   }
   return RESULT_SUCCESS;
 }
 
-Result Detector::_detectBatch(const int& nrImages,
+Result Detector::_detectBatch(internal::EngineInstance& instance,
+                              const int& nrImages,
                               std::vector<std::vector<Detection>>* out) {
   /**     Inference     **/
-  Result r = _inference("detectBatch()");
+  Result r = _inference(instance, "detectBatch()");
   if (r != RESULT_SUCCESS) {
     return r;
   }
@@ -637,22 +1322,33 @@ Result Detector::_detectBatch(const int& nrImages,
   }
 
   for (int i = 0; i < nrImages; ++i) {
-    r = _decodeOutput("detectBatch()", i, &lst[i]);
+    r = _decodeOutput(instance, "detectBatch()", i, &lst[i]);
     if (r != RESULT_SUCCESS) {
       return r;
     }
   }
 
+  TensorRecorder* recorder = _recorder.load();
+  if (recorder != nullptr && recorder->shouldRecord()) {
+    _record(instance, recorder, nrImages, lst.data());
+  }
+
   if (out != nullptr) {
     std::swap(lst, *out);
   }
   return RESULT_SUCCESS;
 }
 
-Result Detector::_inference(const char* logid) {
+Result Detector::_inference(internal::EngineInstance& instance,
+                            const char* logid) {
+  internal::Preprocessor* preprocessor = instance.preprocessor.get();
+
   /*  Enqueue for inference   */
-  if (!_trtExecutionContext->enqueueV2(_deviceMemory.begin(),
-                                       _preprocessor->cudaStream(), nullptr)) {
+  TraceSpan enqueueSpan("enqueue");
+  const bool enqueued = instance.context->enqueueV2(
+      instance.memory.begin(), preprocessor->cudaStream(), nullptr);
+  enqueueSpan.end();
+  if (!enqueued) {
     _logger->logf(LOGGING_ERROR,
                   "[Detector] %s failure: could not enqueue "
                   "data for inference",
@@ -661,10 +1357,13 @@ Result Detector::_inference(const char* logid) {
   }
 
   /*  Copy output back from device memory to host memory  */
-  auto r = cudaMemcpyAsync(_outputHostMemory.data(),
-                           _deviceMemory.at(_outputBinding.index()),
-                           (int)(_outputBinding.volume() * sizeof(float)),
-                           cudaMemcpyDeviceToHost, _preprocessor->cudaStream());
+  TraceSpan copySpan("d2h copy");
+  auto r = cudaMemcpyAsync(
+      instance.outputHostMemory,
+      instance.memory.at(instance.outputBinding.index()),
+      (int)(internal::dimsVolume(instance.outputDims) * sizeof(float)),
+      cudaMemcpyDeviceToHost, preprocessor->cudaStream());
+  copySpan.end();
   if (r != 0) {
     _logger->logf(LOGGING_ERROR,
                   "[Detector] %s failure: could not set up "
@@ -674,104 +1373,75 @@ Result Detector::_inference(const char* logid) {
   }
 
   /*  Synchronize */
-  if (!_preprocessor->synchronizeCudaStream()) {
+  YOLOV5_TRACE_SPAN("sync");
+  if (!preprocessor->synchronizeCudaStream()) {
     return RESULT_FAILURE_CUDA_ERROR;
   }
   return RESULT_SUCCESS;
 }
 
-Result Detector::_decodeOutput(const char* logid, const int& index,
+Result Detector::_decodeOutput(internal::EngineInstance& instance,
+                               const char* logid, const int& index,
                                std::vector<Detection>* out) {
-  std::vector<cv::Rect> boxes;
-  std::vector<float> scores;
-  std::vector<int> classes;
-
-  const int nrClasses = numClasses();
-
-  /*  Decode YoloV5 output    */
-  const int numGridBoxes = _outputBinding.dims().d[1];
-  const int rowSize = _outputBinding.dims().d[2];
-
-  float* begin = _outputHostMemory.data() + index * numGridBoxes * rowSize;
-
-  for (int i = 0; i < numGridBoxes; ++i) {
-    float* ptr = begin + i * rowSize;
-
-    const float objectness = ptr[4];
-    if (objectness < _scoreThreshold) {
-      continue;
-    }
+  const int numGridBoxes = instance.outputDims.d[1];
+  const int rowSize = instance.outputDims.d[2];
+
+  const float* begin =
+      instance.outputHostMemory + index * numGridBoxes * rowSize;
+  const std::shared_ptr<const Classes> classes = std::atomic_load(&_classes);
+  return internal::postprocessOutput(
+      begin, numGridBoxes, rowSize, _scoreThreshold, _nmsThreshold,
+      instance.preprocessor->transform(index), classes.get(), _logger, logid,
+      out);
+}
 
-    /*  Get the class with the highest score attached to it */
-    double maxClassScore = 0.0;
-    int maxScoreIndex = 0;
-    for (int i = 0; i < nrClasses; ++i) {
-      const float& v = ptr[5 + i];
-      if (v > maxClassScore) {
-        maxClassScore = v;
-        maxScoreIndex = i;
-      }
-    }
-    const double score = objectness * maxClassScore;
-    if (score < _scoreThreshold) {
-      continue;
+void Detector::_record(internal::EngineInstance& instance,
+                       TensorRecorder* recorder, const int& nrImages,
+                       const std::vector<Detection>* detections) noexcept {
+  YOLOV5_TRACE_SPAN("record");
+  TensorFrame frame;
+  frame.numImages = nrImages;
+  frame.scoreThreshold = _scoreThreshold;
+  frame.nmsThreshold = _nmsThreshold;
+
+  /*  only the images of this call, the engine batch may be larger   */
+  frame.outputDims = instance.outputDims;
+  frame.outputDims.d[0] = nrImages;
+  frame.output = instance.outputHostMemory;
+
+  std::vector<float> input;
+  try {
+    for (int i = 0; i < nrImages; ++i) {
+      frame.transforms.push_back(instance.preprocessor->transform(i));
+      frame.detections.push_back(detections[i]);
     }
 
-    const float w = ptr[2];
-    const float h = ptr[3];
-    const float x = ptr[0] - w / 2.0;
-    const float y = ptr[1] - h / 2.0;
-
-    try {
-      boxes.push_back(cv::Rect(x, y, w, h));
-      scores.push_back(score);
-      classes.push_back(maxScoreIndex);
-    } catch (const std::exception& e) {
-      _logger->logf(LOGGING_ERROR,
-                    "[Detector] %s failure: got "
-                    "exception setting up model detection: %s",
-                    logid, e.what());
-      return RESULT_FAILURE_ALLOC;
+    if (recorder->options().recordInput) {
+      frame.inputDims = instance.inputDims;
+      frame.inputDims.d[0] = nrImages;
+      input.resize(internal::dimsVolume(frame.inputDims));
     }
-  }
-
-  /*  Apply non-max-suppression   */
-  std::vector<int> indices;
-  try {
-    cv::dnn::NMSBoxes(boxes, scores, _scoreThreshold, _nmsThreshold, indices);
   } catch (const std::exception& e) {
     _logger->logf(LOGGING_ERROR,
-                  "[Detector] %s failure: got exception "
-                  "applying OpenCV non-max-suppression: %s",
-                  logid, e.what());
-    return RESULT_FAILURE_OPENCV_ERROR;
-  }
-
-  /*  Convert to Detection objects    */
-  for (unsigned int i = 0; i < indices.size(); ++i) {
-    const int& j = indices[i];
-    /*  transform bounding box from network space to input space    */
-    const cv::Rect bbox = _preprocessor->transformBbox(index, boxes[j]);
-    const double score = MAX(0.0, MIN(1.0, scores[j]));
-    try {
-      out->push_back(Detection(classes[j], bbox, score));
-    } catch (const std::exception& e) {
-      _logger->logf(LOGGING_ERROR,
-                    "[Detector] %s failure: got "
-                    "exception setting up Detection output: %s",
-                    logid, e.what());
-      return RESULT_FAILURE_ALLOC;
-    }
-
-    if (_classes.isLoaded()) {
-      Detection& det = out->back();
+                  "[Detector] record failure: got exception: %s", e.what());
+    return;
+  }
 
-      std::string className;
-      _classes.getName(det.classId(), &className);
-      det.setClassName(className);
+  /*  The pre-processor may have written the input to the device only   */
+  if (!input.empty()) {
+    const auto r = cudaMemcpy(
+        input.data(), instance.memory.at(instance.inputBinding.index()),
+        input.size() * sizeof(float), cudaMemcpyDeviceToHost);
+    if (r != 0) {
+      _logger->logf(LOGGING_ERROR,
+                    "[Detector] record failure: could not copy input from "
+                    "the device: %s",
+                    cudaGetErrorString(r));
+      return;
     }
+    frame.input = input.data();
   }
-  return RESULT_SUCCESS;
+  recorder->record(frame);
 }
 
 } /*  namespace yolov5    */
\ No newline at end of file
@@ -12,6 +12,11 @@
 
 #include <cuda_runtime_api.h>
 
+#include <cstdlib>
+
+#include "yolov5_perf.h"
+#include "yolov5_trace.h"
+
 namespace yolov5 {
 
 namespace internal {
@@ -44,6 +49,39 @@ bool dimsToString(const nvinfer1::Dims& dims, std::string* out) noexcept {
   return true;
 }
 
+static void swapDims(nvinfer1::Dims& a, nvinfer1::Dims& b) noexcept {
+  nvinfer1::Dims tmp;
+  std::memcpy(&tmp, &a, sizeof(nvinfer1::Dims));
+  std::memcpy(&a, &b, sizeof(nvinfer1::Dims));
+  std::memcpy(&b, &tmp, sizeof(nvinfer1::Dims));
+}
+
+/*  Set up the optimization profile dimensions (profile 0) of a binding   */
+static void setupProfileDims(
+    const std::unique_ptr<nvinfer1::ICudaEngine>& engine, const int& index,
+    const nvinfer1::Dims& dims, const bool& isInput, nvinfer1::Dims* minDims,
+    nvinfer1::Dims* optDims, nvinfer1::Dims* maxDims) noexcept {
+  bool isDynamic = false;
+  for (int i = 0; i < dims.nbDims; ++i) {
+    if (dims.d[i] == -1) {
+      isDynamic = true;
+    }
+  }
+
+  if (isDynamic && isInput && engine->getNbOptimizationProfiles() > 0) {
+    *minDims = engine->getProfileDimensions(
+        index, 0, nvinfer1::OptProfileSelector::kMIN);
+    *optDims = engine->getProfileDimensions(
+        index, 0, nvinfer1::OptProfileSelector::kOPT);
+    *maxDims = engine->getProfileDimensions(
+        index, 0, nvinfer1::OptProfileSelector::kMAX);
+  } else {
+    *minDims = dims;
+    *optDims = dims;
+    *maxDims = dims;
+  }
+}
+
 EngineBinding::EngineBinding() noexcept {}
 
 EngineBinding::~EngineBinding() noexcept {}
@@ -53,10 +91,10 @@ void EngineBinding::swap(EngineBinding& other) noexcept {
   std::swap(_name, other._name);
   std::swap(_volume, other._volume);
 
-  nvinfer1::Dims tmp;
-  std::memcpy(&tmp, &_dims, sizeof(nvinfer1::Dims));
-  std::memcpy(&_dims, &other._dims, sizeof(nvinfer1::Dims));
-  std::memcpy(&other._dims, &tmp, sizeof(nvinfer1::Dims));
+  swapDims(_dims, other._dims);
+  swapDims(_minDims, other._minDims);
+  swapDims(_optDims, other._optDims);
+  swapDims(_maxDims, other._maxDims);
 
   std::swap(_isInput, other._isInput);
 }
@@ -67,6 +105,18 @@ const std::string& EngineBinding::name() const noexcept { return _name; }
 
 const nvinfer1::Dims& EngineBinding::dims() const noexcept { return _dims; }
 
+const nvinfer1::Dims& EngineBinding::minDims() const noexcept {
+  return _minDims;
+}
+
+const nvinfer1::Dims& EngineBinding::optDims() const noexcept {
+  return _optDims;
+}
+
+const nvinfer1::Dims& EngineBinding::maxDims() const noexcept {
+  return _maxDims;
+}
+
 const int& EngineBinding::volume() const noexcept { return _volume; }
 
 bool EngineBinding::isDynamic() const noexcept {
@@ -90,6 +140,12 @@ void EngineBinding::toString(std::string* out) const noexcept {
     *out = "name: '" + _name + "'" + " ;  dims: " + dimsStr +
            " ;  isInput: " + (_isInput ? "true" : "false") +
            " ;  dynamic: " + (isDynamic() ? "true" : "false");
+
+    std::string minStr, maxStr;
+    if (isDynamic() && dimsToString(_minDims, &minStr) &&
+        dimsToString(_maxDims, &maxStr)) {
+      *out += " ;  profile: " + minStr + " - " + maxStr;
+    }
   } catch (const std::exception& e) {
   }
 }
@@ -113,6 +169,9 @@ bool EngineBinding::setup(const std::unique_ptr<nvinfer1::ICudaEngine>& engine,
 
   binding->_isInput = engine->bindingIsInput(binding->_index);
 
+  setupProfileDims(engine, binding->_index, binding->_dims, binding->_isInput,
+                   &binding->_minDims, &binding->_optDims,
+                   &binding->_maxDims);
   return true;
 }
 
@@ -135,61 +194,470 @@ bool EngineBinding::setup(const std::unique_ptr<nvinfer1::ICudaEngine>& engine,
 
   binding->_isInput = engine->bindingIsInput(binding->_index);
 
+  setupProfileDims(engine, binding->_index, binding->_dims, binding->_isInput,
+                   &binding->_minDims, &binding->_optDims,
+                   &binding->_maxDims);
   return true;
 }
 
-DeviceMemory::DeviceMemory() noexcept {}
+size_t dataTypeSize(const nvinfer1::DataType& type) noexcept {
+  switch (type) {
+    case nvinfer1::DataType::kFLOAT:
+    case nvinfer1::DataType::kINT32:
+      return 4;
+    case nvinfer1::DataType::kHALF:
+      return 2;
+    case nvinfer1::DataType::kINT8:
+    case nvinfer1::DataType::kBOOL:
+      return 1;
+    default:
+      return 0;
+  }
+}
 
-DeviceMemory::~DeviceMemory() noexcept {
-  for (unsigned int i = 0; i < _memory.size(); ++i) {
-    if (_memory[i]) {
-      cudaFree(_memory[i]);
+MemoryAllocator::MemoryAllocator() noexcept {}
+
+MemoryAllocator::~MemoryAllocator() noexcept {}
+
+void* CudaDeviceAllocator::allocate(const size_t& size) noexcept {
+  void* ptr = nullptr;
+  if (cudaMalloc(&ptr, size) != 0) {
+    return nullptr;
+  }
+  return ptr;
+}
+
+void CudaDeviceAllocator::free(void* ptr) noexcept { cudaFree(ptr); }
+
+const char* CudaDeviceAllocator::name() const noexcept { return "cuda-device"; }
+
+void* CudaPinnedAllocator::allocate(const size_t& size) noexcept {
+  void* ptr = nullptr;
+  if (cudaMallocHost(&ptr, size) != 0) {
+    return nullptr;
+  }
+  return ptr;
+}
+
+void CudaPinnedAllocator::free(void* ptr) noexcept { cudaFreeHost(ptr); }
+
+const char* CudaPinnedAllocator::name() const noexcept { return "cuda-pinned"; }
+
+void* HostAllocator::allocate(const size_t& size) noexcept {
+  /*  note: the size passed to aligned_alloc must be a multiple of the
+      alignment; the arena size always is   */
+  return std::aligned_alloc(DeviceMemory::ALIGNMENT, size);
+}
+
+void HostAllocator::free(void* ptr) noexcept { std::free(ptr); }
+
+const char* HostAllocator::name() const noexcept { return "host"; }
+
+AllocatorStats::AllocatorStats() noexcept
+    : allocations(0), frees(0), failures(0), liveBytes(0), peakBytes(0) {}
+
+CountingAllocator::CountingAllocator(
+    std::shared_ptr<MemoryAllocator> allocator) noexcept
+    : _allocator(allocator) {}
+
+void* CountingAllocator::allocate(const size_t& size) noexcept {
+  void* ptr = _allocator->allocate(size);
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (ptr == nullptr) {
+    _stats.failures += 1;
+    return nullptr;
+  }
+  try {
+    _sizes[ptr] = size;
+  } catch (const std::exception& e) {
+    _allocator->free(ptr);
+    _stats.failures += 1;
+    return nullptr;
+  }
+  _stats.allocations += 1;
+  _stats.liveBytes += size;
+  _stats.peakBytes = MAX(_stats.peakBytes, _stats.liveBytes);
+  return ptr;
+}
+
+void CountingAllocator::free(void* ptr) noexcept {
+  if (ptr == nullptr) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _sizes.find(ptr);
+    if (it != _sizes.end()) {
+      _stats.frees += 1;
+      _stats.liveBytes -= it->second;
+      _sizes.erase(it);
     }
   }
-  _memory.clear();
+  _allocator->free(ptr);
 }
 
-void DeviceMemory::swap(DeviceMemory& other) noexcept {
+const char* CountingAllocator::name() const noexcept {
+  return _allocator->name();
+}
+
+AllocatorStats CountingAllocator::stats() const noexcept {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _stats;
+}
+
+static size_t alignUp(const size_t& value, const size_t& alignment) noexcept {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+ArenaLayout::ArenaLayout() noexcept : _slotSize(0), _numSlots(0) {}
+
+ArenaLayout::~ArenaLayout() noexcept {}
+
+bool ArenaLayout::setup(const std::vector<size_t>& sizes, const int& numSlots,
+                        const size_t& alignment) noexcept {
+  if (numSlots < 1 || alignment == 0 || (alignment & (alignment - 1)) != 0) {
+    return false;
+  }
+
+  try {
+    _sizes = sizes;
+    _offsets.resize(sizes.size());
+  } catch (const std::exception& e) {
+    return false;
+  }
+
+  size_t offset = 0;
+  for (unsigned int i = 0; i < sizes.size(); ++i) {
+    _offsets[i] = offset;
+    offset += alignUp(sizes[i], alignment);
+  }
+  _slotSize = offset;
+  _numSlots = numSlots;
+  return true;
+}
+
+void ArenaLayout::swap(ArenaLayout& other) noexcept {
+  std::swap(_sizes, other._sizes);
+  std::swap(_offsets, other._offsets);
+  std::swap(_slotSize, other._slotSize);
+  std::swap(_numSlots, other._numSlots);
+}
+
+int ArenaLayout::numBindings() const noexcept { return _sizes.size(); }
+
+int ArenaLayout::numSlots() const noexcept { return _numSlots; }
+
+size_t ArenaLayout::offset(const int& binding, const int& slot) const noexcept {
+  return slot * _slotSize + _offsets[binding];
+}
+
+size_t ArenaLayout::size(const int& binding) const noexcept {
+  return _sizes[binding];
+}
+
+size_t ArenaLayout::totalSize() const noexcept { return _numSlots * _slotSize; }
+
+size_t ArenaLayout::usedSize() const noexcept {
+  size_t r = 0;
+  for (const size_t& size : _sizes) {
+    r += size;
+  }
+  return r * _numSlots;
+}
+
+Arena::Arena() noexcept : _memory(nullptr) {}
+
+Arena::~Arena() noexcept { release(); }
+
+void Arena::swap(Arena& other) noexcept {
+  _layout.swap(other._layout);
+  std::swap(_allocator, other._allocator);
   std::swap(_memory, other._memory);
 }
 
-void** DeviceMemory::begin() const noexcept { return (void**)_memory.data(); }
+bool Arena::setup(const ArenaLayout& layout,
+                  std::shared_ptr<MemoryAllocator> allocator) noexcept {
+  release();
 
-void* DeviceMemory::at(const int& index) const noexcept {
-  return _memory[index];
+  ArenaLayout copy;
+  try {
+    copy = layout;
+  } catch (const std::exception& e) {
+    return false;
+  }
+
+  char* memory = nullptr;
+  if (layout.totalSize() > 0) {
+    memory = (char*)allocator->allocate(layout.totalSize());
+    if (memory == nullptr) {
+      return false;
+    }
+  }
+
+  _layout.swap(copy);
+  _allocator = allocator;
+  _memory = memory;
+  return true;
 }
 
-Result DeviceMemory::setup(const std::shared_ptr<Logger>& logger,
-                           std::unique_ptr<nvinfer1::ICudaEngine>& engine,
-                           DeviceMemory* output) noexcept {
+void Arena::release() noexcept {
+  if (_memory != nullptr) {
+    _allocator->free(_memory);
+    _memory = nullptr;
+  }
+}
+
+void* Arena::at(const int& binding, const int& slot) const noexcept {
+  if (_memory == nullptr || _layout.size(binding) == 0) {
+    return nullptr;
+  }
+  return _memory + _layout.offset(binding, slot);
+}
+
+const ArenaLayout& Arena::layout() const noexcept { return _layout; }
+
+const std::shared_ptr<MemoryAllocator>& Arena::allocator() const noexcept {
+  return _allocator;
+}
+
+const size_t DeviceMemory::ALIGNMENT;
+
+DeviceMemory::DeviceMemory() noexcept {}
+
+DeviceMemory::~DeviceMemory() noexcept {
+  /*  note: the arenas free their memory  */
+}
+
+void DeviceMemory::swap(DeviceMemory& other) noexcept {
+  _device.swap(other._device);
+  _host.swap(other._host);
+  std::swap(_bindings, other._bindings);
+}
+
+void** DeviceMemory::begin(const int& slot) const noexcept {
+  return (void**)_bindings.data() + slot * _device.layout().numBindings();
+}
+
+void* DeviceMemory::at(const int& index, const int& slot) const noexcept {
+  return _device.at(index, slot);
+}
+
+void* DeviceMemory::hostAt(const int& index, const int& slot) const noexcept {
+  return _host.at(index, slot);
+}
+
+size_t DeviceMemory::size(const int& index) const noexcept {
+  return _device.layout().size(index);
+}
+
+int DeviceMemory::numSlots() const noexcept {
+  return _device.layout().numSlots();
+}
+
+MemoryUsage DeviceMemory::usage() const noexcept {
+  MemoryUsage r;
+  r.deviceBytes = _device.layout().totalSize();
+  r.hostBytes = _host.layout().totalSize();
+  r.bindingBytes = _device.layout().usedSize();
+  r.hostPinned = (bool)std::dynamic_pointer_cast<CudaPinnedAllocator>(
+      _host.allocator());
+  r.numBindings = _device.layout().numBindings();
+  r.numSlots = _device.layout().numSlots();
+  return r;
+}
+
+Result DeviceMemory::setup(
+    const std::shared_ptr<Logger>& logger,
+    std::unique_ptr<nvinfer1::ICudaEngine>& engine,
+    std::unique_ptr<nvinfer1::IExecutionContext>& context,
+    const std::vector<int>& hostBindings, const int& numSlots,
+    DeviceMemory* output) noexcept {
   const int32_t nbBindings = engine->getNbBindings();
-  for (int i = 0; i < nbBindings; ++i) {
-    const nvinfer1::Dims dims = engine->getBindingDimensions(i);
-    const int volume = dimsVolume(dims);
 
-    try {
-      output->_memory.push_back(nullptr);
-    } catch (const std::exception& e) {
+  /*  Only the bindings of the first optimization profile are used; the
+      others are left at nullptr    */
+  const int32_t nbProfiles = MAX(1, engine->getNbOptimizationProfiles());
+  const int32_t nbProfileBindings = nbBindings / nbProfiles;
+
+  std::vector<size_t> sizes;
+  try {
+    sizes.resize(nbBindings, 0);
+  } catch (const std::exception& e) {
+    logger->logf(LOGGING_ERROR,
+                 "[DeviceMemory] setup() failure: "
+                 "exception: %s",
+                 e.what());
+    return RESULT_FAILURE_ALLOC;
+  }
+
+  for (int i = 0; i < nbProfileBindings; ++i) {
+    const nvinfer1::Dims dims = context->getBindingDimensions(i);
+    const int volume = dimsVolume(dims);
+    if (volume <= 0) {
       logger->logf(LOGGING_ERROR,
                    "[DeviceMemory] setup() failure: "
-                   "exception: %s",
-                   e.what());
-      return RESULT_FAILURE_ALLOC;
+                   "binding %i has unspecified dimensions",
+                   i);
+      return RESULT_FAILURE_MODEL_ERROR;
     }
-    void** ptr = &output->_memory.back();
 
-    auto r = cudaMalloc(ptr, volume * sizeof(float));
-    if (r != 0 || *ptr == nullptr) {
+    const size_t elementSize = dataTypeSize(engine->getBindingDataType(i));
+    if (elementSize == 0) {
       logger->logf(LOGGING_ERROR,
                    "[DeviceMemory] setup() failure: "
-                   "could not allocate device memory: %s",
-                   cudaGetErrorString(r));
-      return RESULT_FAILURE_CUDA_ERROR;
+                   "binding %i has an unsupported data type",
+                   i);
+      return RESULT_FAILURE_MODEL_ERROR;
+    }
+    sizes[i] = volume * elementSize;
+  }
+
+  std::shared_ptr<MemoryAllocator> deviceAllocator;
+  std::shared_ptr<MemoryAllocator> hostAllocator;
+  try {
+    deviceAllocator = std::make_shared<CudaDeviceAllocator>();
+    hostAllocator = std::make_shared<CudaPinnedAllocator>();
+  } catch (const std::exception& e) {
+    logger->logf(LOGGING_ERROR,
+                 "[DeviceMemory] setup() failure: "
+                 "exception: %s",
+                 e.what());
+    return RESULT_FAILURE_ALLOC;
+  }
+  return setup(logger, sizes, hostBindings, numSlots, deviceAllocator,
+               hostAllocator, output);
+}
+
+Result DeviceMemory::setup(const std::shared_ptr<Logger>& logger,
+                           const std::vector<size_t>& sizes,
+                           const std::vector<int>& hostBindings,
+                           const int& numSlots,
+                           std::shared_ptr<MemoryAllocator> deviceAllocator,
+                           std::shared_ptr<MemoryAllocator> hostAllocator,
+                           DeviceMemory* output) noexcept {
+  ArenaLayout deviceLayout;
+  ArenaLayout hostLayout;
+  std::vector<void*> bindings;
+  try {
+    std::vector<size_t> hostSizes(sizes.size(), 0);
+    for (const int& index : hostBindings) {
+      if (index < 0 || index >= (int)sizes.size()) {
+        logger->logf(LOGGING_ERROR,
+                     "[DeviceMemory] setup() failure: "
+                     "invalid host binding %i",
+                     index);
+        return RESULT_FAILURE_INVALID_INPUT;
+      }
+      hostSizes[index] = sizes[index];
+    }
+
+    if (!deviceLayout.setup(sizes, numSlots, ALIGNMENT) ||
+        !hostLayout.setup(hostSizes, numSlots, ALIGNMENT)) {
+      logger->log(LOGGING_ERROR,
+                  "[DeviceMemory] setup() failure: "
+                  "invalid layout");
+      return RESULT_FAILURE_INVALID_INPUT;
     }
+    bindings.resize(sizes.size() * numSlots, nullptr);
+  } catch (const std::exception& e) {
+    logger->logf(LOGGING_ERROR,
+                 "[DeviceMemory] setup() failure: "
+                 "exception: %s",
+                 e.what());
+    return RESULT_FAILURE_ALLOC;
+  }
+
+  Arena device;
+  if (!device.setup(deviceLayout, deviceAllocator)) {
+    logger->logf(LOGGING_ERROR,
+                 "[DeviceMemory] setup() failure: "
+                 "could not allocate %zu bytes of %s memory",
+                 deviceLayout.totalSize(), deviceAllocator->name());
+    return RESULT_FAILURE_CUDA_ERROR;
+  }
+  Arena host;
+  if (!host.setup(hostLayout, hostAllocator)) {
+    logger->logf(LOGGING_ERROR,
+                 "[DeviceMemory] setup() failure: "
+                 "could not allocate %zu bytes of %s memory",
+                 hostLayout.totalSize(), hostAllocator->name());
+    return RESULT_FAILURE_CUDA_ERROR;
   }
+
+  for (int slot = 0; slot < numSlots; ++slot) {
+    for (unsigned int i = 0; i < sizes.size(); ++i) {
+      bindings[slot * sizes.size() + i] = device.at(i, slot);
+    }
+  }
+
+  output->_device.swap(device);
+  output->_host.swap(host);
+  std::swap(output->_bindings, bindings);
+
+  logger->logf(LOGGING_DEBUG,
+               "[DeviceMemory] setup(): %zu bytes of %s memory, %zu bytes "
+               "of %s memory for %i slot(s)",
+               deviceLayout.totalSize(), deviceAllocator->name(),
+               hostLayout.totalSize(), hostAllocator->name(), numSlots);
   return RESULT_SUCCESS;
 }
 
+double letterboxFill(const cv::Size& input, const cv::Size& network) noexcept {
+  if (input.area() <= 0 || network.area() <= 0) {
+    return 0.0;
+  }
+  const double f = MIN((double)network.height / (double)input.height,
+                       (double)network.width / (double)input.width);
+  const double content = (input.width * f) * (input.height * f);
+  return content / (double)network.area();
+}
+
+int selectInferenceSize(const std::vector<cv::Size>& candidates,
+                        const cv::Size* inputs,
+                        const int& numInputs) noexcept {
+  int best = -1;
+  double bestFill = -1.0;
+  for (unsigned int i = 0; i < candidates.size(); ++i) {
+    double fill = 0.0;
+    for (int j = 0; j < numInputs; ++j) {
+      fill += letterboxFill(inputs[j], candidates[i]);
+    }
+
+    /*  note: small tolerance, so that rounding does not decide    */
+    const double eps = 1e-6 * MAX(1.0, (double)numInputs);
+    if (best == -1 || fill > bestFill + eps ||
+        (fill > bestFill - eps &&
+         candidates[i].area() > candidates[best].area())) {
+      best = i;
+      bestFill = fill;
+    }
+  }
+  return best;
+}
+
+int selectSmallestInferenceSize(const std::vector<cv::Size>& candidates,
+                                const cv::Size* inputs,
+                                const int& numInputs) noexcept {
+  int best = -1;
+  double bestFill = -1.0;
+  for (unsigned int i = 0; i < candidates.size(); ++i) {
+    double fill = 0.0;
+    for (int j = 0; j < numInputs; ++j) {
+      fill += letterboxFill(inputs[j], candidates[i]);
+    }
+
+    const double eps = 1e-6 * MAX(1.0, (double)numInputs);
+    if (best == -1 || candidates[i].area() < candidates[best].area() ||
+        (candidates[i].area() == candidates[best].area() &&
+         fill > bestFill + eps)) {
+      best = i;
+      bestFill = fill;
+    }
+  }
+  return best;
+}
+
 bool opencvHasCuda() noexcept {
   int r = 0;
   try {
@@ -234,6 +702,156 @@ cv::Rect PreprocessorTransform::transformBbox(
   return r;
 }
 
+const cv::Size& PreprocessorTransform::inputSize() const noexcept {
+  return _inputSize;
+}
+
+const double& PreprocessorTransform::scale() const noexcept { return _f; }
+
+const int& PreprocessorTransform::leftWidth() const noexcept {
+  return _leftWidth;
+}
+
+const int& PreprocessorTransform::topHeight() const noexcept {
+  return _topHeight;
+}
+
+void letterbox(const cv::Mat& input, const cv::Size& networkSize,
+               cv::Mat* buffer, cv::Mat* output,
+               PreprocessorTransform* transform) {
+  if (input.size() == networkSize) {
+    /*  copied, so that the output (usually a buffer reused across calls)
+        never refers to the memory of the caller  */
+    input.copyTo(*output);
+    *transform = PreprocessorTransform(input.size(), 1.0, 0, 0);
+    return;
+  }
+
+  const double f = MIN((double)networkSize.height / (double)input.rows,
+                       (double)networkSize.width / (double)input.cols);
+  const cv::Size boxSize = cv::Size(input.cols * f, input.rows * f);
+
+  const int dr = networkSize.height - boxSize.height;
+  const int dc = networkSize.width - boxSize.width;
+  const int topHeight = std::floor(dr / 2.0);
+  const int bottomHeight = std::ceil(dr / 2.0);
+  const int leftWidth = std::floor(dc / 2.0);
+  const int rightWidth = std::ceil(dc / 2.0);
+
+  *transform = PreprocessorTransform(input.size(), f, leftWidth, topHeight);
+
+  cv::resize(input, *buffer, boxSize, 0, 0, cv::INTER_LINEAR);
+  cv::copyMakeBorder(*buffer, *output, topHeight, bottomHeight, leftWidth,
+                     rightWidth, cv::BORDER_CONSTANT, cv::Scalar(0, 0, 0));
+}
+
+void decodeOutput(const float* output, const int& numGridBoxes,
+                  const int& rowSize, const double& scoreThreshold,
+                  std::vector<cv::Rect>* boxes, std::vector<float>* scores,
+                  std::vector<int>* classes) {
+  const int nrClasses = rowSize - 5;
+  for (int i = 0; i < numGridBoxes; ++i) {
+    const float* ptr = output + i * rowSize;
+
+    const float objectness = ptr[4];
+    if (objectness < scoreThreshold) {
+      continue;
+    }
+
+    /*  Get the class with the highest score attached to it */
+    double maxClassScore = 0.0;
+    int maxScoreIndex = 0;
+    for (int i = 0; i < nrClasses; ++i) {
+      const float& v = ptr[5 + i];
+      if (v > maxClassScore) {
+        maxClassScore = v;
+        maxScoreIndex = i;
+      }
+    }
+    const double score = objectness * maxClassScore;
+    if (score < scoreThreshold) {
+      continue;
+    }
+
+    const float w = ptr[2];
+    const float h = ptr[3];
+    const float x = ptr[0] - w / 2.0;
+    const float y = ptr[1] - h / 2.0;
+
+    boxes->push_back(cv::Rect(x, y, w, h));
+    scores->push_back(score);
+    classes->push_back(maxScoreIndex);
+  }
+}
+
+Result postprocessOutput(const float* output, const int& numGridBoxes,
+                         const int& rowSize, const double& scoreThreshold,
+                         const double& nmsThreshold,
+                         const PreprocessorTransform& transform,
+                         const Classes* classes,
+                         const std::shared_ptr<Logger>& logger,
+                         const char* logid,
+                         std::vector<Detection>* out) noexcept {
+  std::vector<cv::Rect> boxes;
+  std::vector<float> scores;
+  std::vector<int> classIds;
+
+  /*  Decode YoloV5 output    */
+  YOLOV5_PERF_SCOPE("decode");
+  TraceSpan decodeSpan("decode");
+  try {
+    decodeOutput(output, numGridBoxes, rowSize, scoreThreshold, &boxes,
+                 &scores, &classIds);
+  } catch (const std::exception& e) {
+    logger->logf(LOGGING_ERROR,
+                 "[Detector] %s failure: got "
+                 "exception setting up model detection: %s",
+                 logid, e.what());
+    return RESULT_FAILURE_ALLOC;
+  }
+  decodeSpan.end();
+
+  /*  Apply non-max-suppression   */
+  std::vector<int> indices;
+  try {
+    YOLOV5_TRACE_SPAN("nms");
+    cv::dnn::NMSBoxes(boxes, scores, scoreThreshold, nmsThreshold, indices);
+  } catch (const std::exception& e) {
+    logger->logf(LOGGING_ERROR,
+                 "[Detector] %s failure: got exception "
+                 "applying OpenCV non-max-suppression: %s",
+                 logid, e.what());
+    return RESULT_FAILURE_OPENCV_ERROR;
+  }
+
+  /*  Convert to Detection objects    */
+  YOLOV5_TRACE_SPAN("bbox transform");
+  for (unsigned int i = 0; i < indices.size(); ++i) {
+    const int& j = indices[i];
+    /*  transform bounding box from network space to input space    */
+    const cv::Rect bbox = transform.transformBbox(boxes[j]);
+    const double score = MAX(0.0, MIN(1.0, scores[j]));
+    try {
+      out->push_back(Detection(classIds[j], bbox, score));
+    } catch (const std::exception& e) {
+      logger->logf(LOGGING_ERROR,
+                   "[Detector] %s failure: got "
+                   "exception setting up Detection output: %s",
+                   logid, e.what());
+      return RESULT_FAILURE_ALLOC;
+    }
+
+    if (classes != nullptr && classes->isLoaded()) {
+      Detection& det = out->back();
+
+      std::string className;
+      classes->getName(det.classId(), &className);
+      det.setClassName(className);
+    }
+  }
+  return RESULT_SUCCESS;
+}
+
 Preprocessor::Preprocessor() noexcept {}
 
 Preprocessor::~Preprocessor() noexcept {}
@@ -287,6 +905,11 @@ cv::Rect Preprocessor::transformBbox(const int& index,
   return _transforms[index].transformBbox(bbox);
 }
 
+const PreprocessorTransform& Preprocessor::transform(const int& index) const
+    noexcept {
+  return _transforms[index];
+}
+
 template <typename T>
 static void setupChannels(const cv::Size& size,
                           const Preprocessor::InputType& inputType,
@@ -316,14 +939,20 @@ CvCpuPreprocessor::CvCpuPreprocessor() noexcept
       _lastType((InputType)-1),
       _lastBatchSize(-1),
       _networkCols(0),
-      _networkRows(0) {}
+      _networkRows(0),
+      _hostInputMemory(nullptr),
+      _deviceInputMemory(nullptr) {}
 
-CvCpuPreprocessor::~CvCpuPreprocessor() noexcept {}
+CvCpuPreprocessor::~CvCpuPreprocessor() noexcept {
+  if (_cudaStream) {
+    cudaStreamDestroy(_cudaStream);
+  }
+}
 
 bool CvCpuPreprocessor::setup(const nvinfer1::Dims& inputDims, const int& flags,
-                              const int& batchSize,
-                              float* inputMemory) noexcept {
-  if (!_cudaStream) {
+                              const int& batchSize, float* inputMemory,
+                              float* hostInputMemory) noexcept {
+  if (!_cudaStream && inputMemory != nullptr) {
     auto r = cudaStreamCreate(&_cudaStream);
     if (r != 0) {
       _logger->logf(LOGGING_ERROR,
@@ -345,7 +974,10 @@ bool CvCpuPreprocessor::setup(const nvinfer1::Dims& inputDims, const int& flags,
     inputType = INPUTTYPE_RGB;
   }
 
-  if (_lastType == inputType && _lastBatchSize == batchSize) {
+  if (_lastType == inputType && _lastBatchSize == batchSize &&
+      _networkRows == inputDims.d[2] && _networkCols == inputDims.d[3] &&
+      _deviceInputMemory == inputMemory &&
+      (hostInputMemory == nullptr || _hostInputMemory == hostInputMemory)) {
     return true;
   }
   _lastType = inputType;
@@ -360,11 +992,18 @@ bool CvCpuPreprocessor::setup(const nvinfer1::Dims& inputDims, const int& flags,
   _inputChannels.clear();
   try {
     /*  Set up host input memory    */
-    _hostInputMemory.resize(dimsVolume(inputDims));
+    if (hostInputMemory != nullptr) {
+      _hostInputBuffer.clear();
+      _hostInputBuffer.shrink_to_fit();
+      _hostInputMemory = hostInputMemory;
+    } else {
+      _hostInputBuffer.resize(dimsVolume(inputDims));
+      _hostInputMemory = _hostInputBuffer.data();
+    }
 
     _inputChannels.resize(batchSize);
     for (unsigned int i = 0; i < _inputChannels.size(); ++i) {
-      float* inputPtr = _hostInputMemory.data() + i * networkSize.area() * 3;
+      float* inputPtr = _hostInputMemory + i * networkSize.area() * 3;
 
       std::vector<cv::Mat>& channels = _inputChannels[i];
       setupChannels<cv::Mat>(networkSize, inputType, inputPtr, channels);
@@ -379,6 +1018,10 @@ bool CvCpuPreprocessor::setup(const nvinfer1::Dims& inputDims, const int& flags,
   return true;
 }
 
+const float* CvCpuPreprocessor::hostInputMemory() const noexcept {
+  return _hostInputMemory;
+}
+
 void CvCpuPreprocessor::reset() noexcept {
   /*  this will trigger setup() to take effect next time  */
   _lastType = (InputType)-1;
@@ -392,26 +1035,14 @@ bool CvCpuPreprocessor::process(const int& index, const cv::Mat& input,
 
   PreprocessorTransform& transform = _transforms[index];
   try {
+    YOLOV5_TRACE_SPAN("preprocess");
+    YOLOV5_PERF_SCOPE("preprocess");
     if (input.rows == _networkRows && input.cols == _networkCols) {
       input.convertTo(_buffer3, CV_32FC3, 1.0f / 255.0f);
       transform = PreprocessorTransform(input.size(), 1.0, 0, 0);
     } else {
-      const double f = MIN((double)_networkRows / (double)input.rows,
-                           (double)_networkCols / (double)input.cols);
-      const cv::Size boxSize = cv::Size(input.cols * f, input.rows * f);
-
-      const int dr = _networkRows - boxSize.height;
-      const int dc = _networkCols - boxSize.width;
-      const int topHeight = std::floor(dr / 2.0);
-      const int bottomHeight = std::ceil(dr / 2.0);
-      const int leftWidth = std::floor(dc / 2.0);
-      const int rightWidth = std::ceil(dc / 2.0);
-
-      transform = PreprocessorTransform(input.size(), f, leftWidth, topHeight);
-
-      cv::resize(input, _buffer1, boxSize, 0, 0, cv::INTER_LINEAR);
-      cv::copyMakeBorder(_buffer1, _buffer2, topHeight, bottomHeight, leftWidth,
-                         rightWidth, cv::BORDER_CONSTANT, cv::Scalar(0, 0, 0));
+      letterbox(input, cv::Size(_networkCols, _networkRows), &_buffer1,
+                &_buffer2, &transform);
       _buffer2.convertTo(_buffer3, CV_32FC3, 1.0f / 255.0f);
     }
     cv::split(_buffer3, _inputChannels[index]);
@@ -425,12 +1056,13 @@ bool CvCpuPreprocessor::process(const int& index, const cv::Mat& input,
   }
 
   /*  Copy from host to device    */
-  if (last) {
+  if (last && _deviceInputMemory != nullptr) {
     const int volume = _inputChannels.size() /*  batch size  */
                        * 3 *
                        _buffer3.size().area(); /*  channels * rows*cols   */
 
-    auto r = cudaMemcpyAsync(_deviceInputMemory, (void*)_hostInputMemory.data(),
+    YOLOV5_TRACE_SPAN("h2d copy");
+    auto r = cudaMemcpyAsync(_deviceInputMemory, (void*)_hostInputMemory,
                              (int)(volume * sizeof(float)),
                              cudaMemcpyHostToDevice, _cudaStream);
     if (r != 0) {
@@ -462,6 +1094,10 @@ cudaStream_t CvCpuPreprocessor::cudaStream() const noexcept {
 }
 
 bool CvCpuPreprocessor::synchronizeCudaStream() noexcept {
+  if (!_cudaStream) {
+    /*  host-only mode  */
+    return true;
+  }
   auto r = cudaStreamSynchronize(_cudaStream);
   if (r != 0) {
     _logger->logf(LOGGING_ERROR,
@@ -477,13 +1113,17 @@ CvCudaPreprocessor::CvCudaPreprocessor() noexcept
     : _lastType((InputType)-1),
       _lastBatchSize(-1),
       _networkCols(0),
-      _networkRows(0) {}
+      _networkRows(0),
+      _inputMemory(nullptr) {}
 
 CvCudaPreprocessor::~CvCudaPreprocessor() noexcept {}
 
 bool CvCudaPreprocessor::setup(const nvinfer1::Dims& inputDims,
                                const int& flags, const int& batchSize,
-                               float* inputMemory) noexcept {
+                               float* inputMemory,
+                               float* hostInputMemory) noexcept {
+  /*  note: pre-processing happens entirely on the device */
+  YOLOV5_UNUSED(hostInputMemory);
 #ifdef YOLOV5_OPENCV_HAS_CUDA
   if ((flags & INPUT_RGB) && (flags & INPUT_BGR)) {
     _logger->log(LOGGING_ERROR,
@@ -496,7 +1136,9 @@ bool CvCudaPreprocessor::setup(const nvinfer1::Dims& inputDims,
     inputType = INPUTTYPE_RGB;
   }
 
-  if (_lastType == inputType && _lastBatchSize == batchSize) {
+  if (_lastType == inputType && _lastBatchSize == batchSize &&
+      _networkRows == inputDims.d[2] && _networkCols == inputDims.d[3] &&
+      _inputMemory == inputMemory) {
     return true;
   }
   _lastType = inputType;
@@ -506,6 +1148,8 @@ bool CvCudaPreprocessor::setup(const nvinfer1::Dims& inputDims,
   _networkCols = inputDims.d[3];
   const cv::Size networkSize(_networkCols, _networkRows);
 
+  _inputMemory = inputMemory;
+
   _inputChannels.clear();
   try {
     _inputChannels.resize(batchSize);
@@ -545,6 +1189,7 @@ bool CvCudaPreprocessor::process(const int& index, const cv::Mat& input,
                                  const bool& last) noexcept {
 #ifdef YOLOV5_OPENCV_HAS_CUDA
   try {
+    YOLOV5_TRACE_SPAN("h2d copy");
     _buffer0.upload(input);
   } catch (const std::exception& e) {
     _logger->logf(LOGGING_ERROR,
@@ -584,6 +1229,7 @@ bool CvCudaPreprocessor::process(const int& index,
 
   PreprocessorTransform& transform = _transforms[index];
   try {
+    YOLOV5_TRACE_SPAN("preprocess");
     if (input.rows == _networkRows && input.cols == _networkCols) {
       input.convertTo(_buffer3, CV_32FC3, 1.0f / 255.0f, _cudaStream);
       transform = PreprocessorTransform(input.size(), 1.0, 0, 0);
@@ -650,6 +1296,11 @@ bool CvCudaPreprocessor::synchronizeCudaStream() noexcept {
   return true;
 }
 
+EngineInstance::EngineInstance() noexcept
+    : outputHostMemory(nullptr), generation(0) {}
+
+EngineInstance::~EngineInstance() noexcept {}
+
 } /*  namespace internal  */
 
 } /*  namespace yolov5    */
\ No newline at end of file
@@ -0,0 +1,266 @@
+#include "yolov5_evaluation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+namespace yolov5 {
+
+namespace {
+
+struct Candidate {
+  int image;
+  int index;
+  double score;
+};
+
+/*  AP of a single class at a single IoU threshold; -1 without ground truth */
+double classAveragePrecision(
+    const int& classId,
+    const std::vector<std::vector<Detection>>& detections,
+    const std::vector<std::vector<Detection>>& groundTruth,
+    const double& iouThreshold) {
+  int numGroundTruth = 0;
+  std::vector<std::vector<bool>> used(groundTruth.size());
+  for (size_t i = 0; i < groundTruth.size(); ++i) {
+    used[i].resize(groundTruth[i].size(), false);
+    for (const Detection& gt : groundTruth[i]) {
+      numGroundTruth += gt.classId() == classId ? 1 : 0;
+    }
+  }
+  if (numGroundTruth == 0) {
+    return -1.0;
+  }
+
+  std::vector<Candidate> candidates;
+  for (size_t i = 0; i < detections.size(); ++i) {
+    for (size_t j = 0; j < detections[i].size(); ++j) {
+      if (detections[i][j].classId() == classId) {
+        candidates.push_back({(int)i, (int)j, detections[i][j].score()});
+      }
+    }
+  }
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [](const Candidate& a, const Candidate& b) {
+                     return a.score > b.score;
+                   });
+
+  /*  precision and recall after every detection   */
+  std::vector<double> precision(candidates.size());
+  std::vector<double> recall(candidates.size());
+  int tp = 0;
+  for (size_t k = 0; k < candidates.size(); ++k) {
+    const Candidate& c = candidates[k];
+    const cv::Rect& box = detections[c.image][c.index].boundingBox();
+    int best = -1;
+    double bestIou = iouThreshold;
+    if ((size_t)c.image < groundTruth.size()) {
+      const std::vector<Detection>& gts = groundTruth[c.image];
+      for (size_t g = 0; g < gts.size(); ++g) {
+        if (gts[g].classId() != classId || used[c.image][g]) {
+          continue;
+        }
+        const double iou = intersectionOverUnion(box, gts[g].boundingBox());
+        if (iou >= bestIou) {
+          bestIou = iou;
+          best = g;
+        }
+      }
+    }
+    if (best >= 0) {
+      used[c.image][best] = true;
+      tp += 1;
+    }
+    precision[k] = (double)tp / (double)(k + 1);
+    recall[k] = (double)tp / (double)numGroundTruth;
+  }
+
+  /*  make precision monotonically decreasing, then sample it at 101
+      recall points   */
+  for (int k = (int)precision.size() - 2; k >= 0; --k) {
+    precision[k] = std::max(precision[k], precision[k + 1]);
+  }
+  double sum = 0.0;
+  size_t k = 0;
+  for (int r = 0; r <= 100; ++r) {
+    const double target = r / 100.0;
+    while (k < recall.size() && recall[k] < target - 1e-12) {
+      ++k;
+    }
+    sum += k < recall.size() ? precision[k] : 0.0;
+  }
+  return sum / 101.0;
+}
+
+} /*  namespace   */
+
+double intersectionOverUnion(const cv::Rect& a, const cv::Rect& b) noexcept {
+  const double intersection = (a & b).area();
+  const double unionArea = a.area() + b.area() - intersection;
+  return unionArea > 0.0 ? intersection / unionArea : 0.0;
+}
+
+double averagePrecision(
+    const std::vector<std::vector<Detection>>& detections,
+    const std::vector<std::vector<Detection>>& groundTruth,
+    const double& iouThreshold) noexcept {
+  try {
+    std::map<int, bool> classes;
+    for (const std::vector<Detection>& gts : groundTruth) {
+      for (const Detection& gt : gts) {
+        classes[gt.classId()] = true;
+      }
+    }
+
+    double sum = 0.0;
+    int numClasses = 0;
+    for (const auto& entry : classes) {
+      const double ap = classAveragePrecision(entry.first, detections,
+                                              groundTruth, iouThreshold);
+      if (ap >= 0.0) {
+        sum += ap;
+        numClasses += 1;
+      }
+    }
+    return numClasses > 0 ? sum / numClasses : -1.0;
+  } catch (const std::exception& e) {
+    return -1.0;
+  }
+}
+
+double meanAveragePrecision(
+    const std::vector<std::vector<Detection>>& detections,
+    const std::vector<std::vector<Detection>>& groundTruth) noexcept {
+  double sum = 0.0;
+  for (int i = 0; i < 10; ++i) {
+    const double ap =
+        averagePrecision(detections, groundTruth, 0.5 + 0.05 * i);
+    if (ap < 0.0) {
+      return -1.0;
+    }
+    sum += ap;
+  }
+  return sum / 10.0;
+}
+
+Result loadYoloLabels(const std::string& filepath, const cv::Size& imageSize,
+                      std::vector<Detection>* out) noexcept {
+  try {
+    out->clear();
+    std::ifstream file(filepath);
+    if (!file.good()) {
+      return RESULT_SUCCESS; /*  no objects  */
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+      std::istringstream ss(line);
+      int classId;
+      double cx, cy, w, h;
+      if (!(ss >> classId >> cx >> cy >> w >> h)) {
+        continue; /*  empty line   */
+      }
+      if (classId < 0 || w <= 0.0 || h <= 0.0) {
+        return RESULT_FAILURE_INVALID_INPUT;
+      }
+      const cv::Rect box(std::lround((cx - w / 2.0) * imageSize.width),
+                         std::lround((cy - h / 2.0) * imageSize.height),
+                         std::lround(w * imageSize.width),
+                         std::lround(h * imageSize.height));
+      out->push_back(Detection(classId, box, 1.0));
+    }
+  } catch (const std::exception& e) {
+    return RESULT_FAILURE_ALLOC;
+  }
+  return RESULT_SUCCESS;
+}
+
+DetectionDrift::DetectionDrift() noexcept { reset(); }
+
+void DetectionDrift::add(const std::vector<Detection>& reference,
+                         const std::vector<Detection>& candidate) noexcept {
+  std::vector<bool> used;
+  try {
+    used.resize(candidate.size(), false);
+  } catch (const std::exception& e) {
+    return;
+  }
+
+  int matched = 0;
+  for (const Detection& ref : reference) {
+    int best = -1;
+    double bestIou = 0.5;
+    for (size_t j = 0; j < candidate.size(); ++j) {
+      if (used[j] || candidate[j].classId() != ref.classId()) {
+        continue;
+      }
+      const double iou = intersectionOverUnion(ref.boundingBox(),
+                                               candidate[j].boundingBox());
+      if (iou >= bestIou) {
+        bestIou = iou;
+        best = j;
+      }
+    }
+    if (best < 0) {
+      continue;
+    }
+    used[best] = true;
+    matched += 1;
+
+    const double iouDelta = 1.0 - bestIou;
+    const double scoreDelta = std::fabs(candidate[best].score() - ref.score());
+    _sumIouDelta += iouDelta;
+    _maxIouDelta = std::max(_maxIouDelta, iouDelta);
+    _sumScoreDelta += scoreDelta;
+    _maxScoreDelta = std::max(_maxScoreDelta, scoreDelta);
+  }
+
+  _numReference += reference.size();
+  _numMatched += matched;
+  _numExtra += candidate.size() - matched;
+}
+
+void DetectionDrift::reset() noexcept {
+  _numReference = 0;
+  _numMatched = 0;
+  _numExtra = 0;
+  _sumIouDelta = 0.0;
+  _maxIouDelta = 0.0;
+  _sumScoreDelta = 0.0;
+  _maxScoreDelta = 0.0;
+}
+
+int DetectionDrift::numReference() const noexcept { return _numReference; }
+
+int DetectionDrift::numMatched() const noexcept { return _numMatched; }
+
+int DetectionDrift::numMissing() const noexcept {
+  return _numReference - _numMatched;
+}
+
+int DetectionDrift::numExtra() const noexcept { return _numExtra; }
+
+double DetectionDrift::unmatchedFraction() const noexcept {
+  const int unmatched = numMissing() + numExtra();
+  if (_numReference == 0) {
+    return unmatched > 0 ? 1.0 : 0.0;
+  }
+  return (double)unmatched / (double)_numReference;
+}
+
+double DetectionDrift::meanIouDelta() const noexcept {
+  return _numMatched > 0 ? _sumIouDelta / _numMatched : 0.0;
+}
+
+double DetectionDrift::maxIouDelta() const noexcept { return _maxIouDelta; }
+
+double DetectionDrift::meanScoreDelta() const noexcept {
+  return _numMatched > 0 ? _sumScoreDelta / _numMatched : 0.0;
+}
+
+double DetectionDrift::maxScoreDelta() const noexcept {
+  return _maxScoreDelta;
+}
+
+} /*  namespace yolov5    */
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "yolov5_logging.h"
 
 #include <cstdarg>
+#include <cstdio>
 #include <cstring>
 
 const char* yolov5::loglevel_to_string(const LogLevel& l) noexcept {
@@ -33,7 +34,7 @@ bool yolov5::loglevel_to_string(const LogLevel& l, std::string* out) noexcept {
   return true;
 }
 
-yolov5::Logger::Logger() noexcept {}
+yolov5::Logger::Logger() noexcept : _minLevel(LOGGING_DEBUG) {}
 
 yolov5::Logger::~Logger() {}
 
@@ -42,6 +43,9 @@ void yolov5::Logger::print(const LogLevel& level, const char* msg) {
 }
 
 void yolov5::Logger::log(const LogLevel& level, const char* msg) noexcept {
+  if (!isEnabled(level)) {
+    return;
+  }
   try {
     this->print(level, msg);
   } catch (...) {
@@ -50,22 +54,256 @@ void yolov5::Logger::log(const LogLevel& level, const char* msg) noexcept {
 
 void yolov5::Logger::logf(const LogLevel& level, const char* fmt,
                           ...) noexcept {
-  char* msg = nullptr;
+  if (!isEnabled(level)) {
+    return;
+  }
 
   va_list args;
   va_start(args, fmt);
+  va_list retry;
+  va_copy(retry, args);
+
+  char buffer[512];
+  const int length = std::vsnprintf(buffer, sizeof(buffer), fmt, args);
+  va_end(args);
 
-  if (vasprintf(&msg, fmt, args) < 0) {
+  const char* msg = buffer;
+  char* allocated = nullptr;
+  if (length < 0) {
     msg = nullptr;
+  } else if ((size_t)length >= sizeof(buffer)) {
+    /*  Rare: long messages are formatted again, on the heap   */
+    if (vasprintf(&allocated, fmt, retry) < 0) {
+      allocated = nullptr;
+    }
+    msg = allocated;
   }
-  va_end(args);
+  va_end(retry);
 
   if (msg) {
     try {
       this->print(level, msg);
     } catch (...) {
     }
-    std::free(msg);
+  }
+  std::free(allocated);
+}
+
+void yolov5::Logger::setMinLevel(const LogLevel& level) noexcept {
+  _minLevel.store((int)level, std::memory_order_relaxed);
+}
+
+yolov5::LogLevel yolov5::Logger::minLevel() const noexcept {
+  return (LogLevel)_minLevel.load(std::memory_order_relaxed);
+}
+
+yolov5::AsyncLoggerOptions::AsyncLoggerOptions() noexcept
+    : capacity(1024), maxRepeats(10), repeatInterval(1.0) {}
+
+yolov5::AsyncLoggerStats::AsyncLoggerStats() noexcept
+    : printed(0), dropped(0), suppressed(0) {}
+
+yolov5::AsyncLogger::AsyncLogger() noexcept
+    : _running(false),
+      _stopping(false),
+      _producers(0),
+      _queued(0),
+      _printed(0),
+      _dropped(0),
+      _suppressed(0) {}
+
+yolov5::AsyncLogger::~AsyncLogger() { stop(); }
+
+yolov5::Result yolov5::AsyncLogger::setup(
+    const AsyncLoggerOptions& options,
+    std::shared_ptr<Logger> backend) noexcept {
+  stop();
+  if (options.capacity < 1 || options.maxRepeats < 0 ||
+      options.repeatInterval <= 0.0) {
+    Logger::print(LOGGING_ERROR,
+                  "[AsyncLogger] setup() failure: invalid options");
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+  if (!_queue.setup(options.capacity)) {
+    Logger::print(LOGGING_ERROR,
+                  "[AsyncLogger] setup() failure: could not allocate "
+                  "records");
+    return RESULT_FAILURE_ALLOC;
+  }
+  _options = options;
+  _backend = backend;
+  for (RepeatEntry& entry : _repeats) {
+    entry.hash.store(0, std::memory_order_relaxed);
+  }
+
+  _stopping = false;
+  _running = true;
+  try {
+    _thread = std::thread(&AsyncLogger::_drain, this);
+  } catch (const std::exception& e) {
+    _running = false;
+    return RESULT_FAILURE_OTHER;
+  }
+  return RESULT_SUCCESS;
+}
+
+void yolov5::AsyncLogger::print(const LogLevel& level, const char* msg) {
+  /*  Registered before checking _running, so that stop() either waits for
+      this record or this call sees that the logger has stopped  */
+  _producers.fetch_add(1);
+  if (!_running.load()) {
+    _producers.fetch_sub(1, std::memory_order_release);
+    _write(level, msg);
+    return;
+  }
+  if (!_allow(msg)) {
+    _producers.fetch_sub(1, std::memory_order_release);
+    return;
+  }
+
+  Record record;
+  record.level = (int)level;
+  size_t length = 0;
+  while (length < sizeof(record.text) - 1 && msg[length] != '\0') {
+    length += 1;
+  }
+  std::memcpy(record.text, msg, length);
+  record.text[length] = '\0';
+  if (msg[length] != '\0') {
+    std::memcpy(record.text + length - 3, "...", 3);
+  }
+
+  if (_queue.tryPush(record)) {
+    _queued.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    _dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+  _producers.fetch_sub(1, std::memory_order_release);
+}
+
+void yolov5::AsyncLogger::flush() noexcept {
+  const uint64_t target = _queued.load(std::memory_order_relaxed);
+  Backoff backoff;
+  while (_running.load(std::memory_order_acquire) &&
+         _printed.load(std::memory_order_acquire) < target) {
+    backoff.wait();
+  }
+}
+
+void yolov5::AsyncLogger::stop() noexcept {
+  if (!_running) {
+    return;
+  }
+  _stopping = true;
+  if (_thread.joinable()) {
+    _thread.join();
+  }
+  _running = false;
+
+  /*  Messages queued while the thread was finishing, including those of
+      print() calls that saw the logger running   */
+  Backoff backoff;
+  while (_producers.load(std::memory_order_acquire) != 0) {
+    backoff.wait();
+  }
+  Record record;
+  while (_queue.tryPop(&record)) {
+    _write((LogLevel)record.level, record.text);
+    _printed.fetch_add(1, std::memory_order_release);
+  }
+}
+
+yolov5::AsyncLoggerStats yolov5::AsyncLogger::stats() const noexcept {
+  AsyncLoggerStats stats;
+  stats.printed = _printed.load(std::memory_order_relaxed);
+  stats.dropped = _dropped.load(std::memory_order_relaxed);
+  stats.suppressed = _suppressed.load(std::memory_order_relaxed);
+  return stats;
+}
+
+bool yolov5::AsyncLogger::_allow(const char* msg) noexcept {
+  if (_options.maxRepeats == 0) {
+    return true;
+  }
+
+  /*  FNV-1a   */
+  uint64_t hash = 14695981039346656037ull;
+  for (const char* c = msg; *c != '\0'; ++c) {
+    hash = (hash ^ (uint8_t)*c) * 1099511628211ull;
+  }
+  hash |= 1; /*  0 marks an unused entry   */
+
+  const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now().time_since_epoch())
+                          .count();
+  const int64_t interval = (int64_t)(_options.repeatInterval * 1e9);
+
+  RepeatEntry& entry = _repeats[hash % 64];
+  if (entry.hash.load(std::memory_order_relaxed) != hash ||
+      now - entry.windowStart.load(std::memory_order_relaxed) >= interval) {
+    entry.hash.store(hash, std::memory_order_relaxed);
+    entry.windowStart.store(now, std::memory_order_relaxed);
+    entry.count.store(1, std::memory_order_relaxed);
+    return true;
+  }
+  if (entry.count.fetch_add(1, std::memory_order_relaxed) <
+      (uint32_t)_options.maxRepeats) {
+    return true;
+  }
+  _suppressed.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+void yolov5::AsyncLogger::_drain() noexcept {
+  uint64_t reportedDropped = 0;
+  uint64_t reportedSuppressed = 0;
+  int sinceReport = 0;
+  Record record;
+  while (true) {
+    const bool idle = !_queue.tryPop(&record);
+    if (!idle) {
+      _write((LogLevel)record.level, record.text);
+      _printed.fetch_add(1, std::memory_order_release);
+      sinceReport += 1;
+    }
+
+    /*  Report what was lost when idle, or periodically under load   */
+    if (idle || sinceReport >= 1024) {
+      sinceReport = 0;
+      const uint64_t dropped = _dropped.load(std::memory_order_relaxed);
+      const uint64_t suppressed =
+          _suppressed.load(std::memory_order_relaxed);
+      if (dropped != reportedDropped || suppressed != reportedSuppressed) {
+        char buffer[160];
+        std::snprintf(buffer, sizeof(buffer),
+                      "[AsyncLogger] dropped %lu messages (queue full), "
+                      "suppressed %lu repeated messages",
+                      (unsigned long)(dropped - reportedDropped),
+                      (unsigned long)(suppressed - reportedSuppressed));
+        _write(LOGGING_WARNING, buffer);
+        reportedDropped = dropped;
+        reportedSuppressed = suppressed;
+      }
+    }
+
+    if (idle) {
+      if (_stopping.load(std::memory_order_acquire)) {
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+}
+
+void yolov5::AsyncLogger::_write(const LogLevel& level,
+                                 const char* msg) noexcept {
+  try {
+    if (_backend) {
+      _backend->print(level, msg);
+    } else {
+      Logger::print(level, msg);
+    }
+  } catch (...) {
   }
 }
 
@@ -100,8 +338,19 @@ void yolov5::TensorRT_Logger::log(nvinfer1::ILogger::Severity severity,
     /*  LOGGING_DEBUG   */
   }
 
-  try {
-    _logger->logf(level, "[TensorRT] %s", msg);
-  } catch (...) {
+  if (!_logger->isEnabled(level)) {
+    return;
+  }
+
+  /*  Prefix the message without formatting it again   */
+  static const char prefix[] = "[TensorRT] ";
+  char buffer[512];
+  const size_t length = std::strlen(msg);
+  if (sizeof(prefix) + length <= sizeof(buffer)) {
+    std::memcpy(buffer, prefix, sizeof(prefix) - 1);
+    std::memcpy(buffer + sizeof(prefix) - 1, msg, length + 1);
+    _logger->log(level, buffer);
+  } else {
+    _logger->logf(level, "%s%s", prefix, msg);
   }
 }
\ No newline at end of file
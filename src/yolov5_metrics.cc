@@ -0,0 +1,525 @@
+#include "yolov5_metrics.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+namespace yolov5 {
+
+namespace {
+
+/*  Failure codes, in the order of MetricsRegistry::_errors   */
+const Result ERROR_CODES[] = {
+    RESULT_FAILURE_INVALID_INPUT,    RESULT_FAILURE_NOT_INITIALIZED,
+    RESULT_FAILURE_NOT_LOADED,       RESULT_FAILURE_MODEL_ERROR,
+    RESULT_FAILURE_OPENCV_NO_CUDA,   RESULT_FAILURE_FILESYSTEM_ERROR,
+    RESULT_FAILURE_CUDA_ERROR,       RESULT_FAILURE_TENSORRT_ERROR,
+    RESULT_FAILURE_OPENCV_ERROR,     RESULT_FAILURE_ALLOC,
+    RESULT_FAILURE_OTHER};
+
+/*  Upper bounds of the exported histogram buckets, in microseconds   */
+const uint64_t BUCKET_BOUNDS[] = {100,    250,    500,     1000,   2500,
+                                  5000,   10000,  25000,   50000,  100000,
+                                  250000, 500000, 1000000, 2500000};
+
+/*  Threads are assigned to shards round-robin, on first use   */
+int threadShard() noexcept {
+  static std::atomic<int> next(0);
+  thread_local const int shard =
+      next.fetch_add(1, std::memory_order_relaxed) % Counter::NUM_SHARDS;
+  return shard;
+}
+
+/*  Labels with another label appended, in Prometheus syntax   */
+std::string withLabel(const std::string& labels, const std::string& label) {
+  return labels.empty() ? label : labels + "," + label;
+}
+
+void appendSample(const std::string& name, const std::string& labels,
+                  const double& value, std::string* out) {
+  char buffer[64];
+  std::snprintf(buffer, sizeof(buffer), " %.10g\n", value);
+  *out += name;
+  if (!labels.empty()) {
+    *out += "{" + labels + "}";
+  }
+  *out += buffer;
+}
+
+bool sendAll(const int& fd, const char* data, size_t size) noexcept {
+  while (size > 0) {
+    const ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    size -= (size_t)n;
+  }
+  return true;
+}
+
+} /*  namespace   */
+
+Counter::Counter() noexcept {
+  for (Shard& shard : _shards) {
+    shard.value.store(0, std::memory_order_relaxed);
+  }
+}
+
+void Counter::add(const uint64_t& n) noexcept {
+  _shards[threadShard()].value.fetch_add(n, std::memory_order_relaxed);
+}
+
+uint64_t Counter::value() const noexcept {
+  uint64_t sum = 0;
+  for (const Shard& shard : _shards) {
+    sum += shard.value.load(std::memory_order_relaxed);
+  }
+  return sum;
+}
+
+Gauge::Gauge() noexcept : _value(0.0) {}
+
+void Gauge::set(const double& value) noexcept {
+  _value.store(value, std::memory_order_relaxed);
+}
+
+void Gauge::add(const double& delta) noexcept {
+  double expected = _value.load(std::memory_order_relaxed);
+  while (!_value.compare_exchange_weak(expected, expected + delta,
+                                       std::memory_order_relaxed)) {
+  }
+}
+
+double Gauge::value() const noexcept {
+  return _value.load(std::memory_order_relaxed);
+}
+
+Histogram::Histogram() noexcept
+    : _shards(new (std::nothrow) Shard[Counter::NUM_SHARDS]) {
+  if (!_shards) {
+    return;
+  }
+  for (int i = 0; i < Counter::NUM_SHARDS; ++i) {
+    for (std::atomic<uint64_t>& bucket : _shards[i].buckets) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+    _shards[i].sum.store(0, std::memory_order_relaxed);
+  }
+}
+
+void Histogram::record(const uint64_t& value) noexcept {
+  if (!_shards) {
+    return;
+  }
+  Shard& shard = _shards[threadShard()];
+  shard.buckets[LatencyHistogram::bucketIndex(value)].fetch_add(
+      1, std::memory_order_relaxed);
+  shard.sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+LatencyHistogram Histogram::snapshot() const noexcept {
+  LatencyHistogram histogram;
+  std::vector<uint64_t> counts;
+  if (bucketCounts(&counts)) {
+    for (int i = 0; i < LatencyHistogram::NUM_BUCKETS; ++i) {
+      histogram.record(LatencyHistogram::bucketValue(i), counts[i]);
+    }
+  }
+  return histogram;
+}
+
+bool Histogram::bucketCounts(std::vector<uint64_t>* out) const noexcept {
+  if (!_shards) {
+    return false;
+  }
+  try {
+    out->assign(LatencyHistogram::NUM_BUCKETS, 0);
+  } catch (const std::exception& e) {
+    return false;
+  }
+  for (int j = 0; j < Counter::NUM_SHARDS; ++j) {
+    for (int i = 0; i < LatencyHistogram::NUM_BUCKETS; ++i) {
+      (*out)[i] += _shards[j].buckets[i].load(std::memory_order_relaxed);
+    }
+  }
+  return true;
+}
+
+uint64_t Histogram::sum() const noexcept {
+  uint64_t sum = 0;
+  if (_shards) {
+    for (int j = 0; j < Counter::NUM_SHARDS; ++j) {
+      sum += _shards[j].sum.load(std::memory_order_relaxed);
+    }
+  }
+  return sum;
+}
+
+MetricsRegistry::MetricsRegistry() noexcept {
+  for (std::atomic<Counter*>& counter : _errors) {
+    counter.store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+MetricsRegistry::~MetricsRegistry() noexcept {}
+
+Counter* MetricsRegistry::counter(const std::string& name,
+                                  const std::string& help,
+                                  const std::string& labels) noexcept {
+  try {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Metric* metric = _find(METRIC_COUNTER, name, help, labels);
+    if (metric == nullptr) {
+      return nullptr;
+    }
+    if (!metric->counter) {
+      metric->counter.reset(new Counter());
+    }
+    return metric->counter.get();
+  } catch (const std::exception& e) {
+    return nullptr;
+  }
+}
+
+Gauge* MetricsRegistry::gauge(const std::string& name, const std::string& help,
+                              const std::string& labels) noexcept {
+  try {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Metric* metric = _find(METRIC_GAUGE, name, help, labels);
+    if (metric == nullptr) {
+      return nullptr;
+    }
+    if (!metric->gauge) {
+      metric->gauge.reset(new Gauge());
+    }
+    return metric->gauge.get();
+  } catch (const std::exception& e) {
+    return nullptr;
+  }
+}
+
+Result MetricsRegistry::gauge(const std::string& name, const std::string& help,
+                              const std::string& labels,
+                              const GaugeFunction& function) noexcept {
+  if (!function) {
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+  try {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Metric* metric = _find(METRIC_GAUGE_FUNCTION, name, help, labels);
+    if (metric == nullptr) {
+      return RESULT_FAILURE_INVALID_INPUT;
+    }
+    metric->function = function;
+  } catch (const std::exception& e) {
+    return RESULT_FAILURE_ALLOC;
+  }
+  return RESULT_SUCCESS;
+}
+
+Histogram* MetricsRegistry::histogram(const std::string& name,
+                                      const std::string& help,
+                                      const std::string& labels) noexcept {
+  try {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Metric* metric = _find(METRIC_HISTOGRAM, name, help, labels);
+    if (metric == nullptr) {
+      return nullptr;
+    }
+    if (!metric->histogram) {
+      metric->histogram.reset(new Histogram());
+    }
+    return metric->histogram.get();
+  } catch (const std::exception& e) {
+    return nullptr;
+  }
+}
+
+void MetricsRegistry::countResult(const Result& r) noexcept {
+  static_assert(sizeof(ERROR_CODES) / sizeof(ERROR_CODES[0]) ==
+                    NUM_ERROR_CODES,
+                "ERROR_CODES and MetricsRegistry::_errors are out of sync");
+  for (int i = 0; i < NUM_ERROR_CODES; ++i) {
+    if (ERROR_CODES[i] != r) {
+      continue;
+    }
+
+    Counter* counter = _errors[i].load(std::memory_order_acquire);
+    if (counter == nullptr) {
+      /*  e.g. "alloc error" -> result="alloc_error"   */
+      std::string label;
+      result_to_string(r, &label);
+      for (char& c : label) {
+        c = c == ' ' ? '_' : c;
+      }
+      counter = this->counter("yolov5_errors_total",
+                              "Failures, by Result code",
+                              "result=\"" + label + "\"");
+      if (counter == nullptr) {
+        return;
+      }
+      _errors[i].store(counter, std::memory_order_release);
+    }
+    counter->add();
+    return;
+  }
+}
+
+bool MetricsRegistry::toPrometheus(std::string* out) const noexcept {
+  try {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::string str;
+
+    /*  Samples of a family have to be adjacent   */
+    std::vector<bool> done(_metrics.size(), false);
+    for (size_t i = 0; i < _metrics.size(); ++i) {
+      if (done[i]) {
+        continue;
+      }
+      const Metric& family = *_metrics[i];
+      static const char* types[] = {"counter", "gauge", "gauge",
+                                    "histogram"};
+      str += "# HELP " + family.name + " " + family.help + "\n";
+      str += "# TYPE " + family.name + " " + types[family.type] + "\n";
+
+      for (size_t j = i; j < _metrics.size(); ++j) {
+        const Metric& metric = *_metrics[j];
+        if (done[j] || metric.name != family.name) {
+          continue;
+        }
+        done[j] = true;
+
+        if (metric.type == METRIC_COUNTER) {
+          appendSample(metric.name, metric.labels,
+                       (double)metric.counter->value(), &str);
+        } else if (metric.type == METRIC_GAUGE) {
+          appendSample(metric.name, metric.labels, metric.gauge->value(),
+                       &str);
+        } else if (metric.type == METRIC_GAUGE_FUNCTION) {
+          appendSample(metric.name, metric.labels, metric.function(), &str);
+        } else {
+          /*  A bucket is counted towards a bound only if all of its
+              values lie below it, so that no "le" bucket counts larger
+              samples; a bucket that straddles a bound counts towards
+              the next one   */
+          std::vector<uint64_t> counts;
+          metric.histogram->bucketCounts(&counts);
+          uint64_t cumulative = 0;
+          size_t bucket = 0;
+          for (const uint64_t& bound : BUCKET_BOUNDS) {
+            while (bucket < counts.size() &&
+                   LatencyHistogram::bucketMax(bucket) <= bound) {
+              cumulative += counts[bucket++];
+            }
+            char le[32];
+            std::snprintf(le, sizeof(le), "le=\"%g\"", bound / 1e6);
+            appendSample(metric.name + "_bucket",
+                         withLabel(metric.labels, le), (double)cumulative,
+                         &str);
+          }
+          while (bucket < counts.size()) {
+            cumulative += counts[bucket++];
+          }
+          appendSample(metric.name + "_bucket",
+                       withLabel(metric.labels, "le=\"+Inf\""),
+                       (double)cumulative, &str);
+          appendSample(metric.name + "_sum", metric.labels,
+                       metric.histogram->sum() / 1e6, &str);
+          appendSample(metric.name + "_count", metric.labels,
+                       (double)cumulative, &str);
+        }
+      }
+    }
+    *out = str;
+  } catch (const std::exception& e) {
+    return false;
+  }
+  return true;
+}
+
+MetricsRegistry::Metric* MetricsRegistry::_find(const MetricType& type,
+                                                const std::string& name,
+                                                const std::string& help,
+                                                const std::string& labels) {
+  for (const auto& metric : _metrics) {
+    if (metric->name == name) {
+      /*  A family has a single type  */
+      const bool sameType =
+          metric->type == type ||
+          (metric->type != METRIC_COUNTER && type != METRIC_COUNTER &&
+           metric->type != METRIC_HISTOGRAM && type != METRIC_HISTOGRAM);
+      if (!sameType) {
+        return nullptr;
+      }
+      if (metric->labels == labels) {
+        return metric->type == type ? metric.get() : nullptr;
+      }
+    }
+  }
+  std::unique_ptr<Metric> metric(new Metric());
+  metric->type = type;
+  metric->name = name;
+  metric->help = help;
+  metric->labels = labels;
+  _metrics.push_back(std::move(metric));
+  return _metrics.back().get();
+}
+
+MetricsServer::MetricsServer() noexcept
+    : _registry(nullptr), _fd(-1), _port(0), _stopped(true) {}
+
+MetricsServer::~MetricsServer() noexcept { stop(); }
+
+Result MetricsServer::start(MetricsRegistry* registry, const int& port,
+                            const std::string& address) noexcept {
+  stop();
+  if (registry == nullptr || port < 0 || port > 65535) {
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+
+  sockaddr_in addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons((uint16_t)port);
+  if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+    if (_logger) {
+      _logger->logf(LOGGING_ERROR,
+                    "[MetricsServer] start() failure: invalid address %s",
+                    address.c_str());
+    }
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+
+  const int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return RESULT_FAILURE_OTHER;
+  }
+  const int yes = 1;
+  ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+  if (::bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 ||
+      ::listen(fd, 8) != 0) {
+    if (_logger) {
+      _logger->logf(LOGGING_ERROR,
+                    "[MetricsServer] start() failure: could not listen on "
+                    "%s:%i: %s",
+                    address.c_str(), port, std::strerror(errno));
+    }
+    ::close(fd);
+    return RESULT_FAILURE_OTHER;
+  }
+
+  socklen_t length = sizeof(addr);
+  ::getsockname(fd, (sockaddr*)&addr, &length);
+  _port = ntohs(addr.sin_port);
+  _fd = fd;
+  _registry = registry;
+  _stopped = false;
+  try {
+    _thread = std::thread(&MetricsServer::_serve, this);
+  } catch (const std::exception& e) {
+    ::close(_fd);
+    _fd = -1;
+    _port = 0;
+    _stopped = true;
+    return RESULT_FAILURE_OTHER;
+  }
+  return RESULT_SUCCESS;
+}
+
+void MetricsServer::stop() noexcept {
+  _stopped = true;
+  if (_thread.joinable()) {
+    _thread.join();
+  }
+  if (_fd >= 0) {
+    ::close(_fd);
+    _fd = -1;
+  }
+  _port = 0;
+}
+
+int MetricsServer::port() const noexcept { return _port; }
+
+void MetricsServer::setLogger(std::shared_ptr<Logger> logger) noexcept {
+  _logger = logger;
+}
+
+void MetricsServer::_serve() noexcept {
+  while (!_stopped) {
+    /*  Wake up regularly to notice stop()  */
+    pollfd pfd;
+    pfd.fd = _fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (::poll(&pfd, 1, 100) <= 0) {
+      continue;
+    }
+    const int client = ::accept4(_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client < 0) {
+      continue;
+    }
+    _handle(client);
+    ::close(client);
+  }
+}
+
+void MetricsServer::_handle(const int& fd) noexcept {
+  timeval timeout;
+  timeout.tv_sec = 1;
+  timeout.tv_usec = 0;
+  ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  /*  Only the request line matters; read until the end of the headers  */
+  char request[2048];
+  size_t size = 0;
+  while (size < sizeof(request) - 1) {
+    const ssize_t n = ::recv(fd, request + size, sizeof(request) - 1 - size, 0);
+    if (n <= 0) {
+      break;
+    }
+    size += (size_t)n;
+    request[size] = '\0';
+    if (std::strstr(request, "\r\n\r\n") != nullptr) {
+      break;
+    }
+  }
+  request[size] = '\0';
+
+  std::string body;
+  const char* status = "200 OK";
+  if (std::strncmp(request, "GET /metrics ", 13) == 0 ||
+      std::strncmp(request, "GET /metrics?", 13) == 0) {
+    if (!_registry->toPrometheus(&body)) {
+      status = "500 Internal Server Error";
+      body.clear();
+    }
+  } else if (std::strncmp(request, "GET ", 4) == 0) {
+    status = "404 Not Found";
+  } else {
+    status = "405 Method Not Allowed";
+  }
+
+  char header[256];
+  std::snprintf(header, sizeof(header),
+                "HTTP/1.1 %s\r\n"
+                "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                "Content-Length: %lu\r\n"
+                "Connection: close\r\n\r\n",
+                status, (unsigned long)body.size());
+  if (sendAll(fd, header, std::strlen(header))) {
+    sendAll(fd, body.data(), body.size());
+  }
+}
+
+} /*  namespace yolov5    */
\ No newline at end of file
@@ -0,0 +1,254 @@
+#include "yolov5_mosaic.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace yolov5 {
+
+RegionTransform::RegionTransform() noexcept {}
+
+RegionTransform::RegionTransform(const cv::Size& imageSize, const double& f,
+                                 const cv::Rect& region) noexcept
+    : internal::PreprocessorTransform(imageSize, f, region.x, region.y),
+      _region(region) {}
+
+RegionTransform::~RegionTransform() noexcept {}
+
+const cv::Rect& RegionTransform::region() const noexcept { return _region; }
+
+bool RegionTransform::contains(const cv::Rect& box) const noexcept {
+  const int cx = box.x + box.width / 2;
+  const int cy = box.y + box.height / 2;
+  return cx >= _region.x && cx < _region.x + _region.width &&
+         cy >= _region.y && cy < _region.y + _region.height;
+}
+
+MosaicOptions::MosaicOptions() noexcept : margin(8) {}
+
+MosaicStats::MosaicStats() noexcept
+    : images(0), canvases(0), imagePixels(0.0), canvasPixels(0.0) {}
+
+double MosaicStats::efficiency() const noexcept {
+  if (canvasPixels <= 0.0) {
+    return 0.0;
+  }
+  return imagePixels / canvasPixels;
+}
+
+MosaicDetector::MosaicDetector() noexcept : _detector(nullptr), _flags(0) {}
+
+MosaicDetector::~MosaicDetector() noexcept {}
+
+Result MosaicDetector::setup(Detector* detector, const MosaicOptions& options,
+                             const int& flags) noexcept {
+  if (detector == nullptr || !detector->isEngineLoaded()) {
+    return RESULT_FAILURE_NOT_LOADED;
+  }
+  _logger = detector->logger();
+  if (options.margin < 0) {
+    _logger->log(LOGGING_ERROR,
+                 "[MosaicDetector] setup() failure: invalid margin");
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+
+  _detector = detector;
+  _options = options;
+  _flags = flags;
+  resetStats();
+  return RESULT_SUCCESS;
+}
+
+Result MosaicDetector::detect(
+    const std::vector<cv::Mat>& images,
+    std::vector<std::vector<Detection>>* out) noexcept {
+  if (_detector == nullptr) {
+    return RESULT_FAILURE_NOT_INITIALIZED;
+  }
+  if (out == nullptr) {
+    _logger->log(LOGGING_ERROR,
+                 "[MosaicDetector] detect() failure: invalid output");
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+  for (const cv::Mat& image : images) {
+    if (image.empty() || image.type() != CV_8UC3) {
+      _logger->log(LOGGING_ERROR,
+                   "[MosaicDetector] detect() failure: expected non-empty "
+                   "8-bit, 3-channel images");
+      return RESULT_FAILURE_INVALID_INPUT;
+    }
+  }
+
+  const cv::Size canvasSize = _detector->inferenceSize();
+  const int batchSize = _detector->batchSize();
+  if (canvasSize.area() == 0 || batchSize < 1) {
+    return RESULT_FAILURE_NOT_LOADED;
+  }
+
+  int numCanvases = 0;
+  try {
+    out->resize(images.size());
+    for (auto& detections : *out) {
+      detections.clear();
+    }
+    numCanvases = _pack(images, canvasSize);
+
+    _canvases.resize(batchSize);
+    for (cv::Mat& canvas : _canvases) {
+      canvas.create(canvasSize, CV_8UC3);
+    }
+  } catch (const std::exception& e) {
+    _logger->logf(LOGGING_ERROR,
+                  "[MosaicDetector] detect() failure: got exception: %s",
+                  e.what());
+    return RESULT_FAILURE_ALLOC;
+  }
+
+  for (int first = 0; first < numCanvases; first += batchSize) {
+    const int count = std::min(batchSize, numCanvases - first);
+    const Result r = _detectCanvases(images, first, count, out);
+    if (r != RESULT_SUCCESS) {
+      return r;
+    }
+  }
+
+  _stats.images += images.size();
+  _stats.canvases += numCanvases;
+  _stats.canvasPixels += (double)numCanvases * canvasSize.area();
+  for (const Placement& placement : _placements) {
+    _stats.imagePixels += placement.transform.region().area();
+  }
+  return RESULT_SUCCESS;
+}
+
+MosaicStats MosaicDetector::stats() const noexcept { return _stats; }
+
+void MosaicDetector::resetStats() noexcept { _stats = MosaicStats(); }
+
+int MosaicDetector::_pack(const std::vector<cv::Mat>& images,
+                          const cv::Size& canvasSize) {
+  const int margin = _options.margin;
+
+  /*  First-fit decreasing height: the tallest images open the shelves  */
+  _order.resize(images.size());
+  for (size_t i = 0; i < images.size(); ++i) {
+    _order[i] = (int)i;
+  }
+  std::sort(_order.begin(), _order.end(),
+            [&images](const int& lhs, const int& rhs) {
+              return images[lhs].rows > images[rhs].rows;
+            });
+
+  _placements.resize(images.size());
+  _shelves.clear();
+  _canvasHeights.clear();
+  for (const int& index : _order) {
+    const cv::Size imageSize = images[index].size();
+
+    /*  Images larger than a canvas are downscaled to fit  */
+    const double f = std::min({1.0,
+                               (double)canvasSize.width / imageSize.width,
+                               (double)canvasSize.height / imageSize.height});
+    const cv::Size size(std::max(1, (int)std::floor(imageSize.width * f)),
+                        std::max(1, (int)std::floor(imageSize.height * f)));
+
+    Shelf* shelf = nullptr;
+    for (Shelf& candidate : _shelves) {
+      if (candidate.height >= size.height &&
+          candidate.width + size.width <= canvasSize.width) {
+        shelf = &candidate;
+        break;
+      }
+    }
+    if (shelf == nullptr) {
+      /*  Open a shelf on the first canvas with enough height left   */
+      int canvas = 0;
+      while (canvas < (int)_canvasHeights.size() &&
+             _canvasHeights[canvas] + size.height > canvasSize.height) {
+        ++canvas;
+      }
+      if (canvas == (int)_canvasHeights.size()) {
+        _canvasHeights.push_back(0);
+      }
+      Shelf newShelf;
+      newShelf.canvas = canvas;
+      newShelf.y = _canvasHeights[canvas];
+      newShelf.height = size.height;
+      newShelf.width = 0;
+      _canvasHeights[canvas] += size.height + margin;
+      _shelves.push_back(newShelf);
+      shelf = &_shelves.back();
+    }
+
+    const cv::Rect region(shelf->width, shelf->y, size.width, size.height);
+    shelf->width += size.width + margin;
+    _placements[index].canvas = shelf->canvas;
+    _placements[index].transform = RegionTransform(imageSize, f, region);
+  }
+  return (int)_canvasHeights.size();
+}
+
+Result MosaicDetector::_detectCanvases(
+    const std::vector<cv::Mat>& images, const int& first, const int& count,
+    std::vector<std::vector<Detection>>* out) {
+  /*  Render the canvases; the margins and unused space stay black, as
+      with letterboxing  */
+  try {
+    for (int i = 0; i < count; ++i) {
+      _canvases[i].setTo(cv::Scalar(0, 0, 0));
+    }
+    for (size_t i = 0; i < images.size(); ++i) {
+      const Placement& placement = _placements[i];
+      if (placement.canvas < first || placement.canvas >= first + count) {
+        continue;
+      }
+      const cv::Rect& region = placement.transform.region();
+      cv::Mat target = _canvases[placement.canvas - first](region);
+      if (region.size() == images[i].size()) {
+        images[i].copyTo(target);
+      } else {
+        cv::resize(images[i], target, region.size(), 0, 0, cv::INTER_AREA);
+      }
+    }
+  } catch (const std::exception& e) {
+    _logger->logf(LOGGING_ERROR,
+                  "[MosaicDetector] detect() failure: could not render "
+                  "canvas: %s",
+                  e.what());
+    return RESULT_FAILURE_OPENCV_ERROR;
+  }
+
+  std::vector<cv::Mat> canvases(_canvases.begin(), _canvases.begin() + count);
+  const Result r = _detector->detectBatch(canvases, &_results, _flags);
+  if (r != RESULT_SUCCESS) {
+    return r;
+  }
+
+  /*  Assign every detection to the image in whose region it lies  */
+  try {
+    for (size_t i = 0; i < images.size(); ++i) {
+      const Placement& placement = _placements[i];
+      if (placement.canvas < first || placement.canvas >= first + count) {
+        continue;
+      }
+      const RegionTransform& transform = placement.transform;
+      for (const Detection& detection :
+           _results[placement.canvas - first]) {
+        if (!transform.contains(detection.boundingBox())) {
+          continue;
+        }
+        Detection mapped = detection;
+        mapped.setBoundingBox(transform.transformBbox(
+            detection.boundingBox() & transform.region()));
+        (*out)[i].push_back(std::move(mapped));
+      }
+    }
+  } catch (const std::exception& e) {
+    _logger->logf(LOGGING_ERROR,
+                  "[MosaicDetector] detect() failure: got exception: %s",
+                  e.what());
+    return RESULT_FAILURE_ALLOC;
+  }
+  return RESULT_SUCCESS;
+}
+
+} /*  namespace yolov5    */
\ No newline at end of file
@@ -0,0 +1,210 @@
+#include "yolov5_motion.h"
+
+#include <algorithm>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+namespace yolov5 {
+
+namespace {
+
+/*  Number of pixels that differ by at least threshold (1-255)  */
+int countChanged(const uint8_t* a, const uint8_t* b, const int& n,
+                 const int& threshold) noexcept {
+  int count = 0;
+  int i = 0;
+#if defined(__SSE2__)
+  const __m128i limit = _mm_set1_epi8((char)(threshold - 1));
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= n; i += 16) {
+    const __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+    const __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+    const __m128i diff =
+        _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+    /*  diff >= threshold <=> diff - (threshold - 1) > 0   */
+    const __m128i unchanged =
+        _mm_cmpeq_epi8(_mm_subs_epu8(diff, limit), zero);
+    count += 16 - __builtin_popcount(_mm_movemask_epi8(unchanged));
+  }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  const uint8x16_t limit = vdupq_n_u8((uint8_t)threshold);
+  uint32x4_t sum = vdupq_n_u32(0);
+  while (i + 16 <= n) {
+    /*  uint16 lanes gain at most 2 per iteration, flush before overflow */
+    const int end = std::min(n - 15, i + 16 * 4096);
+    uint16x8_t partial = vdupq_n_u16(0);
+    for (; i < end; i += 16) {
+      const uint8x16_t diff = vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+      partial = vpadalq_u8(partial, vshrq_n_u8(vcgeq_u8(diff, limit), 7));
+    }
+    sum = vpadalq_u16(sum, partial);
+  }
+  const uint64x2_t total = vpaddlq_u32(sum);
+  count = (int)(vgetq_lane_u64(total, 0) + vgetq_lane_u64(total, 1));
+#endif
+  for (; i < n; ++i) {
+    const int diff = (int)a[i] - (int)b[i];
+    if (diff >= threshold || -diff >= threshold) {
+      count += 1;
+    }
+  }
+  return count;
+}
+
+} /*  namespace   */
+
+MotionGateOptions::MotionGateOptions() noexcept
+    : thumbnailSize(64, 36),
+      pixelThreshold(16),
+      changeThreshold(0.01),
+      refreshInterval(30) {}
+
+MotionGateStats::MotionGateStats() noexcept : frames(0), skipped(0) {}
+
+double MotionGateStats::skipRatio() const noexcept {
+  if (frames == 0) {
+    return 0.0;
+  }
+  return (double)skipped / frames;
+}
+
+MotionGate::MotionGate() noexcept
+    : _hasReference(false),
+      _framesSinceDetection(0),
+      _lastScore(0.0),
+      _statsFrames(0),
+      _statsSkipped(0) {}
+
+MotionGate::~MotionGate() noexcept {}
+
+Result MotionGate::setup(const MotionGateOptions& options) noexcept {
+  if (options.thumbnailSize.width <= 0 || options.thumbnailSize.height <= 0 ||
+      options.pixelThreshold < 1 || options.pixelThreshold > 255 ||
+      options.changeThreshold < 0.0 || options.refreshInterval < 1) {
+    if (_logger) {
+      _logger->log(LOGGING_ERROR,
+                   "[MotionGate] setup() failure: invalid options");
+    }
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+
+  const size_t size =
+      (size_t)options.thumbnailSize.width * options.thumbnailSize.height;
+  try {
+    _current.resize(size);
+    _reference.resize(size);
+  } catch (const std::exception& e) {
+    if (_logger) {
+      _logger->logf(LOGGING_ERROR,
+                    "[MotionGate] setup() failure: got exception: %s",
+                    e.what());
+    }
+    return RESULT_FAILURE_ALLOC;
+  }
+  _options = options;
+  reset();
+  _statsFrames = 0;
+  _statsSkipped = 0;
+  return RESULT_SUCCESS;
+}
+
+Result MotionGate::check(const cv::Mat& image, bool* detect) noexcept {
+  if (detect == nullptr) {
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+  if (_current.empty()) {
+    if (_logger) {
+      _logger->log(LOGGING_ERROR,
+                   "[MotionGate] check() failure: not set up");
+    }
+    return RESULT_FAILURE_NOT_INITIALIZED;
+  }
+  if (image.empty() || image.depth() != CV_8U ||
+      (image.channels() != 1 && image.channels() != 3)) {
+    if (_logger) {
+      _logger->log(LOGGING_ERROR,
+                   "[MotionGate] check() failure: expected an 8-bit BGR "
+                   "or grayscale image");
+    }
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+
+  _thumbnail(image, _current.data());
+  const int n = (int)_current.size();
+  _lastScore = _hasReference
+                   ? (double)countChanged(_current.data(), _reference.data(),
+                                          n, _options.pixelThreshold) /
+                         n
+                   : 1.0;
+
+  *detect = !_hasReference || _lastScore >= _options.changeThreshold ||
+            _framesSinceDetection + 1 >= _options.refreshInterval;
+  if (*detect) {
+    std::swap(_current, _reference);
+    _hasReference = true;
+    _framesSinceDetection = 0;
+  } else {
+    _framesSinceDetection += 1;
+    _statsSkipped += 1;
+  }
+  _statsFrames += 1;
+  return RESULT_SUCCESS;
+}
+
+double MotionGate::lastScore() const noexcept { return _lastScore; }
+
+MotionGateStats MotionGate::stats() const noexcept {
+  MotionGateStats stats;
+  stats.frames = _statsFrames;
+  stats.skipped = _statsSkipped;
+  return stats;
+}
+
+void MotionGate::reset() noexcept {
+  _hasReference = false;
+  _framesSinceDetection = 0;
+  _lastScore = 0.0;
+}
+
+void MotionGate::setLogger(std::shared_ptr<Logger> logger) noexcept {
+  _logger = logger;
+}
+
+void MotionGate::_thumbnail(const cv::Mat& image, uint8_t* out) const
+    noexcept {
+  /*  Every thumbnail pixel is the mean of 2x2 samples in its cell, so
+      only 4 image pixels are read per thumbnail pixel  */
+  const int width = _options.thumbnailSize.width;
+  const int height = _options.thumbnailSize.height;
+  const int channels = image.channels();
+  for (int ty = 0; ty < height; ++ty) {
+    const uint8_t* rows[2] = {
+        image.ptr<uint8_t>((int)(((4 * ty + 1) * (int64_t)image.rows) /
+                                 (4 * height))),
+        image.ptr<uint8_t>((int)(((4 * ty + 3) * (int64_t)image.rows) /
+                                 (4 * height)))};
+    for (int tx = 0; tx < width; ++tx) {
+      const int x0 = (int)(((4 * tx + 1) * (int64_t)image.cols) / (4 * width));
+      const int x1 = (int)(((4 * tx + 3) * (int64_t)image.cols) / (4 * width));
+      int sum = 0;
+      for (const uint8_t* row : rows) {
+        if (channels == 3) {
+          /*  Luma approximation: (B + 2G + R) / 4   */
+          const uint8_t* p0 = row + 3 * x0;
+          const uint8_t* p1 = row + 3 * x1;
+          sum += (p0[0] + 2 * p0[1] + p0[2] + p1[0] + 2 * p1[1] + p1[2]) / 4;
+        } else {
+          sum += row[x0] + row[x1];
+        }
+      }
+      out[ty * width + tx] = (uint8_t)((sum + 2) / 4);
+    }
+  }
+}
+
+} /*  namespace yolov5    */
\ No newline at end of file
@@ -0,0 +1,748 @@
+#include "yolov5_multistream.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace yolov5 {
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double millisecondsSince(const Clock::time_point& start) noexcept {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+Clock::duration fromMilliseconds(const double& ms) noexcept {
+  return std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double, std::milli>(ms));
+}
+
+} /*  namespace   */
+
+const char* shedding_policy_to_string(const SheddingPolicy& policy) noexcept {
+  switch (policy) {
+    case SHED_NONE:
+      return "none";
+    case SHED_DROP_OLDEST:
+      return "drop-oldest";
+    case SHED_DECIMATE:
+      return "decimate";
+    case SHED_LOWER_RESOLUTION:
+      return "lower-resolution";
+    default:
+      return "unknown";
+  }
+}
+
+StreamFrame::StreamFrame() noexcept : streamId(-1), id(0) {}
+
+StreamOptions::StreamOptions() noexcept
+    : live(true),
+      queueCapacity(2),
+      latencyBudget(100.0),
+      priority(0),
+      shedding(SHED_NONE),
+      decimation(2) {}
+
+StreamStats::StreamStats() noexcept
+    : streamId(-1),
+      captured(0),
+      processed(0),
+      dropped(0),
+      shed(0),
+      downscaled(0),
+      missed(0),
+      fps(0.0) {}
+
+MultiStreamRunner::Stream::Stream() noexcept
+    : id(-1),
+      done(false),
+      captured(0),
+      dropped(0),
+      processed(0),
+      shed(0),
+      downscaled(0),
+      missed(0),
+      overloaded(false),
+      processedMetric(nullptr),
+      droppedMetric(nullptr),
+      shedMetric(nullptr),
+      missedMetric(nullptr),
+      latencyMetric(nullptr) {}
+
+MultiStreamRunner::MultiStreamRunner() noexcept
+    : _detector(nullptr),
+      _fairness(FAIRNESS_ROUND_ROBIN),
+      _maxBatchDelay(0.0),
+      _flags(0),
+      _metrics(nullptr),
+      _batchTime(nullptr),
+      _nextStream(0),
+      _running(false),
+      _stopped(false),
+      _runTime(0.0),
+      _batchDeadline(Clock::time_point::max()) {}
+
+MultiStreamRunner::~MultiStreamRunner() noexcept {}
+
+Result MultiStreamRunner::setup(Detector* detector,
+                                const StreamFairness& fairness,
+                                const double& maxBatchDelay,
+                                const int& flags) noexcept {
+  if (detector == nullptr || !detector->isEngineLoaded()) {
+    return RESULT_FAILURE_NOT_LOADED;
+  }
+  _logger = detector->logger();
+  if (_running) {
+    _logger->log(LOGGING_ERROR,
+                 "[MultiStreamRunner] setup() failure: runner is running");
+    return RESULT_FAILURE_OTHER;
+  }
+  if (maxBatchDelay < 0.0) {
+    _logger->log(LOGGING_ERROR,
+                 "[MultiStreamRunner] setup() failure: invalid maximum "
+                 "batch delay");
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+
+  _detector = detector;
+  _fairness = fairness;
+  _maxBatchDelay = maxBatchDelay;
+  _flags = flags;
+  return RESULT_SUCCESS;
+}
+
+int MultiStreamRunner::addStream(const Source& source, const Sink& sink,
+                                 const StreamOptions& options) noexcept {
+  if (_detector == nullptr) {
+    return -1;
+  }
+  if (_running) {
+    _logger->log(LOGGING_ERROR,
+                 "[MultiStreamRunner] addStream() failure: runner is "
+                 "running");
+    return -1;
+  }
+  if (options.queueCapacity < 1) {
+    _logger->log(LOGGING_ERROR,
+                 "[MultiStreamRunner] addStream() failure: queue capacity "
+                 "should be at least 1");
+    return -1;
+  }
+  if (options.latencyBudget <= 0.0 || options.decimation < 1) {
+    _logger->log(LOGGING_ERROR,
+                 "[MultiStreamRunner] addStream() failure: invalid latency "
+                 "budget or decimation");
+    return -1;
+  }
+
+  /*  Frames may be queued, part of the batch being processed, or being
+      decoded   */
+  const int numFrames =
+      options.queueCapacity + _detector->batchSize() + 1;
+  try {
+    std::unique_ptr<Stream> stream(new Stream());
+    stream->id = (int)_streams.size();
+    stream->source = source;
+    stream->sink = sink;
+    stream->options = options;
+    for (int i = 0; i < numFrames; ++i) {
+      stream->frames.emplace_back(new StreamFrame());
+      stream->frames.back()->streamId = stream->id;
+    }
+    if (!stream->queue.setup(options.queueCapacity) ||
+        !stream->free.setup(numFrames)) {
+      _logger->log(LOGGING_ERROR,
+                   "[MultiStreamRunner] addStream() failure: could not set "
+                   "up queues");
+      return -1;
+    }
+    _streams.push_back(std::move(stream));
+  } catch (const std::exception& e) {
+    _logger->logf(LOGGING_ERROR,
+                  "[MultiStreamRunner] addStream() failure: got "
+                  "exception: %s",
+                  e.what());
+    return -1;
+  }
+  return (int)_streams.size() - 1;
+}
+
+int MultiStreamRunner::numStreams() const noexcept {
+  return (int)_streams.size();
+}
+
+Result MultiStreamRunner::run() noexcept {
+  if (_detector == nullptr) {
+    return RESULT_FAILURE_NOT_INITIALIZED;
+  }
+  if (_streams.empty()) {
+    _logger->log(LOGGING_ERROR,
+                 "[MultiStreamRunner] run() failure: no streams added");
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+  const int batchSize = _detector->batchSize();
+  if (batchSize < 1) {
+    return RESULT_FAILURE_NOT_LOADED;
+  }
+  for (const auto& stream : _streams) {
+    if (stream->options.shedding == SHED_LOWER_RESOLUTION &&
+        _detector->inferenceSizes().size() < 2) {
+      _logger->logf(LOGGING_WARNING,
+                    "[MultiStreamRunner] run(): stream %i sheds by lowering "
+                    "the resolution, but the detector has no smaller "
+                    "inference size to choose from",
+                    stream->id);
+    }
+  }
+
+  /*  Reset the streams; all frames start out free   */
+  for (auto& stream : _streams) {
+    stream->queue.setup(stream->options.queueCapacity);
+    stream->free.setup((int)stream->frames.size());
+    for (auto& frame : stream->frames) {
+      stream->free.tryPush(frame.get());
+    }
+    stream->done = false;
+    stream->captured = 0;
+    stream->dropped = 0;
+    stream->processed = 0;
+    stream->shed = 0;
+    stream->downscaled = 0;
+    stream->missed = 0;
+    stream->overloaded = false;
+    stream->latency.reset();
+  }
+  _nextStream = 0;
+  _batchDeadline = Clock::time_point::max();
+  const Result metricsResult = _registerMetrics();
+  if (metricsResult != RESULT_SUCCESS) {
+    return metricsResult;
+  }
+  _stopped = false;
+  _running = true;
+
+  std::vector<StreamFrame*> batch;
+  try {
+    batch.reserve(batchSize);
+    _images.reserve(batchSize);
+    _serviceTimes.assign(batchSize + 1, 0.0);
+  } catch (const std::exception& e) {
+    _logger->logf(LOGGING_ERROR,
+                  "[MultiStreamRunner] run() failure: got exception: %s",
+                  e.what());
+    _running = false;
+    return RESULT_FAILURE_ALLOC;
+  }
+
+  const Clock::time_point startTime = Clock::now();
+  Result result = RESULT_SUCCESS;
+  for (auto& stream : _streams) {
+    try {
+      stream->thread = std::thread(&MultiStreamRunner::_decode, this,
+                                   stream.get());
+    } catch (const std::exception& e) {
+      _logger->logf(LOGGING_ERROR,
+                    "[MultiStreamRunner] run() failure: could not start "
+                    "decode thread: %s",
+                    e.what());
+      result = RESULT_FAILURE_OTHER;
+      _stopped = true;
+      break;
+    }
+  }
+
+  Backoff backoff;
+  while (!_stopped) {
+    _gather(&batch, batchSize);
+    if (batch.empty()) {
+      if (_allDone()) {
+        break;
+      }
+      backoff.wait();
+      continue;
+    }
+    backoff.reset();
+
+    /*  Give the other streams a moment to fill up the batch, as long as
+        that does not make the batch miss its deadline  */
+    const Clock::time_point batchStart = Clock::now();
+    while ((int)batch.size() < batchSize && !_stopped && !_allDone() &&
+           millisecondsSince(batchStart) < _maxBatchDelay &&
+           _fits((int)batch.size() + 1, _batchDeadline)) {
+      const size_t size = batch.size();
+      _gather(&batch, batchSize);
+      if (batch.size() == size) {
+        std::this_thread::yield();
+      }
+    }
+
+    const Clock::time_point processStart = Clock::now();
+    const Result r = _process(&batch);
+    if (_batchTime != nullptr) {
+      _batchTime->record(
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              Clock::now() - processStart)
+              .count());
+    }
+    if (r != RESULT_SUCCESS) {
+      if (_metrics != nullptr) {
+        _metrics->countResult(r);
+      }
+      result = r;
+      _stopped = true;
+    }
+  }
+
+  _stopped = true;
+  for (auto& stream : _streams) {
+    if (stream->thread.joinable()) {
+      stream->thread.join();
+    }
+  }
+  _runTime = std::chrono::duration<double>(Clock::now() - startTime).count();
+  _running = false;
+  return result;
+}
+
+void MultiStreamRunner::stop() noexcept { _stopped = true; }
+
+Result MultiStreamRunner::setMetrics(MetricsRegistry* registry) noexcept {
+  if (_running) {
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+  _metrics = registry;
+  return RESULT_SUCCESS;
+}
+
+Result MultiStreamRunner::_registerMetrics() noexcept {
+  _batchTime = nullptr;
+  for (auto& stream : _streams) {
+    stream->processedMetric = nullptr;
+    stream->droppedMetric = nullptr;
+    stream->shedMetric = nullptr;
+    stream->missedMetric = nullptr;
+    stream->latencyMetric = nullptr;
+  }
+  if (_metrics == nullptr) {
+    return RESULT_SUCCESS;
+  }
+
+  bool ok = true;
+  try {
+    _batchTime = _metrics->histogram("yolov5_batch_seconds",
+                                     "Duration of a batch, including "
+                                     "pre- and post-processing");
+    ok = _batchTime != nullptr;
+    for (auto& stream : _streams) {
+      const std::string label =
+          "stream=\"" + std::to_string(stream->id) + "\"";
+      stream->processedMetric = _metrics->counter(
+          "yolov5_frames_total", "Frames that reached the sink", label);
+      stream->droppedMetric = _metrics->counter(
+          "yolov5_dropped_frames_total",
+          "Frames dropped because the queue of the stream was full", label);
+      stream->shedMetric = _metrics->counter(
+          "yolov5_shed_frames_total",
+          "Frames shed by the scheduler when overloaded", label);
+      stream->missedMetric = _metrics->counter(
+          "yolov5_late_frames_total",
+          "Frames delivered after their deadline", label);
+      stream->latencyMetric = _metrics->histogram(
+          "yolov5_latency_seconds", "Latency from capture to result", label);
+      ok = ok && stream->processedMetric != nullptr &&
+           stream->droppedMetric != nullptr &&
+           stream->shedMetric != nullptr &&
+           stream->missedMetric != nullptr &&
+           stream->latencyMetric != nullptr;
+    }
+  } catch (const std::exception& e) {
+    ok = false;
+  }
+  if (!ok) {
+    _logger->log(LOGGING_ERROR,
+                 "[MultiStreamRunner] run() failure: could not register "
+                 "metrics");
+    return RESULT_FAILURE_ALLOC;
+  }
+  return RESULT_SUCCESS;
+}
+
+std::vector<StreamStats> MultiStreamRunner::stats() const noexcept {
+  std::vector<StreamStats> lst;
+  try {
+    for (const auto& stream : _streams) {
+      StreamStats stats;
+      stats.streamId = stream->id;
+      stats.captured = stream->captured;
+      stats.processed = stream->processed;
+      stats.dropped = stream->dropped;
+      stats.shed = stream->shed;
+      stats.downscaled = stream->downscaled;
+      stats.missed = stream->missed;
+      stats.fps = _runTime > 0.0 ? stream->processed / _runTime : 0.0;
+      stats.latency = stream->latency;
+      lst.push_back(stats);
+    }
+  } catch (const std::exception& e) {
+    return std::vector<StreamStats>();
+  }
+  return lst;
+}
+
+bool MultiStreamRunner::statsToString(std::string* out) const noexcept {
+  const std::vector<StreamStats> lst = stats();
+  try {
+    uint64_t processed = 0;
+    std::string str;
+    char buffer[512];
+    for (const StreamStats& stats : lst) {
+      std::string latency;
+      stats.latency.toString(&latency);
+      std::snprintf(buffer, sizeof(buffer),
+                    "  stream %2i: %7.1f FPS, %8lu captured, %8lu "
+                    "processed, %8lu dropped, %8lu shed, %8lu downscaled, "
+                    "%8lu late, latency %s\n",
+                    stats.streamId, stats.fps, (unsigned long)stats.captured,
+                    (unsigned long)stats.processed,
+                    (unsigned long)stats.dropped, (unsigned long)stats.shed,
+                    (unsigned long)stats.downscaled,
+                    (unsigned long)stats.missed, latency.c_str());
+      str += buffer;
+      processed += stats.processed;
+    }
+    std::snprintf(buffer, sizeof(buffer),
+                  "Multi-stream: %i streams, %lu frames in %.2f s "
+                  "(%.1f FPS)\n",
+                  (int)lst.size(), (unsigned long)processed, _runTime,
+                  _runTime > 0.0 ? processed / _runTime : 0.0);
+    *out = buffer + str;
+  } catch (const std::exception& e) {
+    return false;
+  }
+  return true;
+}
+
+void MultiStreamRunner::_decode(Stream* stream) noexcept {
+  uint64_t id = 0;
+  StreamFrame* frame = nullptr;
+  cv::Mat scratch;
+  Backoff backoff;
+  while (!_stopped) {
+    if (frame == nullptr && !stream->free.tryPop(&frame)) {
+      frame = nullptr;
+      if (!stream->options.live) {
+        backoff.wait();
+        continue;
+      }
+    }
+
+    /*  Live sources keep being read, even if there is no frame to decode
+        into: the frame is dropped   */
+    cv::Mat* image = frame != nullptr ? &frame->image : &scratch;
+    bool ok = false;
+    try {
+      ok = stream->source(image);
+    } catch (const std::exception& e) {
+      _logger->logf(LOGGING_ERROR,
+                    "[MultiStreamRunner] stream %i failure: got "
+                    "exception: %s",
+                    stream->id, e.what());
+    }
+    if (!ok) {
+      break;
+    }
+    stream->captured += 1;
+    if (frame == nullptr) {
+      stream->dropped += 1;
+      if (stream->droppedMetric != nullptr) {
+        stream->droppedMetric->add();
+      }
+      continue;
+    }
+
+    frame->id = id++;
+    frame->captureTime = Clock::now();
+    frame->deadline =
+        frame->captureTime +
+        std::chrono::microseconds(
+            (int64_t)(stream->options.latencyBudget * 1000.0));
+
+    /*  If the queue of a live stream is full, the frame is dropped and
+        its buffer is reused for the next read  */
+    bool queued = stream->queue.tryPush(frame);
+    backoff.reset();
+    while (!queued && !stream->options.live && !_stopped) {
+      backoff.wait();
+      queued = stream->queue.tryPush(frame);
+    }
+    if (queued) {
+      frame = nullptr;
+    } else {
+      stream->dropped += 1;
+      if (stream->droppedMetric != nullptr) {
+        stream->droppedMetric->add();
+      }
+    }
+  }
+  stream->done = true;
+}
+
+void MultiStreamRunner::_gather(std::vector<StreamFrame*>* batch,
+                                const int& batchSize) noexcept {
+  const int numStreams = (int)_streams.size();
+
+  int queued = (int)batch->size();
+  for (const auto& stream : _streams) {
+    queued += (int)stream->queue.size();
+  }
+  _shed(std::min(queued, batchSize));
+
+  if (_fairness == FAIRNESS_DEADLINE) {
+    while ((int)batch->size() < batchSize) {
+      Stream* best = nullptr;
+      StreamFrame* bestFrame = nullptr;
+      for (auto& stream : _streams) {
+        StreamFrame* frame = nullptr;
+        if (!stream->queue.tryPeek(&frame)) {
+          continue;
+        }
+        if (best == nullptr ||
+            stream->options.priority > best->options.priority ||
+            (stream->options.priority == best->options.priority &&
+             frame->deadline < bestFrame->deadline)) {
+          best = stream.get();
+          bestFrame = frame;
+        }
+      }
+      if (best == nullptr) {
+        break;
+      }
+
+      /*  Adding a frame makes the batch slower; do not add frames that
+          would make the batch miss its deadline  */
+      const Clock::time_point deadline =
+          best->options.shedding != SHED_NONE
+              ? std::min(_batchDeadline, bestFrame->deadline)
+              : _batchDeadline;
+      if (!batch->empty() && !_fits((int)batch->size() + 1, deadline)) {
+        break;
+      }
+      best->queue.tryPop(&bestFrame);
+      batch->push_back(bestFrame);
+      _batchDeadline = deadline;
+    }
+    return;
+  }
+
+  /*  Round-robin: one frame per stream per pass, starting at the stream
+      after the one that started the previous batch  */
+  const int start = _nextStream;
+  bool added = true;
+  while ((int)batch->size() < batchSize && added) {
+    added = false;
+    for (int i = 0; i < numStreams && (int)batch->size() < batchSize; ++i) {
+      const int index = (start + i) % numStreams;
+      Stream* stream = _streams[index].get();
+      StreamFrame* frame = nullptr;
+      if (!stream->queue.tryPeek(&frame)) {
+        continue;
+      }
+      const Clock::time_point deadline =
+          stream->options.shedding != SHED_NONE
+              ? std::min(_batchDeadline, frame->deadline)
+              : _batchDeadline;
+      if (!batch->empty() && !_fits((int)batch->size() + 1, deadline)) {
+        added = false;
+        break;
+      }
+      /*  note: only the first frame of a batch moves the position, not
+          polls that find nothing or top up the batch   */
+      if (batch->empty()) {
+        _nextStream = (index + 1) % numStreams;
+      }
+      stream->queue.tryPop(&frame);
+      batch->push_back(frame);
+      _batchDeadline = deadline;
+      added = true;
+    }
+  }
+}
+
+void MultiStreamRunner::_shed(const int& batchSize) noexcept {
+  const Clock::time_point now = Clock::now();
+  const double serviceTime = _serviceTime(std::max(batchSize, 1));
+  for (auto& stream : _streams) {
+    if (stream->options.shedding == SHED_NONE) {
+      continue;
+    }
+
+    /*  Only the head of the queue is examined; frames behind it have a
+        later deadline   */
+    StreamFrame* frame = nullptr;
+    while (stream->queue.tryPeek(&frame) &&
+           _shouldShed(*stream, *frame, now, serviceTime)) {
+      stream->queue.tryPop(&frame);
+      stream->free.tryPush(frame);
+      stream->shed += 1;
+      if (stream->shedMetric != nullptr) {
+        stream->shedMetric->add();
+      }
+      if (stream->options.shedding != SHED_DROP_OLDEST) {
+        stream->overloaded = true;
+      }
+    }
+  }
+}
+
+bool MultiStreamRunner::_shouldShed(const Stream& stream,
+                                    const StreamFrame& frame,
+                                    const Clock::time_point& now,
+                                    const double& serviceTime) const
+    noexcept {
+  switch (stream.options.shedding) {
+    case SHED_NONE:
+      return false;
+    case SHED_DROP_OLDEST:
+      if (stream.queue.size() > 1) {
+        return true;
+      }
+      break;
+    case SHED_DECIMATE:
+      if (stream.overloaded &&
+          frame.id % (uint64_t)stream.options.decimation != 0) {
+        return true;
+      }
+      break;
+    default:
+      break;
+  }
+
+  /*  Infeasible: the result would be late even if the frame was
+      processed right away  */
+  return now + fromMilliseconds(serviceTime) > frame.deadline;
+}
+
+bool MultiStreamRunner::_fits(const int& batchSize,
+                              const Clock::time_point& deadline) const
+    noexcept {
+  if (deadline == Clock::time_point::max()) {
+    return true;
+  }
+  return Clock::now() + fromMilliseconds(_serviceTime(batchSize)) <=
+         deadline;
+}
+
+double MultiStreamRunner::_serviceTime(const int& batchSize) const noexcept {
+  /*  Fall back to the closest measured batch size; unknown service times
+      are taken to be 0, so nothing is shed before the first batch   */
+  const int size = std::min(batchSize, (int)_serviceTimes.size() - 1);
+  for (int i = size; i > 0; --i) {
+    if (_serviceTimes[i] > 0.0) {
+      return _serviceTimes[i];
+    }
+  }
+  for (int i = size + 1; i < (int)_serviceTimes.size(); ++i) {
+    if (_serviceTimes[i] > 0.0) {
+      return _serviceTimes[i];
+    }
+  }
+  return 0.0;
+}
+
+bool MultiStreamRunner::_allDone() const noexcept {
+  for (const auto& stream : _streams) {
+    if (!stream->done || stream->queue.size() > 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Result MultiStreamRunner::_process(std::vector<StreamFrame*>* batch) noexcept {
+  const Clock::time_point start = Clock::now();
+
+  /*  A batch of overloaded SHED_LOWER_RESOLUTION streams only runs at the
+      smallest inference size, since the whole batch shares one shape  */
+  bool reduced = true;
+  _images.clear();
+  for (size_t i = 0; i < batch->size(); ++i) {
+    StreamFrame* frame = (*batch)[i];
+    const Stream* stream = _streams[frame->streamId].get();
+    reduced = reduced && stream->options.shedding == SHED_LOWER_RESOLUTION &&
+              stream->overloaded;
+    /*  note: capacity is reserved  */
+    _images.push_back(frame->image);
+  }
+
+  const Result r = _detector->detectBatch(
+      _images, &_results, reduced ? _flags | INFERENCE_SIZE_SMALLEST : _flags);
+  if (r != RESULT_SUCCESS) {
+    return r;
+  }
+
+  /*  Moving average of the service time of this batch size  */
+  const double duration = millisecondsSince(start);
+  double& serviceTime = _serviceTimes[batch->size()];
+  serviceTime = serviceTime > 0.0 ? serviceTime + (duration - serviceTime) / 8
+                                  : duration;
+
+  /*  Route the results back to their streams   */
+  bool ok = true;
+  for (size_t i = 0; i < batch->size(); ++i) {
+    StreamFrame* frame = (*batch)[i];
+    Stream* stream = _streams[frame->streamId].get();
+    std::swap(frame->detections, _results[i]);
+    if (reduced) {
+      stream->downscaled += 1;
+    }
+
+    const Clock::time_point now = Clock::now();
+    const uint64_t latency =
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            now - frame->captureTime)
+            .count();
+    stream->latency.record(latency);
+    stream->processed += 1;
+    if (stream->processedMetric != nullptr) {
+      stream->latencyMetric->record(latency);
+      stream->processedMetric->add();
+    }
+
+    /*  A stream is no longer overloaded once its results are on time with
+        a comfortable margin   */
+    if (now > frame->deadline) {
+      stream->missed += 1;
+      if (stream->missedMetric != nullptr) {
+        stream->missedMetric->add();
+      }
+      stream->overloaded = true;
+    } else if (frame->deadline - now >=
+               fromMilliseconds(stream->options.latencyBudget / 2)) {
+      stream->overloaded = false;
+    }
+
+    try {
+      ok = stream->sink(frame) && ok;
+    } catch (const std::exception& e) {
+      _logger->logf(LOGGING_ERROR,
+                    "[MultiStreamRunner] stream %i failure: sink got "
+                    "exception: %s",
+                    stream->id, e.what());
+      ok = false;
+    }
+    stream->free.tryPush(frame);
+  }
+  batch->clear();
+  _images.clear();
+  _batchDeadline = Clock::time_point::max();
+
+  if (!ok) {
+    _stopped = true;
+  }
+  return RESULT_SUCCESS;
+}
+
+} /*  namespace yolov5    */
\ No newline at end of file
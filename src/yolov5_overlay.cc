@@ -0,0 +1,243 @@
+#include "yolov5_overlay.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace yolov5 {
+
+namespace {
+
+/*  Upper bound on the number of cached free texts, e.g. frame rates   */
+const size_t MAX_CACHED_TEXTS = 1024;
+
+int textBaseline() {
+  int baseline = 0;
+  cv::getTextSize("0", cv::FONT_HERSHEY_SIMPLEX, 1.0, 2, &baseline);
+  return baseline;
+}
+
+} /*  namespace   */
+
+OverlayOptions::OverlayOptions() noexcept
+    : boxColor(255, 51, 153),
+      textColor(255, 255, 255),
+      boxThickness(4),
+      fontScale(1.0),
+      textThickness(2),
+      labelOpacity(1.0) {}
+
+OverlayRenderer::OverlayRenderer() noexcept {}
+
+OverlayRenderer::~OverlayRenderer() noexcept {}
+
+Result OverlayRenderer::setup(const OverlayOptions& options) noexcept {
+  if (options.boxThickness < 1 || options.fontScale <= 0.0 ||
+      options.textThickness < 1 || options.labelOpacity < 0.0 ||
+      options.labelOpacity > 1.0) {
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+  _options = options;
+  clearCache();
+  return RESULT_SUCCESS;
+}
+
+Result OverlayRenderer::render(const std::vector<Detection>& detections,
+                               cv::Mat* image) noexcept {
+  if (image == nullptr) {
+    return RESULT_SUCCESS;
+  }
+  if (image->type() != CV_8UC3) {
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+
+  try {
+    /*  All boxes first, then all labels, so that labels are never
+        covered by the box of another detection   */
+    for (const Detection& detection : detections) {
+      _drawBox(detection.boundingBox(), image);
+    }
+
+    for (const Detection& detection : detections) {
+      const cv::Mat& name =
+          _classLabel(detection.classId(), detection.className());
+      const cv::Mat& score = _scoreLabel(detection.score());
+
+      const cv::Rect& bbox = detection.boundingBox();
+      const cv::Point tl(bbox.x - _options.boxThickness / 2,
+                         bbox.y - name.rows);
+      _blit(name, tl, image);
+      _blit(score, cv::Point(tl.x + name.cols, tl.y), image);
+    }
+  } catch (const std::exception& e) {
+    return RESULT_FAILURE_OPENCV_ERROR;
+  }
+  return RESULT_SUCCESS;
+}
+
+Result OverlayRenderer::renderText(const std::string& text,
+                                   const cv::Point& origin,
+                                   const cv::Scalar& color,
+                                   cv::Mat* image) noexcept {
+  if (image == nullptr || text.empty()) {
+    return RESULT_SUCCESS;
+  }
+  if (image->type() != CV_8UC3) {
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+
+  try {
+    auto it = _texts.find(text);
+    if (it == _texts.end()) {
+      if (_texts.size() >= MAX_CACHED_TEXTS) {
+        _texts.clear();
+      }
+
+      /*  Same font as the FPS counter of visualizeDetection()   */
+      int baseline = 0;
+      const cv::Size size = cv::getTextSize(text, cv::FONT_HERSHEY_SIMPLEX,
+                                            1.0, 2, &baseline);
+      cv::Mat mask(size.height + baseline + 2, size.width + 2, CV_8UC1,
+                   cv::Scalar(0));
+      cv::putText(mask, text, cv::Point(1, size.height + 1),
+                  cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(255), 2,
+                  cv::LINE_AA);
+      it = _texts.emplace(text, mask).first;
+    }
+    const cv::Mat& mask = it->second;
+
+    /*  The mask is the coverage of every pixel by the text. The baseline
+        offset only depends on the font, not on the text   */
+    static const int baseline = textBaseline();
+    const cv::Point tl(origin.x - 1, origin.y - (mask.rows - baseline - 1));
+    const cv::Rect target =
+        cv::Rect(tl, mask.size()) & cv::Rect(cv::Point(0, 0), image->size());
+    const double b = color[0], g = color[1], r = color[2];
+    for (int y = target.y; y < target.y + target.height; ++y) {
+      const uint8_t* alpha = mask.ptr<uint8_t>(y - tl.y) + (target.x - tl.x);
+      uint8_t* pixel = image->ptr<uint8_t>(y) + 3 * target.x;
+      for (int x = 0; x < target.width; ++x, pixel += 3) {
+        const int a = alpha[x];
+        if (a == 0) {
+          continue;
+        }
+        pixel[0] = (uint8_t)((pixel[0] * (255 - a) + b * a) / 255);
+        pixel[1] = (uint8_t)((pixel[1] * (255 - a) + g * a) / 255);
+        pixel[2] = (uint8_t)((pixel[2] * (255 - a) + r * a) / 255);
+      }
+    }
+  } catch (const std::exception& e) {
+    return RESULT_FAILURE_OPENCV_ERROR;
+  }
+  return RESULT_SUCCESS;
+}
+
+size_t OverlayRenderer::cacheSize() const noexcept {
+  size_t size = _namedLabels.size() + _texts.size();
+  for (const cv::Mat& label : _classLabels) {
+    size += label.empty() ? 0 : 1;
+  }
+  for (const cv::Mat& label : _scoreLabels) {
+    size += label.empty() ? 0 : 1;
+  }
+  return size;
+}
+
+void OverlayRenderer::clearCache() noexcept {
+  _classLabels.clear();
+  _classNames.clear();
+  _namedLabels.clear();
+  _scoreLabels.clear();
+  _texts.clear();
+}
+
+const cv::Mat& OverlayRenderer::_classLabel(const int& classId,
+                                            const std::string& name) {
+  const std::string text = name + ": ";
+  if (classId < 0 || classId > 4096) {
+    auto it = _namedLabels.find(text);
+    if (it == _namedLabels.end()) {
+      it = _namedLabels.emplace(text, _rasterizeLabel(text)).first;
+    }
+    return it->second;
+  }
+
+  if ((size_t)classId >= _classLabels.size()) {
+    _classLabels.resize(classId + 1);
+    _classNames.resize(classId + 1);
+  }
+  if (_classLabels[classId].empty() || _classNames[classId] != name) {
+    _classLabels[classId] = _rasterizeLabel(text);
+    _classNames[classId] = name;
+  }
+  return _classLabels[classId];
+}
+
+const cv::Mat& OverlayRenderer::_scoreLabel(const double& score) {
+  const int value =
+      std::max(0, std::min(100, (int)std::lround(score * 100.0)));
+  if (_scoreLabels.empty()) {
+    _scoreLabels.resize(101);
+  }
+  cv::Mat& label = _scoreLabels[value];
+  if (label.empty()) {
+    char text[8];
+    std::snprintf(text, sizeof(text), "%.2f", value / 100.0);
+    label = _rasterizeLabel(text);
+  }
+  return label;
+}
+
+cv::Mat OverlayRenderer::_rasterizeLabel(const std::string& text) const {
+  int baseline = 0;
+  const cv::Size size =
+      cv::getTextSize(text, cv::FONT_HERSHEY_PLAIN, _options.fontScale,
+                      _options.textThickness, &baseline);
+  cv::Mat label(std::max(size.height, 1), std::max(size.width, 1), CV_8UC3,
+                _options.boxColor);
+  cv::putText(label, text,
+              cv::Point(0, size.height - _options.boxThickness / 2),
+              cv::FONT_HERSHEY_PLAIN, _options.fontScale, _options.textColor,
+              _options.textThickness);
+  return label;
+}
+
+void OverlayRenderer::_drawBox(const cv::Rect& box, cv::Mat* image) const {
+  /*  Four bars, centered on the edges of the box like cv::rectangle()   */
+  const int t = _options.boxThickness;
+  const cv::Rect outer(box.x - t / 2, box.y - t / 2, box.width + t,
+                       box.height + t);
+  const cv::Rect bars[4] = {
+      cv::Rect(outer.x, outer.y, outer.width, t),
+      cv::Rect(outer.x, outer.y + outer.height - t, outer.width, t),
+      cv::Rect(outer.x, outer.y, t, outer.height),
+      cv::Rect(outer.x + outer.width - t, outer.y, t, outer.height)};
+  const cv::Rect imageRect(cv::Point(0, 0), image->size());
+  for (const cv::Rect& bar : bars) {
+    const cv::Rect clipped = bar & imageRect;
+    if (clipped.area() > 0) {
+      (*image)(clipped).setTo(_options.boxColor);
+    }
+  }
+}
+
+void OverlayRenderer::_blit(const cv::Mat& label, const cv::Point& tl,
+                            cv::Mat* image) const {
+  const cv::Rect target = cv::Rect(tl, label.size()) &
+                          cv::Rect(cv::Point(0, 0), image->size());
+  if (target.area() <= 0) {
+    return;
+  }
+  const cv::Mat source =
+      label(cv::Rect(target.x - tl.x, target.y - tl.y, target.width,
+                     target.height));
+  cv::Mat destination = (*image)(target);
+  if (_options.labelOpacity >= 1.0) {
+    source.copyTo(destination);
+  } else {
+    cv::addWeighted(source, _options.labelOpacity, destination,
+                    1.0 - _options.labelOpacity, 0.0, destination);
+  }
+}
+
+} /*  namespace yolov5    */
\ No newline at end of file
@@ -0,0 +1,336 @@
+#include "yolov5_perf.h"
+
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace yolov5 {
+
+namespace {
+
+enum {
+  COUNTER_CYCLES = 0,
+  COUNTER_INSTRUCTIONS = 1,
+  COUNTER_CACHE_MISSES = 2,
+  COUNTER_BRANCH_MISSES = 3,
+  NUM_COUNTERS = 4
+};
+
+/*  Counts read at the beginning of a stage   */
+struct Sample {
+  uint64_t timeEnabled;
+  uint64_t timeRunning;
+  uint64_t values[NUM_COUNTERS];
+};
+
+/*  Counters of a single thread, opened as one group so that they are
+    scheduled onto the PMU together   */
+struct ThreadCounters {
+  ThreadCounters() noexcept
+      : state(STATE_UNOPENED), leader(-1), numSlots(0), depth(0) {
+    for (int i = 0; i < NUM_COUNTERS; ++i) {
+      fds[i] = -1;
+      slots[i] = -1;
+    }
+  }
+
+  ~ThreadCounters() noexcept {
+#ifdef __linux__
+    for (int i = 0; i < NUM_COUNTERS; ++i) {
+      if (fds[i] >= 0) {
+        close(fds[i]);
+      }
+    }
+#endif
+  }
+
+  enum { STATE_UNOPENED, STATE_OPEN, STATE_UNAVAILABLE } state;
+
+  int leader;
+  int fds[NUM_COUNTERS];
+  int slots[NUM_COUNTERS]; /**<    position in the group, -1 if missing  */
+  int numSlots;
+
+  /*  Stages may be nested, e.g. pre-processing within a pipeline stage */
+  static const int MAX_DEPTH = 8;
+  Sample stack[MAX_DEPTH];
+  int depth;
+};
+
+thread_local ThreadCounters threadCounters;
+
+struct StageTotals {
+  const char* name;
+  uint64_t calls;
+  int64_t values[NUM_COUNTERS];
+  bool seen[NUM_COUNTERS]; /**<    whether any sample had the counter  */
+};
+
+struct Registry {
+  std::mutex mutex;
+  std::vector<StageTotals> stages;
+};
+
+Registry& registry() noexcept {
+  static Registry instance;
+  return instance;
+}
+
+#ifdef __linux__
+int openCounter(const uint32_t& type, const uint64_t& config,
+                const int& groupFd) noexcept {
+  struct perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = groupFd < 0 ? 1 : 0;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  /*  calling thread, any CPU   */
+  return (int)syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+}
+#endif
+
+ThreadCounters* currentCounters() noexcept {
+  ThreadCounters& tc = threadCounters;
+  if (tc.state != ThreadCounters::STATE_UNOPENED) {
+    return tc.state == ThreadCounters::STATE_OPEN ? &tc : nullptr;
+  }
+
+  tc.state = ThreadCounters::STATE_UNAVAILABLE;
+#ifdef __linux__
+  const uint64_t configs[NUM_COUNTERS] = {
+      PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+  tc.fds[COUNTER_CYCLES] = openCounter(PERF_TYPE_HARDWARE, configs[0], -1);
+  if (tc.fds[COUNTER_CYCLES] < 0) {
+    return nullptr;
+  }
+  tc.leader = tc.fds[COUNTER_CYCLES];
+  tc.slots[COUNTER_CYCLES] = 0;
+  tc.numSlots = 1;
+
+  /*  The other counters are optional: not every PMU (or hypervisor)
+      provides them   */
+  for (int i = 1; i < NUM_COUNTERS; ++i) {
+    tc.fds[i] = openCounter(PERF_TYPE_HARDWARE, configs[i], tc.leader);
+    if (tc.fds[i] >= 0) {
+      tc.slots[i] = tc.numSlots++;
+    }
+  }
+
+  if (ioctl(tc.leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP) != 0 ||
+      ioctl(tc.leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) != 0) {
+    return nullptr;
+  }
+  tc.state = ThreadCounters::STATE_OPEN;
+  return &tc;
+#else
+  return nullptr;
+#endif
+}
+
+bool readSample(const ThreadCounters& tc, Sample* sample) noexcept {
+#ifdef __linux__
+  uint64_t buffer[3 + NUM_COUNTERS];
+  const ssize_t size = (3 + tc.numSlots) * sizeof(uint64_t);
+  if (read(tc.leader, buffer, size) != size) {
+    return false;
+  }
+
+  /*  { nr, time_enabled, time_running, values[nr] }   */
+  sample->timeEnabled = buffer[1];
+  sample->timeRunning = buffer[2];
+  for (int i = 0; i < NUM_COUNTERS; ++i) {
+    sample->values[i] = tc.slots[i] >= 0 ? buffer[3 + tc.slots[i]] : 0;
+  }
+  return true;
+#else
+  YOLOV5_UNUSED(tc);
+  YOLOV5_UNUSED(sample);
+  return false;
+#endif
+}
+
+} /*  namespace   */
+
+PerfStageStats::PerfStageStats() noexcept
+    : calls(0), cycles(-1), instructions(-1), cacheMisses(-1),
+      branchMisses(-1) {}
+
+double PerfStageStats::ipc() const noexcept {
+  if (cycles <= 0 || instructions < 0) {
+    return 0.0;
+  }
+  return (double)instructions / (double)cycles;
+}
+
+double PerfStageStats::perCall(const int64_t& total) const noexcept {
+  if (total < 0 || calls == 0) {
+    return -1.0;
+  }
+  return (double)total / (double)calls;
+}
+
+std::atomic<bool> PerfCounters::_enabled(false);
+
+Result PerfCounters::setEnabled(const bool& enabled) noexcept {
+  if (enabled && currentCounters() == nullptr) {
+    _enabled.store(false, std::memory_order_relaxed);
+    return RESULT_FAILURE_OTHER;
+  }
+  _enabled.store(enabled, std::memory_order_relaxed);
+  return RESULT_SUCCESS;
+}
+
+bool PerfCounters::isAvailable() noexcept {
+  return currentCounters() != nullptr;
+}
+
+int PerfCounters::begin() noexcept {
+  ThreadCounters* tc = currentCounters();
+  if (tc == nullptr || tc->depth >= ThreadCounters::MAX_DEPTH) {
+    return -1;
+  }
+  const int handle = tc->depth;
+  if (!readSample(*tc, &tc->stack[handle])) {
+    return -1;
+  }
+  tc->depth++;
+  return handle;
+}
+
+void PerfCounters::end(const char* name, const int& handle) noexcept {
+  ThreadCounters* tc = currentCounters();
+  if (tc == nullptr || handle < 0 || handle >= tc->depth) {
+    return;
+  }
+  tc->depth = handle;
+
+  Sample now;
+  if (!readSample(*tc, &now)) {
+    return;
+  }
+  const Sample& start = tc->stack[handle];
+
+  /*  If the group was multiplexed with other events, it only counted
+      part of the time; extrapolate to the whole stage   */
+  const uint64_t enabled = now.timeEnabled - start.timeEnabled;
+  const uint64_t running = now.timeRunning - start.timeRunning;
+  if (running == 0) {
+    return;
+  }
+  const double scale = (double)enabled / (double)running;
+
+  Registry& reg = registry();
+  try {
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    StageTotals* stage = nullptr;
+    for (StageTotals& s : reg.stages) {
+      if (s.name == name || std::strcmp(s.name, name) == 0) {
+        stage = &s;
+        break;
+      }
+    }
+    if (stage == nullptr) {
+      StageTotals s;
+      std::memset(&s, 0, sizeof(s));
+      s.name = name;
+      reg.stages.push_back(s);
+      stage = &reg.stages.back();
+    }
+
+    stage->calls++;
+    for (int i = 0; i < NUM_COUNTERS; ++i) {
+      if (tc->slots[i] < 0) {
+        continue;
+      }
+      stage->values[i] +=
+          (int64_t)((now.values[i] - start.values[i]) * scale + 0.5);
+      stage->seen[i] = true;
+    }
+  } catch (const std::exception& e) {
+  }
+}
+
+std::vector<PerfStageStats> PerfCounters::stats() noexcept {
+  std::vector<PerfStageStats> out;
+  Registry& reg = registry();
+  try {
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (const StageTotals& s : reg.stages) {
+      PerfStageStats stats;
+      stats.name = s.name;
+      stats.calls = s.calls;
+      int64_t* fields[NUM_COUNTERS] = {&stats.cycles, &stats.instructions,
+                                       &stats.cacheMisses,
+                                       &stats.branchMisses};
+      for (int i = 0; i < NUM_COUNTERS; ++i) {
+        *fields[i] = s.seen[i] ? s.values[i] : -1;
+      }
+      out.push_back(stats);
+    }
+  } catch (const std::exception& e) {
+    out.clear();
+  }
+  return out;
+}
+
+bool PerfCounters::statsToString(std::string* out) noexcept {
+  const std::vector<PerfStageStats> lst = stats();
+  if (lst.empty()) {
+    return false;
+  }
+
+  try {
+    char buffer[256];
+    std::string str =
+        "Hardware counters (per call):\n"
+        "  stage             calls      cycles  instructions    IPC"
+        "  LLC misses  branch misses\n";
+    for (const PerfStageStats& stats : lst) {
+      const double values[NUM_COUNTERS] = {
+          stats.perCall(stats.cycles), stats.perCall(stats.instructions),
+          stats.perCall(stats.cacheMisses),
+          stats.perCall(stats.branchMisses)};
+      char columns[NUM_COUNTERS][32];
+      for (int i = 0; i < NUM_COUNTERS; ++i) {
+        if (values[i] < 0.0) {
+          std::snprintf(columns[i], sizeof(columns[i]), "n/a");
+        } else {
+          std::snprintf(columns[i], sizeof(columns[i]), "%.0f", values[i]);
+        }
+      }
+      std::snprintf(buffer, sizeof(buffer),
+                    "  %-14s %8lu %11s %13s %6.2f %11s %14s\n",
+                    stats.name.c_str(), (unsigned long)stats.calls,
+                    columns[0], columns[1], stats.ipc(), columns[2],
+                    columns[3]);
+      str += buffer;
+    }
+    *out = str;
+  } catch (const std::exception& e) {
+    return false;
+  }
+  return true;
+}
+
+void PerfCounters::clear() noexcept {
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  reg.stages.clear();
+}
+
+} /*  namespace yolov5    */
\ No newline at end of file
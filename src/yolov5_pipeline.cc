@@ -0,0 +1,621 @@
+#include "yolov5_pipeline.h"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include "yolov5_perf.h"
+#include "yolov5_trace.h"
+
+namespace yolov5 {
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double secondsSince(const Clock::time_point& start) noexcept {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+} /*  namespace   */
+
+PipelineFrame::PipelineFrame() noexcept : id(0), detected(false) {}
+
+StageStats::StageStats() noexcept
+    : frames(0),
+      busyTime(0.0),
+      idleTime(0.0),
+      meanQueueDepth(0.0),
+      maxQueueDepth(0) {}
+
+double StageStats::throughput() const noexcept {
+  if (busyTime <= 0.0) {
+    return 0.0;
+  }
+  return (double)frames / busyTime;
+}
+
+double StageStats::utilization() const noexcept {
+  const double total = busyTime + idleTime;
+  if (total <= 0.0) {
+    return 0.0;
+  }
+  return busyTime / total;
+}
+
+Pipeline::Pipeline() noexcept
+    : _detector(nullptr),
+      _queueCapacity(0),
+      _flags(0),
+      _motionGate(nullptr),
+      _stopped(false),
+      _captureDone(false),
+      _preprocessDone(false),
+      _inferenceDone(false),
+      _renderDone(false),
+      _result(RESULT_SUCCESS),
+      _runTime(0.0),
+      _metrics(nullptr),
+      _framesCounter(nullptr),
+      _detectionsCounter(nullptr),
+      _skippedCounter(nullptr),
+      _captureTime(nullptr),
+      _preprocessTime(nullptr),
+      _inferenceTime(nullptr),
+      _renderTime(nullptr),
+      _sinkTime(nullptr),
+      _latencyMetric(nullptr),
+      _capturedDepth(nullptr),
+      _preprocessedDepth(nullptr),
+      _detectedDepth(nullptr),
+      _renderedDepth(nullptr) {}
+
+Pipeline::~Pipeline() noexcept {}
+
+Result Pipeline::setup(Detector* detector, const int& queueCapacity,
+                       const int& flags) noexcept {
+  if (detector == nullptr || !detector->isEngineLoaded()) {
+    return RESULT_FAILURE_NOT_LOADED;
+  }
+  _logger = detector->logger();
+  if (queueCapacity < 1) {
+    _logger->log(LOGGING_ERROR,
+                 "[Pipeline] setup() failure: queue capacity should be at "
+                 "least 1");
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+
+  /*  Every queue can be full while each stage holds one frame   */
+  const int numFrames = 4 * queueCapacity + 5;
+  try {
+    _frames.clear();
+    for (int i = 0; i < numFrames; ++i) {
+      _frames.emplace_back(new PipelineFrame());
+    }
+  } catch (const std::exception& e) {
+    _logger->logf(LOGGING_ERROR,
+                  "[Pipeline] setup() failure: could not allocate "
+                  "frames: %s",
+                  e.what());
+    return RESULT_FAILURE_ALLOC;
+  }
+  if (!_free.setup(numFrames) || !_captured.setup(queueCapacity) ||
+      !_preprocessed.setup(queueCapacity) || !_detected.setup(queueCapacity) ||
+      !_rendered.setup(queueCapacity)) {
+    _logger->log(LOGGING_ERROR,
+                 "[Pipeline] setup() failure: could not set up queues");
+    return RESULT_FAILURE_ALLOC;
+  }
+
+  _detector = detector;
+  _queueCapacity = queueCapacity;
+  _flags = flags;
+  return RESULT_SUCCESS;
+}
+
+Result Pipeline::setMotionGate(MotionGate* gate) noexcept {
+  _motionGate = gate;
+  return RESULT_SUCCESS;
+}
+
+Result Pipeline::setRender(const Render& render) noexcept {
+  try {
+    _render = render;
+  } catch (const std::exception& e) {
+    return RESULT_FAILURE_ALLOC;
+  }
+  return RESULT_SUCCESS;
+}
+
+Result Pipeline::setMetrics(MetricsRegistry* registry) noexcept {
+  _metrics = registry;
+  if (registry == nullptr) {
+    _framesCounter = _detectionsCounter = _skippedCounter = nullptr;
+    _captureTime = _preprocessTime = _inferenceTime = nullptr;
+    _renderTime = _sinkTime = _latencyMetric = nullptr;
+    _capturedDepth = _preprocessedDepth = _detectedDepth = nullptr;
+    _renderedDepth = nullptr;
+    return RESULT_SUCCESS;
+  }
+
+  const std::string stageHelp = "Processing time per frame, by stage";
+  const std::string depthHelp = "Frames waiting in a queue, by queue";
+  _framesCounter =
+      registry->counter("yolov5_frames_total", "Frames that reached the sink");
+  _detectionsCounter = registry->counter("yolov5_detections_total",
+                                         "Detections of all frames");
+  _skippedCounter = registry->counter(
+      "yolov5_skipped_frames_total",
+      "Frames whose detection was skipped by the motion gate");
+  _captureTime = registry->histogram("yolov5_stage_seconds", stageHelp,
+                                     "stage=\"capture\"");
+  _preprocessTime = registry->histogram("yolov5_stage_seconds", stageHelp,
+                                        "stage=\"preprocess\"");
+  _inferenceTime = registry->histogram("yolov5_stage_seconds", stageHelp,
+                                       "stage=\"inference\"");
+  _renderTime = registry->histogram("yolov5_stage_seconds", stageHelp,
+                                    "stage=\"render\"");
+  _sinkTime = registry->histogram("yolov5_stage_seconds", stageHelp,
+                                  "stage=\"sink\"");
+  _latencyMetric = registry->histogram("yolov5_latency_seconds",
+                                       "Latency from capture to result");
+  _capturedDepth =
+      registry->gauge("yolov5_queue_depth", depthHelp, "queue=\"captured\"");
+  _preprocessedDepth = registry->gauge("yolov5_queue_depth", depthHelp,
+                                       "queue=\"preprocessed\"");
+  _detectedDepth =
+      registry->gauge("yolov5_queue_depth", depthHelp, "queue=\"detected\"");
+  _renderedDepth =
+      registry->gauge("yolov5_queue_depth", depthHelp, "queue=\"rendered\"");
+
+  if (_framesCounter == nullptr || _detectionsCounter == nullptr ||
+      _skippedCounter == nullptr || _captureTime == nullptr ||
+      _preprocessTime == nullptr || _inferenceTime == nullptr ||
+      _renderTime == nullptr || _sinkTime == nullptr ||
+      _latencyMetric == nullptr || _capturedDepth == nullptr ||
+      _preprocessedDepth == nullptr || _detectedDepth == nullptr ||
+      _renderedDepth == nullptr) {
+    if (_logger) {
+      _logger->log(LOGGING_ERROR,
+                   "[Pipeline] setMetrics() failure: could not register "
+                   "metrics");
+    }
+    setMetrics(nullptr);
+    return RESULT_FAILURE_ALLOC;
+  }
+  return RESULT_SUCCESS;
+}
+
+Result Pipeline::run(const Source& source, const Sink& sink) noexcept {
+  if (_detector == nullptr) {
+    return RESULT_FAILURE_NOT_INITIALIZED;
+  }
+
+  /*  The network input size is determined once per run   */
+  _inferenceSizes = _detector->inferenceSizes();
+  _networkSize = _detector->inferenceSize();
+  if (_networkSize.area() == 0) {
+    return RESULT_FAILURE_NOT_LOADED;
+  }
+
+  /*  Reset the queues; all frames start out free  */
+  if (!_free.setup(_free.capacity()) || !_captured.setup(_queueCapacity) ||
+      !_preprocessed.setup(_queueCapacity) ||
+      !_detected.setup(_queueCapacity) || !_rendered.setup(_queueCapacity)) {
+    _logger->log(LOGGING_ERROR,
+                 "[Pipeline] run() failure: could not set up queues");
+    return RESULT_FAILURE_ALLOC;
+  }
+  for (auto& frame : _frames) {
+    _free.tryPush(frame.get());
+  }
+
+  _stopped = false;
+  _captureDone = false;
+  _preprocessDone = false;
+  _inferenceDone = false;
+  _renderDone = false;
+  _result = RESULT_SUCCESS;
+  _lastDetections.clear();
+  if (_motionGate != nullptr) {
+    _motionGate->reset();
+  }
+
+  _captureStats = StageStats();
+  _captureStats.name = "capture";
+  _preprocessStats = StageStats();
+  _preprocessStats.name = "preprocess";
+  _inferenceStats = StageStats();
+  _inferenceStats.name = "inference";
+  _renderStats = StageStats();
+  _renderStats.name = "render";
+  _sinkStats = StageStats();
+  _sinkStats.name = "sink";
+  _latency.reset();
+
+  const Clock::time_point startTime = Clock::now();
+
+  std::vector<std::thread> threads;
+  try {
+    threads.emplace_back(&Pipeline::_captureStage, this, std::cref(source));
+    threads.emplace_back(&Pipeline::_preprocessStage, this);
+    threads.emplace_back(&Pipeline::_inferenceStage, this);
+    if (_render) {
+      threads.emplace_back(&Pipeline::_renderStage, this);
+    }
+  } catch (const std::exception& e) {
+    _logger->logf(LOGGING_ERROR,
+                  "[Pipeline] run() failure: could not start stage "
+                  "threads: %s",
+                  e.what());
+    _fail(RESULT_FAILURE_OTHER);
+  }
+
+  if (threads.size() == (_render ? 4u : 3u)) {
+    _sinkStage(sink);
+  }
+
+  /*  The sink is done; make sure that the other stages stop as well  */
+  _stopped = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  _runTime = secondsSince(startTime);
+
+  std::lock_guard<std::mutex> lock(_resultMutex);
+  return _result;
+}
+
+void Pipeline::stop() noexcept { _stopped = true; }
+
+const LatencyHistogram& Pipeline::latency() const noexcept {
+  return _latency;
+}
+
+std::vector<StageStats> Pipeline::stats() const noexcept {
+  try {
+    if (_render) {
+      return {_captureStats, _preprocessStats, _inferenceStats, _renderStats,
+              _sinkStats};
+    }
+    return {_captureStats, _preprocessStats, _inferenceStats, _sinkStats};
+  } catch (const std::exception& e) {
+    return std::vector<StageStats>();
+  }
+}
+
+bool Pipeline::statsToString(std::string* out) const noexcept {
+  const std::vector<StageStats> lst = stats();
+  if (lst.empty()) {
+    return false;
+  }
+
+  try {
+    char buffer[256];
+    std::snprintf(buffer, sizeof(buffer),
+                  "Pipeline: %lu frames in %.2f s (%.1f FPS)\n",
+                  (unsigned long)_sinkStats.frames, _runTime,
+                  _runTime > 0.0 ? _sinkStats.frames / _runTime : 0.0);
+    std::string str = buffer;
+    for (const StageStats& stats : lst) {
+      std::snprintf(buffer, sizeof(buffer),
+                    "  %-10s %8lu frames, %7.1f FPS, %5.1f%% busy, queue "
+                    "depth mean %.1f max %i\n",
+                    stats.name.c_str(), (unsigned long)stats.frames,
+                    stats.throughput(), 100.0 * stats.utilization(),
+                    stats.meanQueueDepth, stats.maxQueueDepth);
+      str += buffer;
+    }
+
+    if (_motionGate != nullptr) {
+      const MotionGateStats gateStats = _motionGate->stats();
+      std::snprintf(buffer, sizeof(buffer),
+                    "  motion gate: skipped %lu of %lu frames (%.1f%%)\n",
+                    (unsigned long)gateStats.skipped,
+                    (unsigned long)gateStats.frames,
+                    100.0 * gateStats.skipRatio());
+      str += buffer;
+    }
+
+    std::string latency;
+    if (_latency.toString(&latency)) {
+      str += "  capture-to-result latency: " + latency + "\n";
+    }
+    *out = str;
+  } catch (const std::exception& e) {
+    return false;
+  }
+  return true;
+}
+
+void Pipeline::_captureStage(const Source& source) noexcept {
+  if (Tracer::isEnabled()) {
+    Tracer::setThreadName("capture");
+  }
+  uint64_t id = 0;
+  PipelineFrame* frame = nullptr;
+  while (_pop(&_free, nullptr, &frame, &_captureStats)) {
+    const Clock::time_point start = Clock::now();
+    YOLOV5_TRACE_FRAME(id);
+    TraceSpan span("capture");
+    bool ok = false;
+    try {
+      ok = source(&frame->image);
+    } catch (const std::exception& e) {
+      _logger->logf(LOGGING_ERROR,
+                    "[Pipeline] capture failure: got exception: %s",
+                    e.what());
+      _fail(RESULT_FAILURE_OTHER);
+    }
+    if (!ok) {
+      break;
+    }
+    frame->id = id++;
+    frame->captureTime = Clock::now();
+    span.end();
+    _observe(_captureTime, start);
+    _captureStats.busyTime += secondsSince(start);
+    _captureStats.frames += 1;
+
+    if (!_push(&_captured, frame, &_captureStats)) {
+      break;
+    }
+  }
+  _captureDone = true;
+}
+
+void Pipeline::_preprocessStage() noexcept {
+  if (Tracer::isEnabled()) {
+    Tracer::setThreadName("preprocess");
+  }
+  PipelineFrame* frame = nullptr;
+  while (_pop(&_captured, &_captureDone, &frame, &_preprocessStats)) {
+    const Clock::time_point start = Clock::now();
+    YOLOV5_TRACE_FRAME(frame->id);
+    TraceSpan span("letterbox");
+    frame->detected = true;
+    if (_motionGate != nullptr) {
+      const Result r = _motionGate->check(frame->image, &frame->detected);
+      if (r != RESULT_SUCCESS) {
+        _fail(r);
+        break;
+      }
+    }
+    if (!frame->detected) {
+      span.end();
+      _observe(_preprocessTime, start);
+      if (_skippedCounter != nullptr) {
+        _skippedCounter->add();
+      }
+      _preprocessStats.busyTime += secondsSince(start);
+      _preprocessStats.frames += 1;
+      if (!_push(&_preprocessed, frame, &_preprocessStats)) {
+        break;
+      }
+      continue;
+    }
+
+    cv::Size networkSize = _networkSize;
+    const cv::Size imageSize = frame->image.size();
+    const int index =
+        internal::selectInferenceSize(_inferenceSizes, &imageSize, 1);
+    if (index >= 0) {
+      networkSize = _inferenceSizes[index];
+    }
+
+    try {
+      YOLOV5_PERF_SCOPE("letterbox");
+      internal::letterbox(frame->image, networkSize, &frame->buffer,
+                          &frame->input, &frame->transform);
+    } catch (const std::exception& e) {
+      _logger->logf(LOGGING_ERROR,
+                    "[Pipeline] preprocess failure: got exception: %s",
+                    e.what());
+      _fail(RESULT_FAILURE_OPENCV_ERROR);
+      break;
+    }
+    span.end();
+    _observe(_preprocessTime, start);
+    _preprocessStats.busyTime += secondsSince(start);
+    _preprocessStats.frames += 1;
+
+    if (!_push(&_preprocessed, frame, &_preprocessStats)) {
+      break;
+    }
+  }
+  _preprocessDone = true;
+}
+
+void Pipeline::_inferenceStage() noexcept {
+  if (Tracer::isEnabled()) {
+    Tracer::setThreadName("inference");
+  }
+  PipelineFrame* frame = nullptr;
+  while (_pop(&_preprocessed, &_preprocessDone, &frame, &_inferenceStats)) {
+    const Clock::time_point start = Clock::now();
+    YOLOV5_TRACE_FRAME(frame->id);
+    if (frame->detected) {
+      const Result r =
+          _detector->detect(frame->input, &frame->detections, _flags);
+      if (r != RESULT_SUCCESS) {
+        _fail(r);
+        break;
+      }
+
+      /*  The detector returns boxes relative to the letterboxed input  */
+      for (Detection& detection : frame->detections) {
+        detection.setBoundingBox(
+            frame->transform.transformBbox(detection.boundingBox()));
+      }
+    }
+
+    /*  Frames skipped by the motion gate reuse the last detections   */
+    try {
+      if (frame->detected) {
+        _lastDetections = frame->detections;
+      } else {
+        frame->detections = _lastDetections;
+      }
+    } catch (const std::exception& e) {
+      _logger->logf(LOGGING_ERROR,
+                    "[Pipeline] inference failure: got exception: %s",
+                    e.what());
+      _fail(RESULT_FAILURE_ALLOC);
+      break;
+    }
+    _observe(_inferenceTime, start);
+    _inferenceStats.busyTime += secondsSince(start);
+    _inferenceStats.frames += 1;
+
+    if (!_push(&_detected, frame, &_inferenceStats)) {
+      break;
+    }
+  }
+  _inferenceDone = true;
+}
+
+void Pipeline::_renderStage() noexcept {
+  if (Tracer::isEnabled()) {
+    Tracer::setThreadName("render");
+  }
+  PipelineFrame* frame = nullptr;
+  while (_pop(&_detected, &_inferenceDone, &frame, &_renderStats)) {
+    const Clock::time_point start = Clock::now();
+    YOLOV5_TRACE_FRAME(frame->id);
+    TraceSpan span("render");
+    bool ok = false;
+    try {
+      ok = _render(frame);
+    } catch (const std::exception& e) {
+      _logger->logf(LOGGING_ERROR,
+                    "[Pipeline] render failure: got exception: %s", e.what());
+      _fail(RESULT_FAILURE_OTHER);
+    }
+    span.end();
+    _observe(_renderTime, start);
+    _renderStats.busyTime += secondsSince(start);
+    _renderStats.frames += 1;
+
+    if (!ok || !_push(&_rendered, frame, &_renderStats)) {
+      break;
+    }
+  }
+  _renderDone = true;
+}
+
+void Pipeline::_sinkStage(const Sink& sink) noexcept {
+  /*  With a render stage, the sink takes its frames from that stage  */
+  FrameQueue* input = _render ? &_rendered : &_detected;
+  const std::atomic<bool>* inputDone =
+      _render ? &_renderDone : &_inferenceDone;
+
+  PipelineFrame* frame = nullptr;
+  while (_pop(input, inputDone, &frame, &_sinkStats)) {
+    const Clock::time_point start = Clock::now();
+    YOLOV5_TRACE_FRAME(frame->id);
+    TraceSpan span("sink");
+    const uint64_t latency =
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            start - frame->captureTime)
+            .count();
+    _latency.record(latency);
+    if (_metrics != nullptr) {
+      _latencyMetric->record(latency);
+      _framesCounter->add();
+      _detectionsCounter->add(frame->detections.size());
+    }
+    bool ok = false;
+    try {
+      ok = sink(frame);
+    } catch (const std::exception& e) {
+      _logger->logf(LOGGING_ERROR,
+                    "[Pipeline] sink failure: got exception: %s", e.what());
+      _fail(RESULT_FAILURE_OTHER);
+    }
+    span.end();
+    _observe(_sinkTime, start);
+    _sinkStats.busyTime += secondsSince(start);
+    _sinkStats.frames += 1;
+
+    /*  Recycle the frame   */
+    if (!_push(&_free, frame, &_sinkStats) || !ok) {
+      break;
+    }
+  }
+}
+
+bool Pipeline::_pop(FrameQueue* queue, const std::atomic<bool>* upstreamDone,
+                    PipelineFrame** frame, StageStats* stats) noexcept {
+  const Clock::time_point start = Clock::now();
+  Backoff backoff;
+  bool ok = true;
+  while (!queue->tryPop(frame)) {
+    if (_stopped) {
+      ok = false;
+      break;
+    }
+    /*  note: the queue is checked once more, since the upstream stage may
+        have pushed its last frame right before it finished  */
+    if (upstreamDone != nullptr && *upstreamDone) {
+      ok = queue->tryPop(frame);
+      break;
+    }
+    backoff.wait();
+  }
+  stats->idleTime += secondsSince(start);
+  return ok;
+}
+
+bool Pipeline::_push(FrameQueue* queue, PipelineFrame* frame,
+                     StageStats* stats) noexcept {
+  const Clock::time_point start = Clock::now();
+  Backoff backoff;
+  while (!queue->tryPush(frame)) {
+    if (_stopped) {
+      stats->idleTime += secondsSince(start);
+      return false;
+    }
+    backoff.wait();
+  }
+  stats->idleTime += secondsSince(start);
+
+  const int depth = queue->size();
+  if (_metrics != nullptr) {
+    Gauge* gauge = queue == &_captured       ? _capturedDepth
+                   : queue == &_preprocessed ? _preprocessedDepth
+                   : queue == &_detected     ? _detectedDepth
+                   : queue == &_rendered     ? _renderedDepth
+                                             : nullptr;
+    if (gauge != nullptr) {
+      gauge->set(depth);
+    }
+  }
+  stats->meanQueueDepth +=
+      (depth - stats->meanQueueDepth) / (double)MAX(stats->frames, 1);
+  stats->maxQueueDepth = MAX(stats->maxQueueDepth, depth);
+  return true;
+}
+
+void Pipeline::_fail(const Result& r) noexcept {
+  {
+    std::lock_guard<std::mutex> lock(_resultMutex);
+    if (_result == RESULT_SUCCESS) {
+      _result = r;
+    }
+  }
+  if (_metrics != nullptr) {
+    _metrics->countResult(r);
+  }
+  _stopped = true;
+}
+
+void Pipeline::_observe(Histogram* histogram,
+                        const Clock::time_point& start) const noexcept {
+  if (histogram != nullptr) {
+    histogram->record(std::chrono::duration_cast<std::chrono::microseconds>(
+                          Clock::now() - start)
+                          .count());
+  }
+}
+
+} /*  namespace yolov5    */
\ No newline at end of file
@@ -0,0 +1,474 @@
+#include "yolov5_replay.h"
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace yolov5 {
+
+namespace {
+
+/*  File layout (little-endian, every part 8-byte aligned):
+      "YV5T", uint32 version
+      per frame: RecordHeader, TransformRecord[numImages],
+                 DetectionRecord[numDetections], input floats (if any),
+                 output floats, padding  */
+const uint32_t CAPTURE_VERSION = 1;
+const size_t FILE_HEADER_SIZE = 8;
+
+struct RecordHeader {
+  uint64_t size; /**<    bytes of the record, including this header   */
+  uint64_t sequence;
+  double scoreThreshold;
+  double nmsThreshold;
+  int32_t numImages;
+  int32_t numDetections;
+  int32_t inputDims[4]; /**<    all 0 if the input was not recorded   */
+  int32_t outputDims[3];
+  int32_t reserved;
+};
+
+struct TransformRecord {
+  int32_t inputWidth;
+  int32_t inputHeight;
+  int32_t leftWidth;
+  int32_t topHeight;
+  double scale;
+};
+
+struct DetectionRecord {
+  int32_t image;
+  int32_t classId;
+  int32_t x;
+  int32_t y;
+  int32_t width;
+  int32_t height;
+  double score;
+};
+
+size_t alignTo8(const size_t& size) noexcept { return (size + 7) & ~7; }
+
+/*  Size in bytes of a float tensor with the given dimensions. False if a
+    dimension is negative or the size exceeds the limit, so that sizes
+    read from a (possibly corrupt) file cannot overflow   */
+bool tensorBytes(const int32_t* dims, const int& n, const size_t& limit,
+                 size_t* out) noexcept {
+  size_t volume = 1;
+  for (int i = 0; i < n; ++i) {
+    if (dims[i] < 0) {
+      return false;
+    }
+    if (dims[i] > 0 && volume > limit / sizeof(float) / (size_t)dims[i]) {
+      return false;
+    }
+    volume *= (size_t)dims[i];
+  }
+  *out = volume * sizeof(float);
+  return true;
+}
+
+} /*  namespace   */
+
+TensorFrame::TensorFrame() noexcept
+    : sequence(0),
+      numImages(0),
+      scoreThreshold(0.0),
+      nmsThreshold(0.0),
+      input(nullptr),
+      output(nullptr) {
+  inputDims.nbDims = 0;
+  outputDims.nbDims = 0;
+}
+
+TensorRecorderOptions::TensorRecorderOptions() noexcept
+    : recordInput(true), interval(1), maxBytes((uint64_t)1 << 30) {}
+
+TensorRecorder::TensorRecorder() noexcept
+    : _file(nullptr),
+      _numCalls(0),
+      _numRecorded(0),
+      _bytesWritten(0),
+      _full(false) {}
+
+TensorRecorder::~TensorRecorder() noexcept { close(); }
+
+Result TensorRecorder::open(const std::string& filepath,
+                            const TensorRecorderOptions& options) noexcept {
+  if (!_logger) {
+    try {
+      _logger = std::make_shared<Logger>();
+    } catch (const std::exception& e) {
+      return RESULT_FAILURE_ALLOC;
+    }
+  }
+  if (options.interval < 1) {
+    _logger->log(LOGGING_ERROR,
+                 "[TensorRecorder] open() failure: interval should be at "
+                 "least 1");
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_file != nullptr) {
+    _logger->log(LOGGING_ERROR,
+                 "[TensorRecorder] open() failure: already open");
+    return RESULT_FAILURE_OTHER;
+  }
+
+  std::FILE* file = std::fopen(filepath.c_str(), "wb");
+  if (file == nullptr) {
+    _logger->logf(LOGGING_ERROR,
+                  "[TensorRecorder] open() failure: could not open "
+                  "file '%s'",
+                  filepath.c_str());
+    return RESULT_FAILURE_FILESYSTEM_ERROR;
+  }
+  if (std::fwrite("YV5T", 1, 4, file) != 4 ||
+      std::fwrite(&CAPTURE_VERSION, sizeof(CAPTURE_VERSION), 1, file) != 1) {
+    _logger->log(LOGGING_ERROR,
+                 "[TensorRecorder] open() failure: could not write header");
+    std::fclose(file);
+    return RESULT_FAILURE_FILESYSTEM_ERROR;
+  }
+
+  _file = file;
+  _options = options;
+  _numCalls = 0;
+  _numRecorded = 0;
+  _bytesWritten = FILE_HEADER_SIZE;
+  _full = false;
+  return RESULT_SUCCESS;
+}
+
+bool TensorRecorder::isOpen() const noexcept {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _file != nullptr;
+}
+
+bool TensorRecorder::shouldRecord() noexcept {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_file == nullptr || _full) {
+    return false;
+  }
+  return (_numCalls++ % _options.interval) == 0;
+}
+
+const TensorRecorderOptions& TensorRecorder::options() const noexcept {
+  return _options;
+}
+
+Result TensorRecorder::record(const TensorFrame& frame) noexcept {
+  const int numImages = frame.numImages;
+  if (numImages < 1 || (int)frame.transforms.size() != numImages ||
+      (int)frame.detections.size() != numImages || frame.output == nullptr ||
+      frame.outputDims.nbDims != 3 ||
+      (frame.input != nullptr && frame.inputDims.nbDims != 4)) {
+    if (_logger) {
+      _logger->log(LOGGING_ERROR,
+                   "[TensorRecorder] record() failure: invalid frame");
+    }
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+
+  RecordHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.scoreThreshold = frame.scoreThreshold;
+  header.nmsThreshold = frame.nmsThreshold;
+  header.numImages = numImages;
+  for (int i = 0; i < 3; ++i) {
+    header.outputDims[i] = frame.outputDims.d[i];
+  }
+  const bool hasInput = frame.input != nullptr && _options.recordInput;
+  if (hasInput) {
+    for (int i = 0; i < 4; ++i) {
+      header.inputDims[i] = frame.inputDims.d[i];
+    }
+  }
+
+  std::vector<TransformRecord> transforms(numImages);
+  std::vector<DetectionRecord> detections;
+  try {
+    for (int i = 0; i < numImages; ++i) {
+      const internal::PreprocessorTransform& t = frame.transforms[i];
+      transforms[i].inputWidth = t.inputSize().width;
+      transforms[i].inputHeight = t.inputSize().height;
+      transforms[i].leftWidth = t.leftWidth();
+      transforms[i].topHeight = t.topHeight();
+      transforms[i].scale = t.scale();
+
+      for (const Detection& det : frame.detections[i]) {
+        DetectionRecord d;
+        d.image = i;
+        d.classId = det.classId();
+        d.x = det.boundingBox().x;
+        d.y = det.boundingBox().y;
+        d.width = det.boundingBox().width;
+        d.height = det.boundingBox().height;
+        d.score = det.score();
+        detections.push_back(d);
+      }
+    }
+  } catch (const std::exception& e) {
+    if (_logger) {
+      _logger->logf(LOGGING_ERROR,
+                    "[TensorRecorder] record() failure: got exception: %s",
+                    e.what());
+    }
+    return RESULT_FAILURE_ALLOC;
+  }
+  header.numDetections = detections.size();
+
+  size_t inputBytes = 0, outputBytes = 0;
+  if ((hasInput &&
+       !tensorBytes(header.inputDims, 4, SIZE_MAX / 4, &inputBytes)) ||
+      !tensorBytes(header.outputDims, 3, SIZE_MAX / 4, &outputBytes)) {
+    if (_logger) {
+      _logger->log(LOGGING_ERROR,
+                   "[TensorRecorder] record() failure: invalid tensor "
+                   "dimensions");
+    }
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+  const size_t size = sizeof(RecordHeader) +
+                      transforms.size() * sizeof(TransformRecord) +
+                      detections.size() * sizeof(DetectionRecord) +
+                      inputBytes + outputBytes;
+  header.size = alignTo8(size);
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_file == nullptr || _full) {
+    return RESULT_FAILURE_NOT_INITIALIZED;
+  }
+  if (_options.maxBytes > 0 &&
+      _bytesWritten + header.size > _options.maxBytes) {
+    _full = true;
+    _logger->logf(LOGGING_WARNING,
+                  "[TensorRecorder] record() warning: capture file reached "
+                  "%lu bytes; recording stopped",
+                  (unsigned long)_bytesWritten);
+    return RESULT_SUCCESS;
+  }
+  header.sequence = _numRecorded;
+
+  const uint64_t padding = 0;
+  if (std::fwrite(&header, sizeof(header), 1, _file) != 1 ||
+      std::fwrite(transforms.data(), sizeof(TransformRecord),
+                  transforms.size(), _file) != transforms.size() ||
+      std::fwrite(detections.data(), sizeof(DetectionRecord),
+                  detections.size(), _file) != detections.size() ||
+      std::fwrite(frame.input, 1, inputBytes, _file) != inputBytes ||
+      std::fwrite(frame.output, 1, outputBytes, _file) != outputBytes ||
+      std::fwrite(&padding, 1, header.size - size, _file) !=
+          header.size - size) {
+    _logger->log(LOGGING_ERROR,
+                 "[TensorRecorder] record() failure: could not write to "
+                 "capture file");
+    return RESULT_FAILURE_FILESYSTEM_ERROR;
+  }
+  _numRecorded += 1;
+  _bytesWritten += header.size;
+  return RESULT_SUCCESS;
+}
+
+Result TensorRecorder::close() noexcept {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_file == nullptr) {
+    return RESULT_SUCCESS;
+  }
+  const int r = std::fclose(_file);
+  _file = nullptr;
+  if (r != 0) {
+    _logger->log(LOGGING_ERROR,
+                 "[TensorRecorder] close() failure: could not flush "
+                 "capture file");
+    return RESULT_FAILURE_FILESYSTEM_ERROR;
+  }
+  return RESULT_SUCCESS;
+}
+
+uint64_t TensorRecorder::numRecorded() const noexcept {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _numRecorded;
+}
+
+uint64_t TensorRecorder::bytesWritten() const noexcept {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _bytesWritten;
+}
+
+void TensorRecorder::setLogger(std::shared_ptr<Logger> logger) noexcept {
+  _logger = logger;
+}
+
+TensorCapture::TensorCapture() noexcept : _mapping(nullptr), _size(0) {}
+
+TensorCapture::~TensorCapture() noexcept { close(); }
+
+Result TensorCapture::open(const std::string& filepath) noexcept {
+  if (!_logger) {
+    try {
+      _logger = std::make_shared<Logger>();
+    } catch (const std::exception& e) {
+      return RESULT_FAILURE_ALLOC;
+    }
+  }
+  close();
+
+  const int fd = ::open(filepath.c_str(), O_RDONLY);
+  if (fd < 0) {
+    _logger->logf(LOGGING_ERROR,
+                  "[TensorCapture] open() failure: could not open "
+                  "file '%s'",
+                  filepath.c_str());
+    return RESULT_FAILURE_FILESYSTEM_ERROR;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < FILE_HEADER_SIZE) {
+    _logger->logf(LOGGING_ERROR,
+                  "[TensorCapture] open() failure: '%s' is not a capture "
+                  "file",
+                  filepath.c_str());
+    ::close(fd);
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+  void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    _logger->logf(LOGGING_ERROR,
+                  "[TensorCapture] open() failure: could not map '%s'",
+                  filepath.c_str());
+    return RESULT_FAILURE_FILESYSTEM_ERROR;
+  }
+  _mapping = mapping;
+  _size = st.st_size;
+
+  const char* data = (const char*)_mapping;
+  uint32_t version = 0;
+  std::memcpy(&version, data + 4, sizeof(version));
+  if (std::memcmp(data, "YV5T", 4) != 0 || version != CAPTURE_VERSION) {
+    _logger->logf(LOGGING_ERROR,
+                  "[TensorCapture] open() failure: '%s' is not a capture "
+                  "file of version %u",
+                  filepath.c_str(), CAPTURE_VERSION);
+    close();
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+
+  /*  Index the records. A truncated last record, e.g. of a process that
+      was killed while recording, is ignored  */
+  size_t offset = FILE_HEADER_SIZE;
+  try {
+    while (offset + sizeof(RecordHeader) <= _size) {
+      const RecordHeader* header = (const RecordHeader*)(data + offset);
+      const char* ptr = data + offset + sizeof(RecordHeader);
+
+      /*  Every part must fit in the file, which bounds all sizes and
+          keeps their sum from overflowing  */
+      const size_t numTransforms = MAX(0, header->numImages);
+      const size_t numDetections = MAX(0, header->numDetections);
+      size_t inputBytes = 0, outputBytes = 0;
+      const bool validSizes =
+          numTransforms <= _size / sizeof(TransformRecord) &&
+          numDetections <= _size / sizeof(DetectionRecord) &&
+          tensorBytes(header->inputDims, 4, _size, &inputBytes) &&
+          tensorBytes(header->outputDims, 3, _size, &outputBytes);
+      const size_t size = sizeof(RecordHeader) +
+                          numTransforms * sizeof(TransformRecord) +
+                          numDetections * sizeof(DetectionRecord) +
+                          inputBytes + outputBytes;
+      if (!validSizes || header->numImages < 1 ||
+          header->numDetections < 0 ||
+          header->outputDims[0] != header->numImages || outputBytes == 0 ||
+          header->size < size || header->size % 8 != 0) {
+        _logger->logf(LOGGING_ERROR,
+                      "[TensorCapture] open() failure: corrupt record at "
+                      "offset %lu",
+                      (unsigned long)offset);
+        close();
+        return RESULT_FAILURE_INVALID_INPUT;
+      }
+      if (header->size > _size - offset) {
+        _logger->logf(LOGGING_WARNING,
+                      "[TensorCapture] open() warning: ignoring truncated "
+                      "record at offset %lu",
+                      (unsigned long)offset);
+        break;
+      }
+
+      _frames.emplace_back();
+      TensorFrame& frame = _frames.back();
+      frame.sequence = header->sequence;
+      frame.numImages = header->numImages;
+      frame.scoreThreshold = header->scoreThreshold;
+      frame.nmsThreshold = header->nmsThreshold;
+
+      const TransformRecord* transforms = (const TransformRecord*)ptr;
+      ptr += numTransforms * sizeof(TransformRecord);
+      for (size_t i = 0; i < numTransforms; ++i) {
+        const TransformRecord& t = transforms[i];
+        frame.transforms.push_back(internal::PreprocessorTransform(
+            cv::Size(t.inputWidth, t.inputHeight), t.scale, t.leftWidth,
+            t.topHeight));
+      }
+
+      frame.detections.resize(frame.numImages);
+      const DetectionRecord* detections = (const DetectionRecord*)ptr;
+      ptr += numDetections * sizeof(DetectionRecord);
+      for (size_t i = 0; i < numDetections; ++i) {
+        const DetectionRecord& d = detections[i];
+        if (d.image < 0 || d.image >= frame.numImages) {
+          continue;
+        }
+        frame.detections[d.image].push_back(Detection(
+            d.classId, cv::Rect(d.x, d.y, d.width, d.height), d.score));
+      }
+
+      if (inputBytes > 0) {
+        frame.inputDims.nbDims = 4;
+        for (int i = 0; i < 4; ++i) {
+          frame.inputDims.d[i] = header->inputDims[i];
+        }
+        frame.input = (const float*)ptr;
+        ptr += inputBytes;
+      }
+      frame.outputDims.nbDims = 3;
+      for (int i = 0; i < 3; ++i) {
+        frame.outputDims.d[i] = header->outputDims[i];
+      }
+      frame.output = (const float*)ptr;
+
+      offset += header->size;
+    }
+  } catch (const std::exception& e) {
+    _logger->logf(LOGGING_ERROR,
+                  "[TensorCapture] open() failure: got exception: %s",
+                  e.what());
+    close();
+    return RESULT_FAILURE_ALLOC;
+  }
+  return RESULT_SUCCESS;
+}
+
+void TensorCapture::close() noexcept {
+  _frames.clear();
+  if (_mapping != nullptr) {
+    munmap(_mapping, _size);
+    _mapping = nullptr;
+    _size = 0;
+  }
+}
+
+int TensorCapture::numFrames() const noexcept { return _frames.size(); }
+
+const TensorFrame& TensorCapture::frame(const int& index) const noexcept {
+  return _frames[index];
+}
+
+void TensorCapture::setLogger(std::shared_ptr<Logger> logger) noexcept {
+  _logger = logger;
+}
+
+} /*  namespace yolov5    */
\ No newline at end of file
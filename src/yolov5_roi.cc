@@ -0,0 +1,196 @@
+#include "yolov5_roi.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace yolov5 {
+
+RoiOptions::RoiOptions() noexcept
+    : fullFrameInterval(10),
+      padding(0.5),
+      minRegionScale(0.5),
+      maxCoverage(0.5) {}
+
+RoiStats::RoiStats() noexcept : frames(0), fullFrames(0), regions(0) {}
+
+double RoiStats::meanRegions() const noexcept {
+  const uint64_t regionFrames = frames - fullFrames;
+  if (regionFrames == 0) {
+    return 0.0;
+  }
+  return (double)regions / regionFrames;
+}
+
+RoiDetector::RoiDetector() noexcept
+    : _detector(nullptr),
+      _flags(0),
+      _framesSinceFullFrame(0),
+      _statsFrames(0),
+      _statsFullFrames(0),
+      _statsRegions(0) {}
+
+RoiDetector::~RoiDetector() noexcept {}
+
+Result RoiDetector::setup(Detector* detector, const RoiOptions& options,
+                          const int& flags) noexcept {
+  if (detector == nullptr || !detector->isEngineLoaded()) {
+    return RESULT_FAILURE_NOT_LOADED;
+  }
+  _logger = detector->logger();
+  if (options.fullFrameInterval < 1 || options.padding < 0.0 ||
+      options.minRegionScale <= 0.0 || options.maxCoverage <= 0.0) {
+    _logger->log(LOGGING_ERROR,
+                 "[RoiDetector] setup() failure: invalid options");
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+
+  _detector = detector;
+  _options = options;
+  _flags = flags;
+  reset();
+  _statsFrames = 0;
+  _statsFullFrames = 0;
+  _statsRegions = 0;
+  return RESULT_SUCCESS;
+}
+
+Result RoiDetector::detect(const cv::Mat& image,
+                           std::vector<Detection>* out) noexcept {
+  if (_detector == nullptr) {
+    return RESULT_FAILURE_NOT_INITIALIZED;
+  }
+  if (out == nullptr) {
+    _logger->log(LOGGING_ERROR,
+                 "[RoiDetector] detect() failure: invalid output");
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+
+  try {
+    bool fullFrame = _previous.empty() ||
+                     _framesSinceFullFrame + 1 >= _options.fullFrameInterval;
+    if (!fullFrame && !_computeRegions(image.size())) {
+      fullFrame = true;
+    }
+
+    if (fullFrame) {
+      _regions.clear();
+      const Result r = _detector->detect(image, out, _flags);
+      if (r != RESULT_SUCCESS) {
+        return r;
+      }
+      _framesSinceFullFrame = 0;
+      _statsFullFrames += 1;
+    } else {
+      _crops.clear();
+      for (const cv::Rect& region : _regions) {
+        _crops.push_back(image(region));
+      }
+      const Result r = _detector->detectBatch(_crops, &_results, _flags);
+      _crops.clear(); /*  release the references to the image   */
+      if (r != RESULT_SUCCESS) {
+        return r;
+      }
+
+      /*  The Detector maps the boxes back to the crops; a translation
+          maps them to the frame   */
+      out->clear();
+      for (size_t i = 0; i < _regions.size(); ++i) {
+        const cv::Rect& region = _regions[i];
+        const internal::PreprocessorTransform transform(
+            image.size(), 1.0, -region.x, -region.y);
+        for (Detection& detection : _results[i]) {
+          detection.setBoundingBox(
+              transform.transformBbox(detection.boundingBox()));
+          out->push_back(std::move(detection));
+        }
+      }
+      _framesSinceFullFrame += 1;
+      _statsRegions += _regions.size();
+    }
+
+    _previous = *out;
+  } catch (const std::exception& e) {
+    _logger->logf(LOGGING_ERROR,
+                  "[RoiDetector] detect() failure: got exception: %s",
+                  e.what());
+    return RESULT_FAILURE_OPENCV_ERROR;
+  }
+  _statsFrames += 1;
+  return RESULT_SUCCESS;
+}
+
+void RoiDetector::reset() noexcept {
+  _previous.clear();
+  _regions.clear();
+  _framesSinceFullFrame = 0;
+}
+
+const std::vector<cv::Rect>& RoiDetector::regions() const noexcept {
+  return _regions;
+}
+
+RoiStats RoiDetector::stats() const noexcept {
+  RoiStats stats;
+  stats.frames = _statsFrames;
+  stats.fullFrames = _statsFullFrames;
+  stats.regions = _statsRegions;
+  return stats;
+}
+
+bool RoiDetector::_computeRegions(const cv::Size& imageSize) {
+  _regions.clear();
+  const cv::Size networkSize = _detector->inferenceSize();
+  if (_previous.empty() || networkSize.area() == 0) {
+    return false;
+  }
+
+  /*  Regions have the aspect ratio of the network input, so that they
+      are letterboxed without padding, unless clipped by the image  */
+  for (const Detection& detection : _previous) {
+    const cv::Rect& box = detection.boundingBox();
+    const double width = box.width * (1.0 + 2 * _options.padding);
+    const double height = box.height * (1.0 + 2 * _options.padding);
+    const double scale =
+        std::max({width / networkSize.width, height / networkSize.height,
+                  _options.minRegionScale});
+    const int regionWidth = std::min(
+        (int)std::ceil(scale * networkSize.width), imageSize.width);
+    const int regionHeight = std::min(
+        (int)std::ceil(scale * networkSize.height), imageSize.height);
+
+    const int cx = box.x + box.width / 2;
+    const int cy = box.y + box.height / 2;
+    const int x = std::max(
+        0, std::min(cx - regionWidth / 2, imageSize.width - regionWidth));
+    const int y = std::max(
+        0, std::min(cy - regionHeight / 2, imageSize.height - regionHeight));
+    _regions.emplace_back(x, y, regionWidth, regionHeight);
+  }
+
+  /*  Merge overlapping regions, so that every object is detected once  */
+  bool merged = true;
+  while (merged) {
+    merged = false;
+    for (size_t i = 0; i < _regions.size() && !merged; ++i) {
+      for (size_t j = i + 1; j < _regions.size(); ++j) {
+        if ((_regions[i] & _regions[j]).area() > 0) {
+          _regions[i] |= _regions[j];
+          _regions.erase(_regions.begin() + j);
+          merged = true;
+          break;
+        }
+      }
+    }
+  }
+
+  if ((int)_regions.size() > _detector->batchSize()) {
+    return false;
+  }
+  int64_t area = 0;
+  for (const cv::Rect& region : _regions) {
+    area += region.area();
+  }
+  return area <= _options.maxCoverage * imageSize.area();
+}
+
+} /*  namespace yolov5    */
\ No newline at end of file
@@ -0,0 +1,178 @@
+#include "yolov5_startup.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace yolov5 {
+
+StartupTimeline::StartupTimeline() noexcept
+    : _startTime(std::chrono::steady_clock::now()) {}
+
+StartupTimeline::~StartupTimeline() noexcept {}
+
+int StartupTimeline::begin(const std::string& name) noexcept {
+  const double start = elapsed();
+  try {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _phases.push_back(Phase{name, start, -1.0});
+    return (int)_phases.size() - 1;
+  } catch (const std::exception& e) {
+    return -1;
+  }
+}
+
+void StartupTimeline::end(const int& id) noexcept {
+  const double end = elapsed();
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (id >= 0 && id < (int)_phases.size()) {
+    _phases[id].end = end;
+  }
+}
+
+void StartupTimeline::mark(const std::string& name) noexcept {
+  end(begin(name));
+}
+
+double StartupTimeline::elapsed() const noexcept {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - _startTime)
+      .count();
+}
+
+std::vector<StartupTimeline::Phase> StartupTimeline::phases() const noexcept {
+  try {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _phases;
+  } catch (const std::exception& e) {
+    return std::vector<Phase>();
+  }
+}
+
+bool StartupTimeline::toString(std::string* out) const noexcept {
+  std::vector<Phase> lst = phases();
+  std::stable_sort(lst.begin(), lst.end(),
+                   [](const Phase& a, const Phase& b) {
+                     return a.start < b.start;
+                   });
+
+  try {
+    std::string str = "Startup timeline (ms):\n";
+    char buffer[256];
+    for (const Phase& phase : lst) {
+      if (phase.end < 0) {
+        std::snprintf(buffer, sizeof(buffer), "  %9.1f - %9s  %s\n",
+                      phase.start, "...", phase.name.c_str());
+      } else if (phase.end == phase.start) {
+        std::snprintf(buffer, sizeof(buffer), "  %9.1f %22s\n", phase.start,
+                      phase.name.c_str());
+      } else {
+        std::snprintf(buffer, sizeof(buffer), "  %9.1f - %9.1f  %s (%.1f)\n",
+                      phase.start, phase.end, phase.name.c_str(),
+                      phase.end - phase.start);
+      }
+      str += buffer;
+    }
+    *out = str;
+  } catch (const std::exception& e) {
+    return false;
+  }
+  return true;
+}
+
+FrameRing::FrameRing() noexcept
+    : _dropOldest(false),
+      _head(0),
+      _size(0),
+      _closed(false),
+      _numDropped(0) {}
+
+FrameRing::~FrameRing() noexcept {}
+
+bool FrameRing::setup(const int& capacity, const bool& dropOldest) noexcept {
+  if (capacity < 1) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(_mutex);
+  try {
+    _frames.resize(capacity);
+  } catch (const std::exception& e) {
+    return false;
+  }
+  _dropOldest = dropOldest;
+  _head = 0;
+  _size = 0;
+  _closed = false;
+  _numDropped = 0;
+  return true;
+}
+
+bool FrameRing::push(cv::Mat* frame) noexcept {
+  std::unique_lock<std::mutex> lock(_mutex);
+  const int capacity = (int)_frames.size();
+  if (!_dropOldest) {
+    _cv.wait(lock, [this, capacity]() { return _closed || _size < capacity; });
+  }
+  if (_closed || capacity == 0) {
+    return false;
+  }
+
+  if (_size == capacity) {
+    /*  Replace the oldest frame    */
+    _head = (_head + 1) % capacity;
+    _size -= 1;
+    _numDropped += 1;
+  }
+  const int tail = (_head + _size) % capacity;
+  cv::swap(_frames[tail], *frame);
+  _size += 1;
+
+  lock.unlock();
+  _cv.notify_all();
+  return true;
+}
+
+bool FrameRing::pop(cv::Mat* frame) noexcept {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _cv.wait(lock, [this]() { return _closed || _size > 0; });
+  if (_size == 0) {
+    return false;
+  }
+
+  cv::swap(_frames[_head], *frame);
+  _head = (_head + 1) % (int)_frames.size();
+  _size -= 1;
+
+  lock.unlock();
+  _cv.notify_all();
+  return true;
+}
+
+void FrameRing::close() noexcept {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _closed = true;
+  }
+  _cv.notify_all();
+}
+
+bool FrameRing::isClosed() const noexcept {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _closed;
+}
+
+int FrameRing::size() const noexcept {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _size;
+}
+
+int FrameRing::capacity() const noexcept {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return (int)_frames.size();
+}
+
+uint64_t FrameRing::numDropped() const noexcept {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _numDropped;
+}
+
+} /*  namespace yolov5    */
\ No newline at end of file
@@ -0,0 +1,206 @@
+#include "yolov5_stats.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace yolov5 {
+
+LatencyHistogram::LatencyHistogram() noexcept { reset(); }
+
+LatencyHistogram::~LatencyHistogram() noexcept {}
+
+void LatencyHistogram::record(const uint64_t& value) noexcept {
+  _buckets[bucketIndex(value)] += 1;
+  _count += 1;
+  _sum += (double)value;
+  if (value < _min) {
+    _min = value;
+  }
+  if (value > _max) {
+    _max = value;
+  }
+}
+
+void LatencyHistogram::record(const uint64_t& value,
+                              const uint64_t& times) noexcept {
+  if (times == 0) {
+    return;
+  }
+  _buckets[bucketIndex(value)] += times;
+  _count += times;
+  _sum += (double)value * (double)times;
+  if (value < _min) {
+    _min = value;
+  }
+  if (value > _max) {
+    _max = value;
+  }
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) noexcept {
+  for (int i = 0; i < NUM_BUCKETS; ++i) {
+    _buckets[i] += other._buckets[i];
+  }
+  _count += other._count;
+  _sum += other._sum;
+  if (other._min < _min) {
+    _min = other._min;
+  }
+  if (other._max > _max) {
+    _max = other._max;
+  }
+}
+
+void LatencyHistogram::reset() noexcept {
+  std::memset(_buckets, 0, sizeof(_buckets));
+  _count = 0;
+  _min = UINT64_MAX;
+  _max = 0;
+  _sum = 0.0;
+}
+
+uint64_t LatencyHistogram::count() const noexcept { return _count; }
+
+uint64_t LatencyHistogram::min() const noexcept {
+  return _count > 0 ? _min : 0;
+}
+
+uint64_t LatencyHistogram::max() const noexcept { return _max; }
+
+double LatencyHistogram::mean() const noexcept {
+  return _count > 0 ? _sum / (double)_count : 0.0;
+}
+
+uint64_t LatencyHistogram::percentile(const double& p) const noexcept {
+  if (_count == 0) {
+    return 0;
+  }
+  const double clamped = p < 0.0 ? 0.0 : (p > 1.0 ? 1.0 : p);
+  uint64_t rank = (uint64_t)(clamped * (double)_count + 0.5);
+  if (rank < 1) {
+    rank = 1;
+  }
+
+  uint64_t seen = 0;
+  for (int i = 0; i < NUM_BUCKETS; ++i) {
+    seen += _buckets[i];
+    if (seen >= rank) {
+      /*  The bucket value may exceed the actual values   */
+      const uint64_t value = bucketValue(i);
+      return value < _min ? _min : (value > _max ? _max : value);
+    }
+  }
+  return _max;
+}
+
+bool LatencyHistogram::toString(std::string* out) const noexcept {
+  char buffer[256];
+  std::snprintf(buffer, sizeof(buffer),
+                "n=%lu mean=%.2f p50=%.2f p90=%.2f p99=%.2f p99.9=%.2f "
+                "max=%.2f (ms)",
+                (unsigned long)_count, mean() / 1000.0,
+                percentile(0.5) / 1000.0, percentile(0.9) / 1000.0,
+                percentile(0.99) / 1000.0, percentile(0.999) / 1000.0,
+                max() / 1000.0);
+  try {
+    *out = buffer;
+  } catch (const std::exception& e) {
+    return false;
+  }
+  return true;
+}
+
+int LatencyHistogram::bucketIndex(const uint64_t& value) noexcept {
+  if (value < (uint64_t)SUB_BUCKETS) {
+    return (int)value;
+  }
+  /*  position of the highest bit, >= SUB_BUCKET_BITS  */
+  const int msb = 63 - __builtin_clzll(value);
+  const int shift = msb - SUB_BUCKET_BITS;
+  const int sub = (int)((value >> shift) & (SUB_BUCKETS - 1));
+  return (shift + 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t LatencyHistogram::bucketValue(const int& index) noexcept {
+  if (index < SUB_BUCKETS) {
+    return (uint64_t)index;
+  }
+  /*  middle of the range covered by the bucket  */
+  const int shift = index / SUB_BUCKETS - 1;
+  const uint64_t sub = (uint64_t)(index % SUB_BUCKETS) + SUB_BUCKETS;
+  return (sub << shift) + ((uint64_t)1 << shift) / 2;
+}
+
+uint64_t LatencyHistogram::bucketMax(const int& index) noexcept {
+  if (index < SUB_BUCKETS) {
+    return (uint64_t)index;
+  }
+  /*  note: does not overflow for the last bucket, whose maximum is
+      2^64 - 1  */
+  const int shift = index / SUB_BUCKETS - 1;
+  const uint64_t sub = (uint64_t)(index % SUB_BUCKETS) + SUB_BUCKETS;
+  return (sub << shift) + (((uint64_t)1 << shift) - 1);
+}
+
+LinearTrend::LinearTrend() noexcept { reset(); }
+
+LinearTrend::~LinearTrend() noexcept {}
+
+void LinearTrend::add(const double& x, const double& y) noexcept {
+  if (_count == 0) {
+    _x0 = x;
+  }
+  const double dx = x - _x0;
+  _count += 1;
+  _sumX += dx;
+  _sumY += y;
+  _sumXX += dx * dx;
+  _sumXY += dx * y;
+  _sumYY += y * y;
+}
+
+void LinearTrend::reset() noexcept {
+  _count = 0;
+  _x0 = 0.0;
+  _sumX = 0.0;
+  _sumY = 0.0;
+  _sumXX = 0.0;
+  _sumXY = 0.0;
+  _sumYY = 0.0;
+}
+
+uint64_t LinearTrend::count() const noexcept { return _count; }
+
+double LinearTrend::slope() const noexcept {
+  const double n = (double)_count;
+  const double varX = n * _sumXX - _sumX * _sumX;
+  if (_count < 2 || varX <= 0.0) {
+    return 0.0;
+  }
+  return (n * _sumXY - _sumX * _sumY) / varX;
+}
+
+double LinearTrend::intercept() const noexcept {
+  if (_count == 0) {
+    return 0.0;
+  }
+  return (_sumY - slope() * _sumX) / (double)_count;
+}
+
+double LinearTrend::rSquared() const noexcept {
+  const double n = (double)_count;
+  const double varX = n * _sumXX - _sumX * _sumX;
+  const double varY = n * _sumYY - _sumY * _sumY;
+  if (_count < 2 || varX <= 0.0 || varY <= 0.0) {
+    return 0.0;
+  }
+  const double covXY = n * _sumXY - _sumX * _sumY;
+  const double r2 = (covXY * covXY) / (varX * varY);
+  return r2 > 1.0 ? 1.0 : r2;
+}
+
+double LinearTrend::meanY() const noexcept {
+  return _count == 0 ? 0.0 : _sumY / (double)_count;
+}
+
+} /*  namespace yolov5    */
\ No newline at end of file
@@ -0,0 +1,259 @@
+#include "yolov5_trace.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace yolov5 {
+
+namespace {
+
+struct Span {
+  const char* name;
+  int64_t begin;
+  int64_t end;
+  uint64_t frame;
+};
+
+/*  Spans of a single thread. The lock is only contended while exporting  */
+struct ThreadRing {
+  int id;
+  std::string name;
+
+  std::mutex mutex;
+  std::vector<Span> spans;
+  uint64_t count; /**<    number of spans ever recorded   */
+  bool finished;  /**<    the thread has exited   */
+};
+
+struct Registry {
+  Registry() noexcept : capacity(16384), nextId(1) {}
+
+  std::mutex mutex;
+  std::vector<std::shared_ptr<ThreadRing>> rings;
+  int capacity;
+  int nextId;
+};
+
+Registry& registry() noexcept {
+  static Registry instance;
+  return instance;
+}
+
+/*  Drop the rings of threads that have exited; they are only kept until
+    their spans have been exported or cleared   */
+void dropFinishedRings(
+    const std::vector<std::shared_ptr<ThreadRing>>& finished) noexcept {
+  if (finished.empty()) {
+    return;
+  }
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  reg.rings.erase(std::remove_if(reg.rings.begin(), reg.rings.end(),
+                                 [&](const std::shared_ptr<ThreadRing>& r) {
+                                   return std::find(finished.begin(),
+                                                    finished.end(),
+                                                    r) != finished.end();
+                                 }),
+                  reg.rings.end());
+}
+
+/*  Rings are shared with the registry, so that the spans of threads that
+    have finished can still be exported  */
+struct ThreadState {
+  ThreadState() noexcept : frame(0) {}
+
+  ~ThreadState() noexcept {
+    if (ring) {
+      std::lock_guard<std::mutex> lock(ring->mutex);
+      ring->finished = true;
+    }
+  }
+
+  std::shared_ptr<ThreadRing> ring;
+  uint64_t frame;
+};
+
+thread_local ThreadState threadState;
+
+ThreadRing* currentRing() noexcept {
+  if (!threadState.ring) {
+    Registry& reg = registry();
+    try {
+      std::shared_ptr<ThreadRing> ring = std::make_shared<ThreadRing>();
+      std::lock_guard<std::mutex> lock(reg.mutex);
+      ring->id = reg.nextId++;
+      ring->spans.resize(reg.capacity);
+      ring->count = 0;
+      ring->finished = false;
+      reg.rings.push_back(ring);
+      threadState.ring = ring;
+    } catch (const std::exception& e) {
+      return nullptr;
+    }
+  }
+  return threadState.ring.get();
+}
+
+void writeEscaped(std::FILE* file, const std::string& str) noexcept {
+  for (const char& c : str) {
+    if (c == '"' || c == '\\') {
+      std::fputc('\\', file);
+      std::fputc(c, file);
+    } else if ((unsigned char)c >= 0x20) {
+      std::fputc(c, file);
+    }
+  }
+}
+
+} /*  namespace   */
+
+std::atomic<bool> Tracer::_enabled(false);
+
+void Tracer::setEnabled(const bool& enabled) noexcept {
+  _enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Tracer::setFrame(const uint64_t& frame) noexcept {
+  threadState.frame = frame;
+}
+
+void Tracer::setThreadName(const std::string& name) noexcept {
+  ThreadRing* ring = currentRing();
+  if (ring == nullptr) {
+    return;
+  }
+  try {
+    std::lock_guard<std::mutex> lock(ring->mutex);
+    ring->name = name;
+  } catch (const std::exception& e) {
+  }
+}
+
+void Tracer::setRingCapacity(const int& capacity) noexcept {
+  if (capacity < 1) {
+    return;
+  }
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  reg.capacity = capacity;
+}
+
+void Tracer::record(const char* name, const int64_t& begin,
+                    const int64_t& end) noexcept {
+  ThreadRing* ring = currentRing();
+  if (ring == nullptr) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(ring->mutex);
+  Span& span = ring->spans[ring->count % ring->spans.size()];
+  span.name = name;
+  span.begin = begin;
+  span.end = end;
+  span.frame = threadState.frame;
+  ring->count += 1;
+}
+
+Result Tracer::exportChromeTrace(const std::string& filepath) noexcept {
+  /*  Take a copy of every ring, holding each lock only briefly  */
+  std::vector<std::shared_ptr<ThreadRing>> rings;
+  std::vector<std::shared_ptr<ThreadRing>> finished;
+  std::vector<std::vector<Span>> spans;
+  std::vector<std::string> names;
+  try {
+    Registry& reg = registry();
+    {
+      std::lock_guard<std::mutex> lock(reg.mutex);
+      rings = reg.rings;
+    }
+    for (const auto& ring : rings) {
+      std::lock_guard<std::mutex> lock(ring->mutex);
+      const size_t capacity = ring->spans.size();
+      const size_t size = (size_t)std::min<uint64_t>(ring->count, capacity);
+      std::vector<Span> lst;
+      lst.reserve(size);
+      for (uint64_t i = ring->count - size; i < ring->count; ++i) {
+        lst.push_back(ring->spans[i % capacity]);
+      }
+      spans.push_back(std::move(lst));
+      names.push_back(ring->name);
+      if (ring->finished) {
+        finished.push_back(ring);
+      }
+    }
+  } catch (const std::exception& e) {
+    return RESULT_FAILURE_ALLOC;
+  }
+
+  int64_t origin = INT64_MAX;
+  for (const auto& lst : spans) {
+    for (const Span& span : lst) {
+      origin = std::min(origin, span.begin);
+    }
+  }
+
+  std::FILE* file = std::fopen(filepath.c_str(), "w");
+  if (file == nullptr) {
+    return RESULT_FAILURE_FILESYSTEM_ERROR;
+  }
+
+  /*  Timestamps are in microseconds, with nanosecond decimals   */
+  std::fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+  std::fprintf(file,
+               "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+               "\"args\":{\"name\":\"yolov5\"}}");
+  for (size_t i = 0; i < rings.size(); ++i) {
+    if (!names[i].empty()) {
+      std::fprintf(file,
+                   ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                   "\"tid\":%i,\"args\":{\"name\":\"",
+                   rings[i]->id);
+      writeEscaped(file, names[i]);
+      std::fprintf(file, "\"}}");
+    }
+    for (const Span& span : spans[i]) {
+      std::fprintf(file, ",\n{\"name\":\"");
+      writeEscaped(file, span.name);
+      std::fprintf(file,
+                   "\",\"cat\":\"yolov5\",\"ph\":\"X\",\"pid\":1,"
+                   "\"tid\":%i,\"ts\":%.3f,\"dur\":%.3f,"
+                   "\"args\":{\"frame\":%" PRIu64 "}}",
+                   rings[i]->id, (span.begin - origin) / 1000.0,
+                   (span.end - span.begin) / 1000.0, span.frame);
+    }
+  }
+  std::fprintf(file, "\n]}\n");
+
+  const bool ok = !std::ferror(file);
+  if (std::fclose(file) != 0 || !ok) {
+    return RESULT_FAILURE_FILESYSTEM_ERROR;
+  }
+  dropFinishedRings(finished);
+  return RESULT_SUCCESS;
+}
+
+void Tracer::clear() noexcept {
+  std::vector<std::shared_ptr<ThreadRing>> rings;
+  std::vector<std::shared_ptr<ThreadRing>> finished;
+  try {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    rings = reg.rings;
+    finished.reserve(rings.size());
+  } catch (const std::exception& e) {
+    return;
+  }
+  for (const auto& ring : rings) {
+    std::lock_guard<std::mutex> lock(ring->mutex);
+    ring->count = 0;
+    if (ring->finished) {
+      finished.push_back(ring);
+    }
+  }
+  dropFinishedRings(finished);
+}
+
+} /*  namespace yolov5    */
\ No newline at end of file
@@ -0,0 +1,552 @@
+#include "yolov5_tracker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace yolov5 {
+
+namespace {
+
+/*  Noise of the motion model, relative to the height of the box   */
+const double SIGMA_POSITION = 1.0 / 20;
+const double SIGMA_VELOCITY = 1.0 / 160;
+
+double iou(const cv::Rect2d& a, const cv::Rect2d& b) noexcept {
+  const double w =
+      std::min(a.x + a.width, b.x + b.width) - std::max(a.x, b.x);
+  const double h =
+      std::min(a.y + a.height, b.y + b.height) - std::max(a.y, b.y);
+  if (w <= 0 || h <= 0) {
+    return 0.0;
+  }
+  const double intersection = w * h;
+  return intersection / (a.area() + b.area() - intersection);
+}
+
+int findRoot(std::vector<int>* parent, int i) noexcept {
+  std::vector<int>& p = *parent;
+  while (p[i] != i) {
+    p[i] = p[p[i]];
+    i = p[i];
+  }
+  return i;
+}
+
+} /*  namespace   */
+
+TrackerOptions::TrackerOptions() noexcept
+    : detectionInterval(3),
+      minConfidence(0.3),
+      confidenceDecay(0.9),
+      iouThreshold(0.3),
+      highScore(0.5),
+      lowScore(0.1),
+      minHits(2),
+      maxMisses(3) {}
+
+Track::Track() noexcept
+    : id(0),
+      classId(-1),
+      score(0.0),
+      confidence(0.0),
+      hits(0),
+      framesSinceUpdate(0) {}
+
+Detection Track::toDetection() const noexcept {
+  Detection detection(classId, boundingBox, confidence);
+  detection.setClassName(className);
+  return detection;
+}
+
+TrackerStats::TrackerStats() noexcept : frames(0), detectedFrames(0) {}
+
+double TrackerStats::skippedFraction() const noexcept {
+  if (frames == 0) {
+    return 0.0;
+  }
+  return 1.0 - (double)detectedFrames / frames;
+}
+
+void Tracker::KalmanAxis::init(const double& z, const double& sigmaP,
+                               const double& sigmaV) noexcept {
+  position = z;
+  velocity = 0.0;
+  p00 = 4 * sigmaP * sigmaP;
+  p01 = 0.0;
+  p11 = 100 * sigmaV * sigmaV;
+}
+
+void Tracker::KalmanAxis::predict(const double& qP,
+                                  const double& qV) noexcept {
+  /*  x = F x, P = F P F' + Q, with F = [1 1; 0 1]   */
+  position += velocity;
+  p00 += 2 * p01 + p11 + qP;
+  p01 += p11;
+  p11 += qV;
+}
+
+void Tracker::KalmanAxis::update(const double& z, const double& r) noexcept {
+  const double s = p00 + r;
+  const double k0 = p00 / s;
+  const double k1 = p01 / s;
+  const double y = z - position;
+  position += k0 * y;
+  velocity += k1 * y;
+  p11 -= k1 * p01;
+  p00 *= (1 - k0);
+  p01 *= (1 - k0);
+}
+
+Tracker::Tracker() noexcept
+    : _nextId(1),
+      _framesSinceDetection(0),
+      _statsFrames(0),
+      _statsDetectedFrames(0) {}
+
+Tracker::~Tracker() noexcept {}
+
+Result Tracker::setup(const TrackerOptions& options) noexcept {
+  if (options.detectionInterval < 1 || options.minHits < 1 ||
+      options.maxMisses < 0 || options.iouThreshold <= 0.0 ||
+      options.iouThreshold > 1.0 || options.lowScore > options.highScore ||
+      options.confidenceDecay <= 0.0 || options.confidenceDecay > 1.0) {
+    if (_logger) {
+      _logger->log(LOGGING_ERROR,
+                   "[Tracker] setup() failure: invalid options");
+    }
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+  _options = options;
+  reset();
+  return RESULT_SUCCESS;
+}
+
+bool Tracker::needsDetection() const noexcept {
+  if (_statsDetectedFrames == 0 ||
+      _framesSinceDetection + 1 >= _options.detectionInterval) {
+    return true;
+  }
+  for (const TrackState& state : _tracks) {
+    if (state.confirmed &&
+        state.track.confidence * _options.confidenceDecay <
+            _options.minConfidence) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Result Tracker::update(const std::vector<Detection>& detections,
+                       std::vector<Track>* out) noexcept {
+  try {
+    _statsFrames += 1;
+    _statsDetectedFrames += 1;
+    _framesSinceDetection = 0;
+    _predictTracks();
+
+    _high.clear();
+    _low.clear();
+    for (size_t i = 0; i < detections.size(); ++i) {
+      const double& score = detections[i].score();
+      if (score >= _options.highScore) {
+        _high.push_back((int)i);
+      } else if (score >= _options.lowScore) {
+        _low.push_back((int)i);
+      }
+    }
+
+    /*  First, all tracks against the confident detections; then, the
+        remaining confirmed tracks against the others (ByteTrack)  */
+    _trackMatch.assign(_tracks.size(), -1);
+    _unmatched.resize(_tracks.size());
+    for (size_t i = 0; i < _tracks.size(); ++i) {
+      _unmatched[i] = (int)i;
+    }
+    _associate(detections, &_unmatched, &_high);
+
+    _confirmed.clear();
+    for (const int& t : _unmatched) {
+      if (_tracks[t].confirmed) {
+        _confirmed.push_back(t);
+      }
+    }
+    _associate(detections, &_confirmed, &_low);
+
+    for (size_t i = 0; i < _tracks.size(); ++i) {
+      TrackState& state = _tracks[i];
+      if (_trackMatch[i] >= 0) {
+        _updateTrack(&state, detections[_trackMatch[i]]);
+      } else {
+        state.misses += 1;
+      }
+    }
+
+    /*  Remove lost tracks; tentative tracks are lost after one miss   */
+    const int maxMisses = _options.maxMisses;
+    _tracks.erase(std::remove_if(_tracks.begin(), _tracks.end(),
+                                 [maxMisses](const TrackState& state) {
+                                   return state.misses > maxMisses ||
+                                          (!state.confirmed &&
+                                           state.misses > 0);
+                                 }),
+                  _tracks.end());
+
+    /*  Unmatched confident detections start new tracks   */
+    for (const int& d : _high) {
+      const Detection& detection = detections[d];
+      const cv::Rect& box = detection.boundingBox();
+      const double h = std::max(box.height, 1);
+
+      TrackState state;
+      state.track.id = _nextId++;
+      state.track.classId = detection.classId();
+      state.track.className = detection.className();
+      state.axes[0].init(box.x + box.width / 2.0, SIGMA_POSITION * h,
+                         SIGMA_VELOCITY * h);
+      state.axes[1].init(box.y + box.height / 2.0, SIGMA_POSITION * h,
+                         SIGMA_VELOCITY * h);
+      state.axes[2].init(box.width, SIGMA_POSITION * h, SIGMA_VELOCITY * h);
+      state.axes[3].init(box.height, SIGMA_POSITION * h, SIGMA_VELOCITY * h);
+      state.confirmed = false;
+      state.misses = 0;
+      _updateTrack(&state, detection);
+      _tracks.push_back(std::move(state));
+    }
+
+    if (out != nullptr) {
+      _output(out);
+    }
+  } catch (const std::exception& e) {
+    if (_logger) {
+      _logger->logf(LOGGING_ERROR,
+                    "[Tracker] update() failure: got exception: %s",
+                    e.what());
+    }
+    return RESULT_FAILURE_ALLOC;
+  }
+  return RESULT_SUCCESS;
+}
+
+Result Tracker::predict(std::vector<Track>* out) noexcept {
+  _statsFrames += 1;
+  _framesSinceDetection += 1;
+  _predictTracks();
+  for (TrackState& state : _tracks) {
+    state.track.confidence *= _options.confidenceDecay;
+  }
+
+  if (out != nullptr) {
+    try {
+      _output(out);
+    } catch (const std::exception& e) {
+      if (_logger) {
+        _logger->logf(LOGGING_ERROR,
+                      "[Tracker] predict() failure: got exception: %s",
+                      e.what());
+      }
+      return RESULT_FAILURE_ALLOC;
+    }
+  }
+  return RESULT_SUCCESS;
+}
+
+void Tracker::reset() noexcept {
+  _tracks.clear();
+  _nextId = 1;
+  _framesSinceDetection = 0;
+  _statsFrames = 0;
+  _statsDetectedFrames = 0;
+}
+
+int Tracker::numTracks() const noexcept { return (int)_tracks.size(); }
+
+TrackerStats Tracker::stats() const noexcept {
+  TrackerStats stats;
+  stats.frames = _statsFrames;
+  stats.detectedFrames = _statsDetectedFrames;
+  return stats;
+}
+
+void Tracker::setLogger(std::shared_ptr<Logger> logger) noexcept {
+  _logger = logger;
+}
+
+void Tracker::_predictTracks() noexcept {
+  for (TrackState& state : _tracks) {
+    const double h = std::max(state.axes[3].position, 1.0);
+    const double qP = (SIGMA_POSITION * h) * (SIGMA_POSITION * h);
+    const double qV = (SIGMA_VELOCITY * h) * (SIGMA_VELOCITY * h);
+    for (KalmanAxis& axis : state.axes) {
+      axis.predict(qP, qV);
+    }
+
+    Track& track = state.track;
+    const double width = std::max(state.axes[2].position, 1.0);
+    const double height = std::max(state.axes[3].position, 1.0);
+    track.boundingBox =
+        cv::Rect((int)std::round(state.axes[0].position - width / 2),
+                 (int)std::round(state.axes[1].position - height / 2),
+                 (int)std::round(width), (int)std::round(height));
+    track.velocity =
+        cv::Point2d(state.axes[0].velocity, state.axes[1].velocity);
+    track.framesSinceUpdate += 1;
+  }
+}
+
+void Tracker::_associate(const std::vector<Detection>& detections,
+                         std::vector<int>* tracks,
+                         std::vector<int>* candidates) {
+  const int numTracks = (int)tracks->size();
+  const int numCandidates = (int)candidates->size();
+  if (numTracks == 0 || numCandidates == 0) {
+    return;
+  }
+
+  /*  Predicted boxes of the tracks, and candidates sorted on x  */
+  _boxes.resize(numTracks);
+  for (int a = 0; a < numTracks; ++a) {
+    const KalmanAxis* axes = _tracks[(*tracks)[a]].axes;
+    const double width = std::max(axes[2].position, 1.0);
+    const double height = std::max(axes[3].position, 1.0);
+    _boxes[a] = cv::Rect2d(axes[0].position - width / 2,
+                           axes[1].position - height / 2, width, height);
+  }
+  _order.resize(numCandidates);
+  int maxWidth = 0;
+  for (int b = 0; b < numCandidates; ++b) {
+    _order[b] = b;
+    maxWidth = std::max(
+        maxWidth, detections[(*candidates)[b]].boundingBox().width);
+  }
+  auto x = [&detections, candidates](const int& b) {
+    return detections[(*candidates)[b]].boundingBox().x;
+  };
+  std::sort(_order.begin(), _order.end(),
+            [&x](const int& lhs, const int& rhs) { return x(lhs) < x(rhs); });
+
+  /*  Pairs that may be associated: overlapping boxes of the same class.
+      Only the candidates in the x-range of the track are examined  */
+  _edges.clear();
+  _iou.clear();
+  for (int a = 0; a < numTracks; ++a) {
+    const cv::Rect2d& box = _boxes[a];
+    const int classId = _tracks[(*tracks)[a]].track.classId;
+    auto it = std::lower_bound(
+        _order.begin(), _order.end(), box.x - maxWidth,
+        [&x](const int& b, const double& value) { return x(b) < value; });
+    for (; it != _order.end() && x(*it) < box.x + box.width; ++it) {
+      const Detection& detection = detections[(*candidates)[*it]];
+      if (detection.classId() != classId) {
+        continue;
+      }
+      const cv::Rect& r = detection.boundingBox();
+      const double value = iou(box, cv::Rect2d(r.x, r.y, r.width, r.height));
+      if (value >= _options.iouThreshold) {
+        _edges.emplace_back(a, *it);
+        _iou.push_back(value);
+      }
+    }
+  }
+  if (_edges.empty()) {
+    return;
+  }
+
+  /*  Independent assignment problems: connected components of the
+      graph of pairs. Nodes are tracks [0, numTracks), then candidates  */
+  _parent.resize(numTracks + numCandidates);
+  for (size_t i = 0; i < _parent.size(); ++i) {
+    _parent[i] = (int)i;
+  }
+  for (const auto& edge : _edges) {
+    const int ra = findRoot(&_parent, edge.first);
+    const int rb = findRoot(&_parent, numTracks + edge.second);
+    if (ra != rb) {
+      _parent[ra] = rb;
+    }
+  }
+
+  /*  Edges grouped per component   */
+  _order.resize(_edges.size());
+  for (size_t i = 0; i < _edges.size(); ++i) {
+    _order[i] = (int)i;
+    _parent[_edges[i].first] = findRoot(&_parent, _edges[i].first);
+  }
+  std::sort(_order.begin(), _order.end(), [this](const int& lhs,
+                                                 const int& rhs) {
+    return _parent[_edges[lhs].first] < _parent[_edges[rhs].first];
+  });
+
+  std::vector<int>& trackOf = _rowIndex;
+  std::vector<int>& candidateOf = _colIndex;
+  trackOf.assign(numTracks, -1);
+  candidateOf.assign(numCandidates, -1);
+  std::vector<int> matches(numTracks, -1);
+
+  size_t begin = 0;
+  while (begin < _order.size()) {
+    const int root = _parent[_edges[_order[begin]].first];
+    size_t end = begin + 1;
+    while (end < _order.size() && _parent[_edges[_order[end]].first] == root) {
+      ++end;
+    }
+
+    if (end - begin == 1) {
+      const auto& edge = _edges[_order[begin]];
+      matches[edge.first] = edge.second;
+    } else {
+      /*  Dense cost matrix of the component, 1 - IoU, with the rows being
+          the smaller side  */
+      _rows.clear();
+      _cols.clear();
+      for (size_t i = begin; i < end; ++i) {
+        const auto& edge = _edges[_order[i]];
+        if (trackOf[edge.first] < 0) {
+          trackOf[edge.first] = (int)_rows.size();
+          _rows.push_back(edge.first);
+        }
+        if (candidateOf[edge.second] < 0) {
+          candidateOf[edge.second] = (int)_cols.size();
+          _cols.push_back(edge.second);
+        }
+      }
+      const bool transposed = _rows.size() > _cols.size();
+      const int rows = (int)std::min(_rows.size(), _cols.size());
+      const int cols = (int)std::max(_rows.size(), _cols.size());
+
+      /*  Pairs that cannot be associated have a cost above any valid
+          pair, so they are only chosen if there is no alternative  */
+      _cost.assign((size_t)rows * cols, 2.0);
+      for (size_t i = begin; i < end; ++i) {
+        const auto& edge = _edges[_order[i]];
+        int row = trackOf[edge.first];
+        int col = candidateOf[edge.second];
+        if (transposed) {
+          std::swap(row, col);
+        }
+        _cost[(size_t)row * cols + col] = 1.0 - _iou[_order[i]];
+      }
+      _solve(rows, cols);
+
+      for (int row = 0; row < rows; ++row) {
+        const int col = _assignment[row];
+        if (col < 0 || _cost[(size_t)row * cols + col] > 1.0) {
+          continue;
+        }
+        if (transposed) {
+          matches[_rows[col]] = _cols[row];
+        } else {
+          matches[_rows[row]] = _cols[col];
+        }
+      }
+    }
+    begin = end;
+  }
+
+  /*  Record the matches and remove them from the lists   */
+  for (int a = 0; a < numTracks; ++a) {
+    if (matches[a] >= 0) {
+      _trackMatch[(*tracks)[a]] = (*candidates)[matches[a]];
+      (*candidates)[matches[a]] = -1;
+      (*tracks)[a] = -1;
+    }
+  }
+  tracks->erase(std::remove(tracks->begin(), tracks->end(), -1),
+                tracks->end());
+  candidates->erase(std::remove(candidates->begin(), candidates->end(), -1),
+                    candidates->end());
+}
+
+void Tracker::_solve(const int& rows, const int& cols) {
+  /*  Hungarian algorithm with potentials, O(rows^2 * cols). Indices are
+      1-based; column 0 is a virtual column  */
+  const double INF = std::numeric_limits<double>::infinity();
+  _u.assign(rows + 1, 0.0);
+  _v.assign(cols + 1, 0.0);
+  _p.assign(cols + 1, 0);
+  _way.assign(cols + 1, 0);
+
+  for (int i = 1; i <= rows; ++i) {
+    _p[0] = i;
+    int j0 = 0;
+    _minv.assign(cols + 1, INF);
+    _used.assign(cols + 1, 0);
+    do {
+      _used[j0] = 1;
+      const int i0 = _p[j0];
+      double delta = INF;
+      int j1 = 0;
+      const double* costRow = &_cost[(size_t)(i0 - 1) * cols];
+      for (int j = 1; j <= cols; ++j) {
+        if (_used[j]) {
+          continue;
+        }
+        const double cur = costRow[j - 1] - _u[i0] - _v[j];
+        if (cur < _minv[j]) {
+          _minv[j] = cur;
+          _way[j] = j0;
+        }
+        if (_minv[j] < delta) {
+          delta = _minv[j];
+          j1 = j;
+        }
+      }
+      for (int j = 0; j <= cols; ++j) {
+        if (_used[j]) {
+          _u[_p[j]] += delta;
+          _v[j] -= delta;
+        } else {
+          _minv[j] -= delta;
+        }
+      }
+      j0 = j1;
+    } while (_p[j0] != 0);
+    do {
+      const int j1 = _way[j0];
+      _p[j0] = _p[j1];
+      j0 = j1;
+    } while (j0 != 0);
+  }
+
+  _assignment.assign(rows, -1);
+  for (int j = 1; j <= cols; ++j) {
+    if (_p[j] != 0) {
+      _assignment[_p[j] - 1] = j - 1;
+    }
+  }
+}
+
+void Tracker::_updateTrack(TrackState* state,
+                           const Detection& detection) noexcept {
+  const cv::Rect& box = detection.boundingBox();
+  const double h = std::max(box.height, 1);
+  const double r = (SIGMA_POSITION * h) * (SIGMA_POSITION * h);
+  state->axes[0].update(box.x + box.width / 2.0, r);
+  state->axes[1].update(box.y + box.height / 2.0, r);
+  state->axes[2].update(box.width, r);
+  state->axes[3].update(box.height, r);
+  state->misses = 0;
+
+  Track& track = state->track;
+  track.boundingBox = box;
+  track.velocity =
+      cv::Point2d(state->axes[0].velocity, state->axes[1].velocity);
+  track.score = detection.score();
+  track.confidence = detection.score();
+  track.hits += 1;
+  track.framesSinceUpdate = 0;
+  if (track.hits >= _options.minHits) {
+    state->confirmed = true;
+  }
+}
+
+void Tracker::_output(std::vector<Track>* out) const {
+  out->clear();
+  for (const TrackState& state : _tracks) {
+    if (state.confirmed) {
+      out->push_back(state.track);
+    }
+  }
+}
+
+} /*  namespace yolov5    */
\ No newline at end of file
@@ -0,0 +1,306 @@
+#include "yolov5_writer.h"
+
+#include <cstring>
+#include <type_traits>
+
+namespace yolov5 {
+
+namespace {
+
+const size_t WRITE_BUFFER_SIZE = 1 << 20;
+
+void appendJsonString(const std::string& str, std::string* out) {
+  out->push_back('"');
+  for (const char& c : str) {
+    if (c == '"' || c == '\\') {
+      out->push_back('\\');
+      out->push_back(c);
+    } else if ((unsigned char)c < 0x20) {
+      char buffer[8];
+      std::snprintf(buffer, sizeof(buffer), "\\u%04x", (unsigned char)c);
+      out->append(buffer);
+    } else {
+      out->push_back(c);
+    }
+  }
+  out->push_back('"');
+}
+
+/*  Byte by byte, so that the output is little-endian on any host  */
+template <typename T>
+void appendBinary(const T& value, std::string* out) {
+  static_assert(std::is_integral<T>::value, "expected an integer type");
+  const typename std::make_unsigned<T>::type bits = value;
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    out->push_back((char)((bits >> (8 * i)) & 0xff));
+  }
+}
+
+void appendBinary(const float& value, std::string* out) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  appendBinary(bits, out);
+}
+
+} /*  namespace   */
+
+DetectionWriter::DetectionWriter() noexcept
+    : _file(nullptr),
+      _format(DETECTION_FORMAT_JSONL),
+      _maxPending(0),
+      _numPending(0),
+      _closing(false),
+      _result(RESULT_SUCCESS),
+      _numFrames(0),
+      _numBytes(0) {}
+
+DetectionWriter::~DetectionWriter() noexcept { close(); }
+
+Result DetectionWriter::open(const std::string& filepath,
+                             const DetectionFormat& format,
+                             const int& maxPending) noexcept {
+  if (!_logger) {
+    try {
+      _logger = std::make_shared<Logger>();
+    } catch (const std::exception& e) {
+      return RESULT_FAILURE_ALLOC;
+    }
+  }
+  if (isOpen()) {
+    _logger->log(LOGGING_ERROR,
+                 "[DetectionWriter] open() failure: already open");
+    return RESULT_FAILURE_OTHER;
+  }
+  if (maxPending < 1) {
+    _logger->log(LOGGING_ERROR,
+                 "[DetectionWriter] open() failure: maximum number of "
+                 "pending frames should be at least 1");
+    return RESULT_FAILURE_INVALID_INPUT;
+  }
+
+  FILE* file = std::fopen(filepath.c_str(), "wb");
+  if (file == nullptr) {
+    _logger->logf(LOGGING_ERROR,
+                  "[DetectionWriter] open() failure: could not open "
+                  "file '%s'",
+                  filepath.c_str());
+    return RESULT_FAILURE_FILESYSTEM_ERROR;
+  }
+  std::setvbuf(file, nullptr, _IOFBF, WRITE_BUFFER_SIZE);
+
+  if (format == DETECTION_FORMAT_BINARY) {
+    /*  note: fits the small string buffer, does not allocate  */
+    std::string header("YV5D");
+    appendBinary((uint32_t)1, &header);
+    if (std::fwrite(header.data(), 1, header.size(), file) !=
+        header.size()) {
+      _logger->log(LOGGING_ERROR,
+                   "[DetectionWriter] open() failure: could not write "
+                   "header");
+      std::fclose(file);
+      return RESULT_FAILURE_FILESYSTEM_ERROR;
+    }
+  }
+
+  _file = file;
+  _format = format;
+  _maxPending = maxPending;
+  _numPending = 0;
+  _closing = false;
+  _result = RESULT_SUCCESS;
+  _numFrames = 0;
+  _numBytes = format == DETECTION_FORMAT_BINARY ? 8 : 0;
+
+  try {
+    _thread = std::thread(&DetectionWriter::_run, this);
+  } catch (const std::exception& e) {
+    _logger->logf(LOGGING_ERROR,
+                  "[DetectionWriter] open() failure: could not start "
+                  "writer thread: %s",
+                  e.what());
+    std::fclose(_file);
+    _file = nullptr;
+    return RESULT_FAILURE_OTHER;
+  }
+  return RESULT_SUCCESS;
+}
+
+Result DetectionWriter::write(const uint64_t& frame, const std::string& source,
+                              std::vector<Detection>* detections) noexcept {
+  if (!isOpen()) {
+    if (_logger) {
+      _logger->log(LOGGING_ERROR,
+                   "[DetectionWriter] write() failure: not open");
+    }
+    return RESULT_FAILURE_NOT_INITIALIZED;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cv.wait(lock, [this]() {
+      return _numPending < _maxPending || _result != RESULT_SUCCESS;
+    });
+    if (_result != RESULT_SUCCESS) {
+      return _result;
+    }
+
+    try {
+      /*  Records beyond _numPending are kept for reuse  */
+      if (_numPending == (int)_pending.size()) {
+        _pending.emplace_back();
+      }
+      Record& record = _pending[_numPending];
+      record.frame = frame;
+      record.source = source;
+      std::swap(record.detections, *detections);
+      detections->clear();
+    } catch (const std::exception& e) {
+      _logger->logf(LOGGING_ERROR,
+                    "[DetectionWriter] write() failure: got exception: %s",
+                    e.what());
+      return RESULT_FAILURE_ALLOC;
+    }
+    _numPending += 1;
+  }
+  _cv.notify_all();
+  return RESULT_SUCCESS;
+}
+
+Result DetectionWriter::close() noexcept {
+  if (!isOpen()) {
+    return RESULT_SUCCESS;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _closing = true;
+  }
+  _cv.notify_all();
+  _thread.join();
+
+  if (std::fclose(_file) != 0 && _result == RESULT_SUCCESS) {
+    _logger->log(LOGGING_ERROR,
+                 "[DetectionWriter] close() failure: could not flush "
+                 "output file");
+    _result = RESULT_FAILURE_FILESYSTEM_ERROR;
+  }
+  _file = nullptr;
+  return _result;
+}
+
+bool DetectionWriter::isOpen() const noexcept { return _file != nullptr; }
+
+uint64_t DetectionWriter::numFrames() const noexcept {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _numFrames;
+}
+
+uint64_t DetectionWriter::numBytes() const noexcept {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _numBytes;
+}
+
+void DetectionWriter::setLogger(std::shared_ptr<Logger> logger) noexcept {
+  _logger = logger;
+}
+
+void DetectionWriter::_run() noexcept {
+  std::vector<Record> batch;
+  std::string buffer;
+  while (true) {
+    int numRecords = 0;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _cv.wait(lock, [this]() { return _numPending > 0 || _closing; });
+      if (_numPending == 0) {
+        break; /*  closing and nothing left to write   */
+      }
+      /*  The previous batch is handed back for reuse  */
+      std::swap(batch, _pending);
+      numRecords = _numPending;
+      _numPending = 0;
+    }
+    _cv.notify_all();
+
+    Result r = RESULT_SUCCESS;
+    buffer.clear();
+    try {
+      for (int i = 0; i < numRecords; ++i) {
+        _formatRecord(batch[i], &buffer);
+      }
+    } catch (const std::exception& e) {
+      _logger->logf(LOGGING_ERROR,
+                    "[DetectionWriter] failure: could not format "
+                    "detections: %s",
+                    e.what());
+      r = RESULT_FAILURE_ALLOC;
+    }
+    if (r == RESULT_SUCCESS &&
+        std::fwrite(buffer.data(), 1, buffer.size(), _file) != buffer.size()) {
+      _logger->log(LOGGING_ERROR,
+                   "[DetectionWriter] failure: could not write to "
+                   "output file");
+      r = RESULT_FAILURE_FILESYSTEM_ERROR;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (r != RESULT_SUCCESS) {
+        _result = r;
+      } else {
+        _numFrames += numRecords;
+        _numBytes += buffer.size();
+      }
+    }
+    if (r != RESULT_SUCCESS) {
+      _cv.notify_all();
+      break;
+    }
+  }
+}
+
+void DetectionWriter::_formatRecord(const Record& record,
+                                   std::string* out) const {
+  if (_format == DETECTION_FORMAT_BINARY) {
+    appendBinary((uint64_t)record.frame, out);
+    appendBinary((uint32_t)record.detections.size(), out);
+    for (const Detection& detection : record.detections) {
+      const cv::Rect& box = detection.boundingBox();
+      appendBinary((int32_t)detection.classId(), out);
+      appendBinary((float)detection.score(), out);
+      appendBinary((int32_t)box.x, out);
+      appendBinary((int32_t)box.y, out);
+      appendBinary((int32_t)box.width, out);
+      appendBinary((int32_t)box.height, out);
+    }
+    return;
+  }
+
+  char buffer[128];
+  std::snprintf(buffer, sizeof(buffer), "{\"frame\":%lu",
+                (unsigned long)record.frame);
+  out->append(buffer);
+  if (!record.source.empty()) {
+    out->append(",\"source\":");
+    appendJsonString(record.source, out);
+  }
+  out->append(",\"detections\":[");
+  for (size_t i = 0; i < record.detections.size(); ++i) {
+    const Detection& detection = record.detections[i];
+    const cv::Rect& box = detection.boundingBox();
+    std::snprintf(buffer, sizeof(buffer), "%s{\"class\":%i",
+                  i > 0 ? "," : "", (int)detection.classId());
+    out->append(buffer);
+    if (!detection.className().empty()) {
+      out->append(",\"name\":");
+      appendJsonString(detection.className(), out);
+    }
+    std::snprintf(buffer, sizeof(buffer),
+                  ",\"score\":%.4f,\"box\":[%i,%i,%i,%i]}", detection.score(),
+                  box.x, box.y, box.width, box.height);
+    out->append(buffer);
+  }
+  out->append("]}\n");
+}
+
+} /*  namespace yolov5    */
\ No newline at end of file
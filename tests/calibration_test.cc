@@ -0,0 +1,145 @@
+/*  CalibrationStream on the CPU: listing a dataset, and streaming it
+ *  through the letterbox pre-processing into NCHW batches. No CUDA device
+ *  is needed.
+ */
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "yolov5_calibrator.h"
+#include "yolov5_test.h"
+
+namespace {
+
+const int NETWORK_SIZE = 64;
+
+/*  A dataset of white 64x32 images (letterboxed to rows 16..47 of the
+    network input), plus one file that cannot be decoded  */
+struct Dataset {
+  Dataset() {
+    directory = std::filesystem::temp_directory_path() /
+                ("yolov5_calibration_test_" + std::to_string(::getpid()));
+    std::filesystem::create_directories(directory);
+
+    const cv::Mat white(NETWORK_SIZE / 2, NETWORK_SIZE, CV_8UC3,
+                        cv::Scalar::all(255));
+    for (int i = 0; i < 5; ++i) {
+      const std::string file =
+          (directory / ("image" + std::to_string(i) + ".png")).string();
+      cv::imwrite(file, white);
+      files.push_back(file);
+    }
+    corrupt = (directory / "corrupt.jpg").string();
+    std::ofstream(corrupt) << "not an image";
+    files.push_back(corrupt);
+    std::ofstream(directory / "notes.txt") << "ignored";
+
+    listFile = (directory / "list.txt").string();
+    std::ofstream list(listFile);
+    for (const std::string& file : files) {
+      list << file << "\n";
+    }
+    std::sort(files.begin(), files.end());
+  }
+
+  ~Dataset() {
+    std::error_code error;
+    std::filesystem::remove_all(directory, error);
+  }
+
+  std::filesystem::path directory;
+  std::vector<std::string> files; /**<    sorted, including the corrupt one */
+  std::string corrupt;
+  std::string listFile;
+};
+
+int testListImages() {
+  int failures = 0;
+  Dataset dataset;
+
+  std::vector<std::string> files;
+  YOLOV5_CHECK(yolov5::CalibrationStream::listImages(
+                   dataset.directory.string(), &files) ==
+               yolov5::RESULT_SUCCESS);
+  YOLOV5_CHECK(files == dataset.files);
+
+  files.clear();
+  YOLOV5_CHECK(yolov5::CalibrationStream::listImages(dataset.listFile,
+                                                     &files) ==
+               yolov5::RESULT_SUCCESS);
+  YOLOV5_CHECK(files == dataset.files);
+
+  YOLOV5_CHECK(yolov5::CalibrationStream::listImages(
+                   (dataset.directory / "missing.txt").string(), &files) !=
+               yolov5::RESULT_SUCCESS);
+  return failures;
+}
+
+int testStream() {
+  int failures = 0;
+  Dataset dataset;
+
+  nvinfer1::Dims dims;
+  dims.nbDims = 4;
+  dims.d[0] = 2;
+  dims.d[1] = 3;
+  dims.d[2] = NETWORK_SIZE;
+  dims.d[3] = NETWORK_SIZE;
+
+  yolov5::CalibrationStream stream;
+  YOLOV5_CHECK(stream.start(dataset.files, dims, 2, 1) ==
+               yolov5::RESULT_SUCCESS);
+  YOLOV5_CHECK(stream.numBatches() == 3);
+
+  const size_t plane = NETWORK_SIZE * NETWORK_SIZE;
+  int numBatches = 0, numBlack = 0, numLetterboxed = 0;
+  std::vector<float> batch;
+  while (stream.next(&batch)) {
+    numBatches += 1;
+    YOLOV5_CHECK(batch.size() == 2 * 3 * plane);
+    if (batch.size() != 2 * 3 * plane) {
+      break;
+    }
+    for (int image = 0; image < 2; ++image) {
+      const float* pixels = batch.data() + image * 3 * plane;
+      if (std::all_of(pixels, pixels + 3 * plane,
+                      [](const float& v) { return v == 0.0f; })) {
+        numBlack += 1;
+        continue;
+      }
+
+      /*  black padding above and below, white in between   */
+      bool letterboxed = true;
+      for (size_t i = 0; i < 3 * plane; ++i) {
+        const int row = (i % plane) / NETWORK_SIZE;
+        const bool inside =
+            row >= NETWORK_SIZE / 4 && row < NETWORK_SIZE * 3 / 4;
+        letterboxed &= pixels[i] == (inside ? 1.0f : 0.0f);
+      }
+      numLetterboxed += letterboxed ? 1 : 0;
+    }
+  }
+  YOLOV5_CHECK(numBatches == 3);
+  YOLOV5_CHECK(numBlack == 1);
+  YOLOV5_CHECK(numLetterboxed == 5);
+  YOLOV5_CHECK(stream.numFailedImages() == 1);
+
+  /*  not enough images for a single batch  */
+  dims.d[0] = 8;
+  YOLOV5_CHECK(stream.start(dataset.files, dims, 1, 1) ==
+               yolov5::RESULT_FAILURE_INVALID_INPUT);
+  return failures;
+}
+
+} /*  namespace   */
+
+int main() {
+  int failures = 0;
+  YOLOV5_RUN_TEST(testListImages);
+  YOLOV5_RUN_TEST(testStream);
+  return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
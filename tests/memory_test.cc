@@ -0,0 +1,123 @@
+/*  Sizing and alignment of the engine bindings, with the HostAllocator
+ *  standing in for the CUDA allocators. No CUDA device is needed.
+ */
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "yolov5_detector_internal.h"
+#include "yolov5_test.h"
+
+namespace {
+
+using namespace yolov5::internal;
+
+bool isAligned(const void* ptr) {
+  return ((uintptr_t)ptr % DeviceMemory::ALIGNMENT) == 0;
+}
+
+int testDataTypeSize() {
+  int failures = 0;
+  YOLOV5_CHECK(dataTypeSize(nvinfer1::DataType::kFLOAT) == 4);
+  YOLOV5_CHECK(dataTypeSize(nvinfer1::DataType::kHALF) == 2);
+  YOLOV5_CHECK(dataTypeSize(nvinfer1::DataType::kINT32) == 4);
+  YOLOV5_CHECK(dataTypeSize(nvinfer1::DataType::kINT8) == 1);
+  YOLOV5_CHECK(dataTypeSize(nvinfer1::DataType::kBOOL) == 1);
+  YOLOV5_CHECK(dataTypeSize((nvinfer1::DataType)-1) == 0);
+  return failures;
+}
+
+int testArenaLayout() {
+  int failures = 0;
+  ArenaLayout layout;
+  YOLOV5_CHECK(layout.setup({100, 0, 300, 256}, 2, 256));
+  YOLOV5_CHECK(layout.numBindings() == 4);
+  YOLOV5_CHECK(layout.numSlots() == 2);
+
+  /*  every binding starts at a multiple of the alignment; empty bindings
+      take no space   */
+  YOLOV5_CHECK(layout.offset(0, 0) == 0);
+  YOLOV5_CHECK(layout.offset(1, 0) == 256);
+  YOLOV5_CHECK(layout.offset(2, 0) == 256);
+  YOLOV5_CHECK(layout.offset(3, 0) == 768);
+  YOLOV5_CHECK(layout.offset(0, 1) == 1024);
+  YOLOV5_CHECK(layout.offset(3, 1) == 1024 + 768);
+  for (int slot = 0; slot < 2; ++slot) {
+    for (int binding = 0; binding < 4; ++binding) {
+      YOLOV5_CHECK(layout.offset(binding, slot) % 256 == 0);
+    }
+  }
+
+  YOLOV5_CHECK(layout.size(2) == 300);
+  YOLOV5_CHECK(layout.totalSize() == 2048);
+  YOLOV5_CHECK(layout.usedSize() == 2 * 656);
+
+  YOLOV5_CHECK(!layout.setup({100}, 1, 3));   /*  not a power of two */
+  YOLOV5_CHECK(!layout.setup({100}, 0, 256)); /*  no slots   */
+  return failures;
+}
+
+int testDeviceMemory() {
+  int failures = 0;
+  std::shared_ptr<yolov5::Logger> logger = std::make_shared<yolov5::Logger>();
+  logger->setMinLevel(yolov5::LOGGING_ERROR);
+
+  auto device = std::make_shared<CountingAllocator>(
+      std::make_shared<HostAllocator>());
+  auto host = std::make_shared<CountingAllocator>(
+      std::make_shared<HostAllocator>());
+  {
+    DeviceMemory memory;
+    YOLOV5_CHECK(DeviceMemory::setup(logger, {100, 0, 300}, {2}, 2, device,
+                                     host, &memory) ==
+                 yolov5::RESULT_SUCCESS);
+
+    for (int slot = 0; slot < 2; ++slot) {
+      YOLOV5_CHECK(memory.at(0, slot) != nullptr);
+      YOLOV5_CHECK(memory.at(1, slot) == nullptr);
+      YOLOV5_CHECK(memory.at(2, slot) != nullptr);
+      YOLOV5_CHECK(isAligned(memory.at(0, slot)));
+      YOLOV5_CHECK(isAligned(memory.at(2, slot)));
+      YOLOV5_CHECK(memory.begin(slot)[2] == memory.at(2, slot));
+
+      /*  only the selected binding is mirrored on the host   */
+      YOLOV5_CHECK(memory.hostAt(0, slot) == nullptr);
+      YOLOV5_CHECK(memory.hostAt(2, slot) != nullptr);
+      YOLOV5_CHECK(isAligned(memory.hostAt(2, slot)));
+    }
+    YOLOV5_CHECK((char*)memory.at(2, 0) - (char*)memory.at(0, 0) == 256);
+    YOLOV5_CHECK((char*)memory.at(0, 1) - (char*)memory.at(0, 0) == 768);
+    YOLOV5_CHECK(memory.size(2) == 300);
+
+    const yolov5::MemoryUsage usage = memory.usage();
+    YOLOV5_CHECK(usage.deviceBytes == 1536);
+    YOLOV5_CHECK(usage.hostBytes == 1024);
+    YOLOV5_CHECK(usage.bindingBytes == 800);
+    YOLOV5_CHECK(!usage.hostPinned);
+    YOLOV5_CHECK(usage.numBindings == 3);
+    YOLOV5_CHECK(usage.numSlots == 2);
+
+    YOLOV5_CHECK(device->stats().liveBytes == 1536);
+    YOLOV5_CHECK(host->stats().liveBytes == 1024);
+
+    YOLOV5_CHECK(DeviceMemory::setup(logger, {100}, {5}, 1, device, host,
+                                     &memory) ==
+                 yolov5::RESULT_FAILURE_INVALID_INPUT);
+  }
+
+  /*  everything is freed with the DeviceMemory   */
+  YOLOV5_CHECK(device->stats().allocations == 1);
+  YOLOV5_CHECK(device->stats().liveBytes == 0);
+  YOLOV5_CHECK(host->stats().liveBytes == 0);
+  return failures;
+}
+
+} /*  namespace   */
+
+int main() {
+  int failures = 0;
+  YOLOV5_RUN_TEST(testDataTypeSize);
+  YOLOV5_RUN_TEST(testArenaLayout);
+  YOLOV5_RUN_TEST(testDeviceMemory);
+  return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,132 @@
+/*  The Prometheus exposition of the MetricsRegistry, and the MetricsServer
+ *  on an ephemeral port of localhost.
+ */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+
+#include "yolov5_metrics.h"
+#include "yolov5_test.h"
+
+namespace {
+
+bool contains(const std::string& str, const std::string& part) {
+  return str.find(part) != std::string::npos;
+}
+
+/*  Send a raw request and return the complete response   */
+std::string request(const int& port, const std::string& request) {
+  const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return "";
+  }
+  sockaddr_in address;
+  std::memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  std::string response;
+  if (::connect(fd, (sockaddr*)&address, sizeof(address)) == 0 &&
+      ::send(fd, request.data(), request.size(), 0) ==
+          (ssize_t)request.size()) {
+    char buffer[4096];
+    ssize_t n = 0;
+    while ((n = ::recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+      response.append(buffer, n);
+    }
+  }
+  ::close(fd);
+  return response;
+}
+
+int testExposition() {
+  int failures = 0;
+  yolov5::MetricsRegistry registry;
+
+  registry.counter("test_frames_total", "Frames", "stream=\"0\"")->add(3);
+  registry.gauge("test_depth", "Queue depth")->set(1.5);
+  registry.countResult(yolov5::RESULT_FAILURE_CUDA_ERROR);
+
+  yolov5::Histogram* latency =
+      registry.histogram("test_latency_seconds", "Latency");
+  latency->record(50);   /*  50 us    */
+  latency->record(150);  /*  150 us   */
+  latency->record(2550); /*  in a bucket that straddles 2.5 ms   */
+
+  std::string str;
+  YOLOV5_CHECK(registry.toPrometheus(&str));
+  YOLOV5_CHECK(contains(str, "# HELP test_frames_total Frames\n"));
+  YOLOV5_CHECK(contains(str, "# TYPE test_frames_total counter\n"));
+  YOLOV5_CHECK(contains(str, "test_frames_total{stream=\"0\"} 3\n"));
+  YOLOV5_CHECK(contains(str, "# TYPE test_depth gauge\n"));
+  YOLOV5_CHECK(contains(str, "test_depth 1.5\n"));
+  YOLOV5_CHECK(contains(str, "# TYPE test_latency_seconds histogram\n"));
+
+  /*  cumulative, and no bucket counts samples above its bound   */
+  YOLOV5_CHECK(contains(str, "test_latency_seconds_bucket{le=\"0.0001\"} 1\n"));
+  YOLOV5_CHECK(
+      contains(str, "test_latency_seconds_bucket{le=\"0.00025\"} 2\n"));
+  YOLOV5_CHECK(contains(str, "test_latency_seconds_bucket{le=\"0.0025\"} 2\n"));
+  YOLOV5_CHECK(contains(str, "test_latency_seconds_bucket{le=\"0.005\"} 3\n"));
+  YOLOV5_CHECK(contains(str, "test_latency_seconds_bucket{le=\"+Inf\"} 3\n"));
+  YOLOV5_CHECK(contains(str, "test_latency_seconds_count 3\n"));
+  return failures;
+}
+
+int testBucketMax() {
+  int failures = 0;
+  typedef yolov5::LatencyHistogram H;
+  for (int i = 0; i + 1 < H::NUM_BUCKETS; ++i) {
+    YOLOV5_CHECK(H::bucketIndex(H::bucketMax(i)) == i);
+    YOLOV5_CHECK(H::bucketIndex(H::bucketMax(i) + 1) == i + 1);
+    if (failures > 0) {
+      break;
+    }
+  }
+  YOLOV5_CHECK(H::bucketMax(H::NUM_BUCKETS - 1) == UINT64_MAX);
+  return failures;
+}
+
+int testServer() {
+  int failures = 0;
+  yolov5::MetricsRegistry registry;
+  registry.counter("test_requests_total", "Requests")->add(7);
+
+  yolov5::MetricsServer server;
+  YOLOV5_CHECK(server.start(&registry, 0) == yolov5::RESULT_SUCCESS);
+  const int port = server.port();
+  YOLOV5_CHECK(port > 0);
+
+  const std::string metrics =
+      request(port, "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n");
+  YOLOV5_CHECK(metrics.compare(0, 15, "HTTP/1.1 200 OK") == 0);
+  YOLOV5_CHECK(contains(metrics, "Content-Type: text/plain; version=0.0.4"));
+  YOLOV5_CHECK(contains(metrics, "\r\n\r\n# HELP test_requests_total"));
+  YOLOV5_CHECK(contains(metrics, "test_requests_total 7\n"));
+
+  const std::string missing =
+      request(port, "GET /other HTTP/1.1\r\nHost: localhost\r\n\r\n");
+  YOLOV5_CHECK(missing.compare(0, 22, "HTTP/1.1 404 Not Found") == 0);
+
+  const std::string post =
+      request(port, "POST /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n");
+  YOLOV5_CHECK(post.compare(0, 31, "HTTP/1.1 405 Method Not Allowed") == 0);
+
+  server.stop();
+  return failures;
+}
+
+} /*  namespace   */
+
+int main() {
+  int failures = 0;
+  YOLOV5_RUN_TEST(testExposition);
+  YOLOV5_RUN_TEST(testBucketMax);
+  YOLOV5_RUN_TEST(testServer);
+  return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,27 @@
+#ifndef _YOLOV5_TEST_HPP_
+#define _YOLOV5_TEST_HPP_
+#pragma once
+
+#include <cstdio>
+
+/*  Minimal checks for the CPU-only tests. Every test is a function that
+    returns the number of failed checks; main() adds them up and returns
+    non-zero if any failed, which is what CTest looks at  */
+
+#define YOLOV5_CHECK(condition)                                       \
+  do {                                                                \
+    if (!(condition)) {                                               \
+      std::fprintf(stderr, "%s:%i: check failed: %s\n", __FILE__,     \
+                   __LINE__, #condition);                             \
+      ++failures;                                                     \
+    }                                                                 \
+  } while (0)
+
+#define YOLOV5_RUN_TEST(test)                                         \
+  do {                                                                \
+    const int r = test();                                             \
+    std::printf("%-40s %s\n", #test, r == 0 ? "ok" : "FAILED");       \
+    failures += r;                                                    \
+  } while (0)
+
+#endif /*  include guard   */
\ No newline at end of file